@@ -0,0 +1,148 @@
+// Outbound control messages: string concatenation as the protocols used to build
+// them against JsonWriter over a stack buffer or a reused string.
+// ./build-host/json_writer_bench [iterations]
+#include "json_writer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+static const std::string session_id = "8f3c1a2e-54b7-4d0e-9a61-0c2b7e3f9d45";
+static const std::string wake_word = "你好小智";
+static const std::string states = "[{\"name\":\"Speaker\",\"state\":{\"volume\":70}},"
+                                  "{\"name\":\"Screen\",\"state\":{\"theme\":\"dark\",\"brightness\":80}}]";
+
+// Keeps the compiler from dropping the messages
+static volatile size_t sink = 0;
+
+static void ConcatListen() {
+    std::string message = "{\"session_id\":\"" + session_id + "\"";
+    message += ",\"type\":\"listen\",\"state\":\"start\"";
+    message += ",\"mode\":\"auto\"";
+    message += "}";
+    sink = sink + message.size();
+}
+
+static void WriterListen() {
+    char buffer[256];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.BeginObject();
+    json.Key("session_id").String(session_id);
+    json.Key("type").String("listen");
+    json.Key("state").String("start");
+    json.Key("mode").String("auto");
+    json.EndObject();
+    sink = sink + json.size();
+}
+
+static void ConcatWakeWord() {
+    std::string json = "{\"session_id\":\"" + session_id +
+                      "\",\"type\":\"listen\",\"state\":\"detect\",\"text\":\"" + wake_word + "\"}";
+    sink = sink + json.size();
+}
+
+static void WriterWakeWord() {
+    char buffer[256];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.BeginObject();
+    json.Key("session_id").String(session_id);
+    json.Key("type").String("listen");
+    json.Key("state").String("detect");
+    json.Key("text").String(wake_word);
+    json.EndObject();
+    sink = sink + json.size();
+}
+
+static void ConcatHello() {
+    std::string message = "{";
+    message += "\"type\":\"hello\",";
+    message += "\"version\": 3,";
+    message += "\"transport\":\"udp\",";
+    message += "\"audio_params\":{";
+    message += "\"format\":\"opus\", \"sample_rate\":16000, \"channels\":1, \"frame_duration\":" + std::to_string(60);
+    message += "}}";
+    sink = sink + message.size();
+}
+
+static void WriterHello() {
+    char buffer[256];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.BeginObject();
+    json.Key("type").String("hello");
+    json.Key("version").Int(3);
+    json.Key("transport").String("udp");
+    json.Key("audio_params").BeginObject();
+    json.Key("format").String("opus");
+    json.Key("sample_rate").Int(16000);
+    json.Key("channels").Int(1);
+    json.Key("frame_duration").Int(60);
+    json.EndObject();
+    json.EndObject();
+    sink = sink + json.size();
+}
+
+static void ConcatIotStates() {
+    std::string message = "{\"session_id\":\"" + session_id + "\",\"type\":\"iot\",\"update\":true,\"states\":" + states + "}";
+    sink = sink + message.size();
+}
+
+static void WriterIotStates() {
+    std::string message;
+    message.reserve(states.size() + 96 + session_id.size());
+    JsonWriter json(message);
+    json.BeginObject();
+    json.Key("session_id").String(session_id);
+    json.Key("type").String("iot");
+    json.Key("update").Bool(true);
+    json.Key("states").Raw(states);
+    json.EndObject();
+    sink = sink + json.size();
+}
+
+static void Run(const char* name, void (*function)(), int iterations) {
+    for (int i = 0; i < iterations / 10; i++) {
+        function();
+    }
+    size_t start_allocations = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        function();
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    printf("%-20s %10.1f ns/msg %8.2f allocs/msg\n", name, elapsed / iterations,
+           (double)(allocations - start_allocations) / iterations);
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+    Run("concat listen", ConcatListen, iterations);
+    Run("writer listen", WriterListen, iterations);
+    Run("concat wake_word", ConcatWakeWord, iterations);
+    Run("writer wake_word", WriterWakeWord, iterations);
+    Run("concat hello", ConcatHello, iterations);
+    Run("writer hello", WriterHello, iterations);
+    Run("concat iot states", ConcatIotStates, iterations);
+    Run("writer iot states", WriterIotStates, iterations);
+    return 0;
+}
@@ -0,0 +1,244 @@
+// Spectrum visualizer frames: the per-pixel std::function path SpectrumDisplay used to take
+// against the templated renderer filling columns of the framebuffer, for each style. Before
+// timing, the frames of both paths are compared pixel for pixel, except for the line style
+// whose points the renderer now joins into a continuous line.
+// ./build-host/spectrum_bench [frames]
+#include "spectrumdisplay.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+static constexpr int width = 142;
+static constexpr int height = 16;
+static constexpr int bins = 256;
+static constexpr int steps = 5;
+
+static float spectra[8][bins];
+static volatile size_t sink = 0;
+
+// 1-bpp framebuffer, columns of a row in consecutive bits like a monochrome LVGL buffer
+struct Framebuffer {
+    uint8_t bits[height][(width + 7) / 8];
+
+    void clear() {
+        memset(bits, 0, sizeof(bits));
+    }
+
+    void fill_column(int x, int y1, int y2, uint8_t level) {
+        if (level == 0) {
+            return;
+        }
+        for (int y = y1; y <= y2; y++) {
+            bits[y][x >> 3] |= 0x80 >> (x & 7);
+        }
+    }
+
+    void draw_point(int x, int y, uint8_t dot) {
+        if (x < 0 || y < 0 || x >= width || y >= height) {
+            return;
+        }
+        if (dot) {
+            bits[y][x >> 3] |= 0x80 >> (x & 7);
+        } else {
+            bits[y][x >> 3] &= ~(0x80 >> (x & 7));
+        }
+    }
+};
+
+// The previous SpectrumDisplay: std::pow per frame and a callback per pixel
+struct CallbackPath {
+    std::function<void(int, int, uint8_t)> draw;
+    float current[bins] = {};
+    float target[bins] = {};
+    float interpolated[bins] = {};
+    int step = steps;
+
+    void Interpolate(float* out) {
+        float eased = 1 - std::pow(1 - static_cast<float>(step) / steps, 4);
+        for (int i = 0; i < bins; i++) {
+            out[i] = current[i] + (target[i] - current[i]) * eased;
+        }
+    }
+
+    void Input(const float* data) {
+        if (step < steps) {
+            Interpolate(current);
+        } else {
+            memcpy(current, target, sizeof(current));
+        }
+        memcpy(target, data, sizeof(target));
+        step = 0;
+    }
+
+    void Bars(const float* data, bool gradient) {
+        for (int i = 0; i < width; i++) {
+            int bar = static_cast<int>(data[i * bins / width] * FFT_FACTOR);
+            for (int x = i; x < i + 4; x++) {
+                for (int y = 0; y < bar && y <= height; y++) {
+                    draw(x, height - y - 1, gradient ? bar : 1);
+                }
+            }
+        }
+    }
+
+    void Line(const float* data) {
+        for (int i = 0; i < width - 1; i++) {
+            int y1 = static_cast<int>(data[i * (bins - 40) / width + 40] * FFT_FACTOR);
+            int y2 = static_cast<int>(data[(i + 1) * (bins - 40) / width + 40] * FFT_FACTOR);
+            draw(i, height - y1 - 1, 1);
+            draw(i + 1, height - y2 - 1, 1);
+        }
+    }
+
+    void Dot(const float* data) {
+        for (int i = 0; i < width; i++) {
+            int y = static_cast<int>(data[i * (bins - 40) / width + 40] * FFT_FACTOR);
+            y = y > height - 1 ? height - 1 : (y < 1 ? 0 : y);
+            for (int j = (height - y) / 2; j < (height - y) / 2 + y; j++) {
+                draw(i, j, 1);
+            }
+        }
+    }
+
+    void Polygon(const float* data) {
+        for (int i = 0; i < width - 1; i++) {
+            for (int x = i; x <= i + 1; x++) {
+                int y = static_cast<int>(data[x * bins / width] * FFT_FACTOR);
+                for (int j = y; j < height; j++) {
+                    draw(x, j, 1);
+                }
+            }
+        }
+    }
+
+    void CenteredBars(const float* data) {
+        for (int i = 0; i < width; i++) {
+            int bar = static_cast<int>(data[i * bins / width] * FFT_FACTOR);
+            int start = height / 2 - bar / 2;
+            for (int x = i; x < i + 4; x++) {
+                for (int y = start; y < start + bar && y <= height; y++) {
+                    draw(x, y, 1);
+                }
+            }
+        }
+    }
+
+    bool Process(SpectrumStyle style) {
+        if (step >= steps) {
+            return false;
+        }
+        Interpolate(interpolated);
+        switch (style) {
+        case STYLE_BAR:
+            Bars(interpolated, false);
+            break;
+        case STYLE_LINE:
+            Line(interpolated);
+            break;
+        case STYLE_DOT:
+            Dot(interpolated);
+            break;
+        case STYLE_POLYGON:
+            Polygon(interpolated);
+            break;
+        case STYLE_CENTERED_BAR:
+            CenteredBars(interpolated);
+            break;
+        default:
+            Bars(interpolated, true);
+            break;
+        }
+        step++;
+        return true;
+    }
+};
+
+static const char* names[STYLE_MAX] = {"bar", "line", "dot", "polygon", "centered bar", "gradient bar"};
+
+// Frames of a style that differ between the two paths, over every step of all spectra twice
+static int Compare(SpectrumStyle style) {
+    Framebuffer expected;
+    Framebuffer actual;
+    CallbackPath old_path;
+    old_path.draw = [&expected](int x, int y, uint8_t dot) { expected.draw_point(x, y, dot); };
+    SpectrumDisplay<Framebuffer> renderer(actual, width, height);
+    renderer.setSpectrumStyle(style);
+    int differing = 0;
+    for (int i = 0; i < 2 * 8 * steps; i++) {
+        if (i % steps == 0) {
+            old_path.Input(spectra[(i / steps) % 8]);
+            renderer.inputFFTData(spectra[(i / steps) % 8], bins);
+        }
+        expected.clear();
+        old_path.Process(style);
+        renderer.spectrumProcess(0);
+        if (memcmp(expected.bits, actual.bits, sizeof(expected.bits)) != 0) {
+            differing++;
+        }
+    }
+    return differing;
+}
+
+template <typename Frame>
+static double Measure(Frame frame, int frames) {
+    for (int i = 0; i < frames / 10; i++) {
+        frame(i);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        frame(i);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return frames / elapsed;
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 200000;
+    for (int s = 0; s < 8; s++) {
+        for (int i = 0; i < bins; i++) {
+            spectra[s][i] = 18.0f + 16.0f * sinf(i * 0.09f + s * 0.8f) * cosf(i * 0.023f - s * 0.3f);
+        }
+    }
+
+    for (int style = 0; style < STYLE_MAX; style++) {
+        if (style == STYLE_LINE) {
+            continue;
+        }
+        int differing = Compare((SpectrumStyle)style);
+        if (differing > 0) {
+            printf("%s: %d frames differ between the two paths\n", names[style], differing);
+            return 1;
+        }
+    }
+
+    Framebuffer framebuffer;
+    for (int style = 0; style < STYLE_MAX; style++) {
+        CallbackPath old_path;
+        old_path.draw = [&framebuffer](int x, int y, uint8_t dot) { framebuffer.draw_point(x, y, dot); };
+        double old_fps = Measure([&](int i) {
+            if (i % steps == 0) {
+                old_path.Input(spectra[(i / steps) % 8]);
+            }
+            framebuffer.clear();
+            old_path.Process((SpectrumStyle)style);
+            sink = sink + framebuffer.bits[height - 1][i % sizeof(framebuffer.bits[0])];
+        }, frames);
+
+        SpectrumDisplay<Framebuffer> renderer(framebuffer, width, height);
+        renderer.setSpectrumStyle((SpectrumStyle)style);
+        double new_fps = Measure([&](int i) {
+            if (i % steps == 0) {
+                renderer.inputFFTData(spectra[(i / steps) % 8], bins);
+            }
+            renderer.spectrumProcess(0);
+            sink = sink + framebuffer.bits[height - 1][i % sizeof(framebuffer.bits[0])];
+        }, frames);
+
+        printf("%-14s callback %10.0f fps   columns %10.0f fps\n", names[style], old_fps, new_fps);
+    }
+    return 0;
+}
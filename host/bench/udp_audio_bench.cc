@@ -0,0 +1,184 @@
+// Encrypted UDP audio frames: the copy based path MqttProtocol used to take against
+// AudioFrameCipher with a reused frame buffer and recycled payload buffers.
+// ./build-host/udp_audio_bench [packets] [payload bytes]
+#include "audio_frame_cipher.h"
+
+#include <mbedtls/aes.h>
+#include <arpa/inet.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+static const std::string key_hex = "2b7e151628aed2a6abf7158809cf4f3c";
+static const std::string nonce_hex = "01000000a1b2c3d40000000000000000";
+
+static std::vector<uint8_t> payload;
+static uint32_t sequence = 0;
+static volatile size_t sink = 0;
+
+static std::string DecodeHexString(const std::string& hex_string) {
+    std::string decoded;
+    for (size_t i = 0; i < hex_string.size(); i += 2) {
+        decoded.push_back((char)strtol(hex_string.substr(i, 2).c_str(), nullptr, 16));
+    }
+    return decoded;
+}
+
+// The previous MqttProtocol::SendAudio and receive callback
+struct CopyPath {
+    mbedtls_aes_context aes_ctx;
+    std::string aes_nonce;
+    std::string received;
+
+    CopyPath() {
+        aes_nonce = DecodeHexString(nonce_hex);
+        mbedtls_aes_init(&aes_ctx);
+        mbedtls_aes_setkey_enc(&aes_ctx, (const unsigned char*)DecodeHexString(key_hex).c_str(), 128);
+    }
+
+    ~CopyPath() {
+        mbedtls_aes_free(&aes_ctx);
+    }
+
+    void Send() {
+        std::string nonce(aes_nonce);
+        *(uint16_t*)&nonce[2] = htons(payload.size());
+        *(uint32_t*)&nonce[12] = htonl(++sequence);
+
+        std::string encrypted;
+        encrypted.resize(aes_nonce.size() + payload.size());
+        memcpy(encrypted.data(), nonce.data(), nonce.size());
+        size_t nc_off = 0;
+        uint8_t stream_block[16] = {0};
+        mbedtls_aes_crypt_ctr(&aes_ctx, payload.size(), &nc_off, (uint8_t*)nonce.c_str(), stream_block,
+            payload.data(), (uint8_t*)&encrypted[nonce.size()]);
+        // The UDP client hands the datagram over as a string
+        received = encrypted;
+    }
+
+    void Receive() {
+        size_t decrypted_size = received.size() - aes_nonce.size();
+        size_t nc_off = 0;
+        uint8_t stream_block[16] = {0};
+        std::vector<uint8_t> decrypted(decrypted_size);
+        mbedtls_aes_crypt_ctr(&aes_ctx, decrypted_size, &nc_off, (uint8_t*)received.data(), stream_block,
+            (uint8_t*)received.data() + aes_nonce.size(), decrypted.data());
+        sink = sink + decrypted[0];
+    }
+};
+
+struct FramePath {
+    AudioFrameCipher cipher;
+    std::string frame;
+    std::string received;
+    std::vector<uint8_t> pool;
+
+    FramePath() {
+        cipher.SetKey(key_hex, nonce_hex);
+    }
+
+    void Send() {
+        frame.resize(AUDIO_FRAME_HEADER_SIZE + payload.size());
+        cipher.Seal(payload.data(), payload.size(), 0, ++sequence, (uint8_t*)&frame[0]);
+        received.assign(frame);
+    }
+
+    void Receive() {
+        uint32_t timestamp, received_sequence;
+        auto data = (const uint8_t*)received.data();
+        AudioFrameCipher::ParseHeader(data, received.size(), &timestamp, &received_sequence);
+        // Same as Protocol::AcquireAudioBuffer/ReleaseAudioBuffer with one buffer in flight
+        std::vector<uint8_t> decrypted = std::move(pool);
+        decrypted.resize(received.size() - AUDIO_FRAME_HEADER_SIZE);
+        cipher.Open(data, received.size(), decrypted.data());
+        sink = sink + decrypted[0];
+        decrypted.clear();
+        pool = std::move(decrypted);
+    }
+};
+
+template <typename Path>
+static void Run(const char* name, int packets) {
+    Path path;
+    for (int i = 0; i < packets / 10; i++) {
+        path.Send();
+        path.Receive();
+    }
+
+    size_t start_allocations = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < packets; i++) {
+        path.Send();
+    }
+    double send_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t send_allocations = allocations - start_allocations;
+
+    start_allocations = allocations;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < packets; i++) {
+        path.Receive();
+    }
+    double receive_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t receive_allocations = allocations - start_allocations;
+
+    printf("%-8s send %10.0f pkt/s %5.2f allocs/pkt   receive %10.0f pkt/s %5.2f allocs/pkt\n", name,
+           packets / send_seconds, (double)send_allocations / packets,
+           packets / receive_seconds, (double)receive_allocations / packets);
+}
+
+// Both paths must produce the same datagram and get the payload back
+static bool Verify() {
+    CopyPath copy;
+    FramePath frame;
+    sequence = 0;
+    copy.Send();
+    sequence = 0;
+    frame.Send();
+    if (copy.received != frame.received) {
+        return false;
+    }
+    std::vector<uint8_t> decrypted(payload.size());
+    return frame.cipher.Open((const uint8_t*)frame.received.data(), frame.received.size(), decrypted.data()) &&
+           decrypted == payload;
+}
+
+int main(int argc, char** argv) {
+    int packets = argc > 1 ? atoi(argv[1]) : 200000;
+    size_t payload_size = argc > 2 ? atoi(argv[2]) : 120;
+    payload.resize(payload_size);
+    for (size_t i = 0; i < payload_size; i++) {
+        payload[i] = i * 7;
+    }
+    if (!Verify()) {
+        printf("Frames differ between the two paths\n");
+        return 1;
+    }
+    printf("%d packets, %zu byte payload\n", packets, payload_size);
+    Run<CopyPath>("copy", packets);
+    Run<FramePath>("framed", packets);
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "host_audio_codec.h"
+
+#include <esp_log.h>
+
+#include <cstring>
+#include <thread>
+
+#define TAG "HostAudioCodec"
+
+// Falling further behind than this restarts the clock instead of bursting to catch up
+#define MAX_PACE_LAG_MS 100
+// A longer gap in the speaker output is a new playback rather than an underrun
+#define PLAYBACK_IDLE_MS 500
+
+HostAudioCodec::HostAudioCodec(int input_sample_rate, int output_sample_rate,
+                               const std::string& input_path, const std::string& output_path, bool realtime)
+    : realtime_(realtime) {
+    duplex_ = true;
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+
+    if (!input_path.empty()) {
+        input_file_ = fopen(input_path.c_str(), "rb");
+        if (input_file_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to open input %s", input_path.c_str());
+        }
+    }
+    if (!output_path.empty()) {
+        output_file_ = fopen(output_path.c_str(), "wb");
+        if (output_file_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to open output %s", output_path.c_str());
+        }
+    }
+    input_deadline_ = output_deadline_ = std::chrono::steady_clock::now();
+    ESP_LOGI(TAG, "Input %s @ %d Hz, output %s @ %d Hz",
+             input_file_ ? input_path.c_str() : "(silence)", input_sample_rate_,
+             output_file_ ? output_path.c_str() : "(discard)", output_sample_rate_);
+}
+
+HostAudioCodec::~HostAudioCodec() {
+    if (input_file_ != nullptr) {
+        fclose(input_file_);
+    }
+    if (output_file_ != nullptr) {
+        fclose(output_file_);
+    }
+}
+
+void HostAudioCodec::EnableOutput(bool enable) {
+    AudioCodec::EnableOutput(enable);
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    if (!enable && output_file_ != nullptr) {
+        fflush(output_file_);
+    }
+}
+
+void HostAudioCodec::Pace(std::chrono::steady_clock::time_point& deadline, int samples, int sample_rate,
+                          std::chrono::microseconds buffered) {
+    if (!realtime_) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now - deadline > std::chrono::milliseconds(MAX_PACE_LAG_MS)) {
+        deadline = now;
+    }
+    deadline += std::chrono::microseconds((int64_t)samples * 1000000 / sample_rate);
+    std::this_thread::sleep_until(deadline - buffered);
+}
+
+// The benchmark runner parses these lines for time-to-first-audio and underruns
+void HostAudioCodec::CheckUnderrun() {
+    if (!realtime_) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    auto gap = std::chrono::duration_cast<std::chrono::milliseconds>(now - output_deadline_).count();
+    if (gap >= PLAYBACK_IDLE_MS) {
+        ESP_LOGI(TAG, "Playback started");
+    } else if (gap > 0) {
+        ESP_LOGW(TAG, "Underrun %d ms", (int)gap);
+    }
+    if (gap > 0) {
+        // A drained speaker does not catch up, playback resumes from now
+        output_deadline_ = now;
+    }
+}
+
+int HostAudioCodec::Read(int16_t* dest, int samples) {
+    Pace(input_deadline_, samples / input_channels_, input_sample_rate_);
+    size_t read = 0;
+    if (input_enabled_ && input_file_ != nullptr) {
+        read = fread(dest, sizeof(int16_t), samples, input_file_);
+    }
+    // The microphone keeps delivering silence once the file runs out
+    memset(dest + read, 0, (samples - read) * sizeof(int16_t));
+    return samples;
+}
+
+int HostAudioCodec::Write(const int16_t* data, int samples) {
+    CheckUnderrun();
+    if (output_enabled_) {
+        std::lock_guard<std::mutex> lock(output_mutex_);
+        if (output_file_ != nullptr) {
+            fwrite(data, sizeof(int16_t), samples, output_file_);
+        }
+    }
+    // Like I2S, return once the rest fits into the DMA buffers instead of after it is played
+    auto dma_buffered = std::chrono::microseconds((int64_t)AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM * 1000000 / output_sample_rate_);
+    Pace(output_deadline_, samples / output_channels_, output_sample_rate_, dma_buffered);
+    return samples;
+}
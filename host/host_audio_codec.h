@@ -0,0 +1,37 @@
+#ifndef _HOST_AUDIO_CODEC_H
+#define _HOST_AUDIO_CODEC_H
+
+#include "audio_codec.h"
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+// File backed codec for the host build: the microphone reads raw PCM from a file
+// and the speaker appends raw PCM to another one, both at the I2S pace
+class HostAudioCodec : public AudioCodec {
+private:
+    FILE* input_file_ = nullptr;
+    FILE* output_file_ = nullptr;
+    std::mutex output_mutex_;
+    bool realtime_;
+    std::chrono::steady_clock::time_point input_deadline_;
+    std::chrono::steady_clock::time_point output_deadline_;
+
+    void Pace(std::chrono::steady_clock::time_point& deadline, int samples, int sample_rate,
+              std::chrono::microseconds buffered = std::chrono::microseconds(0));
+    void CheckUnderrun();
+
+    virtual int Read(int16_t* dest, int samples) override;
+    virtual int Write(const int16_t* data, int samples) override;
+
+public:
+    HostAudioCodec(int input_sample_rate, int output_sample_rate,
+                   const std::string& input_path, const std::string& output_path, bool realtime);
+    virtual ~HostAudioCodec();
+
+    virtual void EnableOutput(bool enable) override;
+};
+
+#endif // _HOST_AUDIO_CODEC_H
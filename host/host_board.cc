@@ -0,0 +1,133 @@
+#include "board.h"
+#include "display.h"
+#include "system_info.h"
+#include "json_writer.h"
+#include "host_config.h"
+#include "host_audio_codec.h"
+#include "iot/thing_manager.h"
+
+#include <esp_log.h>
+#include <font_awesome_symbols.h>
+#include <posix_http.h>
+#include <posix_mqtt.h>
+#include <posix_udp.h>
+#include <tcp_transport.h>
+
+#include <mutex>
+
+#define TAG "HostBoard"
+
+// Prints what a screen would show so that the state flow can be followed on the console
+class HostDisplay : public Display {
+private:
+    std::recursive_timed_mutex mutex_;
+
+    virtual bool Lock(int timeout_ms = 0) override {
+        if (timeout_ms <= 0) {
+            mutex_.lock();
+            return true;
+        }
+        return mutex_.try_lock_for(std::chrono::milliseconds(timeout_ms));
+    }
+
+    virtual void Unlock() override {
+        mutex_.unlock();
+    }
+
+public:
+    virtual void SetStatus(const char* status) override {
+        ESP_LOGI(TAG, "Status: %s", status);
+    }
+
+    virtual void ShowNotification(const char* notification, int duration_ms = 3000) override {
+        ESP_LOGI(TAG, "Notification: %s", notification);
+    }
+
+    virtual void ShowNotification(const std::string& notification, int duration_ms = 3000) override {
+        ShowNotification(notification.c_str(), duration_ms);
+    }
+
+    virtual void SetEmotion(const char* emotion) override {
+        ESP_LOGI(TAG, "Emotion: %s", emotion);
+    }
+
+    virtual void SetChatMessage(const char* role, const char* content) override {
+        if (content != nullptr && content[0] != '\0') {
+            ESP_LOGI(TAG, "%s: %s", role, content);
+        }
+    }
+
+    virtual void SetIcon(const char* icon) override {
+        ESP_LOGI(TAG, "Icon: %s", icon);
+    }
+};
+
+// A board for Linux and macOS, the network goes through BSD sockets and the audio through files
+class HostBoard : public Board {
+private:
+    void InitializeIot() {
+        auto& thing_manager = iot::ThingManager::GetInstance();
+        thing_manager.AddThing(iot::CreateThing("Speaker"));
+    }
+
+public:
+    HostBoard() {
+        ESP_LOGI(TAG, "Initializing host board");
+        InitializeIot();
+    }
+
+    virtual std::string GetBoardType() override {
+        return "host";
+    }
+
+    virtual AudioCodec* GetAudioCodec() override {
+        static HostAudioCodec audio_codec(host_config.input_sample_rate, host_config.output_sample_rate,
+            host_config.input_path, host_config.output_path, host_config.realtime);
+        return &audio_codec;
+    }
+
+    virtual Display* GetDisplay() override {
+        static HostDisplay display;
+        return &display;
+    }
+
+    virtual Http* CreateHttp() override {
+        return new PosixHttp();
+    }
+
+    virtual WebSocket* CreateWebSocket() override {
+        return new WebSocket(new TcpTransport());
+    }
+
+    virtual Mqtt* CreateMqtt() override {
+        return new PosixMqtt();
+    }
+
+    virtual Udp* CreateUdp() override {
+        return new PosixUdp();
+    }
+
+    virtual void StartNetwork() override {
+        // The host network is up before the process starts
+    }
+
+    virtual const char* GetNetworkStateIcon() override {
+        return FONT_AWESOME_WIFI;
+    }
+
+    virtual void SetPowerSaveMode(bool enabled) override {
+    }
+
+    virtual std::string GetBoardJson() override {
+        std::string board_json;
+        JsonWriter writer(board_json);
+        writer.BeginObject();
+        writer.Key("type").String(BOARD_TYPE);
+        writer.Key("name").String(BOARD_NAME);
+        writer.Key("mac").String(SystemInfo::GetMacAddress());
+        writer.EndObject();
+        return board_json;
+    }
+};
+
+DECLARE_BOARD(HostBoard);
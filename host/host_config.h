@@ -0,0 +1,17 @@
+#ifndef HOST_CONFIG_H
+#define HOST_CONFIG_H
+
+#include <string>
+
+// Options of the host simulator, filled from the command line before the board is created
+struct HostConfig {
+    std::string input_path;         // Raw s16le mono microphone input, silence when empty or at EOF
+    std::string output_path;        // Raw s16le mono speaker output, discarded when empty
+    int input_sample_rate = 16000;
+    int output_sample_rate = 24000;
+    bool realtime = true;           // Pace audio reads and writes like the I2S DMA does
+};
+
+extern HostConfig host_config;
+
+#endif // HOST_CONFIG_H
@@ -0,0 +1,157 @@
+#include <esp_log.h>
+#include <esp_err.h>
+#include <esp_mac.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+#include <esp_event.h>
+
+#include "application.h"
+#include "settings.h"
+#include "host_config.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#define TAG "main"
+
+HostConfig host_config;
+
+static void PrintUsage(const char* program) {
+    printf("Usage: %s [options]\n"
+           "  --nvs <path>          Settings file (default: nvs.txt)\n"
+           "  --ota-url <url>       OTA endpoint, stored into the wifi namespace\n"
+           "  --input <path>        Raw s16le mono microphone input (default: silence)\n"
+           "  --output <path>       Raw s16le mono speaker output (default: discard)\n"
+           "  --input-rate <hz>     Microphone sample rate (default: 16000)\n"
+           "  --output-rate <hz>    Speaker sample rate (default: 24000)\n"
+           "  --no-realtime         Do not pace the audio files at the sample rate\n"
+           "  --mac <aa:bb:..>      Base MAC address, defaults to one derived from the hostname\n"
+           "  --log-level <level>   none, error, warn, info, debug or verbose (default: info)\n"
+           "  --exit-after <sec>    Exit after the given number of seconds\n"
+           "\n"
+           "Commands on stdin: listen, stop, toggle, wake <word>, abort, quit\n", program);
+}
+
+static bool ParseLogLevel(const char* name, esp_log_level_t* level) {
+    static const char* names[] = {"none", "error", "warn", "info", "debug", "verbose"};
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *level = (esp_log_level_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ParseMac(const char* text, uint8_t mac[6]) {
+    unsigned int bytes[6];
+    if (sscanf(text, "%x:%x:%x:%x:%x:%x", &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5]) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        mac[i] = bytes[i];
+    }
+    return true;
+}
+
+static void Exit(int code) {
+    // Flush the speaker output, the other threads are never joined
+    fflush(nullptr);
+    _exit(code);
+}
+
+// Reads commands from stdin in place of the buttons of a real board
+static void CommandLoop() {
+    auto& app = Application::GetInstance();
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (line == "listen") {
+            app.StartListening();
+        } else if (line == "stop") {
+            app.StopListening();
+        } else if (line == "toggle") {
+            app.ToggleChatState();
+        } else if (line.compare(0, 5, "wake ") == 0) {
+            app.WakeWordInvoke(line.substr(5));
+        } else if (line == "abort") {
+            app.Schedule([&app]() {
+                app.AbortSpeaking(kAbortReasonNone);
+            });
+        } else if (line == "quit") {
+            Exit(0);
+        } else if (!line.empty()) {
+            ESP_LOGW(TAG, "Unknown command: %s", line.c_str());
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string nvs_path = "nvs.txt";
+    std::string ota_url;
+    int exit_after = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--nvs" && has_value) {
+            nvs_path = argv[++i];
+        } else if (arg == "--ota-url" && has_value) {
+            ota_url = argv[++i];
+        } else if (arg == "--input" && has_value) {
+            host_config.input_path = argv[++i];
+        } else if (arg == "--output" && has_value) {
+            host_config.output_path = argv[++i];
+        } else if (arg == "--input-rate" && has_value) {
+            host_config.input_sample_rate = atoi(argv[++i]);
+        } else if (arg == "--output-rate" && has_value) {
+            host_config.output_sample_rate = atoi(argv[++i]);
+        } else if (arg == "--no-realtime") {
+            host_config.realtime = false;
+        } else if (arg == "--mac" && has_value) {
+            uint8_t mac[6];
+            if (!ParseMac(argv[++i], mac)) {
+                fprintf(stderr, "Invalid MAC address: %s\n", argv[i]);
+                return 1;
+            }
+            esp_base_mac_addr_set(mac);
+        } else if (arg == "--log-level" && has_value) {
+            esp_log_level_t level;
+            if (!ParseLogLevel(argv[++i], &level)) {
+                fprintf(stderr, "Invalid log level: %s\n", argv[i]);
+                return 1;
+            }
+            esp_log_level_set("*", level);
+        } else if (arg == "--exit-after" && has_value) {
+            exit_after = atoi(argv[++i]);
+        } else {
+            PrintUsage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+
+    nvs_flash_set_path(nvs_path.c_str());
+    ESP_ERROR_CHECK(nvs_flash_init());
+    if (!ota_url.empty()) {
+        Settings settings("wifi", true);
+        settings.SetString("ota_url", ota_url);
+    }
+
+    if (exit_after > 0) {
+        std::thread([exit_after]() {
+            std::this_thread::sleep_for(std::chrono::seconds(exit_after));
+            ESP_LOGI(TAG, "Exiting after %d seconds", exit_after);
+            Exit(0);
+        }).detach();
+    }
+    std::thread(CommandLoop).detach();
+
+    // Launch the application, Start() runs the main event loop and never returns
+    Application::GetInstance().Start();
+    return 0;
+}
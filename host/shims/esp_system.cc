@@ -0,0 +1,297 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_mac.h"
+#include "esp_chip_info.h"
+#include "esp_flash.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#include "esp_app_desc.h"
+
+#include <unistd.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+
+#ifndef PROJECT_VER
+#define PROJECT_VER "0.0.0"
+#endif
+
+#define TAG "System"
+
+/* Logging */
+
+static std::mutex log_mutex;
+static esp_log_level_t default_log_level = ESP_LOG_INFO;
+static std::map<std::string, esp_log_level_t> log_levels;
+
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    if (strcmp(tag, "*") == 0) {
+        default_log_level = level;
+        log_levels.clear();
+    } else {
+        log_levels[tag] = level;
+    }
+}
+
+esp_log_level_t esp_log_level_get(const char* tag) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    if (log_levels.empty()) {
+        return default_log_level;
+    }
+    auto it = log_levels.find(tag);
+    return it != log_levels.end() ? it->second : default_log_level;
+}
+
+uint32_t esp_log_timestamp() {
+    return esp_timer_get_time() / 1000;
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+    static const char* colors[] = {"", "\033[0;31m", "\033[0;33m", "\033[0;32m", "", ""};
+    static const bool use_color = isatty(STDOUT_FILENO);
+
+    // Like IDF, the level is checked again here for callers that bypass ESP_LOGx
+    if (level > esp_log_level_get(tag)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(log_mutex);
+    if (use_color) {
+        fputs(colors[level], stdout);
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(stdout, format, args);
+    va_end(args);
+    if (use_color && colors[level][0] != '\0') {
+        // Keep the reset ahead of the newline so that grep sees clean lines
+        fputs("\033[0m", stdout);
+    }
+    fflush(stdout);
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_NVS_NOT_INITIALIZED: return "ESP_ERR_NVS_NOT_INITIALIZED";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_INVALID_HANDLE: return "ESP_ERR_NVS_INVALID_HANDLE";
+        case ESP_ERR_NVS_READ_ONLY: return "ESP_ERR_NVS_READ_ONLY";
+        case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+        default: return "UNKNOWN ERROR";
+    }
+}
+
+/* System */
+
+void esp_restart() {
+    ESP_LOGW(TAG, "Restart requested, exiting");
+    fflush(stdout);
+    exit(0);
+}
+
+// The host has no meaningful heap limit, report the size of the ESP32-S3 PSRAM boards
+#define HOST_REPORTED_HEAP_SIZE (8 * 1024 * 1024)
+
+uint32_t esp_get_free_heap_size() {
+    return HOST_REPORTED_HEAP_SIZE;
+}
+
+uint32_t esp_get_minimum_free_heap_size() {
+    return HOST_REPORTED_HEAP_SIZE;
+}
+
+void* heap_caps_malloc(size_t size, uint32_t caps) {
+    return malloc(size);
+}
+
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    return calloc(n, size);
+}
+
+void* heap_caps_realloc(void* ptr, size_t size, uint32_t caps) {
+    return realloc(ptr, size);
+}
+
+void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return HOST_REPORTED_HEAP_SIZE;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    return HOST_REPORTED_HEAP_SIZE;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return HOST_REPORTED_HEAP_SIZE;
+}
+
+uint32_t esp_random() {
+    static std::mutex mutex;
+    static std::random_device device;
+    std::lock_guard<std::mutex> lock(mutex);
+    return device();
+}
+
+void esp_fill_random(void* buf, size_t len) {
+    auto bytes = (uint8_t*)buf;
+    for (size_t i = 0; i < len; i += 4) {
+        uint32_t value = esp_random();
+        memcpy(bytes + i, &value, len - i < 4 ? len - i : 4);
+    }
+}
+
+/* Identity */
+
+static uint8_t base_mac[6];
+static bool base_mac_set = false;
+
+esp_err_t esp_base_mac_addr_set(const uint8_t* mac) {
+    memcpy(base_mac, mac, sizeof(base_mac));
+    base_mac_set = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t type) {
+    if (!base_mac_set) {
+        // Stable per host: a locally administered address hashed from the host name
+        char hostname[256] = {0};
+        gethostname(hostname, sizeof(hostname) - 1);
+        uint64_t hash = 14695981039346656037ULL;
+        for (const char* p = hostname; *p; p++) {
+            hash = (hash ^ (uint8_t)*p) * 1099511628211ULL;
+        }
+        for (int i = 0; i < 6; i++) {
+            base_mac[i] = hash >> (i * 8);
+        }
+        base_mac[0] = (base_mac[0] & 0xfc) | 0x02;
+        base_mac_set = true;
+    }
+    memcpy(mac, base_mac, sizeof(base_mac));
+    mac[5] += (uint8_t)type;
+    return ESP_OK;
+}
+
+void esp_chip_info(esp_chip_info_t* out_info) {
+    out_info->model = CHIP_POSIX_LINUX;
+    out_info->features = 0;
+    out_info->revision = 0;
+    out_info->cores = CONFIG_FREERTOS_NUMBER_OF_CORES;
+}
+
+esp_err_t esp_flash_get_size(esp_flash_t* chip, uint32_t* out_size) {
+    *out_size = 16 * 1024 * 1024;
+    return ESP_OK;
+}
+
+/* Partitions and OTA */
+
+static const esp_partition_t partitions[] = {
+    {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS, 0x9000, 0x4000, "nvs", false},
+    {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_OTA, 0xd000, 0x2000, "otadata", false},
+    {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_PHY, 0xf000, 0x1000, "phy_init", false},
+    {ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, 0x20000, 0x600000, "factory", false},
+};
+#define PARTITION_COUNT (sizeof(partitions) / sizeof(partitions[0]))
+
+// The iterator is the index of the current partition plus one
+static esp_partition_iterator_t FindFrom(size_t index, esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                         const char* label) {
+    for (size_t i = index; i < PARTITION_COUNT; i++) {
+        auto& p = partitions[i];
+        if ((type == ESP_PARTITION_TYPE_ANY || p.type == type) &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || p.subtype == subtype) &&
+            (label == nullptr || strcmp(p.label, label) == 0)) {
+            return (esp_partition_iterator_t)(uintptr_t)(i + 1);
+        }
+    }
+    return nullptr;
+}
+
+esp_partition_iterator_t esp_partition_find(esp_partition_type_t type, esp_partition_subtype_t subtype, const char* label) {
+    return FindFrom(0, type, subtype, label);
+}
+
+const esp_partition_t* esp_partition_get(esp_partition_iterator_t iterator) {
+    return &partitions[(uintptr_t)iterator - 1];
+}
+
+esp_partition_iterator_t esp_partition_next(esp_partition_iterator_t iterator) {
+    // Only used with ANY/ANY in this code base
+    return FindFrom((uintptr_t)iterator, ESP_PARTITION_TYPE_ANY, ESP_PARTITION_SUBTYPE_ANY, nullptr);
+}
+
+void esp_partition_iterator_release(esp_partition_iterator_t iterator) {
+}
+
+const esp_partition_t* esp_ota_get_running_partition() {
+    return &partitions[3];
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from) {
+    return nullptr;
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* ota_state) {
+    *ota_state = ESP_OTA_IMG_VALID;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback() {
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+const esp_app_desc_t* esp_app_get_description() {
+    static esp_app_desc_t app_desc = []() {
+        esp_app_desc_t desc = {};
+        desc.magic_word = 0xabcd5432;
+        snprintf(desc.version, sizeof(desc.version), "%s", PROJECT_VER);
+        snprintf(desc.project_name, sizeof(desc.project_name), "%s", "xiaozhi");
+        snprintf(desc.time, sizeof(desc.time), "%s", __TIME__);
+        snprintf(desc.date, sizeof(desc.date), "%s", __DATE__);
+        snprintf(desc.idf_ver, sizeof(desc.idf_ver), "%s", "host");
+        return desc;
+    }();
+    return &app_desc;
+}
@@ -0,0 +1,163 @@
+#include "esp_timer.h"
+
+#include <pthread.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    std::string name;
+    int64_t period_us = 0;
+    int64_t alarm_us = 0;
+    bool active = false;
+};
+
+class TimerDispatcher {
+public:
+    static TimerDispatcher& GetInstance() {
+        static TimerDispatcher instance;
+        return instance;
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<esp_timer*> timers_;
+    // The timer whose callback is running, esp_timer_delete() waits for it
+    esp_timer* running_ = nullptr;
+    std::condition_variable running_cv_;
+    std::thread::id thread_id_;
+
+private:
+    TimerDispatcher() {
+        std::thread([this]() {
+            pthread_setname_np(pthread_self(), "esp_timer");
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                thread_id_ = std::this_thread::get_id();
+            }
+            Loop();
+        }).detach();
+    }
+
+    void Loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            esp_timer* next = nullptr;
+            for (auto timer : timers_) {
+                if (timer->active && (next == nullptr || timer->alarm_us < next->alarm_us)) {
+                    next = timer;
+                }
+            }
+            if (next == nullptr) {
+                cv_.wait(lock);
+                continue;
+            }
+            int64_t now = esp_timer_get_time();
+            if (next->alarm_us > now) {
+                cv_.wait_for(lock, std::chrono::microseconds(next->alarm_us - now));
+                continue;
+            }
+
+            if (next->period_us > 0) {
+                next->alarm_us += next->period_us;
+                if (next->alarm_us < now) {
+                    // Skip the periods that were missed while the callback was busy
+                    next->alarm_us = now + next->period_us;
+                }
+            } else {
+                next->active = false;
+            }
+            running_ = next;
+            lock.unlock();
+            next->callback(next->arg);
+            lock.lock();
+            running_ = nullptr;
+            running_cv_.notify_all();
+        }
+    }
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle) {
+    if (create_args == nullptr || create_args->callback == nullptr || out_handle == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto timer = new esp_timer();
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+    timer->name = create_args->name != nullptr ? create_args->name : "";
+
+    auto& dispatcher = TimerDispatcher::GetInstance();
+    std::lock_guard<std::mutex> lock(dispatcher.mutex_);
+    dispatcher.timers_.push_back(timer);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t StartTimer(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us) {
+    auto& dispatcher = TimerDispatcher::GetInstance();
+    std::lock_guard<std::mutex> lock(dispatcher.mutex_);
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = true;
+    timer->period_us = period_us;
+    timer->alarm_us = esp_timer_get_time() + timeout_us;
+    dispatcher.cv_.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return StartTimer(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    return StartTimer(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    auto& dispatcher = TimerDispatcher::GetInstance();
+    std::lock_guard<std::mutex> lock(dispatcher.mutex_);
+    if (!timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    dispatcher.cv_.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    auto& dispatcher = TimerDispatcher::GetInstance();
+    std::unique_lock<std::mutex> lock(dispatcher.mutex_);
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    auto& timers = dispatcher.timers_;
+    timers.erase(std::remove(timers.begin(), timers.end(), timer), timers.end());
+    // Deleting a timer from its own callback is allowed, otherwise wait for the callback
+    if (dispatcher.running_ == timer && std::this_thread::get_id() != dispatcher.thread_id_) {
+        dispatcher.running_cv_.wait(lock, [&dispatcher, timer]() {
+            return dispatcher.running_ != timer;
+        });
+    }
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    auto& dispatcher = TimerDispatcher::GetInstance();
+    std::lock_guard<std::mutex> lock(dispatcher.mutex_);
+    return timer->active;
+}
+
+int64_t esp_timer_get_time() {
+    static const auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
@@ -0,0 +1,224 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#include <esp_log.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#define TAG "FreeRTOS"
+
+struct HostTask {
+    std::string name;
+    TaskFunction_t function = nullptr;
+    void* arg = nullptr;
+    UBaseType_t priority = 0;
+    UBaseType_t number = 0;
+    std::mutex mutex;
+    std::condition_variable notify_cv;
+    uint32_t notify_value = 0;
+};
+
+struct HostEventGroup {
+    std::mutex mutex;
+    std::condition_variable cv;
+    EventBits_t bits = 0;
+};
+
+static std::mutex tasks_mutex;
+static std::vector<HostTask*> tasks;
+static UBaseType_t next_task_number = 1;
+static thread_local HostTask* current_task = nullptr;
+static const auto start_time = std::chrono::steady_clock::now();
+
+static void RegisterTask(HostTask* task) {
+    std::lock_guard<std::mutex> lock(tasks_mutex);
+    task->number = next_task_number++;
+    tasks.push_back(task);
+}
+
+static void UnregisterTask(HostTask* task) {
+    std::lock_guard<std::mutex> lock(tasks_mutex);
+    tasks.erase(std::remove(tasks.begin(), tasks.end(), task), tasks.end());
+}
+
+int xPortGetCoreID() {
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : cpu % CONFIG_FREERTOS_NUMBER_OF_CORES;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core_id) {
+    // Stack size and core affinity are ignored, the host threads are big enough
+    auto task = new HostTask();
+    task->name = name != nullptr ? name : "";
+    task->function = function;
+    task->arg = arg;
+    task->priority = priority;
+    RegisterTask(task);
+    if (handle != nullptr) {
+        *handle = task;
+    }
+
+    std::thread([task]() {
+        current_task = task;
+        pthread_setname_np(pthread_self(), task->name.substr(0, 15).c_str());
+        task->function(task->arg);
+        // A FreeRTOS task must not return, but vTaskDelete(NULL) is a no-op here
+        UnregisterTask(task);
+        current_task = nullptr;
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(function, name, stack_depth, arg, priority, handle, -1);
+}
+
+void vTaskDelete(TaskHandle_t handle) {
+    if (handle == nullptr || handle == current_task) {
+        // The calling task ends as soon as its function returns
+        return;
+    }
+    // A std::thread cannot be killed from outside, the task keeps running detached
+    ESP_LOGW(TAG, "vTaskDelete(%s) from another task is not supported on the host", handle->name.c_str());
+    UnregisterTask(handle);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount() {
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+    return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    if (current_task == nullptr) {
+        // Threads that were not created by xTaskCreate (main, timers) get a task lazily
+        auto task = new HostTask();
+        char name[16] = {0};
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        task->name = name;
+        RegisterTask(task);
+        current_task = task;
+    }
+    return current_task;
+}
+
+char* pcTaskGetName(TaskHandle_t handle) {
+    if (handle == nullptr) {
+        handle = xTaskGetCurrentTaskHandle();
+    }
+    return handle->name.data();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle) {
+    return 0;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks() {
+    std::lock_guard<std::mutex> lock(tasks_mutex);
+    return tasks.size();
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* status_array, UBaseType_t array_size,
+                                 configRUN_TIME_COUNTER_TYPE* total_run_time) {
+    std::lock_guard<std::mutex> lock(tasks_mutex);
+    if (array_size < tasks.size()) {
+        return 0;
+    }
+    for (size_t i = 0; i < tasks.size(); i++) {
+        status_array[i].xHandle = tasks[i];
+        status_array[i].pcTaskName = tasks[i]->name.c_str();
+        status_array[i].xTaskNumber = tasks[i]->number;
+        status_array[i].uxCurrentPriority = tasks[i]->priority;
+        status_array[i].ulRunTimeCounter = 0;
+        status_array[i].usStackHighWaterMark = 0;
+    }
+    if (total_run_time != nullptr) {
+        *total_run_time = xTaskGetTickCount() * 1000;
+    }
+    return tasks.size();
+}
+
+void xTaskNotifyGive(TaskHandle_t handle) {
+    std::lock_guard<std::mutex> lock(handle->mutex);
+    handle->notify_value++;
+    handle->notify_cv.notify_all();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    auto task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    auto ready = [task]() { return task->notify_value > 0; };
+    if (ticks == portMAX_DELAY) {
+        task->notify_cv.wait(lock, ready);
+    } else {
+        task->notify_cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+    }
+    uint32_t value = task->notify_value;
+    if (value > 0) {
+        task->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+EventGroupHandle_t xEventGroupCreate() {
+    return new HostEventGroup();
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto satisfied = [group, bits, wait_for_all]() {
+        return wait_for_all ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    bool ok;
+    if (ticks == portMAX_DELAY) {
+        group->cv.wait(lock, satisfied);
+        ok = true;
+    } else {
+        ok = group->cv.wait_for(lock, std::chrono::milliseconds(ticks), satisfied);
+    }
+    // Like FreeRTOS, return the bits as they were before clearing
+    EventBits_t value = group->bits;
+    if (ok && clear_on_exit) {
+        group->bits &= ~bits;
+    }
+    return value;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    group->cv.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t value = group->bits;
+    group->bits &= ~bits;
+    return value;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    return group->bits;
+}
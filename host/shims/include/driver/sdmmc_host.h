@@ -0,0 +1,14 @@
+#ifndef HOST_DRIVER_SDMMC_HOST_H
+#define HOST_DRIVER_SDMMC_HOST_H
+
+#include "driver/gpio.h"
+
+typedef enum {
+    SPI1_HOST = 0,
+    SPI2_HOST = 1,
+    SPI3_HOST = 2,
+} spi_host_device_t;
+
+typedef struct sdmmc_card_t sdmmc_card_t;
+
+#endif // HOST_DRIVER_SDMMC_HOST_H
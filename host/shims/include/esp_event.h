@@ -0,0 +1,8 @@
+#ifndef HOST_ESP_EVENT_H
+#define HOST_ESP_EVENT_H
+
+#include "esp_err.h"
+
+inline esp_err_t esp_event_loop_create_default() { return ESP_OK; }
+
+#endif // HOST_ESP_EVENT_H
@@ -0,0 +1,6 @@
+#ifndef HOST_ESP_LCD_PANEL_IO_H
+#define HOST_ESP_LCD_PANEL_IO_H
+
+#include "esp_err.h"
+
+#endif // HOST_ESP_LCD_PANEL_IO_H
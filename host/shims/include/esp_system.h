@@ -0,0 +1,13 @@
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <cstdint>
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+
+// There is no reboot on the host, the process exits instead
+[[noreturn]] void esp_restart();
+uint32_t esp_get_free_heap_size();
+uint32_t esp_get_minimum_free_heap_size();
+
+#endif // HOST_ESP_SYSTEM_H
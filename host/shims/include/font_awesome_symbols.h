@@ -0,0 +1,39 @@
+#ifndef HOST_FONT_AWESOME_SYMBOLS_H
+#define HOST_FONT_AWESOME_SYMBOLS_H
+
+// Host shim: icons are printed in the log, so they are spelled out as text
+
+#define FONT_AWESOME_BATTERY_1 "[battery-1]"
+#define FONT_AWESOME_BATTERY_2 "[battery-2]"
+#define FONT_AWESOME_BATTERY_3 "[battery-3]"
+#define FONT_AWESOME_BATTERY_CHARGING "[battery-charging]"
+#define FONT_AWESOME_BATTERY_EMPTY "[battery-empty]"
+#define FONT_AWESOME_BATTERY_FULL "[battery-full]"
+#define FONT_AWESOME_DOWNLOAD "[download]"
+#define FONT_AWESOME_VOLUME_MUTE "[volume-mute]"
+#define FONT_AWESOME_WIFI "[wifi]"
+#define FONT_AWESOME_WIFI_OFF "[wifi-off]"
+
+#define FONT_AWESOME_EMOJI_NEUTRAL "(neutral)"
+#define FONT_AWESOME_EMOJI_HAPPY "(happy)"
+#define FONT_AWESOME_EMOJI_LAUGHING "(laughing)"
+#define FONT_AWESOME_EMOJI_FUNNY "(funny)"
+#define FONT_AWESOME_EMOJI_SAD "(sad)"
+#define FONT_AWESOME_EMOJI_ANGRY "(angry)"
+#define FONT_AWESOME_EMOJI_CRYING "(crying)"
+#define FONT_AWESOME_EMOJI_LOVING "(loving)"
+#define FONT_AWESOME_EMOJI_EMBARRASSED "(embarrassed)"
+#define FONT_AWESOME_EMOJI_SURPRISED "(surprised)"
+#define FONT_AWESOME_EMOJI_SHOCKED "(shocked)"
+#define FONT_AWESOME_EMOJI_THINKING "(thinking)"
+#define FONT_AWESOME_EMOJI_WINKING "(winking)"
+#define FONT_AWESOME_EMOJI_COOL "(cool)"
+#define FONT_AWESOME_EMOJI_RELAXED "(relaxed)"
+#define FONT_AWESOME_EMOJI_DELICIOUS "(delicious)"
+#define FONT_AWESOME_EMOJI_KISSY "(kissy)"
+#define FONT_AWESOME_EMOJI_CONFIDENT "(confident)"
+#define FONT_AWESOME_EMOJI_SLEEPY "(sleepy)"
+#define FONT_AWESOME_EMOJI_SILLY "(silly)"
+#define FONT_AWESOME_EMOJI_CONFUSED "(confused)"
+
+#endif // HOST_FONT_AWESOME_SYMBOLS_H
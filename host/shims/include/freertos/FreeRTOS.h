@@ -0,0 +1,40 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// Host shim: a tiny subset of FreeRTOS on top of std::thread, 1 tick == 1 ms
+
+#include <cstdint>
+#include <cstddef>
+
+#include <sys/time.h>
+
+// portmacro.h pulls these in on the target and the sources rely on it
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+
+typedef uint32_t TickType_t;
+typedef unsigned int UBaseType_t;
+typedef int BaseType_t;
+typedef uint32_t EventBits_t;
+typedef uint8_t StackType_t;
+typedef struct HostTask* TaskHandle_t;
+typedef struct HostEventGroup* EventGroupHandle_t;
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define portNUM_PROCESSORS 2
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define configMAX_TASK_NAME_LEN 16
+#define configRUN_TIME_COUNTER_TYPE uint32_t
+
+#ifndef CONFIG_FREERTOS_NUMBER_OF_CORES
+#define CONFIG_FREERTOS_NUMBER_OF_CORES 2
+#endif
+
+int xPortGetCoreID();
+
+#endif // HOST_FREERTOS_H
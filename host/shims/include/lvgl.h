@@ -0,0 +1,46 @@
+#ifndef HOST_LVGL_H
+#define HOST_LVGL_H
+
+// Host shim: just enough of the LVGL API for display.cc, the host has no pixels
+
+#include <cstdint>
+
+typedef struct _lv_obj_t lv_obj_t;
+typedef struct _lv_font_t lv_font_t;
+typedef struct _lv_indev_t lv_indev_t;
+typedef struct _lv_display_t lv_display_t;
+typedef struct _lv_event_t lv_event_t;
+typedef void (*lv_event_cb_t)(lv_event_t* e);
+typedef struct _lv_timer_t lv_timer_t;
+typedef void (*lv_timer_cb_t)(lv_timer_t* timer);
+
+#define LV_DEF_REFR_PERIOD 33
+
+typedef enum {
+    LV_OBJ_FLAG_HIDDEN = (1 << 0),
+} lv_obj_flag_t;
+
+typedef enum {
+    LV_EVENT_ALL = 0,
+    LV_EVENT_REFR_START,
+    LV_EVENT_REFR_READY,
+    LV_EVENT_FLUSH_START,
+    LV_EVENT_FLUSH_FINISH,
+} lv_event_code_t;
+
+inline void lv_label_set_text(lv_obj_t*, const char*) {}
+inline void lv_obj_add_flag(lv_obj_t*, lv_obj_flag_t) {}
+inline void lv_obj_clear_flag(lv_obj_t*, lv_obj_flag_t) {}
+inline bool lv_obj_has_flag(const lv_obj_t*, lv_obj_flag_t) { return false; }
+inline void lv_obj_del(lv_obj_t*) {}
+inline lv_event_code_t lv_event_get_code(lv_event_t*) { return LV_EVENT_ALL; }
+inline void lv_display_add_event_cb(lv_display_t*, lv_event_cb_t, lv_event_code_t, void*) {}
+inline lv_timer_t* lv_timer_create(lv_timer_cb_t, uint32_t, void*) { return nullptr; }
+inline void* lv_timer_get_user_data(lv_timer_t*) { return nullptr; }
+inline void lv_timer_delete(lv_timer_t*) {}
+inline void lv_timer_set_period(lv_timer_t*, uint32_t) {}
+inline void lv_timer_pause(lv_timer_t*) {}
+inline void lv_timer_resume(lv_timer_t*) {}
+inline lv_timer_t* lv_display_get_refr_timer(lv_display_t*) { return nullptr; }
+
+#endif // HOST_LVGL_H
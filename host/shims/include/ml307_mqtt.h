@@ -0,0 +1,7 @@
+#ifndef HOST_ML307_MQTT_H
+#define HOST_ML307_MQTT_H
+
+// The modem transports are not available on the host, the generic interface is enough
+#include "mqtt.h"
+
+#endif // HOST_ML307_MQTT_H
@@ -0,0 +1,7 @@
+#ifndef HOST_ML307_SSL_TRANSPORT_H
+#define HOST_ML307_SSL_TRANSPORT_H
+
+// The modem transports are not available on the host, the generic interface is enough
+#include "transport.h"
+
+#endif // HOST_ML307_SSL_TRANSPORT_H
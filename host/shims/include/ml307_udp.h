@@ -0,0 +1,7 @@
+#ifndef HOST_ML307_UDP_H
+#define HOST_ML307_UDP_H
+
+// The modem transports are not available on the host, the generic interface is enough
+#include "udp.h"
+
+#endif // HOST_ML307_UDP_H
@@ -0,0 +1,12 @@
+#ifndef HOST_NVS_FLASH_H
+#define HOST_NVS_FLASH_H
+
+#include "nvs.h"
+
+// Host only: select the file that backs the NVS partition, call before nvs_flash_init()
+void nvs_flash_set_path(const char* path);
+
+esp_err_t nvs_flash_init();
+esp_err_t nvs_flash_erase();
+
+#endif // HOST_NVS_FLASH_H
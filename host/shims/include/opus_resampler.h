@@ -0,0 +1,29 @@
+#ifndef HOST_OPUS_RESAMPLER_H
+#define HOST_OPUS_RESAMPLER_H
+
+// Same interface as the esp-opus-encoder component, using linear interpolation
+// instead of the SILK resampler which is not exported by the system libopus
+
+#include <cstdint>
+
+class OpusResampler {
+public:
+    OpusResampler();
+    ~OpusResampler();
+
+    void Configure(int input_sample_rate, int output_sample_rate);
+    void Process(const int16_t* input, int input_samples, int16_t* output);
+    int GetOutputSamples(int input_samples) const;
+
+    int input_sample_rate() const { return input_sample_rate_; }
+    int output_sample_rate() const { return output_sample_rate_; }
+
+private:
+    int input_sample_rate_ = 0;
+    int output_sample_rate_ = 0;
+    // Fractional read position carried over between blocks, in input samples
+    double position_ = 0;
+    int16_t last_sample_ = 0;
+};
+
+#endif // HOST_OPUS_RESAMPLER_H
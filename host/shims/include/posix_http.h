@@ -0,0 +1,43 @@
+#ifndef HOST_POSIX_HTTP_H
+#define HOST_POSIX_HTTP_H
+
+// Plain HTTP/1.1 client over a POSIX socket, https:// is not supported on the host
+
+#include "http.h"
+
+#include <map>
+#include <string>
+
+class PosixHttp : public Http {
+public:
+    PosixHttp();
+    ~PosixHttp();
+
+    void SetHeader(const std::string& key, const std::string& value) override;
+    bool Open(const std::string& method, const std::string& url, const std::string& content = "") override;
+    void Close() override;
+
+    int GetStatusCode() const override { return status_code_; }
+    std::string GetResponseHeader(const std::string& key) const override;
+    size_t GetBodyLength() const override { return content_length_; }
+    const std::string& GetBody() override;
+    int Read(char* buffer, size_t buffer_size) override;
+
+private:
+    int fd_ = -1;
+    int status_code_ = -1;
+    size_t content_length_ = 0;
+    size_t body_read_ = 0;
+    bool chunked_ = false;
+    size_t chunk_remaining_ = 0;
+    bool chunked_done_ = false;
+    std::string buffer_;
+    std::string body_;
+    std::map<std::string, std::string> headers_;
+    std::map<std::string, std::string> response_headers_;
+
+    bool ReadLine(std::string& line);
+    int ReadRaw(char* buffer, size_t size);
+};
+
+#endif // HOST_POSIX_HTTP_H
@@ -0,0 +1,48 @@
+#ifndef HOST_POSIX_MQTT_H
+#define HOST_POSIX_MQTT_H
+
+// Minimal MQTT 3.1.1 client over plain TCP (QoS 0 publish, QoS 0/1 subscribe)
+
+#include "mqtt.h"
+
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <condition_variable>
+
+class PosixMqtt : public Mqtt {
+public:
+    PosixMqtt();
+    ~PosixMqtt();
+
+    bool Connect(const std::string broker_address, int broker_port, const std::string client_id,
+                 const std::string username, const std::string password) override;
+    void Disconnect() override;
+    bool Publish(const std::string topic, const std::string payload, int qos = 0) override;
+    bool Subscribe(const std::string topic, int qos = 0) override;
+    bool Unsubscribe(const std::string topic) override;
+    bool IsConnected() override { return connected_; }
+
+private:
+    int fd_ = -1;
+    std::atomic<bool> connected_{false};
+    std::atomic<bool> closing_{false};
+    std::mutex send_mutex_;
+    std::mutex state_mutex_;
+    std::condition_variable state_cv_;
+    bool connack_received_ = false;
+    uint8_t connack_code_ = 0;
+    uint16_t packet_id_ = 0;
+    std::thread receive_thread_;
+    std::thread keep_alive_thread_;
+
+    bool SendPacket(uint8_t header, const std::string& body);
+    bool ReceiveExactly(uint8_t* buffer, size_t size);
+    void ReceiveLoop();
+    void KeepAliveLoop();
+    void Shutdown();
+};
+
+#endif // HOST_POSIX_MQTT_H
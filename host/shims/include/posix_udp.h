@@ -0,0 +1,28 @@
+#ifndef HOST_POSIX_UDP_H
+#define HOST_POSIX_UDP_H
+
+// Connected UDP socket with a receive thread
+
+#include "udp.h"
+
+#include <thread>
+#include <atomic>
+
+class PosixUdp : public Udp {
+public:
+    PosixUdp();
+    ~PosixUdp();
+
+    bool Connect(const std::string& host, int port) override;
+    void Disconnect() override;
+    int Send(const std::string& data) override;
+
+private:
+    int fd_ = -1;
+    std::atomic<bool> closing_{false};
+    std::thread receive_thread_;
+
+    void ReceiveLoop();
+};
+
+#endif // HOST_POSIX_UDP_H
@@ -0,0 +1,6 @@
+#ifndef HOST_SDMMC_CMD_H
+#define HOST_SDMMC_CMD_H
+
+#include "esp_err.h"
+
+#endif // HOST_SDMMC_CMD_H
@@ -0,0 +1,20 @@
+#ifndef HOST_TCP_TRANSPORT_H
+#define HOST_TCP_TRANSPORT_H
+
+#include "transport.h"
+
+class TcpTransport : public Transport {
+public:
+    TcpTransport();
+    ~TcpTransport();
+
+    bool Connect(const char* host, int port) override;
+    void Disconnect() override;
+    int Send(const char* data, size_t length) override;
+    int Receive(char* buffer, size_t buffer_size) override;
+
+private:
+    int fd_ = -1;
+};
+
+#endif // HOST_TCP_TRANSPORT_H
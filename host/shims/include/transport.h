@@ -0,0 +1,23 @@
+#ifndef HOST_TRANSPORT_H
+#define HOST_TRANSPORT_H
+
+// Same interface as the esp-ml307 component
+
+#include <cstddef>
+
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    virtual bool Connect(const char* host, int port) = 0;
+    virtual void Disconnect() = 0;
+    virtual int Send(const char* data, size_t length) = 0;
+    virtual int Receive(char* buffer, size_t buffer_size) = 0;
+
+    bool connected() const { return connected_; }
+
+protected:
+    bool connected_ = false;
+};
+
+#endif // HOST_TRANSPORT_H
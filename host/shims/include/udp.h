@@ -0,0 +1,31 @@
+#ifndef HOST_UDP_H
+#define HOST_UDP_H
+
+// Same interface as the esp-ml307 component
+
+#include <string>
+#include <functional>
+
+class Udp {
+public:
+    virtual ~Udp() = default;
+
+    virtual bool Connect(const std::string& host, int port) = 0;
+    virtual void Disconnect() = 0;
+    virtual int Send(const std::string& data) = 0;
+
+    virtual void OnMessage(std::function<void(const std::string& data)> callback) {
+        message_callback_ = std::move(callback);
+    }
+    bool connected() const { return connected_; }
+    const std::string& remote_host() const { return remote_host_; }
+    int remote_port() const { return remote_port_; }
+
+protected:
+    std::function<void(const std::string& data)> message_callback_;
+    std::string remote_host_;
+    int remote_port_ = 0;
+    bool connected_ = false;
+};
+
+#endif // HOST_UDP_H
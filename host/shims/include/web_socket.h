@@ -0,0 +1,60 @@
+#ifndef HOST_WEB_SOCKET_H
+#define HOST_WEB_SOCKET_H
+
+// Same interface as the esp-ml307 component, frames are read on a receive thread
+
+#include <cstdint>
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+#include "transport.h"
+
+#define WEB_SOCKET_HAS_GATHER_SEND 1
+
+class WebSocket {
+public:
+    WebSocket(Transport* transport);
+    ~WebSocket();
+
+    void SetHeader(const char* key, const char* value);
+    void SetReceiveBufferSize(size_t size);
+    bool IsConnected() const;
+    bool Connect(const char* uri);
+    bool Send(const std::string& data);
+    bool Send(const void* data, size_t len, bool binary = false, bool fin = true);
+    // Not in the esp-ml307 component: one frame whose payload is header followed by payload,
+    // gathered while masking so that the caller does not join them first
+    bool Send(const void* header, size_t header_len, const void* payload, size_t payload_len, bool binary = true);
+    void Ping();
+    void Close();
+
+    void OnConnected(std::function<void()> callback);
+    void OnDisconnected(std::function<void()> callback);
+    void OnData(std::function<void(const char*, size_t, bool binary)> callback);
+    void OnError(std::function<void(int)> callback);
+
+private:
+    Transport* transport_;
+    std::thread receive_thread_;
+    std::atomic<bool> connected_{false};
+    std::atomic<bool> closing_{false};
+    std::mutex send_mutex_;
+    std::string frame_;     // Reused for every outgoing frame, guarded by send_mutex_
+    size_t receive_buffer_size_ = 2048;
+    std::map<std::string, std::string> headers_;
+    std::function<void()> on_connected_;
+    std::function<void()> on_disconnected_;
+    std::function<void(const char*, size_t, bool binary)> on_data_;
+    std::function<void(int)> on_error_;
+
+    bool SendFrame(uint8_t opcode, const void* head, size_t head_len, const void* data, size_t data_len, bool fin);
+    bool ReceiveExactly(char* buffer, size_t size);
+    void ReceiveLoop();
+};
+
+#endif // HOST_WEB_SOCKET_H
@@ -0,0 +1,204 @@
+#include "posix_http.h"
+#include "socket_util.h"
+
+#include <esp_log.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#define TAG "PosixHttp"
+
+static std::string ToLower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    return value;
+}
+
+PosixHttp::PosixHttp() {
+}
+
+PosixHttp::~PosixHttp() {
+    Close();
+}
+
+void PosixHttp::SetHeader(const std::string& key, const std::string& value) {
+    headers_[key] = value;
+}
+
+bool PosixHttp::Open(const std::string& method, const std::string& url, const std::string& content) {
+    // http://host[:port]/path
+    const std::string scheme = "http://";
+    if (url.compare(0, scheme.size(), scheme) != 0) {
+        ESP_LOGE(TAG, "Only http:// is supported on the host: %s", url.c_str());
+        return false;
+    }
+    size_t host_start = scheme.size();
+    size_t path_start = url.find('/', host_start);
+    std::string authority = url.substr(host_start, path_start == std::string::npos ? std::string::npos : path_start - host_start);
+    std::string path = path_start == std::string::npos ? "/" : url.substr(path_start);
+    std::string host = authority;
+    int port = 80;
+    size_t colon = authority.find(':');
+    if (colon != std::string::npos) {
+        host = authority.substr(0, colon);
+        port = std::stoi(authority.substr(colon + 1));
+    }
+
+    Close();
+    fd_ = SocketConnect(host, port, SOCK_STREAM);
+    if (fd_ < 0) {
+        return false;
+    }
+
+    std::string request = method + " " + path + " HTTP/1.1\r\n";
+    request += "Host: " + authority + "\r\n";
+    request += "Connection: close\r\n";
+    for (auto& header : headers_) {
+        request += header.first + ": " + header.second + "\r\n";
+    }
+    if (!content.empty() || method == "POST" || method == "PUT") {
+        request += "Content-Length: " + std::to_string(content.size()) + "\r\n";
+    }
+    request += "\r\n";
+    request += content;
+    if (!SocketSendAll(fd_, request.data(), request.size())) {
+        ESP_LOGE(TAG, "Failed to send request");
+        Close();
+        return false;
+    }
+
+    // Status line: HTTP/1.1 200 OK
+    std::string line;
+    if (!ReadLine(line) || line.compare(0, 5, "HTTP/") != 0) {
+        ESP_LOGE(TAG, "Invalid response status line");
+        Close();
+        return false;
+    }
+    size_t space = line.find(' ');
+    status_code_ = space == std::string::npos ? -1 : atoi(line.c_str() + space + 1);
+
+    response_headers_.clear();
+    while (ReadLine(line) && !line.empty()) {
+        size_t separator = line.find(':');
+        if (separator == std::string::npos) {
+            continue;
+        }
+        std::string value = line.substr(separator + 1);
+        value.erase(0, value.find_first_not_of(' '));
+        response_headers_[ToLower(line.substr(0, separator))] = value;
+    }
+
+    auto length = response_headers_.find("content-length");
+    content_length_ = length != response_headers_.end() ? strtoul(length->second.c_str(), nullptr, 10) : 0;
+    auto encoding = response_headers_.find("transfer-encoding");
+    chunked_ = encoding != response_headers_.end() && ToLower(encoding->second) == "chunked";
+    body_read_ = 0;
+    chunk_remaining_ = 0;
+    chunked_done_ = false;
+    body_.clear();
+    return true;
+}
+
+void PosixHttp::Close() {
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    buffer_.clear();
+}
+
+std::string PosixHttp::GetResponseHeader(const std::string& key) const {
+    auto it = response_headers_.find(ToLower(key));
+    return it != response_headers_.end() ? it->second : "";
+}
+
+const std::string& PosixHttp::GetBody() {
+    char buffer[1024];
+    int ret;
+    while ((ret = Read(buffer, sizeof(buffer))) > 0) {
+        body_.append(buffer, ret);
+    }
+    return body_;
+}
+
+int PosixHttp::Read(char* buffer, size_t buffer_size) {
+    if (chunked_) {
+        if (chunked_done_) {
+            return 0;
+        }
+        if (chunk_remaining_ == 0) {
+            std::string line;
+            if (!ReadLine(line)) {
+                return -1;
+            }
+            if (line.empty() && !ReadLine(line)) {
+                // The CRLF that ends the previous chunk
+                return -1;
+            }
+            chunk_remaining_ = strtoul(line.c_str(), nullptr, 16);
+            if (chunk_remaining_ == 0) {
+                chunked_done_ = true;
+                return 0;
+            }
+        }
+        int ret = ReadRaw(buffer, std::min(buffer_size, chunk_remaining_));
+        if (ret > 0) {
+            chunk_remaining_ -= ret;
+        }
+        return ret;
+    }
+
+    if (content_length_ > 0) {
+        if (body_read_ >= content_length_) {
+            return 0;
+        }
+        buffer_size = std::min(buffer_size, content_length_ - body_read_);
+    }
+    int ret = ReadRaw(buffer, buffer_size);
+    if (ret > 0) {
+        body_read_ += ret;
+    }
+    return ret;
+}
+
+bool PosixHttp::ReadLine(std::string& line) {
+    while (true) {
+        size_t end = buffer_.find("\r\n");
+        if (end != std::string::npos) {
+            line = buffer_.substr(0, end);
+            buffer_.erase(0, end + 2);
+            return true;
+        }
+        char chunk[512];
+        ssize_t ret = recv(fd_, chunk, sizeof(chunk), 0);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return false;
+        }
+        buffer_.append(chunk, ret);
+    }
+}
+
+int PosixHttp::ReadRaw(char* buffer, size_t size) {
+    if (!buffer_.empty()) {
+        size_t n = std::min(size, buffer_.size());
+        memcpy(buffer, buffer_.data(), n);
+        buffer_.erase(0, n);
+        return n;
+    }
+    if (fd_ < 0) {
+        return -1;
+    }
+    while (true) {
+        ssize_t ret = recv(fd_, buffer, size, 0);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        return ret;
+    }
+}
@@ -0,0 +1,302 @@
+#include "posix_mqtt.h"
+#include "socket_util.h"
+
+#include <esp_log.h>
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+
+#define TAG "PosixMqtt"
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_SUBSCRIBE 0x82
+#define MQTT_SUBACK 0x90
+#define MQTT_UNSUBSCRIBE 0xa2
+#define MQTT_UNSUBACK 0xb0
+#define MQTT_PINGREQ 0xc0
+#define MQTT_PINGRESP 0xd0
+#define MQTT_DISCONNECT 0xe0
+
+#define MQTT_CONNECT_TIMEOUT_MS 10000
+
+static void AppendU16(std::string& out, uint16_t value) {
+    out.push_back(value >> 8);
+    out.push_back(value & 0xff);
+}
+
+static void AppendString(std::string& out, const std::string& value) {
+    AppendU16(out, value.size());
+    out += value;
+}
+
+PosixMqtt::PosixMqtt() {
+}
+
+PosixMqtt::~PosixMqtt() {
+    Disconnect();
+}
+
+bool PosixMqtt::Connect(const std::string broker_address, int broker_port, const std::string client_id,
+                        const std::string username, const std::string password) {
+    Disconnect();
+
+    fd_ = SocketConnect(broker_address, broker_port, SOCK_STREAM);
+    if (fd_ < 0) {
+        return false;
+    }
+
+    // CONNECT: protocol name, level 4 (3.1.1), flags, keep alive, payload
+    std::string body;
+    AppendString(body, "MQTT");
+    body.push_back(4);
+    uint8_t flags = 0x02;  // Clean session
+    if (!username.empty()) {
+        flags |= 0x80;
+    }
+    if (!password.empty()) {
+        flags |= 0x40;
+    }
+    body.push_back(flags);
+    AppendU16(body, keep_alive_seconds_);
+    AppendString(body, client_id);
+    if (!username.empty()) {
+        AppendString(body, username);
+    }
+    if (!password.empty()) {
+        AppendString(body, password);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state_mutex_);
+        connack_received_ = false;
+    }
+    closing_ = false;
+    if (!SendPacket(MQTT_CONNECT, body)) {
+        Shutdown();
+        return false;
+    }
+
+    receive_thread_ = std::thread([this]() {
+        pthread_setname_np(pthread_self(), "mqtt_receive");
+        ReceiveLoop();
+    });
+
+    std::unique_lock<std::mutex> lock(state_mutex_);
+    if (!state_cv_.wait_for(lock, std::chrono::milliseconds(MQTT_CONNECT_TIMEOUT_MS), [this]() { return connack_received_; })) {
+        ESP_LOGE(TAG, "CONNACK timeout");
+        lock.unlock();
+        Disconnect();
+        return false;
+    }
+    if (connack_code_ != 0) {
+        ESP_LOGE(TAG, "Connection refused, return code: %d", connack_code_);
+        lock.unlock();
+        Disconnect();
+        return false;
+    }
+    lock.unlock();
+
+    connected_ = true;
+    keep_alive_thread_ = std::thread([this]() {
+        pthread_setname_np(pthread_self(), "mqtt_keepalive");
+        KeepAliveLoop();
+    });
+    if (on_connected_callback_) {
+        on_connected_callback_();
+    }
+    return true;
+}
+
+void PosixMqtt::Disconnect() {
+    if (connected_) {
+        SendPacket(MQTT_DISCONNECT, "");
+    }
+    Shutdown();
+    if (receive_thread_.joinable()) {
+        if (receive_thread_.get_id() == std::this_thread::get_id()) {
+            receive_thread_.detach();
+        } else {
+            receive_thread_.join();
+        }
+    }
+    if (keep_alive_thread_.joinable()) {
+        keep_alive_thread_.join();
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+void PosixMqtt::Shutdown() {
+    closing_ = true;
+    connected_ = false;
+    if (fd_ >= 0) {
+        shutdown(fd_, SHUT_RDWR);
+    }
+    state_cv_.notify_all();
+}
+
+bool PosixMqtt::Publish(const std::string topic, const std::string payload, int qos) {
+    if (!connected_) {
+        return false;
+    }
+    // Only QoS 0 is used by the protocols
+    std::string body;
+    AppendString(body, topic);
+    body += payload;
+    return SendPacket(MQTT_PUBLISH, body);
+}
+
+bool PosixMqtt::Subscribe(const std::string topic, int qos) {
+    if (!connected_) {
+        return false;
+    }
+    std::string body;
+    AppendU16(body, ++packet_id_);
+    AppendString(body, topic);
+    body.push_back(qos > 1 ? 1 : qos);
+    return SendPacket(MQTT_SUBSCRIBE, body);
+}
+
+bool PosixMqtt::Unsubscribe(const std::string topic) {
+    if (!connected_) {
+        return false;
+    }
+    std::string body;
+    AppendU16(body, ++packet_id_);
+    AppendString(body, topic);
+    return SendPacket(MQTT_UNSUBSCRIBE, body);
+}
+
+bool PosixMqtt::SendPacket(uint8_t header, const std::string& body) {
+    std::string packet;
+    packet.push_back(header);
+    // Remaining length, 7 bits per byte
+    size_t length = body.size();
+    do {
+        uint8_t byte = length % 128;
+        length /= 128;
+        if (length > 0) {
+            byte |= 0x80;
+        }
+        packet.push_back(byte);
+    } while (length > 0);
+    packet += body;
+
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    if (fd_ < 0 || !SocketSendAll(fd_, packet.data(), packet.size())) {
+        ESP_LOGE(TAG, "Failed to send packet 0x%02x", header);
+        return false;
+    }
+    return true;
+}
+
+bool PosixMqtt::ReceiveExactly(uint8_t* buffer, size_t size) {
+    while (size > 0) {
+        ssize_t ret = recv(fd_, buffer, size, 0);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return false;
+        }
+        buffer += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+void PosixMqtt::ReceiveLoop() {
+    std::string body;
+    while (!closing_) {
+        uint8_t header;
+        if (!ReceiveExactly(&header, 1)) {
+            break;
+        }
+        size_t length = 0;
+        int shift = 0;
+        uint8_t byte;
+        do {
+            if (!ReceiveExactly(&byte, 1)) {
+                goto done;
+            }
+            length |= (size_t)(byte & 0x7f) << shift;
+            shift += 7;
+        } while ((byte & 0x80) && shift < 28);
+        body.resize(length);
+        if (length > 0 && !ReceiveExactly((uint8_t*)body.data(), length)) {
+            break;
+        }
+
+        switch (header & 0xf0) {
+            case MQTT_CONNACK: {
+                std::lock_guard<std::mutex> lock(state_mutex_);
+                connack_code_ = body.size() >= 2 ? (uint8_t)body[1] : 0xff;
+                connack_received_ = true;
+                state_cv_.notify_all();
+                break;
+            }
+            case MQTT_PUBLISH: {
+                if (body.size() < 2) {
+                    break;
+                }
+                size_t topic_length = ((uint8_t)body[0] << 8) | (uint8_t)body[1];
+                size_t offset = 2 + topic_length;
+                int qos = (header >> 1) & 0x03;
+                uint16_t packet_id = 0;
+                if (qos > 0) {
+                    packet_id = ((uint8_t)body[offset] << 8) | (uint8_t)body[offset + 1];
+                    offset += 2;
+                }
+                if (offset > body.size()) {
+                    break;
+                }
+                if (qos == 1) {
+                    std::string ack;
+                    AppendU16(ack, packet_id);
+                    SendPacket(MQTT_PUBACK, ack);
+                }
+                if (on_message_callback_) {
+                    on_message_callback_(body.substr(2, topic_length), body.substr(offset));
+                }
+                break;
+            }
+            default:
+                // PINGRESP, SUBACK, UNSUBACK and PUBACK need no action
+                break;
+        }
+    }
+done:
+    bool was_connected = connected_.exchange(false);
+    if (was_connected && !closing_) {
+        ESP_LOGW(TAG, "Connection closed by broker");
+        if (on_disconnected_callback_) {
+            on_disconnected_callback_();
+        }
+    }
+    state_cv_.notify_all();
+}
+
+void PosixMqtt::KeepAliveLoop() {
+    if (keep_alive_seconds_ <= 0) {
+        return;
+    }
+    auto interval = std::chrono::seconds(keep_alive_seconds_) / 2;
+    std::unique_lock<std::mutex> lock(state_mutex_);
+    while (!closing_) {
+        if (state_cv_.wait_for(lock, interval, [this]() { return closing_.load(); })) {
+            break;
+        }
+        lock.unlock();
+        SendPacket(MQTT_PINGREQ, "");
+        lock.lock();
+    }
+}
@@ -0,0 +1,84 @@
+#include "posix_udp.h"
+#include "socket_util.h"
+
+#include <esp_log.h>
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#define TAG "PosixUdp"
+
+PosixUdp::PosixUdp() {
+}
+
+PosixUdp::~PosixUdp() {
+    Disconnect();
+}
+
+bool PosixUdp::Connect(const std::string& host, int port) {
+    Disconnect();
+    fd_ = SocketConnect(host, port, SOCK_DGRAM);
+    if (fd_ < 0) {
+        return false;
+    }
+    remote_host_ = host;
+    remote_port_ = port;
+    connected_ = true;
+    closing_ = false;
+    receive_thread_ = std::thread([this]() {
+        pthread_setname_np(pthread_self(), "udp_receive");
+        ReceiveLoop();
+    });
+    return true;
+}
+
+void PosixUdp::Disconnect() {
+    closing_ = true;
+    if (fd_ >= 0) {
+        shutdown(fd_, SHUT_RDWR);
+    }
+    if (receive_thread_.joinable()) {
+        receive_thread_.join();
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    connected_ = false;
+}
+
+int PosixUdp::Send(const std::string& data) {
+    if (fd_ < 0) {
+        return -1;
+    }
+    ssize_t ret = send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Send failed: %d", errno);
+    }
+    return ret;
+}
+
+void PosixUdp::ReceiveLoop() {
+    std::string buffer;
+    while (!closing_) {
+        buffer.resize(1500);
+        ssize_t ret = recv(fd_, buffer.data(), buffer.size(), 0);
+        if (ret < 0) {
+            if (errno == EINTR || errno == ECONNREFUSED) {
+                // ICMP port unreachable is reported on connected sockets, keep listening
+                continue;
+            }
+            break;
+        }
+        if (ret == 0 && closing_) {
+            break;
+        }
+        buffer.resize(ret);
+        if (message_callback_) {
+            message_callback_(buffer);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#include "socket_util.h"
+
+#include <esp_log.h>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#define TAG "Socket"
+
+int SocketConnect(const std::string& host, int port, int type) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = type;
+    struct addrinfo* result = nullptr;
+    std::string service = std::to_string(port);
+    int ret = getaddrinfo(host.c_str(), service.c_str(), &hints, &result);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to resolve %s: %s", host.c_str(), gai_strerror(ret));
+        return -1;
+    }
+
+    int fd = -1;
+    for (auto ai = result; ai != nullptr; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Failed to connect to %s:%d: %s", host.c_str(), port, strerror(errno));
+        return -1;
+    }
+    if (type == SOCK_STREAM) {
+        // Audio frames are small, do not let Nagle hold them back
+        int flag = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    }
+    return fd;
+}
+
+bool SocketSendAll(int fd, const void* data, size_t size) {
+    auto p = (const char*)data;
+    while (size > 0) {
+        ssize_t ret = send(fd, p, size, MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += ret;
+        size -= ret;
+    }
+    return true;
+}
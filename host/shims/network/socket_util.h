@@ -0,0 +1,12 @@
+#ifndef HOST_SOCKET_UTIL_H
+#define HOST_SOCKET_UTIL_H
+
+#include <cstddef>
+#include <string>
+
+// Resolve host and open a connected socket (SOCK_STREAM or SOCK_DGRAM), -1 on failure
+int SocketConnect(const std::string& host, int port, int type);
+// Write the whole buffer, retrying on short writes, false when the socket failed
+bool SocketSendAll(int fd, const void* data, size_t size);
+
+#endif // HOST_SOCKET_UTIL_H
@@ -0,0 +1,56 @@
+#include "tcp_transport.h"
+#include "socket_util.h"
+
+#include <esp_log.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#define TAG "TcpTransport"
+
+TcpTransport::TcpTransport() {
+}
+
+TcpTransport::~TcpTransport() {
+    Disconnect();
+}
+
+bool TcpTransport::Connect(const char* host, int port) {
+    fd_ = SocketConnect(host, port, SOCK_STREAM);
+    connected_ = fd_ >= 0;
+    return connected_;
+}
+
+void TcpTransport::Disconnect() {
+    if (fd_ >= 0) {
+        // shutdown() wakes up a thread blocked in Receive()
+        shutdown(fd_, SHUT_RDWR);
+        close(fd_);
+        fd_ = -1;
+    }
+    connected_ = false;
+}
+
+int TcpTransport::Send(const char* data, size_t length) {
+    if (fd_ < 0 || !SocketSendAll(fd_, data, length)) {
+        ESP_LOGE(TAG, "Send failed");
+        connected_ = false;
+        return -1;
+    }
+    return length;
+}
+
+int TcpTransport::Receive(char* buffer, size_t buffer_size) {
+    while (true) {
+        ssize_t ret = recv(fd_, buffer, buffer_size, 0);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            connected_ = false;
+        }
+        return ret;
+    }
+}
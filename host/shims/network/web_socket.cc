@@ -0,0 +1,314 @@
+#include "web_socket.h"
+
+#include <esp_log.h>
+#include <esp_random.h>
+#include <mbedtls/base64.h>
+
+#include <pthread.h>
+
+#include <cstring>
+#include <string>
+
+#define TAG "WebSocket"
+
+#define WS_OPCODE_CONTINUATION 0x0
+#define WS_OPCODE_TEXT 0x1
+#define WS_OPCODE_BINARY 0x2
+#define WS_OPCODE_CLOSE 0x8
+#define WS_OPCODE_PING 0x9
+#define WS_OPCODE_PONG 0xa
+
+WebSocket::WebSocket(Transport* transport) : transport_(transport) {
+}
+
+WebSocket::~WebSocket() {
+    Close();
+    delete transport_;
+}
+
+void WebSocket::SetHeader(const char* key, const char* value) {
+    headers_[key] = value;
+}
+
+void WebSocket::SetReceiveBufferSize(size_t size) {
+    receive_buffer_size_ = size;
+}
+
+bool WebSocket::IsConnected() const {
+    return connected_;
+}
+
+bool WebSocket::Connect(const char* uri) {
+    // ws://host[:port]/path, wss:// needs a TLS transport which the host does not provide
+    std::string url(uri);
+    size_t host_start = url.find("://");
+    if (host_start == std::string::npos) {
+        ESP_LOGE(TAG, "Invalid uri: %s", uri);
+        return false;
+    }
+    bool secure = url.compare(0, host_start, "wss") == 0;
+    host_start += 3;
+    size_t path_start = url.find('/', host_start);
+    std::string authority = url.substr(host_start, path_start == std::string::npos ? std::string::npos : path_start - host_start);
+    std::string path = path_start == std::string::npos ? "/" : url.substr(path_start);
+    std::string host = authority;
+    int port = secure ? 443 : 80;
+    size_t colon = authority.find(':');
+    if (colon != std::string::npos) {
+        host = authority.substr(0, colon);
+        port = std::stoi(authority.substr(colon + 1));
+    }
+
+    if (!transport_->Connect(host.c_str(), port)) {
+        ESP_LOGE(TAG, "Failed to connect to %s:%d", host.c_str(), port);
+        return false;
+    }
+
+    uint8_t key[16];
+    esp_fill_random(key, sizeof(key));
+    unsigned char key_base64[32];
+    size_t key_base64_length = 0;
+    mbedtls_base64_encode(key_base64, sizeof(key_base64), &key_base64_length, key, sizeof(key));
+
+    std::string request = "GET " + path + " HTTP/1.1\r\n";
+    request += "Host: " + authority + "\r\n";
+    request += "Upgrade: websocket\r\n";
+    request += "Connection: Upgrade\r\n";
+    request += "Sec-WebSocket-Key: " + std::string((char*)key_base64, key_base64_length) + "\r\n";
+    request += "Sec-WebSocket-Version: 13\r\n";
+    for (auto& header : headers_) {
+        request += header.first + ": " + header.second + "\r\n";
+    }
+    request += "\r\n";
+    if (transport_->Send(request.data(), request.size()) < 0) {
+        return false;
+    }
+
+    // Read the response headers byte by byte so that no frame data is consumed
+    std::string response;
+    char c;
+    while (response.size() < 4096) {
+        if (transport_->Receive(&c, 1) != 1) {
+            ESP_LOGE(TAG, "Connection closed during handshake");
+            return false;
+        }
+        response += c;
+        if (response.size() >= 4 && response.compare(response.size() - 4, 4, "\r\n\r\n") == 0) {
+            break;
+        }
+    }
+    if (response.compare(0, 12, "HTTP/1.1 101") != 0) {
+        ESP_LOGE(TAG, "Handshake failed: %s", response.substr(0, response.find("\r\n")).c_str());
+        return false;
+    }
+
+    connected_ = true;
+    closing_ = false;
+    receive_thread_ = std::thread([this]() {
+        pthread_setname_np(pthread_self(), "ws_receive");
+        ReceiveLoop();
+    });
+    if (on_connected_) {
+        on_connected_();
+    }
+    return true;
+}
+
+bool WebSocket::Send(const std::string& data) {
+    return Send(data.data(), data.size(), false);
+}
+
+bool WebSocket::Send(const void* data, size_t len, bool binary, bool fin) {
+    return SendFrame(binary ? WS_OPCODE_BINARY : WS_OPCODE_TEXT, nullptr, 0, data, len, fin);
+}
+
+bool WebSocket::Send(const void* header, size_t header_len, const void* payload, size_t payload_len, bool binary) {
+    return SendFrame(binary ? WS_OPCODE_BINARY : WS_OPCODE_TEXT, header, header_len, payload, payload_len, true);
+}
+
+void WebSocket::Ping() {
+    SendFrame(WS_OPCODE_PING, nullptr, 0, nullptr, 0, true);
+}
+
+void WebSocket::Close() {
+    if (connected_) {
+        SendFrame(WS_OPCODE_CLOSE, nullptr, 0, nullptr, 0, true);
+    }
+    closing_ = true;
+    connected_ = false;
+    transport_->Disconnect();
+    if (receive_thread_.joinable()) {
+        if (receive_thread_.get_id() == std::this_thread::get_id()) {
+            receive_thread_.detach();
+        } else {
+            receive_thread_.join();
+        }
+    }
+}
+
+void WebSocket::OnConnected(std::function<void()> callback) {
+    on_connected_ = callback;
+}
+
+void WebSocket::OnDisconnected(std::function<void()> callback) {
+    on_disconnected_ = callback;
+}
+
+void WebSocket::OnData(std::function<void(const char*, size_t, bool binary)> callback) {
+    on_data_ = callback;
+}
+
+void WebSocket::OnError(std::function<void(int)> callback) {
+    on_error_ = callback;
+}
+
+bool WebSocket::SendFrame(uint8_t opcode, const void* head, size_t head_len, const void* data, size_t data_len,
+    bool fin) {
+    if (!connected_) {
+        return false;
+    }
+
+    // Client frames are always masked, the header and the masked payload are written
+    // into one buffer that keeps its capacity so that a frame goes out in one write.
+    // The payload is gathered from the two parts while it is masked
+    size_t len = head_len + data_len;
+    std::lock_guard<std::mutex> lock(send_mutex_);
+    frame_.clear();
+    frame_.push_back((fin ? 0x80 : 0x00) | opcode);
+    if (len < 126) {
+        frame_.push_back(0x80 | len);
+    } else if (len < 65536) {
+        frame_.push_back(0x80 | 126);
+        frame_.push_back(len >> 8);
+        frame_.push_back(len & 0xff);
+    } else {
+        frame_.push_back(0x80 | 127);
+        for (int i = 7; i >= 0; i--) {
+            frame_.push_back((uint64_t)len >> (i * 8));
+        }
+    }
+    uint8_t mask[4];
+    esp_fill_random(mask, sizeof(mask));
+    frame_.append((char*)mask, sizeof(mask));
+    size_t offset = frame_.size();
+    frame_.resize(offset + len);
+    auto part = (const uint8_t*)head;
+    for (size_t i = 0; i < head_len; i++) {
+        frame_[offset + i] = part[i] ^ mask[i % 4];
+    }
+    part = (const uint8_t*)data;
+    for (size_t i = 0; i < data_len; i++) {
+        frame_[offset + head_len + i] = part[i] ^ mask[(head_len + i) % 4];
+    }
+
+    if (transport_->Send(frame_.data(), frame_.size()) < 0) {
+        ESP_LOGE(TAG, "Failed to send frame");
+        connected_ = false;
+        return false;
+    }
+    return true;
+}
+
+bool WebSocket::ReceiveExactly(char* buffer, size_t size) {
+    while (size > 0) {
+        int ret = transport_->Receive(buffer, size);
+        if (ret <= 0) {
+            return false;
+        }
+        buffer += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+void WebSocket::ReceiveLoop() {
+    std::vector<char> message;
+    bool message_binary = false;
+    std::vector<char> payload;
+    payload.reserve(receive_buffer_size_);
+
+    while (!closing_) {
+        uint8_t header[2];
+        if (!ReceiveExactly((char*)header, sizeof(header))) {
+            break;
+        }
+        bool fin = header[0] & 0x80;
+        uint8_t opcode = header[0] & 0x0f;
+        bool masked = header[1] & 0x80;
+        uint64_t length = header[1] & 0x7f;
+        if (length == 126) {
+            uint8_t ext[2];
+            if (!ReceiveExactly((char*)ext, sizeof(ext))) {
+                break;
+            }
+            length = (ext[0] << 8) | ext[1];
+        } else if (length == 127) {
+            uint8_t ext[8];
+            if (!ReceiveExactly((char*)ext, sizeof(ext))) {
+                break;
+            }
+            length = 0;
+            for (int i = 0; i < 8; i++) {
+                length = (length << 8) | ext[i];
+            }
+        }
+        uint8_t mask[4] = {0};
+        if (masked && !ReceiveExactly((char*)mask, sizeof(mask))) {
+            break;
+        }
+        // One extra byte so that text frames can be handed out NUL terminated
+        payload.resize(length + 1);
+        if (length > 0 && !ReceiveExactly(payload.data(), length)) {
+            break;
+        }
+        if (masked) {
+            for (uint64_t i = 0; i < length; i++) {
+                payload[i] ^= mask[i % 4];
+            }
+        }
+        payload[length] = '\0';
+
+        switch (opcode) {
+            case WS_OPCODE_PING:
+                SendFrame(WS_OPCODE_PONG, nullptr, 0, payload.data(), length, true);
+                break;
+            case WS_OPCODE_PONG:
+                break;
+            case WS_OPCODE_CLOSE:
+                closing_ = true;
+                break;
+            case WS_OPCODE_TEXT:
+            case WS_OPCODE_BINARY:
+            case WS_OPCODE_CONTINUATION:
+                if (opcode != WS_OPCODE_CONTINUATION) {
+                    message_binary = opcode == WS_OPCODE_BINARY;
+                }
+                if (fin && message.empty()) {
+                    if (on_data_) {
+                        on_data_(payload.data(), length, message_binary);
+                    }
+                } else {
+                    message.insert(message.end(), payload.begin(), payload.begin() + length);
+                    if (fin) {
+                        size_t message_length = message.size();
+                        message.push_back('\0');
+                        if (on_data_) {
+                            on_data_(message.data(), message_length, message_binary);
+                        }
+                        message.clear();
+                    }
+                }
+                break;
+            default:
+                ESP_LOGW(TAG, "Unknown opcode: %d", opcode);
+                break;
+        }
+    }
+
+    bool was_connected = connected_.exchange(false);
+    if (was_connected) {
+        if (on_disconnected_) {
+            on_disconnected_();
+        }
+    }
+}
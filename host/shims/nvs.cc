@@ -0,0 +1,261 @@
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include <esp_log.h>
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#define TAG "NVS"
+
+/*
+ * NVS file format, one entry per line:
+ * |namespace|\t|key|\t|i or s|\t|value|
+ * Tabs, newlines and backslashes in strings are escaped.
+ */
+
+struct NvsValue {
+    bool is_string = false;
+    int32_t int_value = 0;
+    std::string string_value;
+};
+
+typedef std::map<std::string, NvsValue> NvsNamespace;
+
+struct NvsHandle {
+    std::string ns;
+    bool read_write;
+};
+
+static std::mutex nvs_mutex;
+static std::string nvs_path = "nvs.txt";
+static bool nvs_initialized = false;
+static std::map<std::string, NvsNamespace> nvs_data;
+static std::map<nvs_handle_t, NvsHandle> nvs_handles;
+static nvs_handle_t next_handle = 1;
+
+static std::string Escape(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        switch (c) {
+            case '\\': escaped += "\\\\"; break;
+            case '\t': escaped += "\\t"; break;
+            case '\n': escaped += "\\n"; break;
+            default: escaped += c; break;
+        }
+    }
+    return escaped;
+}
+
+static std::string Unescape(const std::string& value) {
+    std::string unescaped;
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '\\' && i + 1 < value.size()) {
+            char c = value[++i];
+            unescaped += c == 't' ? '\t' : c == 'n' ? '\n' : c;
+        } else {
+            unescaped += value[i];
+        }
+    }
+    return unescaped;
+}
+
+static void Load() {
+    nvs_data.clear();
+    std::ifstream file(nvs_path);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string ns, key, type, value;
+        if (!std::getline(fields, ns, '\t') || !std::getline(fields, key, '\t') || !std::getline(fields, type, '\t')) {
+            continue;
+        }
+        std::getline(fields, value);
+        NvsValue entry;
+        if (type == "s") {
+            entry.is_string = true;
+            entry.string_value = Unescape(value);
+        } else {
+            entry.int_value = strtol(value.c_str(), nullptr, 10);
+        }
+        nvs_data[Unescape(ns)][Unescape(key)] = entry;
+    }
+}
+
+static esp_err_t Save() {
+    std::string temp_path = nvs_path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::trunc);
+        if (!file) {
+            ESP_LOGE(TAG, "Failed to write %s", temp_path.c_str());
+            return ESP_FAIL;
+        }
+        for (auto& ns : nvs_data) {
+            for (auto& entry : ns.second) {
+                file << Escape(ns.first) << '\t' << Escape(entry.first) << '\t';
+                if (entry.second.is_string) {
+                    file << "s\t" << Escape(entry.second.string_value) << '\n';
+                } else {
+                    file << "i\t" << entry.second.int_value << '\n';
+                }
+            }
+        }
+    }
+    // Replace the file atomically so that a killed process never leaves it half written
+    if (rename(temp_path.c_str(), nvs_path.c_str()) != 0) {
+        ESP_LOGE(TAG, "Failed to replace %s", nvs_path.c_str());
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void nvs_flash_set_path(const char* path) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    nvs_path = path;
+}
+
+esp_err_t nvs_flash_init() {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    Load();
+    nvs_initialized = true;
+    ESP_LOGI(TAG, "Loaded %zu namespaces from %s", nvs_data.size(), nvs_path.c_str());
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase() {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    nvs_data.clear();
+    return Save();
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    if (!nvs_initialized) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    // Like the real NVS, a read-only open of a namespace that was never written fails
+    if (open_mode == NVS_READONLY && nvs_data.find(name) == nvs_data.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    nvs_handle_t handle = next_handle++;
+    nvs_handles[handle] = NvsHandle{name, open_mode == NVS_READWRITE};
+    nvs_data[name];
+    *out_handle = handle;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    nvs_handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    if (nvs_handles.find(handle) == nvs_handles.end()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    return Save();
+}
+
+// Looks up the namespace of a handle, the caller holds nvs_mutex
+static esp_err_t GetNamespace(nvs_handle_t handle, bool write, NvsNamespace** out) {
+    auto it = nvs_handles.find(handle);
+    if (it == nvs_handles.end()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (write && !it->second.read_write) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    *out = &nvs_data[it->second.ns];
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    NvsNamespace* ns;
+    esp_err_t err = GetNamespace(handle, false, &ns);
+    if (err != ESP_OK) {
+        return err;
+    }
+    auto it = ns->find(key);
+    if (it == ns->end() || !it->second.is_string) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    auto& value = it->second.string_value;
+    if (out_value == nullptr) {
+        *length = value.size() + 1;
+        return ESP_OK;
+    }
+    if (*length < value.size() + 1) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, value.c_str(), value.size() + 1);
+    *length = value.size() + 1;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    NvsNamespace* ns;
+    esp_err_t err = GetNamespace(handle, true, &ns);
+    if (err != ESP_OK) {
+        return err;
+    }
+    auto& entry = (*ns)[key];
+    entry.is_string = true;
+    entry.string_value = value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out_value) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    NvsNamespace* ns;
+    esp_err_t err = GetNamespace(handle, false, &ns);
+    if (err != ESP_OK) {
+        return err;
+    }
+    auto it = ns->find(key);
+    if (it == ns->end() || it->second.is_string) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out_value = it->second.int_value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    NvsNamespace* ns;
+    esp_err_t err = GetNamespace(handle, true, &ns);
+    if (err != ESP_OK) {
+        return err;
+    }
+    auto& entry = (*ns)[key];
+    entry.is_string = false;
+    entry.int_value = value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    NvsNamespace* ns;
+    esp_err_t err = GetNamespace(handle, true, &ns);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return ns->erase(key) > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    NvsNamespace* ns;
+    esp_err_t err = GetNamespace(handle, true, &ns);
+    if (err != ESP_OK) {
+        return err;
+    }
+    ns->clear();
+    return ESP_OK;
+}
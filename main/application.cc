@@ -8,6 +8,11 @@
 #include "websocket_protocol.h"
 #include "font_awesome_symbols.h"
 #include "iot/thing_manager.h"
+#include "event_trace.h"
+#include "deferred_log.h"
+#include "boot_profiler.h"
+#include "settings.h"
+#include "frame_governor.h"
 #include "assets/lang_config.h"
 
 #if CONFIG_USE_AUDIO_PROCESSOR
@@ -16,6 +21,10 @@
 #include "dummy_audio_processor.h"
 #endif
 
+#if CONFIG_DISPLAY_BENCHMARK
+#include "display_benchmark.h"
+#endif
+
 #include <cstring>
 #include <esp_log.h>
 #include <cJSON.h>
@@ -24,6 +33,18 @@
 
 #define TAG "Application"
 
+#ifndef CONFIG_BOOT_TIME_BUDGET_MS
+#define CONFIG_BOOT_TIME_BUDGET_MS 8000
+#endif
+
+// Boot phase budgets in milliseconds, checked by the boot profiler
+#define BOOT_BUDGET_BOARD_MS 1500
+#define BOOT_BUDGET_AUDIO_MS 500
+#define BOOT_BUDGET_FRONTEND_MS 1500
+#define BOOT_BUDGET_NETWORK_MS 6000
+#define BOOT_BUDGET_OTA_MS 3000
+#define BOOT_BUDGET_PROTOCOL_MS 2000
+
 static const char *const STATE_STRINGS[] = {
     "unknown",
     "starting",
@@ -77,6 +98,23 @@ Application::~Application()
     vEventGroupDelete(event_group_);
 }
 
+// The broker settings the protocol connects with, empty before the first OTA check
+static std::string GetMqttSettings() {
+    Settings settings("mqtt", false);
+    std::string endpoint = settings.GetString("endpoint");
+    if (endpoint.empty()) {
+        return "";
+    }
+    return endpoint + "\n" + settings.GetString("client_id") + "\n" + settings.GetString("username") + "\n" +
+        settings.GetString("password") + "\n" + settings.GetString("publish_topic");
+}
+
+void Application::WaitForFrontend() {
+#if CONFIG_PARALLEL_BOOT
+    xEventGroupWaitBits(event_group_, FRONTEND_READY_EVENT, pdFALSE, pdFALSE, portMAX_DELAY);
+#endif
+}
+
 void Application::CheckNewVersion() {
     const int MAX_RETRY = 10;
     int retry_count = 0;
@@ -365,15 +403,190 @@ void Application::StopListening() {
         } });
 }
 
+void Application::InitializeProtocol() {
+    auto& board = Board::GetInstance();
+    auto display = board.GetDisplay();
+    auto codec = board.GetAudioCodec();
+
+    protocol_->OnIncomingAudio([this](AudioStreamPacket&& packet) {
+        const int max_packets_in_queue = 600 / OPUS_FRAME_DURATION_MS;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (audio_decode_queue_.size() < max_packets_in_queue) {
+            audio_decode_queue_.emplace_back(std::move(packet));
+        }
+        TRACE_COUNTER("decode_queue", audio_decode_queue_.size());
+    });
+    protocol_->OnAudioChannelOpened([this, codec, &board]() {
+        board.SetPowerSaveMode(false);
+        if (protocol_->server_sample_rate() != codec->output_sample_rate()) {
+            ESP_LOGW(TAG, "Server sample rate %d does not match device output sample rate %d, resampling may cause distortion",
+                protocol_->server_sample_rate(), codec->output_sample_rate());
+        }
+        SetDecodeSampleRate(protocol_->server_sample_rate(), protocol_->server_frame_duration());
+        auto& thing_manager = iot::ThingManager::GetInstance();
+        protocol_->SendIotDescriptors(thing_manager.GetDescriptorsJson());
+        std::string states;
+        if (thing_manager.GetStatesJson(states, false)) {
+            protocol_->SendIotStates(states);
+        }
+    });
+    protocol_->OnAudioChannelClosed([this, &board]() {
+        board.SetPowerSaveMode(true);
+        Schedule([this]() {
+            auto display = Board::GetInstance().GetDisplay();
+            display->SetChatMessage("system", "");
+            SetDeviceState(kDeviceStateIdle);
+        }); });
+    protocol_->OnIncomingJson("tts", [this, display](const JsonValue& root) {
+        auto state = root.Get("state");
+        if (state.Equals("start")) {
+            Schedule([this]() {
+                aborted_ = false;
+                if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
+                    SetDeviceState(kDeviceStateSpeaking);
+                }
+            });
+        } else if (state.Equals("stop")) {
+            Schedule([this]() {
+                background_task_->WaitForCompletion();
+                if (device_state_ == kDeviceStateSpeaking) {
+                    if (listening_mode_ == kListeningModeManualStop) {
+                        SetDeviceState(kDeviceStateIdle);
+                    } else {
+                        SetDeviceState(kDeviceStateListening);
+                    }
+                }
+            });
+        } else if (state.Equals("sentence_start")) {
+            auto text = root.Get("text");
+            if (text.IsString()) {
+                std::string message = text.ToString();
+                DLOGI(TAG, "<< %s", message.c_str());
+                Schedule([this, display, message = std::move(message)]() {
+                    display->SetChatMessage("assistant", message.c_str());
+                });
+            }
+        }
+    });
+    protocol_->OnIncomingJson("stt", [this, display](const JsonValue& root) {
+        auto text = root.Get("text");
+        if (text.IsString()) {
+            std::string message = text.ToString();
+            DLOGI(TAG, ">> %s", message.c_str());
+            Schedule([this, display, message = std::move(message)]() {
+                display->SetChatMessage("user", message.c_str());
+            });
+        }
+    });
+    protocol_->OnIncomingJson("llm", [this, display](const JsonValue& root) {
+        auto emotion = root.Get("emotion");
+        if (emotion.IsString()) {
+            Schedule([this, display, emotion_str = emotion.ToString()]() {
+                display->SetEmotion(emotion_str.c_str());
+            });
+        }
+    });
+    protocol_->OnIncomingJson("iot", [](const JsonValue& root) {
+        // The things take their parameters as cJSON, only the commands array is parsed into a tree
+        auto commands = root.Get("commands");
+        if (!commands.IsArray()) {
+            return;
+        }
+        cJSON* array = cJSON_ParseWithLength(commands.raw(), commands.raw_size());
+        if (array == nullptr) {
+            ESP_LOGE(TAG, "Failed to parse IoT commands");
+            return;
+        }
+        auto& thing_manager = iot::ThingManager::GetInstance();
+        for (int i = 0; i < cJSON_GetArraySize(array); ++i) {
+            auto command = cJSON_GetArrayItem(array, i);
+            thing_manager.Invoke(command);
+        }
+        cJSON_Delete(array);
+    });
+    protocol_->OnIncomingJson("system", [this](const JsonValue& root) {
+        auto command = root.Get("command");
+        if (!command.IsString()) {
+            return;
+        }
+        ESP_LOGI(TAG, "System command: %s", command.ToString().c_str());
+        if (command.Equals("reboot")) {
+            // Do a reboot if user requests a OTA update
+            Schedule([this]() {
+                Reboot();
+            });
+#if CONFIG_USE_EVENT_TRACE
+        } else if (command.Equals("trace")) {
+            background_task_->Schedule([]() {
+                EventTrace::GetInstance().DumpToConsole();
+            });
+#endif
+#if CONFIG_USE_DEFERRED_LOG
+        } else if (command.Equals("log")) {
+            background_task_->Schedule([]() {
+                DeferredLog::GetInstance().DumpToConsole();
+            });
+#endif
+        } else {
+            ESP_LOGW(TAG, "Unknown system command: %s", command.ToString().c_str());
+        }
+    });
+    protocol_->OnIncomingJson("alert", [this](const JsonValue& root) {
+        auto status = root.Get("status");
+        auto message = root.Get("message");
+        auto emotion = root.Get("emotion");
+        if (status.IsString() && message.IsString() && emotion.IsString()) {
+            Alert(status.ToString().c_str(), message.ToString().c_str(), emotion.ToString().c_str(), Lang::Sounds::P3_VIBRATION);
+        } else {
+            ESP_LOGW(TAG, "Alert command requires status, message and emotion");
+        }
+    });
+    protocol_->OnNetworkError([this](const std::string& message) {
+        if (quiet_network_errors_) {
+            ESP_LOGW(TAG, "Early start failed: %s", message.c_str());
+            return;
+        }
+        SetDeviceState(kDeviceStateIdle);
+        Alert(Lang::Strings::ERROR, message.c_str(), "sad", Lang::Sounds::P3_EXCLAMATION);
+    });
+}
+
 void Application::Start()
 {
+#if CONFIG_USE_EVENT_TRACE
+    // Allocate the trace rings before any task starts recording
+    EventTrace::GetInstance();
+#endif
+#if CONFIG_USE_DEFERRED_LOG
+    DeferredLog::GetInstance();
+#endif
+    int board_phase = BOOT_PHASE_BEGIN("board_init", BOOT_BUDGET_BOARD_MS);
     auto &board = Board::GetInstance();
+    BOOT_PHASE_END(board_phase);
     SetDeviceState(kDeviceStateStarting);
 
+#if CONFIG_PARALLEL_BOOT
+    /* Bring up the network while the codec, the audio front end and the wake word models load.
+       The display is already up: the board constructor creates it and the network needs the board */
+    xTaskCreate([](void* arg) {
+        Application* app = (Application*)arg;
+        {
+            BOOT_PHASE("network", BOOT_BUDGET_NETWORK_MS);
+            Board::GetInstance().StartNetwork();
+        }
+        xEventGroupSetBits(app->event_group_, NETWORK_READY_EVENT);
+        vTaskDelete(NULL);
+    }, "network_start", 4096 * 2, this, 3, nullptr);
+#endif
+
     /* Setup the display */
     auto display = board.GetDisplay();
+#if CONFIG_DISPLAY_BENCHMARK
+    DisplayBenchmark(display).Run();
+#endif
 
     /* Setup the audio codec */
+    int audio_phase = BOOT_PHASE_BEGIN("audio_init", BOOT_BUDGET_AUDIO_MS);
     auto codec = board.GetAudioCodec();
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
     opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
@@ -410,153 +623,55 @@ void Application::Start()
         vTaskDelete(NULL);
     }, "audio_loop", 4096 * 2, this, 8, &audio_loop_task_handle_);
 #endif
+    BOOT_PHASE_END(audio_phase);
 
+#if !CONFIG_PARALLEL_BOOT
     /* Wait for the network to be ready */
-    board.StartNetwork();
-
-    // Check for new firmware version or get the MQTT broker address
-    CheckNewVersion();
-
-    // Initialize the protocol
-    display->SetStatus(Lang::Strings::LOADING_PROTOCOL);
-
-    if (ota_.HasMqttConfig()) {
-        protocol_ = std::make_unique<MqttProtocol>();
-    } 
-    // else if (ota_.HasWebsocketConfig()) {
-    //     protocol_ = std::make_unique<WebsocketProtocol>();
-    // } 
-    else {
-        ESP_LOGW(TAG, "No protocol specified in the OTA config, using MQTT");
-        protocol_ = std::make_unique<MqttProtocol>();
+    {
+        BOOT_PHASE("network", BOOT_BUDGET_NETWORK_MS);
+        board.StartNetwork();
     }
+#endif
 
-    protocol_->OnNetworkError([this](const std::string& message) {
-        SetDeviceState(kDeviceStateIdle);
-        Alert(Lang::Strings::ERROR, message.c_str(), "sad", Lang::Sounds::P3_EXCLAMATION);
-    });
-    protocol_->OnIncomingAudio([this](AudioStreamPacket&& packet) {
-        const int max_packets_in_queue = 600 / OPUS_FRAME_DURATION_MS;
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (audio_decode_queue_.size() < max_packets_in_queue) {
-            audio_decode_queue_.emplace_back(std::move(packet));
-        }
-    });
-    protocol_->OnAudioChannelOpened([this, codec, &board]() {
-        board.SetPowerSaveMode(false);
-        if (protocol_->server_sample_rate() != codec->output_sample_rate()) {
-            ESP_LOGW(TAG, "Server sample rate %d does not match device output sample rate %d, resampling may cause distortion",
-                protocol_->server_sample_rate(), codec->output_sample_rate());
-        }
-        SetDecodeSampleRate(protocol_->server_sample_rate(), protocol_->server_frame_duration());
-        auto& thing_manager = iot::ThingManager::GetInstance();
-        protocol_->SendIotDescriptors(thing_manager.GetDescriptorsJson());
-        std::string states;
-        if (thing_manager.GetStatesJson(states, false)) {
-            protocol_->SendIotStates(states);
-        }
-    });
-    protocol_->OnAudioChannelClosed([this, &board]() {
-        board.SetPowerSaveMode(true);
-        Schedule([this]() {
-            auto display = Board::GetInstance().GetDisplay();
-            display->SetChatMessage("system", "");
-            SetDeviceState(kDeviceStateIdle);
-        }); });
-    protocol_->OnIncomingJson([this, display](const cJSON *root)
-                              {
-        // Parse JSON data
-        auto type = cJSON_GetObjectItem(root, "type");
-        if (strcmp(type->valuestring, "tts") == 0) {
-            auto state = cJSON_GetObjectItem(root, "state");
-            if (strcmp(state->valuestring, "start") == 0) {
-                Schedule([this]() {
-                    aborted_ = false;
-                    if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
-                        SetDeviceState(kDeviceStateSpeaking);
-                    }
-                });
-            } else if (strcmp(state->valuestring, "stop") == 0) {
-                Schedule([this]() {
-                    background_task_->WaitForCompletion();
-                    if (device_state_ == kDeviceStateSpeaking) {
-                        if (listening_mode_ == kListeningModeManualStop) {
-                            SetDeviceState(kDeviceStateIdle);
-                        } else {
-                            SetDeviceState(kDeviceStateListening);
-                        }
-                    }
-                });
-            } else if (strcmp(state->valuestring, "sentence_start") == 0) {
-                auto text = cJSON_GetObjectItem(root, "text");
-                if (text != NULL) {
-                    ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    Schedule([this, display, message = std::string(text->valuestring)]() {
-                        display->SetChatMessage("assistant", message.c_str());
-                    });
-                }
-            }
-        } else if (strcmp(type->valuestring, "stt") == 0) {
-            auto text = cJSON_GetObjectItem(root, "text");
-            if (text != NULL) {
-                ESP_LOGI(TAG, ">> %s", text->valuestring);
-                Schedule([this, display, message = std::string(text->valuestring)]() {
-                    display->SetChatMessage("user", message.c_str());
-                });
-            }
-        } else if (strcmp(type->valuestring, "llm") == 0) {
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (emotion != NULL) {
-                Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
-                    display->SetEmotion(emotion_str.c_str());
-                });
-            }
-        } else if (strcmp(type->valuestring, "iot") == 0) {
-            auto commands = cJSON_GetObjectItem(root, "commands");
-            if (commands != NULL) {
-                auto& thing_manager = iot::ThingManager::GetInstance();
-                for (int i = 0; i < cJSON_GetArraySize(commands); ++i) {
-                    auto command = cJSON_GetArrayItem(commands, i);
-                    thing_manager.Invoke(command);
-                }
-            }
-        } else if (strcmp(type->valuestring, "system") == 0) {
-            auto command = cJSON_GetObjectItem(root, "command");
-            if (command != NULL) {
-                ESP_LOGI(TAG, "System command: %s", command->valuestring);
-                if (strcmp(command->valuestring, "reboot") == 0) {
-                    // Do a reboot if user requests a OTA update
-                    Schedule([this]() {
-                        Reboot();
-                    });
-                } else {
-                    ESP_LOGW(TAG, "Unknown system command: %s", command->valuestring);
-                }
-            }
-        } else if (strcmp(type->valuestring, "alert") == 0) {
-            auto status = cJSON_GetObjectItem(root, "status");
-            auto message = cJSON_GetObjectItem(root, "message");
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (status != NULL && message != NULL && emotion != NULL) {
-                Alert(status->valuestring, message->valuestring, emotion->valuestring, Lang::Sounds::P3_VIBRATION);
-            } else {
-                ESP_LOGW(TAG, "Alert command requires status, message and emotion");
-            }
-        }
-    });
-    bool protocol_started = protocol_->Start();
-
+    int frontend_phase = BOOT_PHASE_BEGIN("audio_frontend", BOOT_BUDGET_FRONTEND_MS);
     audio_processor_->Initialize(codec);
     audio_processor_->OnOutput([this](std::vector<int16_t>&& data) {
         background_task_->Schedule([this, data = std::move(data)]() mutable {
-            if (protocol_->IsAudioChannelBusy()) {
+            // With aggregation the frames encoded during a slow send wait for the next message
+            bool aggregate = protocol_->max_frames_per_packet() > 1;
+            bool busy = protocol_->IsAudioChannelBusy();
+            if (busy && !aggregate) {
+                TRACE_INSTANT("uplink_busy_drop");
                 return;
             }
-            opus_encoder_->Encode(std::move(data), [this](std::vector<uint8_t>&& opus) {
+            TRACE_SCOPE("opus_encode");
+            opus_encoder_->Encode(std::move(data), [this, aggregate, busy](std::vector<uint8_t>&& opus) {
                 AudioStreamPacket packet;
                 packet.payload = std::move(opus);
                 packet.timestamp = last_output_timestamp_;
                 last_output_timestamp_ = 0;
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+                // Captured while the channel opens, sent right after the start listening command
+                if (device_state_ == kDeviceStateConnecting) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (connecting_audio_.size() >= MAX_CONNECTING_AUDIO_FRAMES) {
+                        connecting_audio_.pop_front();
+                    }
+                    connecting_audio_.emplace_back(std::move(packet));
+                    return;
+                }
+#endif
+                if (aggregate) {
+                    protocol_->QueueAudio(std::move(packet));
+                    if (busy) {
+                        TRACE_INSTANT("uplink_busy_queue");
+                    } else {
+                        Schedule([this]() {
+                            protocol_->SendQueuedAudio();
+                        });
+                    }
+                    return;
+                }
                 Schedule([this, packet = std::move(packet)]() {
                     protocol_->SendAudio(packet);
                 });
@@ -615,11 +730,96 @@ void Application::Start()
         display->SpectrumShow(data.data(), data.size()); });
 #endif
 
+#endif
+    BOOT_PHASE_END(frontend_phase);
+
+#if CONFIG_PARALLEL_BOOT
+    xEventGroupSetBits(event_group_, FRONTEND_READY_EVENT);
+    xEventGroupWaitBits(event_group_, NETWORK_READY_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
+
+    // Connect with the broker settings saved by the previous boot while the version check runs,
+    // reconnect afterwards only if that failed or the OTA server handed out different settings
+    struct EarlyStart {
+        Application* app;
+        bool started;
+    } early_start = {this, false};
+    std::string mqtt_settings = GetMqttSettings();
+    bool start_early = !mqtt_settings.empty();
+    if (start_early) {
+        // Saved broker settings mean the previous OTA config chose MQTT. Every callback is in
+        // place before the task starts, errors stay quiet until the version check confirms them
+        protocol_ = std::make_unique<MqttProtocol>();
+        InitializeProtocol();
+        quiet_network_errors_ = true;
+        xTaskCreate([](void* arg) {
+            auto early_start = (EarlyStart*)arg;
+            {
+                BOOT_PHASE("protocol_start", BOOT_BUDGET_PROTOCOL_MS);
+                early_start->started = early_start->app->protocol_->Start();
+            }
+            xEventGroupSetBits(early_start->app->event_group_, PROTOCOL_STARTED_EVENT);
+            vTaskDelete(NULL);
+        }, "protocol_start", 4096, &early_start, 3, nullptr);
+    }
 #endif
 
+    // Check for new firmware version or get the MQTT broker address
+    {
+        BOOT_PHASE("ota_check", BOOT_BUDGET_OTA_MS);
+        CheckNewVersion();
+    }
+
+    display->SetStatus(Lang::Strings::LOADING_PROTOCOL);
+    bool protocol_started = false;
+#if CONFIG_PARALLEL_BOOT
+    if (start_early) {
+        xEventGroupWaitBits(event_group_, PROTOCOL_STARTED_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
+        quiet_network_errors_ = false;
+        protocol_started = early_start.started;
+    }
+#endif
+
+    // Initialize the protocol from the OTA config the version check fetched
+    if (ota_.HasMqttConfig()) {
+        if (!protocol_) {
+            protocol_ = std::make_unique<MqttProtocol>();
+            InitializeProtocol();
+        }
+    } else if (ota_.HasWebsocketConfig()) {
+        // Replaces the client the early start connected with broker settings of an older config
+        protocol_ = std::make_unique<WebsocketProtocol>();
+        InitializeProtocol();
+#if CONFIG_PARALLEL_BOOT
+        start_early = false;
+#endif
+    } else {
+        ESP_LOGW(TAG, "No protocol specified in the OTA config, using MQTT");
+        if (!protocol_) {
+            protocol_ = std::make_unique<MqttProtocol>();
+            InitializeProtocol();
+        }
+    }
+
+#if CONFIG_PARALLEL_BOOT
+    if (start_early) {
+        if (!protocol_started || GetMqttSettings() != mqtt_settings) {
+            ESP_LOGI(TAG, "Reconnecting with the settings from the OTA server");
+            BOOT_PHASE("protocol_restart", BOOT_BUDGET_PROTOCOL_MS);
+            protocol_started = protocol_->Start();
+        }
+    } else
+#endif
+    {
+        BOOT_PHASE("protocol_start", BOOT_BUDGET_PROTOCOL_MS);
+        protocol_started = protocol_->Start();
+    }
+
     // Wait for the new version check to finish
     xEventGroupWaitBits(event_group_, CHECK_NEW_VERSION_DONE_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
     SetDeviceState(kDeviceStateIdle);
+#if CONFIG_USE_BOOT_PROFILER
+    BootProfiler::GetInstance().Report(CONFIG_BOOT_TIME_BUDGET_MS);
+#endif
 
     if (protocol_started) {
         std::string message = std::string(Lang::Strings::VERSION) + ota_.GetCurrentVersion();
@@ -661,6 +861,17 @@ void Application::OnClockTimer()
             }
         }
     }
+
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+    // Keep the connection ready so that the next conversation does not wait for it
+    if (device_state_ == kDeviceStateIdle && protocol_) {
+        Schedule([this]() {
+            if (device_state_ == kDeviceStateIdle) {
+                protocol_->PreWarm();
+            }
+        });
+    }
+#endif
 }
 
 // Add a async task to MainLoop
@@ -683,13 +894,13 @@ void Application::MainEventLoop() {
             std::unique_lock<std::mutex> lock(mutex_);
             std::list<std::function<void()>> tasks = std::move(main_tasks_);
             lock.unlock();
+            TRACE_SCOPE("main_tasks");
             for (auto &task : tasks)
             {
                 task();
             }
         }
-        UBaseType_t uxHighWaterMark = uxTaskGetStackHighWaterMark(NULL);
-        ESP_LOGD(TAG, "Task free stack size: %u bytes", uxHighWaterMark * sizeof(StackType_t));
+        DLOGD(TAG, "Task free stack size: %u bytes", uxTaskGetStackHighWaterMark(NULL) * sizeof(StackType_t));
     }
 }
 
@@ -747,8 +958,12 @@ void Application::OnAudioOutput() {
             return;
         }
 
+        TRACE_SCOPE("opus_decode");
         std::vector<int16_t> pcm;
-        if (!opus_decoder_->Decode(std::move(packet.payload), pcm)) {
+        bool decoded = opus_decoder_->Decode(std::move(packet.payload), pcm);
+        // Decode() only reads the payload, its storage goes back to the protocol for the next packet
+        protocol_->ReleaseAudioBuffer(std::move(packet.payload));
+        if (!decoded) {
             return;
         }
         // Resample if the sample rate is different
@@ -783,6 +998,7 @@ void Application::OnAudioInput() {
         std::vector<int16_t> data;
         int samples = audio_processor_->GetFeedSize();
         if (samples > 0) {
+            TRACE_SCOPE("audio_feed");
             ReadAudio(data, 16000, samples);
             audio_processor_->Feed(data);
 #if CONFIG_USE_FFT_EFFECT
@@ -856,12 +1072,14 @@ void Application::SetDeviceState(DeviceState state) {
     auto previous_state = device_state_;
     device_state_ = state;
     ESP_LOGI(TAG, "STATE: %s", STATE_STRINGS[device_state_]);
+    TRACE_COUNTER("device_state", state);
     // The state is changed, wait for all background tasks to finish
     background_task_->WaitForCompletion();
 
     auto& board = Board::GetInstance();
     auto display = board.GetDisplay();
     auto led = board.GetLed();
+    FrameGovernor::GetInstance().OnStateChanged();
     led->OnStateChanged();
     switch (state) {
         case kDeviceStateUnknown:
@@ -869,6 +1087,20 @@ void Application::SetDeviceState(DeviceState state) {
             display->SetStatus(Lang::Strings::STANDBY);
             display->SetEmotion("neutral");
             audio_processor_->Stop();
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                connecting_audio_.clear();
+            }
+            // Prepare the next conversation now instead of on the next clock tick
+            if (protocol_) {
+                Schedule([this]() {
+                    if (device_state_ == kDeviceStateIdle) {
+                        protocol_->PreWarm();
+                    }
+                });
+            }
+#endif
 #if CONFIG_USE_WAKE_WORD_DETECT
             wake_word_detect_.StartDetection();
 #endif
@@ -877,6 +1109,16 @@ void Application::SetDeviceState(DeviceState state) {
             display->SetStatus(Lang::Strings::CONNECTING);
             display->SetEmotion("neutral");
             display->SetChatMessage("system", "");
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+            // Start capturing while the channel opens, the frames wait in connecting_audio_
+            if (!audio_processor_->IsRunning()) {
+                opus_encoder_->ResetState();
+#if CONFIG_USE_WAKE_WORD_DETECT
+                wake_word_detect_.StopDetection();
+#endif
+                audio_processor_->Start();
+            }
+#endif
             break;
         case kDeviceStateListening:
             display->SetStatus(Lang::Strings::LISTENING);
@@ -886,18 +1128,23 @@ void Application::SetDeviceState(DeviceState state) {
             UpdateIotStates();
 
             // Make sure the audio processor is running
-            if (!audio_processor_->IsRunning()) {
+            if (!audio_processor_->IsRunning() || previous_state == kDeviceStateConnecting) {
                 // Send the start listening command
                 protocol_->SendStartListening(listening_mode_);
                 if (listening_mode_ == kListeningModeAutoStop && previous_state == kDeviceStateSpeaking) {
                     // FIXME: Wait for the speaker to empty the buffer
                     vTaskDelay(pdMS_TO_TICKS(120));
                 }
-                opus_encoder_->ResetState();
+                if (!audio_processor_->IsRunning()) {
+                    opus_encoder_->ResetState();
 #if CONFIG_USE_WAKE_WORD_DETECT
-                wake_word_detect_.StopDetection();
+                    wake_word_detect_.StopDetection();
+#endif
+                    audio_processor_->Start();
+                }
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+                SendConnectingAudio();
 #endif
-                audio_processor_->Start();
             }
             break;
         case kDeviceStateSpeaking:
@@ -917,6 +1164,23 @@ void Application::SetDeviceState(DeviceState state) {
     }
 }
 
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+void Application::SendConnectingAudio() {
+    std::list<AudioStreamPacket> packets;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        packets = std::move(connecting_audio_);
+        connecting_audio_.clear();
+    }
+    if (!packets.empty()) {
+        ESP_LOGI(TAG, "Sending %u frames captured while connecting", (unsigned)packets.size());
+    }
+    for (auto& packet : packets) {
+        protocol_->SendAudio(packet);
+    }
+}
+#endif
+
 void Application::ResetDecoder() {
     std::lock_guard<std::mutex> lock(mutex_);
     opus_decoder_->ResetState();
@@ -33,6 +33,9 @@
 #define AUDIO_INPUT_READY_EVENT (1 << 1)
 #define AUDIO_OUTPUT_READY_EVENT (1 << 2)
 #define CHECK_NEW_VERSION_DONE_EVENT (1 << 3)
+#define NETWORK_READY_EVENT (1 << 4)
+#define PROTOCOL_STARTED_EVENT (1 << 5)
+#define FRONTEND_READY_EVENT (1 << 6)
 
 enum DeviceState {
     kDeviceStateUnknown,
@@ -48,6 +51,8 @@ enum DeviceState {
 };
 
 #define OPUS_FRAME_DURATION_MS 60
+// Audio captured while the channel opens is kept for at most 3 seconds
+#define MAX_CONNECTING_AUDIO_FRAMES (3000 / OPUS_FRAME_DURATION_MS)
 
 class Application {
 public:
@@ -75,6 +80,9 @@ public:
     void WakeWordInvoke(const std::string& wake_word);
     void PlaySound(const std::string_view& sound);
     bool CanEnterSleepMode();
+    // With CONFIG_PARALLEL_BOOT the network starts on its own task, which must wait here before
+    // it changes the device state while Start() still sets up the audio front end
+    void WaitForFrontend();
 
 private:
     Application();
@@ -105,6 +113,8 @@ private:
     bool busy_decoding_audio_ = false;
     int clock_ticks_ = 0;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
+    // Set while the protocol connects early with the saved settings, its errors are not alerted
+    std::atomic<bool> quiet_network_errors_ = false;
 
     // Audio encode / decode
     TaskHandle_t audio_loop_task_handle_ = nullptr;
@@ -113,6 +123,9 @@ private:
     std::atomic<uint32_t> last_output_timestamp_ = 0;
     std::list<AudioStreamPacket> audio_decode_queue_;
     std::condition_variable audio_decode_cv_;
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+    std::list<AudioStreamPacket> connecting_audio_;
+#endif
 
     std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
     std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
@@ -126,8 +139,12 @@ private:
     void OnAudioOutput();
     void ReadAudio(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+    void SendConnectingAudio();
+#endif
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
     void CheckNewVersion();
+    void InitializeProtocol();
     void ShowActivationCode();
     void OnClockTimer();
     void SetListeningMode(ListeningMode mode);
@@ -1,5 +1,6 @@
 #include "afe_audio_processor.h"
 #include <esp_log.h>
+#include "event_trace.h"
 
 #define PROCESSOR_RUNNING 0x01
 
@@ -114,6 +115,7 @@ void AfeAudioProcessor::AudioProcessorTask() {
         if ((xEventGroupGetBits(event_group_) & PROCESSOR_RUNNING) == 0) {
             continue;
         }
+        TRACE_SCOPE("afe_output");
         if (res == nullptr || res->ret_value == ESP_FAIL) {
             if (res != nullptr) {
                 ESP_LOGI(TAG, "Error code: %d", res->ret_value);
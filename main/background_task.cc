@@ -2,6 +2,8 @@
 
 #include <esp_log.h>
 #include <esp_task_wdt.h>
+#include "event_trace.h"
+#include "deferred_log.h"
 
 #define TAG "BackgroundTask"
 
@@ -23,7 +25,7 @@ void BackgroundTask::Schedule(std::function<void()> callback) {
     if (active_tasks_ >= 30) {
         int free_sram = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
         if (free_sram < 10000) {
-            ESP_LOGW(TAG, "active_tasks_ == %u, free_sram == %u", active_tasks_.load(), free_sram);
+            DLOGW(TAG, "active_tasks_ == %u, free_sram == %u", active_tasks_.load(), free_sram);
         }
     }
     active_tasks_++;
@@ -56,6 +58,7 @@ void BackgroundTask::BackgroundTaskLoop() {
         std::list<std::function<void()>> tasks = std::move(main_tasks_);
         lock.unlock();
 
+        TRACE_SCOPE("background_tasks");
         for (auto& task : tasks) {
             task();
         }
@@ -1,5 +1,6 @@
 #include "backlight.h"
 #include "settings.h"
+#include "frame_governor.h"
 
 #include <esp_log.h>
 #include <driver/ledc.h>
@@ -59,6 +60,8 @@ void Backlight::SetBrightness(uint8_t brightness, bool permanent) {
 
     target_brightness_ = brightness;
     step_ = (target_brightness_ > brightness_) ? 1 : -1;
+    // Nothing drawn is visible once the backlight is off
+    FrameGovernor::GetInstance().SetBacklight(brightness);
 
     if (transition_timer_ != nullptr) {
         // 启动定时器，每 5ms 更新一次
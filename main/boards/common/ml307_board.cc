@@ -3,6 +3,7 @@
 #include "application.h"
 #include "display.h"
 #include "font_awesome_symbols.h"
+#include "json_writer.h"
 #include "assets/lang_config.h"
 
 #include <esp_log.h>
@@ -47,6 +48,9 @@ void Ml307Board::WaitForNetworkReady() {
     auto display = Board::GetInstance().GetDisplay();
     display->SetStatus(Lang::Strings::REGISTERING_NETWORK);
     int result = modem_.WaitForNetworkReady();
+    if (result < 0) {
+        application.WaitForFrontend();
+    }
     if (result == -1) {
         application.Alert(Lang::Strings::ERROR, Lang::Strings::PIN_ERROR, "sad", Lang::Sounds::P3_ERR_PIN);
         return;
@@ -106,14 +110,21 @@ const char* Ml307Board::GetNetworkStateIcon() {
 
 std::string Ml307Board::GetBoardJson() {
     // Set the board type for OTA
-    std::string board_json = std::string("{\"type\":\"" BOARD_TYPE "\",");
-    board_json += "\"name\":\"" BOARD_NAME "\",";
-    board_json += "\"revision\":\"" + modem_.GetModuleName() + "\",";
-    board_json += "\"carrier\":\"" + modem_.GetCarrierName() + "\",";
-    board_json += "\"csq\":\"" + std::to_string(modem_.GetCsq()) + "\",";
-    board_json += "\"imei\":\"" + modem_.GetImei() + "\",";
-    board_json += "\"iccid\":\"" + modem_.GetIccid() + "\",";
-    board_json += "\"cereg\":" + modem_.GetRegistrationState().ToString() + "}";
+    std::string board_json;
+    board_json.reserve(256);
+    JsonWriter writer(board_json);
+    writer.BeginObject();
+    writer.Key("type").String(BOARD_TYPE);
+    writer.Key("name").String(BOARD_NAME);
+    writer.Key("revision").String(modem_.GetModuleName());
+    writer.Key("carrier").String(modem_.GetCarrierName());
+    char csq[12];
+    snprintf(csq, sizeof(csq), "%d", modem_.GetCsq());
+    writer.Key("csq").String(csq);
+    writer.Key("imei").String(modem_.GetImei());
+    writer.Key("iccid").String(modem_.GetIccid());
+    writer.Key("cereg").Raw(modem_.GetRegistrationState().ToString());
+    writer.EndObject();
     return board_json;
 }
 
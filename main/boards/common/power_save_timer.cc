@@ -1,5 +1,6 @@
 #include "power_save_timer.h"
 #include "application.h"
+#include "frame_governor.h"
 
 #include <esp_log.h>
 
@@ -63,6 +64,7 @@ void PowerSaveTimer::PowerSaveCheck() {
     if (seconds_to_sleep_ != -1 && ticks_ >= seconds_to_sleep_) {
         if (!in_sleep_mode_) {
             in_sleep_mode_ = true;
+            FrameGovernor::GetInstance().SetSleepMode(true);
             if (on_enter_sleep_mode_) {
                 on_enter_sleep_mode_();
             }
@@ -86,6 +88,7 @@ void PowerSaveTimer::WakeUp() {
     ticks_ = 0;
     if (in_sleep_mode_) {
         in_sleep_mode_ = false;
+        FrameGovernor::GetInstance().SetSleepMode(false);
 
         if (cpu_max_freq_ != -1) {
             esp_pm_config_t pm_config = {
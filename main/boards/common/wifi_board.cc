@@ -5,6 +5,7 @@
 #include "system_info.h"
 #include "font_awesome_symbols.h"
 #include "settings.h"
+#include "json_writer.h"
 #include "assets/lang_config.h"
 
 #include <freertos/FreeRTOS.h>
@@ -38,6 +39,7 @@ std::string WifiBoard::GetBoardType() {
 
 void WifiBoard::EnterWifiConfigMode() {
     auto& application = Application::GetInstance();
+    application.WaitForFrontend();
     application.SetDeviceState(kDeviceStateWifiConfiguring);
 
     auto& wifi_ap = WifiConfigurationAp::GetInstance();
@@ -153,15 +155,20 @@ const char* WifiBoard::GetNetworkStateIcon() {
 std::string WifiBoard::GetBoardJson() {
     // Set the board type for OTA
     auto& wifi_station = WifiStation::GetInstance();
-    std::string board_json = std::string("{\"type\":\"" BOARD_TYPE "\",");
-    board_json += "\"name\":\"" BOARD_NAME "\",";
+    std::string board_json;
+    board_json.reserve(192);
+    JsonWriter writer(board_json);
+    writer.BeginObject();
+    writer.Key("type").String(BOARD_TYPE);
+    writer.Key("name").String(BOARD_NAME);
     if (!wifi_config_mode_) {
-        board_json += "\"ssid\":\"" + wifi_station.GetSsid() + "\",";
-        board_json += "\"rssi\":" + std::to_string(wifi_station.GetRssi()) + ",";
-        board_json += "\"channel\":" + std::to_string(wifi_station.GetChannel()) + ",";
-        board_json += "\"ip\":\"" + wifi_station.GetIpAddress() + "\",";
+        writer.Key("ssid").String(wifi_station.GetSsid());
+        writer.Key("rssi").Int(wifi_station.GetRssi());
+        writer.Key("channel").Int(wifi_station.GetChannel());
+        writer.Key("ip").String(wifi_station.GetIpAddress());
     }
-    board_json += "\"mac\":\"" + SystemInfo::GetMacAddress() + "\"}";
+    writer.Key("mac").String(SystemInfo::GetMacAddress());
+    writer.EndObject();
     return board_json;
 }
 
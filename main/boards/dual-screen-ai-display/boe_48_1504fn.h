@@ -12,11 +12,214 @@
 #define _BOE_48_1504FN_H_
 
 #include "pt6302.h"
+#include "vfd_engine.h"
 #include <cmath>
+#include <cstddef>
 #include <esp_wifi.h>
 
 // Define the number of characters
 #define CHAR_SIZE (95 + 1)
+#define DISPLAY_SIZE 10
+#define SYMBOL_COUNT 162
+#define SYMBOL_CGRAM_SIZE 5
+#define GR_COUNT 15
+
+// The symbols below byte 25 are drawn by the first SYMBOL_CGRAM_SIZE CGRAM characters, the
+// others by the ADRAM, both moved here to offsets into PT6302::Gram
+template <size_t Count>
+constexpr std::array<VfdSymbol, Count> boe_symbol_positions(const VfdSymbol (&positions)[Count])
+{
+    std::array<VfdSymbol, Count> symbols = {};
+    for (size_t i = 0; i < Count; i++)
+    {
+        int byte = positions[i].byteIndex;
+        symbols[i].byteIndex = byte < 25 ? offsetof(PT6302::Gram, cgram) + byte : offsetof(PT6302::Gram, symbol) + byte - 25;
+        symbols[i].bitMask = positions[i].bitMask;
+    }
+    return symbols;
+}
+
+// Ten dot-matrix characters of a PT6302, the last three CGRAM characters carry the transitions and
+// the characters beyond ASCII
+struct BoePanel
+{
+    static constexpr VfdController controller = VFD_CONTROLLER_PT6302;
+    static constexpr int cells = DISPLAY_SIZE;
+    static constexpr int glyph_width = 5;
+    static constexpr int cgram_slots = 3;
+    static constexpr int digits = 0;
+    static constexpr int rows = 1;
+    static constexpr int frame_ms = 10;
+    static constexpr int scroll_ms = 120;
+    static constexpr VfdAnimations::NumAni scroll_enter = VfdAnimations::NONE;
+    static constexpr VfdAnimations::NumAni scroll_move = VfdAnimations::NONE;
+    // Position of each symbol in the order of BOE_48_1504FN::Symbols
+    static constexpr VfdSymbol raw_symbols[SYMBOL_COUNT] = {
+        {0, 1},       // L_0_0
+        {0, 2},       // L_3_9
+        {0, 4},       // L_4_7
+        {0, 8},       // L_3_4
+        {0, 0x10},    // L_4_2
+        {0, 0x20},    // L_3_13
+        {0, 0x40},    // L_4_11
+        {1, 1},       // L_1_0
+        {1, 2},       // L_4_9
+        {1, 4},       // L_3_6
+        {1, 8},       // L_4_4
+        {1, 0x10},    // L_3_1
+        {1, 0x20},    // L_4_13
+        {1, 0x40},    // L_OUTLINE
+        {2, 1},       // L_2_0
+        {2, 2},       // L_3_8
+        {2, 4},       // L_4_6
+        {2, 8},       // L_3_3
+        {2, 0x10},    // L_4_1
+        {2, 0x20},    // L_3_12
+        {3, 1},       // L_3_10
+        {3, 2},       // L_4_8
+        {3, 4},       // L_3_5
+        {3, 8},       // L_4_3
+        {3, 0x10},    // L_3_0
+        {3, 0x20},    // L_4_12
+        {4, 1},       // L_4_10
+        {4, 2},       // L_3_7
+        {4, 4},       // L_4_5
+        {4, 8},       // L_3_2
+        {4, 0x10},    // L_4_0
+        {4, 0x20},    // L_3_11
+        {5, 1},       // LD_0_0
+        {5, 2},       // LD_LINE
+        {5, 4},       // LD_6
+        {5, 8},       // LD_4
+        {5, 0x10},    // LD_1
+        {6, 1},       // LD_1_0
+        {6, 2},       // LD_MUTE
+        {6, 4},       // LD_DTS
+        {6, 8},       // LD_IPOD
+        {7, 1},       // LD_2_0
+        {7, 2},       // LD_REC
+        {7, 4},       // LD_II
+        {7, 8},       // LD_KARAOKE
+        {8, 1},       // LD_3_0
+        {8, 2},       // LD_CLOCK
+        {8, 4},       // LD_DB_PL
+        {8, 8},       // LD_3
+        {9, 1},       // LD_4_0
+        {9, 2},       // LD_DB_D
+        {9, 4},       // LD_5
+        {9, 8},       // LD_2
+        {10, 1},      // D_DIVX
+        {10, 2},      // D_CD
+        {10, 4},      // D_DVD_LINE
+        {10, 8},      // D_XDSS
+        {10, 0x10},   // D_2_L
+        {10, 0x20},   // D_CCN_L
+        {10, 0x40},   // D_OUTLINE_3
+        {11, 1},      // D_USB
+        {11, 2},      // D_DIVX_L
+        {11, 4},      // D_CD_L
+        {11, 8},      // D_USER
+        {11, 0x10},   // D_CCN_R
+        {11, 0x20},   // D_1_OUTLINE
+        {11, 0x40},   // D_OUTLINE_2
+        {12, 1},      // D_AUX
+        {12, 2},      // D_USB_L
+        {12, 4},      // D_OUTLINE
+        {12, 8},      // D_2_OUTLINE
+        {12, 0x10},   // D_CCN_D
+        {12, 0x20},   // D_1_R
+        {12, 0x40},   // D_OUTLINE_1
+        {13, 1},      // D_MUSIC
+        {13, 2},      // D_AUX_L
+        {13, 4},      // D_MP3OPT
+        {13, 8},      // D_2_R
+        {13, 0x10},   // D_CCN
+        {13, 0x20},   // D_1
+        {13, 0x40},   // D_OUTLINE_0
+        {14, 1},      // D_DVD
+        {14, 2},      // D_MUSIC_L
+        {14, 4},      // D_VSM
+        {14, 8},      // D_2
+        {14, 0x10},   // D_CCN_U
+        {14, 0x20},   // D_1_L
+        {14, 0x40},   // D_PAUSE
+        {15, 1},      // RD_0_0
+        {15, 2},      // RD_LINE
+        {15, 4},      // RD_1
+        {15, 8},      // RD_USB
+        {15, 0x10},   // RD_2_CIRCLE
+        {15, 0x20},   // RD_1_NUM
+        {16, 1},      // RD_1_0
+        {16, 2},      // RD_DUBB
+        {16, 4},      // RD_1_P0
+        {16, 8},      // RD_3_CIRCLE
+        {16, 0x10},   // RD_2
+        {16, 0x20},   // RD_SURR
+        {17, 1},      // RD_2_0
+        {17, 2},      // RD_MIC
+        {17, 4},      // RD_1_P1
+        {17, 8},      // RD_3
+        {17, 0x10},   // RD_2_P1
+        {17, 0x20},   // RD_BAT
+        {18, 1},      // RD_3_0
+        {18, 2},      // RD_V_FADE
+        {18, 4},      // RD_ECHO
+        {18, 8},      // RD_3_P1
+        {18, 0x10},   // RD_2_P2
+        {19, 1},      // RD_4_0
+        {19, 2},      // RD_1_CIRCLE
+        {19, 4},      // RD_REC
+        {19, 8},      // RD_3_P2
+        {19, 0x10},   // RD_2_NUM
+        {20, 1},      // R_0_0
+        {20, 2},      // R_3_9
+        {20, 4},      // R_4_7
+        {20, 8},      // R_3_4
+        {20, 0x10},   // R_4_2
+        {20, 0x20},   // R_3_13
+        {20, 0x40},   // R_4_11
+        {21, 1},      // R_1_0
+        {21, 2},      // R_4_9
+        {21, 4},      // R_3_6
+        {21, 8},      // R_4_4
+        {21, 0x10},   // R_3_1
+        {21, 0x20},   // R_4_13
+        {21, 0x40},   // R_OUTLINE
+        {22, 1},      // R_2_0
+        {22, 2},      // R_3_8
+        {22, 4},      // R_4_6
+        {22, 8},      // R_3_3
+        {22, 0x10},   // R_4_1
+        {22, 0x20},   // R_3_12
+        {23, 1},      // R_3_10
+        {23, 2},      // R_4_8
+        {23, 4},      // R_3_5
+        {23, 8},      // R_4_3
+        {23, 0x10},   // R_3_0
+        {23, 0x20},   // R_4_12
+        {24, 1},      // R_4_10
+        {24, 2},      // R_3_7
+        {24, 4},      // R_4_5
+        {24, 8},      // R_3_2
+        {24, 0x10},   // R_4_0
+        {24, 0x20},   // R_3_11
+        {25 + 0, 1},  // L_LINE
+        {25 + 0, 2},  // CHP/TRK
+        {25 + 1, 2},  // EQ
+        {25 + 2, 2},  // PROG
+        {25 + 3, 2},  // RANDOM
+        {25 + 4, 2},  // REPEAT
+        {25 + 5, 1},  // DISC
+        {25 + 5, 2},  // ALL
+        {25 + 6, 2},  // SLEEP
+        {25 + 7, 2},  // SYNC
+        {25 + 8, 2},  // NET
+        {25 + 9, 1},  // R_LINE
+        {25 + 9, 2},  // RDS
+        {25 + 12, 1}, // PLAY
+    };
+    static constexpr auto symbols = boe_symbol_positions(raw_symbols);
+};
 
 /**
  * @class BOE_48_1504FN
@@ -24,20 +227,11 @@
  *
  * It provides methods for displaying spectrum, numbers, symbols, dot matrix and other information, and also supports animation effects.
  */
-class BOE_48_1504FN : protected PT6302
+class BOE_48_1504FN : protected PT6302, public VfdEngine<BOE_48_1504FN, BoePanel>
 {
-#define BUFFER_SIZE 256
-#define DISPLAY_SIZE 10
-#define SYMBOL_COUNT 162
-#define SYMBOL_CGRAM_SIZE 5
-#define GR_COUNT 15
-public:
-    typedef struct
-    {
-        int byteIndex; // Byte index
-        int bitMask;   // Bit index
-    } SymbolPosition;
+    friend class VfdEngine<BOE_48_1504FN, BoePanel>;
 
+public:
     typedef enum
     {
         L_0_0,
@@ -205,199 +399,8 @@ public:
         SYMBOL_MAX
     } Symbols;
 
-    SymbolPosition symbolPositions[SYMBOL_COUNT] = {
-        {0, 1},       // L_0_0
-        {0, 2},       // L_3_9
-        {0, 4},       // L_4_7
-        {0, 8},       // L_3_4
-        {0, 0x10},    // L_4_2
-        {0, 0x20},    // L_3_13
-        {0, 0x40},    // L_4_11
-        {1, 1},       // L_1_0
-        {1, 2},       // L_4_9
-        {1, 4},       // L_3_6
-        {1, 8},       // L_4_4
-        {1, 0x10},    // L_3_1
-        {1, 0x20},    // L_4_13
-        {1, 0x40},    // L_OUTLINE
-        {2, 1},       // L_2_0
-        {2, 2},       // L_3_8
-        {2, 4},       // L_4_6
-        {2, 8},       // L_3_3
-        {2, 0x10},    // L_4_1
-        {2, 0x20},    // L_3_12
-        {3, 1},       // L_3_10
-        {3, 2},       // L_4_8
-        {3, 4},       // L_3_5
-        {3, 8},       // L_4_3
-        {3, 0x10},    // L_3_0
-        {3, 0x20},    // L_4_12
-        {4, 1},       // L_4_10
-        {4, 2},       // L_3_7
-        {4, 4},       // L_4_5
-        {4, 8},       // L_3_2
-        {4, 0x10},    // L_4_0
-        {4, 0x20},    // L_3_11
-        {5, 1},       // LD_0_0
-        {5, 2},       // LD_LINE
-        {5, 4},       // LD_6
-        {5, 8},       // LD_4
-        {5, 0x10},    // LD_1
-        {6, 1},       // LD_1_0
-        {6, 2},       // LD_MUTE
-        {6, 4},       // LD_DTS
-        {6, 8},       // LD_IPOD
-        {7, 1},       // LD_2_0
-        {7, 2},       // LD_REC
-        {7, 4},       // LD_II
-        {7, 8},       // LD_KARAOKE
-        {8, 1},       // LD_3_0
-        {8, 2},       // LD_CLOCK
-        {8, 4},       // LD_DB_PL
-        {8, 8},       // LD_3
-        {9, 1},       // LD_4_0
-        {9, 2},       // LD_DB_D
-        {9, 4},       // LD_5
-        {9, 8},       // LD_2
-        {10, 1},      // D_DIVX
-        {10, 2},      // D_CD
-        {10, 4},      // D_DVD_LINE
-        {10, 8},      // D_XDSS
-        {10, 0x10},   // D_2_L
-        {10, 0x20},   // D_CCN_L
-        {10, 0x40},   // D_OUTLINE_3
-        {11, 1},      // D_USB
-        {11, 2},      // D_DIVX_L
-        {11, 4},      // D_CD_L
-        {11, 8},      // D_USER
-        {11, 0x10},   // D_CCN_R
-        {11, 0x20},   // D_1_OUTLINE
-        {11, 0x40},   // D_OUTLINE_2
-        {12, 1},      // D_AUX
-        {12, 2},      // D_USB_L
-        {12, 4},      // D_OUTLINE
-        {12, 8},      // D_2_OUTLINE
-        {12, 0x10},   // D_CCN_D
-        {12, 0x20},   // D_1_R
-        {12, 0x40},   // D_OUTLINE_1
-        {13, 1},      // D_MUSIC
-        {13, 2},      // D_AUX_L
-        {13, 4},      // D_MP3OPT
-        {13, 8},      // D_2_R
-        {13, 0x10},   // D_CCN
-        {13, 0x20},   // D_1
-        {13, 0x40},   // D_OUTLINE_0
-        {14, 1},      // D_DVD
-        {14, 2},      // D_MUSIC_L
-        {14, 4},      // D_VSM
-        {14, 8},      // D_2
-        {14, 0x10},   // D_CCN_U
-        {14, 0x20},   // D_1_L
-        {14, 0x40},   // D_PAUSE
-        {15, 1},      // RD_0_0
-        {15, 2},      // RD_LINE
-        {15, 4},      // RD_1
-        {15, 8},      // RD_USB
-        {15, 0x10},   // RD_2_CIRCLE
-        {15, 0x20},   // RD_1_NUM
-        {16, 1},      // RD_1_0
-        {16, 2},      // RD_DUBB
-        {16, 4},      // RD_1_P0
-        {16, 8},      // RD_3_CIRCLE
-        {16, 0x10},   // RD_2
-        {16, 0x20},   // RD_SURR
-        {17, 1},      // RD_2_0
-        {17, 2},      // RD_MIC
-        {17, 4},      // RD_1_P1
-        {17, 8},      // RD_3
-        {17, 0x10},   // RD_2_P1
-        {17, 0x20},   // RD_BAT
-        {18, 1},      // RD_3_0
-        {18, 2},      // RD_V_FADE
-        {18, 4},      // RD_ECHO
-        {18, 8},      // RD_3_P1
-        {18, 0x10},   // RD_2_P2
-        {19, 1},      // RD_4_0
-        {19, 2},      // RD_1_CIRCLE
-        {19, 4},      // RD_REC
-        {19, 8},      // RD_3_P2
-        {19, 0x10},   // RD_2_NUM
-        {20, 1},      // R_0_0
-        {20, 2},      // R_3_9
-        {20, 4},      // R_4_7
-        {20, 8},      // R_3_4
-        {20, 0x10},   // R_4_2
-        {20, 0x20},   // R_3_13
-        {20, 0x40},   // R_4_11
-        {21, 1},      // R_1_0
-        {21, 2},      // R_4_9
-        {21, 4},      // R_3_6
-        {21, 8},      // R_4_4
-        {21, 0x10},   // R_3_1
-        {21, 0x20},   // R_4_13
-        {21, 0x40},   // R_OUTLINE
-        {22, 1},      // R_2_0
-        {22, 2},      // R_3_8
-        {22, 4},      // R_4_6
-        {22, 8},      // R_3_3
-        {22, 0x10},   // R_4_1
-        {22, 0x20},   // R_3_12
-        {23, 1},      // R_3_10
-        {23, 2},      // R_4_8
-        {23, 4},      // R_3_5
-        {23, 8},      // R_4_3
-        {23, 0x10},   // R_3_0
-        {23, 0x20},   // R_4_12
-        {24, 1},      // R_4_10
-        {24, 2},      // R_3_7
-        {24, 4},      // R_4_5
-        {24, 8},      // R_3_2
-        {24, 0x10},   // R_4_0
-        {24, 0x20},   // R_3_11
-        {25 + 0, 1},  // L_LINE
-        {25 + 0, 2},  // CHP/TRK
-        {25 + 1, 2},  // EQ
-        {25 + 2, 2},  // PROG
-        {25 + 3, 2},  // RANDOM
-        {25 + 4, 2},  // REPEAT
-        {25 + 5, 1},  // DISC
-        {25 + 5, 2},  // ALL
-        {25 + 6, 2},  // SLEEP
-        {25 + 7, 2},  // SYNC
-        {25 + 8, 2},  // NET
-        {25 + 9, 1},  // R_LINE
-        {25 + 9, 2},  // RDS
-        {25 + 12, 1}, // PLAY
-    };
-
-    typedef enum
-    {
-        NONE = -1,
-        UP2DOWN,
-        DOWN2UP,
-        LEFT2RT,
-        RT2LEFT,
-        MAX
-    } NumAni;
 
 private:
-    typedef struct
-    {
-        char current_content;
-        char last_content;
-        int animation_step;
-        int animation_index;
-        NumAni animation_type;
-        bool need_update;
-    } ContentData;
-
-    typedef struct
-    {
-        char buffer[BUFFER_SIZE + 1]; // +1 for null terminator
-        int start_pos;
-        int length;
-    } CircularBuffer;
-
     // Hexadecimal code corresponding to each character
     // !"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[]^_`abcdefghijklmnopqrstuvwxyz
     const uint8_t hex_codes[CHAR_SIZE][5] = {
@@ -503,36 +506,27 @@ private:
 public:
     BOE_48_1504FN(gpio_num_t din, gpio_num_t clk, gpio_num_t cs, spi_host_device_t spi_num);
     BOE_48_1504FN(spi_device_handle_t spi_device);
-    void noti_show(const char *str, int timeout = 8000);
+    void noti_show(const char *str, int timeout = 8000) { VfdEngine::noti_show(str, timeout); }
     void spectrum_show(float *buf, int size);
-    void content_show(int start, const char *buf, int size, bool forceupdate = false, NumAni ani = LEFT2RT);
-    void symbolhelper(Symbols symbol, bool is_on);
+    void symbolhelper(Symbols symbol, bool is_on) { set_symbol(symbol, is_on); }
 
 private:
     const unsigned int digits = 15;
-    bool cgramBusy[3] = {0};
-    ContentData currentContentData[DISPLAY_SIZE] = {0};
-    ContentData tempContentData[DISPLAY_SIZE] = {0};
-    CircularBuffer *cb = new CircularBuffer();
-    int64_t content_inhibit_time = 0;
     Symbols bar_L_3[14] = {L_3_0, L_3_1, L_3_2, L_3_3, L_3_4, L_3_5, L_3_6, L_3_7, L_3_8, L_3_9, L_3_10, L_3_11, L_3_12, L_3_13};
     Symbols bar_L_4[14] = {L_4_0, L_4_1, L_4_2, L_4_3, L_4_4, L_4_5, L_4_6, L_4_7, L_4_8, L_4_9, L_4_10, L_4_11, L_4_12, L_4_13};
     Symbols bar_R_3[14] = {R_3_0, R_3_1, R_3_2, R_3_3, R_3_4, R_3_5, R_3_6, R_3_7, R_3_8, R_3_9, R_3_10, R_3_11, R_3_12, R_3_13};
     Symbols bar_R_4[14] = {R_4_0, R_4_1, R_4_2, R_4_3, R_4_4, R_4_5, R_4_6, R_4_7, R_4_8, R_4_9, R_4_10, R_4_11, R_4_12, R_4_13};
     void init_task();
-    void contentanimate();
-    int get_cgram();
-    void free_cgram(int *index);
-    void display_buffer();
-    void scroll_buffer();
     const uint8_t *find_content_hex_code(char ch);
-    void find_enum_code(Symbols flag, int *byteIndex, int *bitMask);
+
+    // VfdEngine hooks
+    uint8_t *symbol_ram() { return internal_gram.array; }
+    const uint8_t *glyph_of(char ch) { return find_content_hex_code(ch); }
+    void show_char(int index, char ch) { internal_gram.number[index] = ch < 8 ? ' ' : ch; }
+    void show_cgram(int index, int slot, const uint8_t *columns);
+    void flush() { refrash(&internal_gram); }
 
     void refrash(Gram *gram) override;
-protected:
-    void charhelper(int index, char ch);                     // write to dcram
-    void charhelper(int index, int ramindex, uint8_t *code); // write to cgram, then index from the dcram
-    void noti_show(int start, const char *buf, int size, bool forceupdate = false, NumAni ani = LEFT2RT, int timeout = 2000);
 };
 
 #endif // _BOE_48_1504FN_H_
@@ -32,7 +32,9 @@
 #include <esp_wifi.h>
 #include "rx8900.h"
 #include "esp_sntp.h"
+#include "boot_profiler.h"
 #include "settings.h"
+#include "event_trace.h"
 #if SUB_DISPLAY_EN && FORD_VFD_EN
 #include "ford_vfd.h"
 #elif SUB_DISPLAY_EN && HNA_16MM65T_EN
@@ -352,9 +354,10 @@ public:
 #endif
     }
 
-    virtual void SetChatMessage(const char *role, const char *content) override
+    // Called with the display locked on the LVGL task, in the order the messages were set
+    virtual void ApplyChatMessage(const char *role, const char *content) override
     {
-        if (content != nullptr && *content == '\0')
+        if (*content == '\0')
             return;
 #if SUB_DISPLAY_EN && FORD_VFD_EN
         SetSubContent(content);
@@ -365,28 +368,26 @@ public:
 #endif
 
 #if AMOLED_191
-        QspiLcdDisplay::SetChatMessage(role, content);
+        QspiLcdDisplay::ApplyChatMessage(role, content);
 #elif AMOLED_095
-        SpiLcdDisplay::SetChatMessage(role, content);
+        SpiLcdDisplay::ApplyChatMessage(role, content);
 #endif
     }
 
 #if SUB_DISPLAY_EN && FORD_VFD_EN
 
-    virtual void ShowNotification(const std::string &notification, int duration_ms = 3000) override
+    // Ordered with the status and the chat messages by the update queue
+    virtual void ApplyNotification(const char *notification, int duration_ms) override
     {
-        DisplayLockGuard lock(this);
-        if (notification_label_ == nullptr)
+#if AMOLED_191
+        QspiLcdDisplay::ApplyNotification(notification, duration_ms);
+#elif AMOLED_095
+        SpiLcdDisplay::ApplyNotification(notification, duration_ms);
+#endif
+        if (duration_ms > 0)
         {
-            return;
+            SetSubContent(notification);
         }
-        lv_label_set_text(notification_label_, notification.c_str());
-        lv_obj_clear_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
-        lv_obj_add_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
-
-        esp_timer_stop(notification_timer_);
-        ESP_ERROR_CHECK(esp_timer_start_once(notification_timer_, duration_ms * 1000));
-        SetSubContent(notification.c_str());
     }
 
     void SetSubBacklight(uint8_t brightness)
@@ -396,40 +397,12 @@ public:
 
     static void sub_disp_flush(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map)
     {
-        auto display = Board::GetInstance().GetDisplay();
-#if 0
-        int32_t x, y;
-        uint8_t byte_index = 0;
-        uint8_t bit_index = 0;
-
-        for (y = area->y1; y <= area->y2; y++)
-        {
-            for (x = area->x1; x <= area->x2; x++)
-            {
-                uint8_t color = (px_map[byte_index] >> (7 - bit_index)) & 0x01;
-
-                display->DrawPoint(x, y, color);
-
-                bit_index++;
-                if (bit_index == 8)
-                {
-                    bit_index = 0;
-                    byte_index++;
-                }
-            }
-        }
-#else
-        uint16_t *buf16 = (uint16_t *)px_map;
-        int32_t x, y;
-        for (y = area->y1; y <= area->y2; y++)
-        {
-            for (x = area->x1; x <= area->x2; x++)
-            {
-                display->DrawPoint(x, y, *buf16);
-                buf16++;
-            }
-        }
-#endif
+        TRACE_SCOPE("vfd_flush");
+        auto self = static_cast<CustomLcdDisplay *>(lv_display_get_user_data(disp));
+        // I1 buffers start with the two entry palette, the rows follow it
+        px_map += 8;
+        int32_t stride = lv_draw_buf_width_to_stride(lv_area_get_width(area), LV_COLOR_FORMAT_I1);
+        self->draw_bitmap(area->x1, area->y1, area->x2, area->y2, px_map, stride);
         lv_display_flush_ready(disp);
     }
 
@@ -442,22 +415,18 @@ public:
             ESP_LOGI(TAG, "Failed to create subdisplay");
             return;
         }
+        lv_display_set_user_data(subdisplay, this);
         lv_display_set_flush_cb(subdisplay, sub_disp_flush);
-#if 0
+        // 1 bit per dot, the whole panel fits in 8 + 18 * 16 bytes
         lv_display_set_color_format(subdisplay, LV_COLOR_FORMAT_I1);
-        static uint16_t buf1[FORD_WIDTH * FORD_HEIGHT / 8];
-        static uint16_t buf2[FORD_WIDTH * FORD_HEIGHT / 8];
-        lv_display_set_buffers(subdisplay, buf1, buf2, sizeof(buf1), LV_DISPLAY_RENDER_MODE_FULL);
-#else
-        static uint16_t buf[FORD_WIDTH * FORD_HEIGHT];
+        static uint8_t buf[8 + LV_DRAW_BUF_STRIDE(FORD_WIDTH, LV_COLOR_FORMAT_I1) * FORD_HEIGHT] __attribute__((aligned(4)));
         lv_display_set_buffers(subdisplay, buf, nullptr, sizeof(buf), LV_DISPLAY_RENDER_MODE_PARTIAL);
-#endif
         LV_LOG_INFO("Subscreen initialized successfully");
     }
 
+    // Called with the display locked
     void SetSubContent(const char *content)
     {
-        DisplayLockGuard lock(this);
         lv_label_set_text(sub_status_label_, content);
     }
 
@@ -569,6 +538,7 @@ public:
     virtual void SpectrumShow(float *buf, int size) override
     {
         _spectrum->inputFFTData(buf, size);
+        wake();
     }
 #endif
     void SetSubSleep(bool en = true)
@@ -1738,10 +1708,19 @@ public:
 
         vTaskDelay(pdMS_TO_TICKS(120));
 
+        // The PCF8574 behind I2C switches the display rails, so these steps stay in order
+        int phase = BOOT_PHASE_BEGIN("board_adc", 100);
         InitializeAdc();
+        BOOT_PHASE_END(phase);
+        phase = BOOT_PHASE_BEGIN("board_i2c", 300);
         InitializeI2c();
+        BOOT_PHASE_END(phase);
+        phase = BOOT_PHASE_BEGIN("board_rtc", 100);
         InitializeTimeSync();
+        BOOT_PHASE_END(phase);
+        phase = BOOT_PHASE_BEGIN("board_display", 800);
         InitializeDisplay();
+        BOOT_PHASE_END(phase);
         // test();
         InitializeIot();
         if (!display_->GetAutoDimming())
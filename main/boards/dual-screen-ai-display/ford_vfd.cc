@@ -75,6 +75,9 @@ void FORD_VFD::write_data8(uint8_t *dat, int len)
 void FORD_VFD::setbrightness(uint8_t brightness)
 {
 	dimming = brightness * 127 / 100;
+	// The brightness goes out with the frame
+	refresh_.invalidate();
+	wake();
 }
 
 void FORD_VFD::refrash(uint8_t *gram, int size)
@@ -87,360 +90,175 @@ void FORD_VFD::refrash(uint8_t *gram, int size)
 	write_data8((uint8_t *)gram, size);
 }
 
-void FORD_VFD::time_blink()
+void FORD_VFD::init()
 {
-	static bool time_mark = true;
-	time_mark = !time_mark;
-	// symbolhelper(COLON1, time_mark);
-	symbolhelper(COLON2, time_mark);
+	write_data8(0x55);
+	write_data8((uint8_t *)init_data_block1, sizeof(init_data_block1));
+	write_data8((uint8_t *)init_data_block2, sizeof(init_data_block2));
+	write_data8((uint8_t *)init_data_block3, sizeof(init_data_block3));
+	write_data8((uint8_t *)init_data_block4, sizeof(init_data_block4));
+	write_data8((uint8_t *)init_data_block5, sizeof(init_data_block5));
+	write_data8((uint8_t *)gram, sizeof(gram));
+	write_data8((uint8_t *)init_data_block7, sizeof(init_data_block7));
+	write_data8((uint8_t *)init_data_block8, sizeof(init_data_block8));
 }
 
-void FORD_VFD::number_show(int start, char *buf, int size, NumAni ani)
+void FORD_VFD::init_task()
 {
-	for (size_t i = 0; i < size && (start + i) < NUM_COUNT; i++)
-	{
-		currentData[start + i].animation_type = ani;
-		currentData[start + i].current_content = buf[i];
-	}
+	_spectrum = new SpectrumDisplay<FORD_VFD>(*this, FORD_WIDTH, FORD_HEIGHT);
+	symbolhelper(BT, true);
+	start();
 }
 
-uint8_t FORD_VFD::contentgetpart(uint8_t raw, uint8_t before_raw, uint8_t mask)
+void FORD_VFD::frame()
 {
-	return (raw & mask) | (before_raw & (~mask));
+	if (_mode == FFT && _spectrum != nullptr)
+		_spectrum->spectrumProcess(esp_timer_get_time() / 1000);
 }
 
-void FORD_VFD::contentanimate()
+// The controller takes the whole frame, it is only skipped when nothing changed
+void FORD_VFD::flush()
 {
-	static int64_t start_time = esp_timer_get_time() / 1000;
-	int64_t current_time = esp_timer_get_time() / 1000;
-	int64_t elapsed_time = current_time - start_time;
+	int first, last;
+	if (refresh_.take(gram, &first, &last))
+		refrash(gram, sizeof gram);
+}
 
-	if (elapsed_time >= 30)
-		start_time = current_time;
-	else
-		return;
+// Byte and bit of every dot in gram. The controller packs three columns by four rows into
+// groups, alternating between two layouts, and skips the bytes of the segment digits
+typedef struct
+{
+	uint16_t index[FORD_HEIGHT][FORD_WIDTH];
+	uint8_t mask[FORD_HEIGHT][FORD_WIDTH];
+	uint8_t pixels[FORD_GRAM_SIZE]; // Dot bits of each byte, the others drive segments
+} FordPixelMap;
 
-	for (int i = 0; i < NUM_COUNT; i++)
+static constexpr FordPixelMap make_pixel_map()
+{
+	FordPixelMap map = {};
+	constexpr uint8_t oddMasks[] = {2, 4, 1};
+	constexpr uint8_t evenMasks[] = {2, 1, 4};
+	for (int y = 0; y < FORD_HEIGHT; ++y)
 	{
-		if (currentData[i].current_content != currentData[i].last_content)
+		for (int x = 0; x < FORD_WIDTH; ++x)
 		{
-			uint8_t before_raw_code = find_hex_code(currentData[i].last_content);
-			uint8_t raw_code = find_hex_code(currentData[i].current_content);
-			uint8_t code = raw_code;
-			if (currentData[i].animation_type == CLOCKWISE)
-			{
-				switch (currentData[i].animation_step)
-				{
-				case 0:
-					code = contentgetpart(raw_code, before_raw_code, 1);
-					break;
-				case 1:
-					code = contentgetpart(raw_code, before_raw_code, 3);
-					break;
-				case 2:
-					code = contentgetpart(raw_code, before_raw_code, 0x43);
-					break;
-				case 3:
-					code = contentgetpart(raw_code, before_raw_code, 0x47);
-					break;
-				case 4:
-					code = contentgetpart(raw_code, before_raw_code, 0x4f);
-					break;
-				case 5:
-					code = contentgetpart(raw_code, before_raw_code, 0x5f);
-					break;
-				default:
-					currentData[i].animation_step = -1;
-					break;
-				}
-			}
-			else if (currentData[i].animation_type == ANTICLOCKWISE)
-			{
-				switch (currentData[i].animation_step)
-				{
-				case 0:
-					code = contentgetpart(raw_code, before_raw_code, 1);
-					break;
-				case 1:
-					code = contentgetpart(raw_code, before_raw_code, 0x21);
-					break;
-				case 2:
-					code = contentgetpart(raw_code, before_raw_code, 0x61);
-					break;
-				case 3:
-					code = contentgetpart(raw_code, before_raw_code, 0x71);
-					break;
-				case 4:
-					code = contentgetpart(raw_code, before_raw_code, 0x79);
-					break;
-				case 5:
-					code = contentgetpart(raw_code, before_raw_code, 0x7d);
-					break;
-				default:
-					currentData[i].animation_step = -1;
-					break;
-				}
-			}
-			else if (currentData[i].animation_type == UP2DOWN)
-			{
-				switch (currentData[i].animation_step)
-				{
-				case 0:
-					code = contentgetpart(raw_code, before_raw_code, 0x1);
-					break;
-				case 1:
-					code = contentgetpart(raw_code, before_raw_code, 0x21);
-					break;
-				case 2:
-					code = contentgetpart(raw_code, before_raw_code, 0x73);
-					break;
-				default:
-					currentData[i].animation_step = -1;
-					break;
-				}
-			}
-			else if (currentData[i].animation_type == DOWN2UP)
-			{
-				switch (currentData[i].animation_step)
-				{
-				case 0:
-					code = contentgetpart(raw_code, before_raw_code, 0x8);
-					break;
-				case 1:
-					code = contentgetpart(raw_code, before_raw_code, 0xc);
-					break;
-				case 2:
-					code = contentgetpart(raw_code, before_raw_code, 0x5e);
-					break;
-				default:
-					currentData[i].animation_step = -1;
-					break;
-				}
-			}
-			else if (currentData[i].animation_type == LEFT2RT)
+			int row = FORD_HEIGHT - 1 - y;
+			int index = 2 + 16 * (x / 3) + row / 4 * 3;
+			if (index > 480)
+				index += 32;
+			else if (index > 256)
+				index += 16;
+			bool isOdd = (x / 3) % 2 == 1;
+			uint8_t group = isOdd ? oddMasks[x % 3] : evenMasks[x % 3];
+			uint8_t mask = 0;
+			switch (row % 4)
 			{
-				switch (currentData[i].animation_step)
-				{
-				case 0:
-					code = contentgetpart(raw_code, before_raw_code, 0x10);
-					break;
-				case 1:
-					code = contentgetpart(raw_code, before_raw_code, 0x18);
-					break;
-				case 2:
-					code = contentgetpart(raw_code, before_raw_code, 0x7c);
-					break;
-				default:
-					currentData[i].animation_step = -1;
-					break;
-				}
+			case 0:
+				mask = isOdd ? group << 5 : group << 2;
+				break;
+			case 1:
+				if (isOdd && group == 1)
+					index += 1, mask = 0x80;
+				else if (isOdd)
+					mask = group >> 1;
+				else
+					index += 1, mask = group << 4;
+				break;
+			case 2:
+				if (isOdd)
+					index += 1, mask = group << 1;
+				else if (group == 4)
+					index += 1, mask = 0x01;
+				else
+					index += 2, mask = group << 6;
+				break;
+			case 3:
+				index += 2;
+				mask = isOdd ? group << 3 : group;
+				break;
 			}
-			else if (currentData[i].animation_type == RT2LEFT)
-			{
-				switch (currentData[i].animation_step)
-				{
-				case 0:
-					code = contentgetpart(raw_code, before_raw_code, 0x4);
-					break;
-				case 1:
-					code = contentgetpart(raw_code, before_raw_code, 0xc);
-					break;
-				case 2:
-					code = contentgetpart(raw_code, before_raw_code, 0x5e);
-					break;
-				default:
-					currentData[i].animation_step = -1;
-					break;
-				}
-			}
-			else
-				currentData[i].animation_step = -1;
-
-			if (currentData[i].animation_step == -1)
-				currentData[i].last_content = currentData[i].current_content;
-
-			charhelper(i, code);
-			currentData[i].animation_step++;
+			map.index[y][x] = index;
+			map.mask[y][x] = mask;
+			map.pixels[index] |= mask;
 		}
 	}
+	return map;
 }
 
-void FORD_VFD::init()
-{
-	write_data8(0x55);
-	write_data8((uint8_t *)init_data_block1, sizeof(init_data_block1));
-	write_data8((uint8_t *)init_data_block2, sizeof(init_data_block2));
-	write_data8((uint8_t *)init_data_block3, sizeof(init_data_block3));
-	write_data8((uint8_t *)init_data_block4, sizeof(init_data_block4));
-	write_data8((uint8_t *)init_data_block5, sizeof(init_data_block5));
-	write_data8((uint8_t *)gram, sizeof(gram));
-	write_data8((uint8_t *)init_data_block7, sizeof(init_data_block7));
-	write_data8((uint8_t *)init_data_block8, sizeof(init_data_block8));
-}
+static constexpr FordPixelMap pixel_map = make_pixel_map();
 
-void FORD_VFD::init_task()
-{
-	_spectrum = new SpectrumDisplay(FORD_WIDTH, FORD_HEIGHT);
-	_spectrum->setDrawPointCallback([this](int x, int y, uint8_t dot)
-									{ this->draw_point(x, y, dot, FFT); });
-	xTaskCreate(
-		[](void *arg)
-		{
-			FORD_VFD *vfd = static_cast<FORD_VFD *>(arg);
-			vfd->symbolhelper(BT, true);
-			while (true)
-			{
-				if (vfd->_mode == FFT)
-					vfd->clear();
-				vfd->_spectrum->spectrumProcess();
-				vfd->refrash(vfd->gram, sizeof vfd->gram);
-				vTaskDelay(pdMS_TO_TICKS(10));
-				vfd->contentanimate();
-			}
-			vTaskDelete(NULL);
-		},
-		"vfd",
-		4096 - 1024,
-		this,
-		6,
-		nullptr);
-}
-// 合并 get_oddgroup 和 get_evengroup 函数
-uint8_t FORD_VFD::get_group(int x, uint8_t dot, uint8_t group, bool isOdd)
+void FORD_VFD::draw_point(int x, int y, uint8_t dot, Mode mode)
 {
-	static const uint8_t oddMasks[] = {2, 4, 1};
-	static const uint8_t evenMasks[] = {2, 1, 4};
-	const uint8_t *masks = isOdd ? oddMasks : evenMasks;
-	int remainder = x % 3;
+	if (mode != _mode)
+		return;
+	if (x >= FORD_WIDTH || y >= FORD_HEIGHT || x < 0 || y < 0)
+		return;
 	if (dot)
-	{
-		group |= masks[remainder];
-	}
+		gram[pixel_map.index[y][x]] |= pixel_map.mask[y][x];
 	else
-	{
-		group &= ~masks[remainder];
-	}
-	return group & 0x7;
+		gram[pixel_map.index[y][x]] &= ~pixel_map.mask[y][x];
 }
 
-void FORD_VFD::draw_point(int x, int y, uint8_t dot, Mode mode)
+void FORD_VFD::fill_rect(int x1, int y1, int x2, int y2, uint8_t dot, Mode mode)
 {
 	if (mode != _mode)
 		return;
-	if (x >= FORD_WIDTH || y >= FORD_HEIGHT || x < 0 || y < 0)
-		return;
-	uint16_t index;
-	uint8_t temp;
-	y = FORD_HEIGHT - 1 - y;
-	index = 2 + 16 * (x / 3) + y / 4 * 3; //+y%16
-	if (index > 480)
-		index += 32;
-	else if (index > 256)
-		index += 16;
-
-	bool isOdd = (16 * (x / 3) / 16 % 2) == 1;
-	int remainder = y % 4;
-	switch (remainder)
+	x1 = x1 < 0 ? 0 : x1;
+	x2 = x2 >= FORD_WIDTH ? FORD_WIDTH - 1 : x2;
+	y1 = y1 < 0 ? 0 : y1;
+	y2 = y2 >= FORD_HEIGHT ? FORD_HEIGHT - 1 : y2;
+	for (int y = y1; y <= y2; ++y)
 	{
-	case 0:
-		if (isOdd)
-		{
-			temp = (get_group(x, dot, (gram[index] >> 5) & 0x7, true) << 5);
-			gram[index] &= ~0xe0;
-			gram[index] |= temp;
-		}
-		else
-		{
-			temp = (get_group(x, dot, (gram[index] >> 2) & 0x7, false) << 2);
-			gram[index] &= ~0x1c;
-			gram[index] |= temp;
-		}
-		break;
-	case 1:
-		if (isOdd)
-		{
-			temp = (get_group(x, dot, (gram[index] << 1) & 0x7, true) >> 1);
-			gram[index] &= ~0x3;
-			gram[index] |= temp;
-
-			temp = (get_group(x, dot, (gram[index + 1] >> 7) & 0x7, true) << 7);
-			gram[index + 1] &= ~0x80;
-			gram[index + 1] |= temp;
-		}
-		else
-		{
-			temp = (get_group(x, dot, (gram[index + 1] >> 4) & 0x7, false) << 4);
-			gram[index + 1] &= ~0x70;
-			gram[index + 1] |= temp;
-		}
-		break;
-	case 2:
-		if (isOdd)
-		{
-			temp = (get_group(x, dot, (gram[index + 1] >> 1) & 0x7, true) << 1);
-			gram[index + 1] &= ~0xe;
-			gram[index + 1] |= temp;
-		}
-		else
-		{
-			temp = (get_group(x, dot, (gram[index + 1] << 2) & 0x7, false) >> 2);
-			gram[index + 1] &= ~0x1;
-			gram[index + 1] |= temp;
-			temp = (get_group(x, dot, (gram[index + 2] >> 6) & 0x7, false) << 6);
-			gram[index + 2] &= ~0xc0;
-			gram[index + 2] |= temp;
-		}
-		break;
-	case 3:
-		if (isOdd)
-		{
-			temp = (get_group(x, dot, (gram[index + 2] >> 3) & 0x7, true) << 3);
-			gram[index + 2] &= ~0x38;
-			gram[index + 2] |= temp;
-		}
-		else
+		const uint16_t *index = pixel_map.index[y];
+		const uint8_t *mask = pixel_map.mask[y];
+		for (int x = x1; x <= x2; ++x)
 		{
-			temp = (get_group(x, dot, (gram[index + 2]) & 0x7, false));
-			gram[index + 2] &= ~0x7;
-			gram[index + 2] |= temp;
+			if (dot)
+				gram[index[x]] |= mask[x];
+			else
+				gram[index[x]] &= ~mask[x];
 		}
-		break;
 	}
+	wake();
 }
-void FORD_VFD::clear()
+
+void FORD_VFD::draw_bitmap(int x1, int y1, int x2, int y2, const uint8_t *bitmap, int stride, Mode mode)
 {
-#if 1
-	for (int y = 0; y < FORD_HEIGHT; ++y)
+	if (mode != _mode)
+		return;
+	int left = x1 < 0 ? 0 : x1;
+	int right = x2 >= FORD_WIDTH ? FORD_WIDTH - 1 : x2;
+	for (int y = y1 < 0 ? 0 : y1; y <= y2 && y < FORD_HEIGHT; ++y)
 	{
-		for (int x = 0; x < FORD_WIDTH; ++x)
+		const uint8_t *row = bitmap + (y - y1) * stride;
+		const uint16_t *index = pixel_map.index[y];
+		const uint8_t *mask = pixel_map.mask[y];
+		for (int x = left; x <= right; ++x)
 		{
-			draw_point(x, y, 0, _mode);
+			int bit = x - x1;
+			if (row[bit >> 3] & (0x80 >> (bit & 7)))
+				gram[index[x]] |= mask[x];
+			else
+				gram[index[x]] &= ~mask[x];
 		}
 	}
-#else
-	memset(&gram[2], 0, 270 - 2);
-	memset(&gram[275], 0, 510 - 275);
-	memset(&gram[515], 0, 814 - 515);
-#endif
+	wake();
 }
-void FORD_VFD::find_enum_code(Symbols flag, int *byteIndex, int *bitMask)
+
+// Segment bits share the bytes of the dots, so only the dot bits are cleared
+void FORD_VFD::clear()
 {
-	*byteIndex = symbolPositions[flag].byteIndex;
-	*bitMask = symbolPositions[flag].bitMask;
+	for (size_t i = 0; i < sizeof gram; ++i)
+		gram[i] &= ~pixel_map.pixels[i];
 }
 
-void FORD_VFD::symbolhelper(Symbols symbol, bool is_on)
+// Columns of the dot matrix, the renderer has already clipped the rows
+void FORD_VFD::fill_column(int x, int y1, int y2, uint8_t level)
 {
-	if (symbol >= SYMBOL_MAX)
+	if (!level)
 		return;
-
-	int byteIndex, bitMask;
-	find_enum_code(symbol, &byteIndex, &bitMask);
-
-	if (is_on)
-		gram[byteIndex] |= bitMask;
-	else
-		gram[byteIndex] &= ~bitMask;
+	for (int y = y1; y <= y2; ++y)
+		gram[pixel_map.index[y][x]] |= pixel_map.mask[y][x];
 }
 
 uint8_t process_bit(uint8_t real, uint8_t realbitdelta, uint8_t phy, uint8_t phybitdelta)
@@ -17,21 +17,54 @@
 #include <driver/gpio.h>
 #include <esp_log.h>
 #include "spectrumdisplay.h"
+#include "vfd_engine.h"
+#include "vfd_refresh.h"
 
 #define CHAR_SIZE (62 + 1)
 #define FORD_WIDTH 142
 #define FORD_HEIGHT 16
+#define FORD_GRAM_SIZE 818
 #define NUM_COUNT (9)
 
-class FORD_VFD
+// Nine seven segment digits and the symbols, the dot matrix is drawn by SpectrumDisplay and LVGL
+struct FordPanel
 {
-public:
-    typedef struct
-    {
-        int byteIndex; // Byte index
-        int bitMask;  // Bit index
-    } SymbolPosition;
+    static constexpr VfdController controller = VFD_CONTROLLER_PANEL;
+    static constexpr int cells = NUM_COUNT;
+    static constexpr int glyph_width = 0;
+    static constexpr int cgram_slots = 0;
+    static constexpr int digits = 0;
+    static constexpr int rows = 0;
+    static constexpr int frame_ms = 10;
+    static constexpr const auto &steps = vfd_seven_segment_steps;
+    // Position of each symbol in gram, in the order of FORD_VFD::Symbols
+    static constexpr VfdSymbol symbols[] = {
+        {272, 0x20}, // 冒号1
+        {816, 0x20}, // 冒号2
+        {270, 0x40}, // 点1
+        {513, 1},    // fm
+        {511, 0x20}, // am
+        {513, 0x40}, // dab
+        {513, 2},    // 1
+        {513, 4},    // 2
+        {513, 8},    // ta
+        {513, 0x10}, // tp
+        {513, 0x20}, // 蓝牙
+        {511, 0x40}, // 耳机
+        {511, 0x80}, // ipod
+        {510, 1},    // U盘
+        {510, 0x10}, // CD
+        {510, 4},    // CD
+        {510, 8},    // CD
+        {510, 2},    // CD
+    };
+};
 
+class FORD_VFD : public VfdEngine<FORD_VFD, FordPanel>
+{
+    friend class VfdEngine<FORD_VFD, FordPanel>;
+
+public:
     typedef enum
     {
         IDLE = -1,
@@ -39,18 +72,6 @@ public:
         FFT
     } Mode;
 
-    typedef enum
-    {
-        NONE = -1,
-        CLOCKWISE,
-        ANTICLOCKWISE,
-        UP2DOWN,
-        DOWN2UP,
-        LEFT2RT,
-        RT2LEFT,
-        MAX
-    } NumAni;
-
     typedef enum
     {
         COLON1, // 冒号1
@@ -74,36 +95,34 @@ public:
         SYMBOL_MAX
     } Symbols;
 
-    typedef struct
-    {
-        char current_content;
-        char last_content;
-        int animation_step;
-        NumAni animation_type;
-    } NumberData;
-
 public:
     FORD_VFD(gpio_num_t din, gpio_num_t clk, gpio_num_t cs, spi_host_device_t spi_num);
     FORD_VFD(spi_device_handle_t spi_device);
     void draw_point(int x, int y, uint8_t dot, Mode mode = CONTENT);
+    void fill_rect(int x1, int y1, int x2, int y2, uint8_t dot, Mode mode = CONTENT);
+    // Copies a 1-bpp bitmap (MSB first, 1 = lit, rows stride bytes apart) into the area x1..x2, y1..y2
+    void draw_bitmap(int x1, int y1, int x2, int y2, const uint8_t *bitmap, int stride, Mode mode = CONTENT);
     void clear();
-    void find_enum_code(Symbols flag, int *byteIndex, int *bitMask);
-    void symbolhelper(Symbols symbol, bool is_on);
+    // Lights rows y1..y2 of column x, the primitive SpectrumDisplay draws with
+    void fill_column(int x, int y1, int y2, uint8_t level);
+    void symbolhelper(Symbols symbol, bool is_on) { set_symbol(symbol, is_on); }
 
     void charhelper(int index, char ch);
     void charhelper(int index, uint8_t code);
     void setsleep(bool en);
     void refrash(uint8_t *gram, int size);
 
-    void time_blink();
-    void number_show(int start, char *buf, int size, NumAni ani = CLOCKWISE);
-    uint8_t contentgetpart(uint8_t raw, uint8_t before_raw, uint8_t mask);
+    void number_show(int start, char *buf, int size, NumAni ani = CLOCKWISE) { content_show(start, buf, size, false, ani); }
     void test();
     void setmode(Mode mode)
     {
         _mode = mode;
+        FrameGovernor::GetInstance().SetSpectrumShown(mode == FFT);
+        if (mode == FFT && _spectrum != nullptr)
+            _spectrum->invalidate();
+        wake();
     }
-    SpectrumDisplay *_spectrum;
+    SpectrumDisplay<FORD_VFD> *_spectrum = nullptr;
 
 protected:
     uint8_t find_hex_code(char ch);
@@ -113,6 +132,7 @@ protected:
 
 private:
     Mode _mode = CONTENT;
+    VfdRefresh<FORD_GRAM_SIZE> refresh_;
     gpio_num_t _cs;
     const uint8_t init_data_block0[102] = {0};
     const uint8_t init_data_block1[4] = {0x01, 0xa8, 0x4c, 0x80};
@@ -144,7 +164,7 @@ private:
         0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0x80, 0x00, 0x00, 0x00};
     const uint8_t init_data_block7[2] = {0x91, 0x00};
     const uint8_t init_data_block8[2] = {0x11, 0x20};
-    unsigned char gram[818] = {
+    unsigned char gram[FORD_GRAM_SIZE] = {
         0x6F,
         0x00,
     };
@@ -212,33 +232,19 @@ private:
         0x5b  // Z
     };
 
-    SymbolPosition symbolPositions[100] = {
-        {272, 0x20}, // 冒号1
-        {816, 0x20}, // 冒号2
-        {270, 0x40}, // 点1
-        {513, 1},    // fm
-        {511, 0x20}, // am
-        {513, 0x40}, // dab
-        {513, 2},    // 1
-        {513, 4},    // 2
-        {513, 8},    // ta
-        {513, 0x10}, // tp
-        {513, 0x20}, // 蓝牙
-        {511, 0x40}, // 耳机
-        {511, 0x80}, // ipod
-        {510, 1},    // U盘
-        {510, 0x10}, // CD
-        {510, 4},    // CD
-        {510, 8},    // CD
-        {510, 2},    // CD
-    };
     uint8_t dimming = 0;
     spi_device_handle_t spi_device_;
-    NumberData currentData[NUM_COUNT] = {0};
+    static constexpr Symbols blink_symbols[] = {COLON2};
     void init();
     void init_task();
-    void contentanimate();
-    uint8_t get_group(int x, uint8_t dot, uint8_t group, bool isOdd);
+
+    // VfdEngine hooks
+    uint8_t *symbol_ram() { return gram; }
+    uint32_t segments_of(char ch) { return find_hex_code(ch); }
+    void show_segments(int index, uint32_t code) { charhelper(index, (uint8_t)code); }
+    void frame();
+    bool moving() { return _mode == FFT && _spectrum != nullptr && _spectrum->animating(); }
+    void flush();
 };
 
 #endif
\ No newline at end of file
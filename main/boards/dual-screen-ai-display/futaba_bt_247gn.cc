@@ -8,6 +8,7 @@
 #include "freertos/FreeRTOS.h"
 #include "futaba_bt_247gn.h"
 #include "string.h"
+#include <algorithm>
 
 #define TAG "FTB_BT_247GN"
 // 0x00-0x0D 原始数据，可带最多9*13参数，地址自增
@@ -86,30 +87,7 @@ void FTB_BT_247GN::init_task()
     symbolhelper(Key, true);
     symbolhelper(TempO, true);
     symbolhelper(Lock, true);
-    xTaskCreate(
-        [](void *arg)
-        {
-            int count = 0;
-            FTB_BT_247GN *vfd = static_cast<FTB_BT_247GN *>(arg);
-            while (true)
-            {
-                if (!((++count) % 12))
-                {
-                    vfd->display_buffer();
-                    vfd->scroll_buffer();
-                }
-                vfd->refrash();
-                vTaskDelay(pdMS_TO_TICKS(30));
-                vfd->pixelanimate();
-                vfd->numberanimate();
-            }
-            vTaskDelete(NULL);
-        },
-        "vfd",
-        4096,
-        this,
-        6,
-        nullptr);
+    start("vfd", 4096);
 }
 
 void FTB_BT_247GN::test()
@@ -131,6 +109,7 @@ void FTB_BT_247GN::setbrightness(uint8_t brightness)
     dimming = brightness;
 	if (dimming < 5)
 		dimming = 5;
+    wake();
 }
 
 void FTB_BT_247GN::setsleep(bool en)
@@ -140,58 +119,7 @@ void FTB_BT_247GN::setsleep(bool en)
         memset(pixel_gram, 0, sizeof pixel_gram);
         memset(num_gram, 0, sizeof num_gram);
         memset(icon_gram, 0, sizeof icon_gram);
-    }
-}
-
-void FTB_BT_247GN::noti_show(int start, const char *buf, int size, bool forceupdate, NumAni ani, int timeout)
-{
-    content_inhibit_time = esp_timer_get_time() / 1000 + timeout;
-    for (size_t i = 0; i < PIXEL_COUNT; i++)
-    {
-        currentPixelData[i].animation_type = ani;
-        currentPixelData[i].current_content = ' ';
-        if (forceupdate)
-            currentPixelData[i].need_update = true;
-    }
-    for (size_t i = 0; i < size && (start + i) < PIXEL_COUNT; i++)
-    {
-        currentPixelData[start + i].animation_type = ani;
-        currentPixelData[start + i].current_content = buf[i];
-        if (forceupdate)
-            currentPixelData[start + i].need_update = true;
-    }
-}
-
-void FTB_BT_247GN::pixel_show(int start, const char *buf, int size, bool forceupdate, NumAni ani)
-{
-    if (content_inhibit_time != 0)
-    {
-        for (size_t i = 0; i < size && (start + i) < PIXEL_COUNT; i++)
-        {
-            tempPixelData[start + i].animation_type = ani;
-            tempPixelData[start + i].current_content = buf[i];
-            if (forceupdate)
-                tempPixelData[start + i].need_update = true;
-        }
-        return;
-    }
-    for (size_t i = 0; i < size && (start + i) < PIXEL_COUNT; i++)
-    {
-        currentPixelData[start + i].animation_type = ani;
-        currentPixelData[start + i].current_content = buf[i];
-        if (forceupdate)
-            currentPixelData[start + i].need_update = true;
-    }
-}
-
-void FTB_BT_247GN::num_show(int start, const char *buf, int size, bool forceupdate, NumAni ani)
-{
-    for (size_t i = 0; i < size && (start + i) < NUM_COUNT; i++)
-    {
-        currentNumData[start + i].animation_type = ani;
-        currentNumData[start + i].current_content = buf[i];
-        if (forceupdate)
-            currentNumData[start + i].need_update = true;
+        wake();
     }
 }
 
@@ -211,299 +139,6 @@ uint8_t FTB_BT_247GN::find_num_hex_code(char ch)
     return 0;
 }
 
-void FTB_BT_247GN::pixelanimate()
-{
-    static int64_t start_time = esp_timer_get_time() / 1000;
-    int64_t current_time = esp_timer_get_time() / 1000;
-    int64_t elapsed_time = current_time - start_time;
-    uint8_t temp_code[5] = {0};
-
-    if (elapsed_time >= 30)
-        start_time = current_time;
-    else
-        return;
-
-    if (content_inhibit_time != 0)
-    {
-        elapsed_time = current_time - content_inhibit_time;
-        if (elapsed_time > 0)
-        {
-            for (size_t i = 0; i < PIXEL_COUNT; i++)
-            {
-                currentPixelData[i].last_content = currentPixelData[i].current_content;
-                currentPixelData[i].animation_type = tempPixelData[i].animation_type;
-                currentPixelData[i].current_content = tempPixelData[i].current_content;
-                currentPixelData[i].need_update = true;
-            }
-            content_inhibit_time = 0;
-        }
-    }
-
-    for (int i = 0; i < PIXEL_COUNT; i++)
-    {
-        if (currentPixelData[i].current_content != currentPixelData[i].last_content || currentPixelData[i].need_update)
-        {
-            currentPixelData[i].animation_step++;
-            const uint8_t *before_raw_code = find_pixel_hex_code(currentPixelData[i].last_content);
-            const uint8_t *raw_code = find_pixel_hex_code(currentPixelData[i].current_content);
-            if (currentPixelData[i].animation_type == UP2DOWN)
-            {
-                for (int j = 0; j < 5; j++)
-                    temp_code[j] = (before_raw_code[j] << currentPixelData[i].animation_step) | (raw_code[j] >> (8 - currentPixelData[i].animation_step));
-
-                if (currentPixelData[i].animation_step >= 8)
-                    currentPixelData[i].animation_step = -1;
-            }
-            else if (currentPixelData[i].animation_type == DOWN2UP)
-            {
-                for (int j = 0; j < 5; j++)
-                    temp_code[j] = (before_raw_code[j] >> currentPixelData[i].animation_step) | (raw_code[j] << (8 - currentPixelData[i].animation_step));
-
-                if (currentPixelData[i].animation_step >= 8)
-                    currentPixelData[i].animation_step = -1;
-            }
-            else if (currentPixelData[i].animation_type == LEFT2RT)
-            {
-                switch (currentPixelData[i].animation_step)
-                {
-                case 0:
-                    for (int j = 0; j < 4; j++)
-                        temp_code[j] = before_raw_code[j + 1];
-                    for (int j = 4; j < 5; j++)
-                        temp_code[j] = raw_code[j - 4];
-                    break;
-                case 1:
-                    for (int j = 0; j < 3; j++)
-                        temp_code[j] = before_raw_code[j + 2];
-                    for (int j = 3; j < 5; j++)
-                        temp_code[j] = raw_code[j - 3];
-                    break;
-                case 2:
-                    for (int j = 0; j < 2; j++)
-                        temp_code[j] = before_raw_code[j + 3];
-                    for (int j = 2; j < 5; j++)
-                        temp_code[j] = raw_code[j - 2];
-                    break;
-                case 3:
-                    for (int j = 0; j < 1; j++)
-                        temp_code[j] = before_raw_code[j + 4];
-                    for (int j = 1; j < 5; j++)
-                        temp_code[j] = raw_code[j - 1];
-                    break;
-                default:
-                    currentPixelData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else if (currentPixelData[i].animation_type == RT2LEFT)
-            {
-                switch (currentPixelData[i].animation_step)
-                {
-                case 0:
-                    for (int j = 0; j < 4; j++)
-                        temp_code[j + 1] = before_raw_code[j];
-                    for (int j = 4; j < 5; j++)
-                        temp_code[j - 4] = raw_code[j];
-                    break;
-                case 1:
-                    for (int j = 0; j < 3; j++)
-                        temp_code[j + 2] = before_raw_code[j];
-                    for (int j = 3; j < 5; j++)
-                        temp_code[j - 3] = raw_code[j];
-                    break;
-                case 2:
-                    for (int j = 0; j < 2; j++)
-                        temp_code[j + 3] = before_raw_code[j];
-                    for (int j = 2; j < 5; j++)
-                        temp_code[j - 2] = raw_code[j];
-                    break;
-                case 3:
-                    for (int j = 0; j < 1; j++)
-                        temp_code[j + 4] = before_raw_code[j];
-                    for (int j = 1; j < 5; j++)
-                        temp_code[j - 1] = raw_code[j];
-                    break;
-                default:
-                    currentPixelData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else
-                currentPixelData[i].animation_step = -1;
-
-            if (currentPixelData[i].animation_step == -1)
-            {
-                currentPixelData[i].need_update = false;
-                currentPixelData[i].last_content = currentPixelData[i].current_content;
-                memcpy(temp_code, raw_code, sizeof temp_code);
-            }
-
-            pixelhelper(i, temp_code);
-        }
-    }
-}
-
-uint8_t FTB_BT_247GN::contentgetpart(uint8_t raw, uint8_t before_raw, uint8_t mask)
-{
-    return (raw & mask) | (before_raw & (~mask));
-}
-
-void FTB_BT_247GN::numberanimate()
-{
-    static int64_t start_time = esp_timer_get_time() / 1000;
-    int64_t current_time = esp_timer_get_time() / 1000;
-    int64_t elapsed_time = current_time - start_time;
-
-    if (elapsed_time >= 30)
-        start_time = current_time;
-    else
-        return;
-
-    for (int i = 0; i < NUM_COUNT; i++)
-    {
-        if (currentNumData[i].current_content != currentNumData[i].last_content || currentNumData[i].need_update)
-        {
-            currentNumData[i].need_update = false;
-            uint8_t before_raw_code = find_num_hex_code(currentNumData[i].last_content);
-            uint8_t raw_code = find_num_hex_code(currentNumData[i].current_content);
-            uint8_t code = raw_code;
-            if (currentNumData[i].animation_type == CLOCKWISE)
-            {
-                switch (currentNumData[i].animation_step)
-                {
-                case 0:
-                    code = contentgetpart(raw_code, before_raw_code, 1);
-                    break;
-                case 1:
-                    code = contentgetpart(raw_code, before_raw_code, 3);
-                    break;
-                case 2:
-                    code = contentgetpart(raw_code, before_raw_code, 0x43);
-                    break;
-                case 3:
-                    code = contentgetpart(raw_code, before_raw_code, 0x47);
-                    break;
-                case 4:
-                    code = contentgetpart(raw_code, before_raw_code, 0x4f);
-                    break;
-                case 5:
-                    code = contentgetpart(raw_code, before_raw_code, 0x5f);
-                    break;
-                default:
-                    currentNumData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else if (currentNumData[i].animation_type == ANTICLOCKWISE)
-            {
-                switch (currentNumData[i].animation_step)
-                {
-                case 0:
-                    code = contentgetpart(raw_code, before_raw_code, 1);
-                    break;
-                case 1:
-                    code = contentgetpart(raw_code, before_raw_code, 0x21);
-                    break;
-                case 2:
-                    code = contentgetpart(raw_code, before_raw_code, 0x61);
-                    break;
-                case 3:
-                    code = contentgetpart(raw_code, before_raw_code, 0x71);
-                    break;
-                case 4:
-                    code = contentgetpart(raw_code, before_raw_code, 0x79);
-                    break;
-                case 5:
-                    code = contentgetpart(raw_code, before_raw_code, 0x7d);
-                    break;
-                default:
-                    currentNumData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else if (currentNumData[i].animation_type == UP2DOWN)
-            {
-                switch (currentNumData[i].animation_step)
-                {
-                case 0:
-                    code = contentgetpart(raw_code, before_raw_code, 0x1);
-                    break;
-                case 1:
-                    code = contentgetpart(raw_code, before_raw_code, 0x21);
-                    break;
-                case 2:
-                    code = contentgetpart(raw_code, before_raw_code, 0x73);
-                    break;
-                default:
-                    currentNumData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else if (currentNumData[i].animation_type == DOWN2UP)
-            {
-                switch (currentNumData[i].animation_step)
-                {
-                case 0:
-                    code = contentgetpart(raw_code, before_raw_code, 0x8);
-                    break;
-                case 1:
-                    code = contentgetpart(raw_code, before_raw_code, 0xc);
-                    break;
-                case 2:
-                    code = contentgetpart(raw_code, before_raw_code, 0x5e);
-                    break;
-                default:
-                    currentNumData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else if (currentNumData[i].animation_type == LEFT2RT)
-            {
-                switch (currentNumData[i].animation_step)
-                {
-                case 0:
-                    code = contentgetpart(raw_code, before_raw_code, 0x10);
-                    break;
-                case 1:
-                    code = contentgetpart(raw_code, before_raw_code, 0x18);
-                    break;
-                case 2:
-                    code = contentgetpart(raw_code, before_raw_code, 0x7c);
-                    break;
-                default:
-                    currentNumData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else if (currentNumData[i].animation_type == RT2LEFT)
-            {
-                switch (currentNumData[i].animation_step)
-                {
-                case 0:
-                    code = contentgetpart(raw_code, before_raw_code, 0x4);
-                    break;
-                case 1:
-                    code = contentgetpart(raw_code, before_raw_code, 0xc);
-                    break;
-                case 2:
-                    code = contentgetpart(raw_code, before_raw_code, 0x5e);
-                    break;
-                default:
-                    currentNumData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else
-                currentNumData[i].animation_step = -1;
-
-            if (currentNumData[i].animation_step == -1)
-                currentNumData[i].last_content = currentNumData[i].current_content;
-
-            numhelper(i, code);
-            currentNumData[i].animation_step++;
-        }
-    }
-}
 void FTB_BT_247GN::pixelhelper(int index, uint8_t *code)
 {
     memcpy(pixel_gram + index * 5, code, 5);
@@ -514,23 +149,12 @@ void FTB_BT_247GN::numhelper(int index, uint8_t code)
     num_gram[index] = code;
 }
 
-void FTB_BT_247GN::symbolhelper(Symbols icon, bool en)
-{
-    icon_gram[(int)icon] = en;
-}
-
-void FTB_BT_247GN::time_blink()
-{
-    static bool time_mark = true;
-    time_mark = !time_mark;
-    symbolhelper(Colon, time_mark);
-}
-
 void FTB_BT_247GN::set_fonttype(int index)
 {
 #if USE_MUTI_FONTS
     ESP_LOGI(TAG, "fonttype: %d", index % 6);
     hex_codes = hex_codes_map[index % 6];
+    redraw();
 #endif
 }
 
@@ -542,9 +166,18 @@ void FTB_BT_247GN::refrash() // origin
         lastdimming = dimming;
         dimming_write(dimming);
     }
-    pixel_write(0, 0, pixel_gram, (sizeof pixel_gram) / 5);
-    num_write(0, num_gram, sizeof num_gram);
-    icon_write(0, icon_gram, sizeof icon_gram);
+    // Each RAM is written from its first changed entry, the address auto-increments
+    int first, last;
+    if (pixel_refresh_.take(pixel_gram, &first, &last))
+    {
+        // The start address has four bits, later characters are reached by the increment
+        int from = std::min(first / 5, 15);
+        pixel_write(from, 0, pixel_gram + from * 5, last / 5 - from + 1);
+    }
+    if (num_refresh_.take(num_gram, &first, &last))
+        num_write(first, num_gram + first, last - first + 1);
+    if (icon_refresh_.take(icon_gram, &first, &last))
+        icon_write(first, icon_gram + first, last - first + 1);
 }
 
 void FTB_BT_247GN::pixel_write(int x, int y, const uint8_t *code, int len)
@@ -614,177 +247,9 @@ void FTB_BT_247GN::dimming_write(int val)
     write_data8(temp_gram, 2);
 }
 
-void FTB_BT_247GN::display_buffer()
-{
-    if (cb->length_top)
-    {
-        if (cb->length_top <= DISPLAY_SIZE)
-        {
-            pixel_show(0, cb->buffer_top, DISPLAY_SIZE, false, DOWN2UP);
-
-            // ESP_LOGI(TAG, "%s", cb->buffer_top);
-        }
-        else
-        {
-            // Scroll display for length > 10
-            char display[DISPLAY_SIZE + 1];
-            for (int i = 0; i < DISPLAY_SIZE; i++)
-            {
-                int pos = (cb->start_pos_top + i) % cb->length_top;
-                display[i] = cb->buffer_top[pos];
-            }
-            pixel_show(0, display, DISPLAY_SIZE, true, LEFT2RT);
-
-            // ESP_LOGI(TAG, "%s", display);
-        }
-    }
-
-    if (cb->length_bottom)
-    {
-        if (cb->length_bottom <= DISPLAY_SIZE)
-        {
-            pixel_show(10, cb->buffer_bottom, DISPLAY_SIZE, false, DOWN2UP);
-
-            // ESP_LOGI(TAG, "%s", cb->buffer_bottom);
-        }
-        else
-        {
-            // Scroll display for length > 10
-            char display[DISPLAY_SIZE + 1];
-            for (int i = 0; i < DISPLAY_SIZE; i++)
-            {
-                int pos = (cb->start_pos_bottom + i) % cb->length_bottom;
-                display[i] = cb->buffer_bottom[pos];
-            }
-            pixel_show(10, display, DISPLAY_SIZE, true, LEFT2RT);
-
-            // ESP_LOGI(TAG, "%s", display);
-        }
-    }
-}
-void FTB_BT_247GN::scroll_buffer()
-{
-    static int64_t start_time = esp_timer_get_time() / 1000;
-    int64_t current_time = esp_timer_get_time() / 1000;
-
-    int64_t elapsed_time = current_time - start_time;
-
-    if (elapsed_time >= 100)
-        start_time = current_time;
-    else
-        return;
-
-    if (cb->length_top > DISPLAY_SIZE)
-    {
-        cb->start_pos_top = (cb->start_pos_top + 1) % cb->length_top;
-    }
-    if (cb->length_bottom > DISPLAY_SIZE)
-    {
-        cb->start_pos_bottom = (cb->start_pos_bottom + 1) % cb->length_bottom;
-    }
-}
-
-void FTB_BT_247GN::pixel_show(int y, const char *str)
-{
-    int str_len = strlen(str);
-    if (str_len > BUFFER_SIZE)
-    {
-        // Only keep the last BUFFER_SIZE characters if input is too long
-        str += (str_len - BUFFER_SIZE);
-        str_len = BUFFER_SIZE;
-    }
-    if (y == 0)
-    {
-        memset(cb->buffer_top, 0, sizeof cb->buffer_top);
-        cb->start_pos_top = 0;
-        cb->length_top = 0;
-        if (str_len + cb->length_top <= (BUFFER_SIZE - 2))
-        {
-            // Simple append
-            strncpy(cb->buffer_top + cb->length_top, str, str_len);
-            cb->length_top += str_len;
-            if (str_len > DISPLAY_SIZE)
-            {
-                memset(cb->buffer_top + cb->length_top, ' ', 2);
-                cb->length_top += 2;
-            }
-        }
-        else
-        {
-            // Need to wrap around
-            int remaining = BUFFER_SIZE - cb->length_top;
-            strncpy(cb->buffer_top + cb->length_top, str, remaining);
-            strncpy(cb->buffer_top, str + remaining, str_len - remaining);
-            cb->length_top = BUFFER_SIZE;
-            cb->buffer_top[cb->length_top] = '\0';
-        }
-    }
-    else
-    {
-        memset(cb->buffer_bottom, 0, sizeof cb->buffer_bottom);
-        cb->start_pos_bottom = 0;
-        cb->length_bottom = 0;
-        if (str_len + cb->length_bottom <= (BUFFER_SIZE - 2))
-        {
-            // Simple append
-            strncpy(cb->buffer_bottom + cb->length_bottom, str, str_len);
-            cb->length_bottom += str_len;
-            if (str_len > DISPLAY_SIZE)
-            {
-                memset(cb->buffer_bottom + cb->length_bottom, ' ', 2);
-                cb->length_bottom += 2;
-            }
-        }
-        else
-        {
-            // Need to wrap around
-            int remaining = BUFFER_SIZE - cb->length_bottom;
-            strncpy(cb->buffer_bottom + cb->length_bottom, str, remaining);
-            strncpy(cb->buffer_bottom, str + remaining, str_len - remaining);
-            cb->length_bottom = BUFFER_SIZE;
-            cb->buffer_bottom[cb->length_bottom] = '\0';
-        }
-    }
-}
-
 void FTB_BT_247GN::spectrum_show(float *buf, int size)
 {
-    symbolhelper(Bar_1, false);
-    symbolhelper(Bar_2, false);
-    symbolhelper(Bar_3, false);
-    symbolhelper(Bar_4, false);
-    symbolhelper(Bar_5, false);
-    symbolhelper(Bar_6, false);
-    symbolhelper(Bar_7, false);
-    symbolhelper(Bar_8, false);
-    symbolhelper(Bar_9, false);
-    symbolhelper(Bar_10, false);
-
-    int fft_level = 0;
-    for (size_t i = size / 4; i < size * 3 / 4; i++)
-    {
-        fft_level += buf[i];
-    }
-    fft_level /= (size / 2);
-
-    if (fft_level > 5)
-        symbolhelper(Bar_1, true);
-    if (fft_level > 15)
-        symbolhelper(Bar_2, true);
-    if (fft_level > 25)
-        symbolhelper(Bar_3, true);
-    if (fft_level > 35)
-        symbolhelper(Bar_4, true);
-    if (fft_level > 45)
-        symbolhelper(Bar_5, true);
-    if (fft_level > 55)
-        symbolhelper(Bar_6, true);
-    if (fft_level > 65)
-        symbolhelper(Bar_7, true);
-    if (fft_level > 75)
-        symbolhelper(Bar_8, true);
-    if (fft_level > 85)
-        symbolhelper(Bar_9, true);
-    if (fft_level > 95)
-        symbolhelper(Bar_10, true);
-}
\ No newline at end of file
+    static const Symbols bars[] = {Bar_1, Bar_2, Bar_3, Bar_4, Bar_5, Bar_6, Bar_7, Bar_8, Bar_9, Bar_10};
+    static const int thresholds[] = {5, 15, 25, 35, 45, 55, 65, 75, 85, 95};
+    meter(bars, thresholds, band_mean(buf, size / 4, size * 3 / 4));
+}
@@ -10,6 +10,8 @@
 #include <driver/spi_master.h>
 #include <driver/gpio.h>
 #include <esp_log.h>
+#include "vfd_refresh.h"
+#include "vfd_engine.h"
 
 #define USE_MUTI_FONTS false
 // uint8_t reverseBits0To6(uint8_t byte)
@@ -38,18 +40,38 @@
 //     }
 //     return 0;
 // }
+#define PIXEL_COUNT (20)
+#define NUM_COUNT (21)
+#define ICON_COUNT (51)
+
+// Two rows of ten 5x7 characters, seven segment digits and one flag per icon, all behind the panel's own controller
+struct FutabaPanel
+{
+    static constexpr VfdController controller = VFD_CONTROLLER_PANEL;
+    static constexpr int cells = PIXEL_COUNT;
+    static constexpr int glyph_width = 5;
+    static constexpr int cgram_slots = 0;
+    static constexpr int digits = NUM_COUNT;
+    static constexpr int rows = 2;
+    static constexpr int frame_ms = 30;
+    static constexpr int scroll_ms = 360;
+    static constexpr VfdAnimations::NumAni scroll_enter = VfdAnimations::DOWN2UP;
+    static constexpr VfdAnimations::NumAni scroll_move = VfdAnimations::LEFT2RT;
+    static constexpr const auto &steps = vfd_seven_segment_steps;
+    static constexpr auto symbols = vfd_symbol_bytes<ICON_COUNT>();
+};
+
 /**
  * @class FTB_BT_247GN
  * @brief A class for interacting with the FTB_BT_247GN device using SPI communication.
  *
  * This class provides methods to initialize the FTB_BT_247GN device, write data to it, and refresh its display.
  */
-class FTB_BT_247GN
+class FTB_BT_247GN : public VfdEngine<FTB_BT_247GN, FutabaPanel>
 {
+    friend class VfdEngine<FTB_BT_247GN, FutabaPanel>;
+
 public:
-#define PIXEL_COUNT (20)
-#define NUM_COUNT (21)
-#define ICON_COUNT (51)
 #define CHAR_SIZE (95 + 1)
     //  Hexadecimal code corresponding to each character
     //  !"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[]^_`abcdefghijklmnopqrstuvwxyz
@@ -769,53 +791,21 @@ public:
         Max
     } Symbols;
 
-    typedef enum
-    {
-        NONE = -1,
-        CLOCKWISE,
-        ANTICLOCKWISE,
-        UP2DOWN,
-        DOWN2UP,
-        LEFT2RT,
-        RT2LEFT,
-        MAX
-    } NumAni;
-
-    typedef struct
-    {
-        char current_content;
-        char last_content;
-        int animation_step;
-        NumAni animation_type;
-        bool need_update;
-    } ContentData;
-
-#define BUFFER_SIZE 256
-#define DISPLAY_SIZE 10
-
-    typedef struct
-    {
-        char buffer_top[BUFFER_SIZE + 1];    // +1 for null terminator
-        char buffer_bottom[BUFFER_SIZE + 1]; // +1 for null terminator
-        int start_pos_top;
-        int start_pos_bottom;
-        int length_top;
-        int length_bottom;
-    } CircularBuffer;
-
     FTB_BT_247GN(gpio_num_t din, gpio_num_t clk, gpio_num_t cs, spi_host_device_t spi_num);
     FTB_BT_247GN(spi_device_handle_t spi_device);
     void test();
     void setbrightness(uint8_t brightness);
     void setsleep(bool en);
-    void noti_show(int start, const char *buf, int size, bool forceupdate = false, NumAni ani = LEFT2RT, int timeout = 2000);
-    void pixel_show(int y, const char *str);
+    // Keeps a text on the top (y = 0) or bottom row, scrolling it when it does not fit
+    void pixel_show(int y, const char *str) { row_show(y ? 1 : 0, str); }
     void spectrum_show(float *buf, int size);
-    void num_show(int start, const char *buf, int size, bool forceupdate = false, NumAni ani = ANTICLOCKWISE);
+    void num_show(int start, const char *buf, int size, bool forceupdate = false, NumAni ani = ANTICLOCKWISE)
+    {
+        digit_show(start, buf, size, forceupdate, ani);
+    }
     void pixelhelper(int index, uint8_t *code);
     void numhelper(int index, uint8_t code);
-    void symbolhelper(Symbols icon, bool en);
-    void time_blink();
+    void symbolhelper(Symbols icon, bool en) { set_symbol(icon, en); }
     void set_fonttype(int index);
 
 private:
@@ -828,27 +818,30 @@ private:
 #endif
     uint8_t dimming = 0;
     spi_device_handle_t spi_device_;
-    int64_t content_inhibit_time = 0;
-    ContentData currentPixelData[PIXEL_COUNT] = {0};
-    ContentData tempPixelData[PIXEL_COUNT] = {0};
-    ContentData currentNumData[NUM_COUNT] = {0};
     uint8_t pixel_gram[5 * PIXEL_COUNT] = {0};
     uint8_t num_gram[NUM_COUNT] = {0};
     uint8_t icon_gram[ICON_COUNT] = {0};
-    CircularBuffer *cb = new CircularBuffer();
+    VfdRefresh<sizeof(pixel_gram)> pixel_refresh_;
+    VfdRefresh<sizeof(num_gram)> num_refresh_;
+    VfdRefresh<sizeof(icon_gram)> icon_refresh_;
 
     void init_task();
-    void pixelanimate();
-    void numberanimate();
     void refrash();
-    void display_buffer();
-    void scroll_buffer();
 
-    uint8_t contentgetpart(uint8_t raw, uint8_t before_raw, uint8_t mask);
     void write_data8(uint8_t *dat, int len);
     const uint8_t *find_pixel_hex_code(char ch);
     uint8_t find_num_hex_code(char ch);
 
+    static constexpr Symbols blink_symbols[] = {Colon};
+
+    // VfdEngine hooks
+    uint8_t *symbol_ram() { return icon_gram; }
+    const uint8_t *glyph_of(char ch) { return find_pixel_hex_code(ch); }
+    void show_glyph(int index, const uint8_t *code) { memcpy(pixel_gram + index * 5, code, 5); }
+    uint32_t segments_of(char ch) { return find_num_hex_code(ch); }
+    void show_digit(int index, uint32_t code) { numhelper(index, code); }
+    void flush() { refrash(); }
+
 protected:
     void pixel_write(int x, int y, const uint8_t *code, int len);
     void pixel_write(int x, int y, const char *ascii, int len);
@@ -857,7 +850,10 @@ protected:
     void icon_write(Symbols icon, bool en);
     void icon_write(int x, const uint8_t *code, int len);
     void dimming_write(int val);
-    void pixel_show(int start, const char *buf, int size, bool forceupdate = false, NumAni ani = LEFT2RT);
+    void pixel_show(int start, const char *buf, int size, bool forceupdate = false, NumAni ani = LEFT2RT)
+    {
+        content_show(start, buf, size, forceupdate, ani);
+    }
 };
 
 #endif
\ No newline at end of file
@@ -54,224 +54,6 @@ void HNA_16MM65T::waveanimate()
     corewavehelper(left_sum * 8 / 90 / 4, right_sum * 8 / 90 / 4);
 }
 
-/**
- * @brief Gets a part of the content by combining raw and previous raw data according to a mask.
- *
- * Combines the raw data and the previous raw data based on the given mask,
- * where the bits in the mask determine which parts come from the raw data and which come from the previous raw data.
- *
- * @param raw The current raw data.
- * @param before_raw The previous raw data.
- * @param mask The mask used to determine the combination method.
- * @return The combined data.
- */
-uint32_t HNA_16MM65T::contentgetpart(uint32_t raw, uint32_t before_raw, uint32_t mask)
-{
-    return (raw & mask) | (before_raw & (~mask));
-}
-
-/**
- * @brief Performs the content animation process.
- *
- * Checks the elapsed time, updates the content data if the inhibition time has passed.
- * For each content item with a different current and last content,
- * it selects the appropriate animation step based on the animation type and updates the display.
- */
-void HNA_16MM65T::contentanimate()
-{
-    static int64_t start_time = esp_timer_get_time() / 1000;
-    int64_t current_time = esp_timer_get_time() / 1000;
-    int64_t elapsed_time = current_time - start_time;
-
-    if (elapsed_time >= 30)
-        start_time = current_time;
-    else
-        return;
-
-    if (content_inhibit_time != 0)
-    {
-        elapsed_time = current_time - content_inhibit_time;
-        if (elapsed_time > 0)
-        {
-            for (size_t i = 0; i < CONTENT_SIZE; i++)
-            {
-                currentData[i].last_content = currentData[i].current_content;
-                currentData[i].animation_type = tempData[i].animation_type;
-                currentData[i].current_content = tempData[i].current_content;
-            }
-            content_inhibit_time = 0;
-        }
-    }
-
-    for (int i = 0; i < CONTENT_SIZE; i++)
-    {
-        if (currentData[i].current_content != currentData[i].last_content)
-        {
-            uint32_t before_raw_code = find_hex_code(currentData[i].last_content);
-            uint32_t raw_code = find_hex_code(currentData[i].current_content);
-            uint32_t code = raw_code;
-            if (currentData[i].animation_type == CLOCKWISE)
-            {
-                switch (currentData[i].animation_step)
-                {
-                case 0:
-                    code = contentgetpart(raw_code, before_raw_code, 0x080000 | 0x800000);
-                    break;
-                case 1:
-                    code = contentgetpart(raw_code, before_raw_code, 0x4C0000 | 0x800000);
-                    break;
-                case 2:
-                    code = contentgetpart(raw_code, before_raw_code, 0x6e0000 | 0x800000);
-                    break;
-                case 3:
-                    code = contentgetpart(raw_code, before_raw_code, 0x6f6000 | 0x800000);
-                    break;
-                case 4:
-                    code = contentgetpart(raw_code, before_raw_code, 0x6f6300 | 0x800000);
-                    break;
-                case 5:
-                    code = contentgetpart(raw_code, before_raw_code, 0x6f6770 | 0x800000);
-                    break;
-                case 6:
-                    code = contentgetpart(raw_code, before_raw_code, 0x6f6ff0 | 0x800000);
-                    break;
-                case 7:
-                    code = contentgetpart(raw_code, before_raw_code, 0x6ffff0 | 0x800000);
-                    break;
-                default:
-                    currentData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else if (currentData[i].animation_type == ANTICLOCKWISE)
-            {
-                switch (currentData[i].animation_step)
-                {
-                case 0:
-                    code = contentgetpart(raw_code, before_raw_code, 0x004880);
-                    break;
-                case 1:
-                    code = contentgetpart(raw_code, before_raw_code, 0x004ca0);
-                    break;
-                case 2:
-                    code = contentgetpart(raw_code, before_raw_code, 0x004ef0);
-                    break;
-                case 3:
-                    code = contentgetpart(raw_code, before_raw_code, 0x006ff0);
-                    break;
-                case 4:
-                    code = contentgetpart(raw_code, before_raw_code, 0x036ff0);
-                    break;
-                case 5:
-                    code = contentgetpart(raw_code, before_raw_code, 0x676ff0);
-                    break;
-                case 6:
-                    code = contentgetpart(raw_code, before_raw_code, 0xef6ff0);
-                    break;
-                case 7:
-                    code = contentgetpart(raw_code, before_raw_code, 0xffeff0);
-                    break;
-                default:
-                    currentData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else if (currentData[i].animation_type == UP2DOWN)
-            {
-                switch (currentData[i].animation_step)
-                {
-                case 0:
-                    code = contentgetpart(raw_code, before_raw_code, 0xe00000);
-                    break;
-                case 1:
-                    code = contentgetpart(raw_code, before_raw_code, 0xff0000);
-                    break;
-                case 2:
-                    code = contentgetpart(raw_code, before_raw_code, 0xffe000);
-                    break;
-                case 3:
-                    code = contentgetpart(raw_code, before_raw_code, 0xffff00);
-                    break;
-                default:
-                    currentData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else if (currentData[i].animation_type == DOWN2UP)
-            {
-                switch (currentData[i].animation_step)
-                {
-                case 0:
-                    code = contentgetpart(raw_code, before_raw_code, 0x0000f0);
-                    break;
-                case 1:
-                    code = contentgetpart(raw_code, before_raw_code, 0x001ff0);
-                    break;
-                case 2:
-                    code = contentgetpart(raw_code, before_raw_code, 0x00fff0);
-                    break;
-                case 3:
-                    code = contentgetpart(raw_code, before_raw_code, 0x1ffff0);
-                    break;
-                default:
-                    currentData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else if (currentData[i].animation_type == LEFT2RT)
-            {
-                switch (currentData[i].animation_step)
-                {
-                case 0:
-                    code = contentgetpart(raw_code, before_raw_code, 0x901080);
-                    break;
-                case 1:
-                    code = contentgetpart(raw_code, before_raw_code, 0xd89880);
-                    break;
-                case 2:
-                    code = contentgetpart(raw_code, before_raw_code, 0xdcdce0);
-                    break;
-                case 3:
-                    code = contentgetpart(raw_code, before_raw_code, 0xdefee0);
-                    break;
-                default:
-                    currentData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else if (currentData[i].animation_type == RT2LEFT)
-            {
-                switch (currentData[i].animation_step)
-                {
-                case 0:
-                    code = contentgetpart(raw_code, before_raw_code, 0x210110);
-                    break;
-                case 1:
-                    code = contentgetpart(raw_code, before_raw_code, 0x632310);
-                    break;
-                case 2:
-                    code = contentgetpart(raw_code, before_raw_code, 0x676770);
-                    break;
-                case 3:
-                    code = contentgetpart(raw_code, before_raw_code, 0x6fef70);
-                    break;
-                default:
-                    currentData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else
-                currentData[i].animation_step = -1;
-
-            if (currentData[i].animation_step == -1)
-                currentData[i].last_content = currentData[i].current_content;
-
-            charhelper(i, code);
-            currentData[i].animation_step++;
-        }
-    }
-}
-
 /**
  * @brief Constructor for the PT6324 class.
  *
@@ -310,26 +92,10 @@ HNA_16MM65T::HNA_16MM65T(spi_device_handle_t spi_device) : PT6324(spi_device)
 
 void HNA_16MM65T::init_task()
 {
-    xTaskCreate(
-        [](void *arg)
-        {
-            HNA_16MM65T *vfd = static_cast<HNA_16MM65T *>(arg);
-            vfd->symbolhelper(LBAR_RBAR, true);
-            while (true)
-            {
-                vfd->refrash(vfd->internal_gram);
-                vfd->contentanimate();
-                vfd->waveanimate();
-                vTaskDelay(pdMS_TO_TICKS(10));
-            }
-            vTaskDelete(NULL);
-        },
-        "vfd",
-        4096 - 1024,
-        this,
-        6,
-        nullptr);
+    symbolhelper(LBAR_RBAR, true);
+    start();
 }
+
 /**
  * @brief Displays spectrum information.
  *
@@ -346,27 +112,10 @@ void HNA_16MM65T::spectrum_show(float *buf, int size)
         return;
     static float fft_gain[FFT_SIZE] = {1.5f * 2, 1.6f * 2, 2.6f * 2, 2.8f * 2, 3.0f * 2, 3.0f * 2, 3.0f * 2, 3.0f * 2, 3.0f * 2, 3.0f * 2, 3.0f * 2, 3.0f * 2};
     static uint8_t fft_postion[FFT_SIZE] = {0, 2, 4, 6, 8, 10, 11, 9, 7, 5, 3, 1};
-    static float max = 0;
     float fft_buf[FFT_SIZE];
-    int sum = 0;
     int elements_per_part = size / 4 / 12;
     for (int i = 0; i < FFT_SIZE; i++)
-    {
-        int max_val = 0;
-        for (int j = 0; j < elements_per_part; j++)
-        {
-            if (max_val < buf[(i + 3) * elements_per_part + j])
-                max_val = buf[(i + 3) * elements_per_part + j];
-        }
-        sum += max_val;
-        fft_buf[i] = max_val;
-        if (max < fft_buf[i])
-        {
-            max = fft_buf[i];
-        }
-        if (fft_buf[i] < 0)
-            fft_buf[i] = -fft_buf[i];
-    }
+        fft_buf[i] = (int)band_peak(buf, (i + 3) * elements_per_part, (i + 4) * elements_per_part);
     wavebusy = false;
     for (size_t i = 0; i < FFT_SIZE; i++)
     {
@@ -376,76 +125,6 @@ void HNA_16MM65T::spectrum_show(float *buf, int size)
     }
 }
 
-/**
- * @brief Controls the blinking effect related to time and toggles the display state of specific Symbols.
- *
- * If there is a content inhibition time, the function returns directly. Otherwise, it toggles the time mark state
- * and updates the display of corresponding Symbols according to the mark state.
- */
-void HNA_16MM65T::time_blink()
-{
-    static bool time_mark = true;
-    time_mark = !time_mark;
-    if (content_inhibit_time != 0)
-    {
-        symbolhelper(NUM6_MARK, false);
-        symbolhelper(NUM8_MARK, false);
-        return;
-    }
-    symbolhelper(NUM6_MARK, time_mark);
-    symbolhelper(NUM8_MARK, time_mark);
-}
-
-/**
- * @brief Displays content and sets the content and its animation type at the specified starting position.
- *
- * If there is a content inhibition time, the content is stored in the temporary data. Otherwise,
- * the content is stored in the current data, and the corresponding animation type is set.
- *
- * @param start The starting position index.
- * @param buf The character array to be displayed.
- * @param size The number of characters to be displayed.
- * @param ani The animation type enumeration value.
- */
-void HNA_16MM65T::content_show(int start, char *buf, int size, NumAni ani)
-{
-    if (content_inhibit_time != 0)
-    {
-        for (size_t i = 0; i < size && (start + i) < CONTENT_SIZE; i++)
-        {
-            tempData[start + i].animation_type = ani;
-            tempData[start + i].current_content = buf[i];
-        }
-        return;
-    }
-    for (size_t i = 0; i < size && (start + i) < CONTENT_SIZE; i++)
-    {
-        currentData[start + i].animation_type = ani;
-        currentData[start + i].current_content = buf[i];
-    }
-}
-
-/**
- * @brief Displays notification content and sets the content, animation type, and inhibition time at the specified starting position.
- *
- * Sets the content inhibition time, stores the content in the current data, and sets the corresponding animation type.
- *
- * @param start The starting position index.
- * @param buf The character array to be displayed.
- * @param size The number of characters to be displayed.
- * @param ani The animation type enumeration value.
- * @param timeout The content inhibition time (in milliseconds).
- */
-void HNA_16MM65T::noti_show(int start, char *buf, int size, NumAni ani, int timeout)
-{
-    content_inhibit_time = esp_timer_get_time() / 1000 + timeout;
-    for (size_t i = 0; i < size && (start + i) < CONTENT_SIZE; i++)
-    {
-        currentData[start + i].animation_type = ani;
-        currentData[start + i].current_content = buf[i];
-    }
-}
-
 /**
  * @brief Test function that creates a task to simulate spectrum data display.
  *
@@ -541,45 +220,6 @@ void HNA_16MM65T::charhelper(int index, uint32_t code)
     internal_gram[NUM_BEGIN + index * 3 + 0] = code & 0xff;
 }
 
-/**
- * @brief Finds the position of a symbol in the display buffer based on its enumeration value.
- *
- * Receives a symbol enumeration value, looks up the corresponding byte index and bit index in the `symbolPositions` array,
- * and stores them in the variables pointed to by the input pointers.
- *
- * @param flag The symbol enumeration value used to identify the symbol to be found.
- * @param byteIndex A pointer to an integer used to store the byte index of the symbol.
- * @param bitMask A pointer to an integer used to store the bit index of the symbol.
- */
-void HNA_16MM65T::find_enum_code(Symbols flag, int *byteIndex, int *bitMask)
-{
-    *byteIndex = symbolPositions[flag].byteIndex;
-    *bitMask = symbolPositions[flag].bitMask;
-}
-
-/**
- * @brief Controls the display state of a specific symbol.
- *
- * Finds the position of the symbol in the display buffer based on the input symbol enumeration value and display state flag,
- * and sets or clears the corresponding bit to control the display or hiding of the symbol.
- *
- * @param symbol The symbol enumeration value of the symbol to be controlled.
- * @param is_on A boolean value indicating whether the symbol should be displayed (true for display, false for hiding).
- */
-void HNA_16MM65T::symbolhelper(Symbols symbol, bool is_on)
-{
-    if (symbol >= SYMBOL_MAX)
-        return;
-
-    int byteIndex, bitMask;
-    find_enum_code(symbol, &byteIndex, &bitMask);
-
-    if (is_on)
-        internal_gram[byteIndex] |= bitMask;
-    else
-        internal_gram[byteIndex] &= ~bitMask;
-}
-
 /**
  * @brief Updates the display buffer according to different dot matrix states.
  *
@@ -12,18 +12,10 @@
 #define _HNA_16MM65T_H_
 
 #include "pt6324.h"
+#include "vfd_engine.h"
 #include <cmath>
 #include <esp_wifi.h>
 
-/**
- * @class HNA_16MM65T
- * @brief This class inherits from the PT6324 class and is used to control the display of a specific device.
- *
- * It provides methods for displaying spectrum, numbers, symbols, dot matrix and other information, and also supports animation effects.
- */
-class HNA_16MM65T : protected PT6324
-{
-public:
 // Define the number of characters
 #define CHAR_SIZE (62 + 1)
 // Define the starting index of numbers
@@ -35,6 +27,92 @@ public:
 #define FFT_SIZE (12)
 // Define the number of digits
 #define CONTENT_SIZE (10)
+
+// Ten sixteen segment digits on a PT6324, the waves and dots are drawn by the driver
+struct HnaPanel
+{
+    static constexpr VfdController controller = VFD_CONTROLLER_PT6324;
+    static constexpr int cells = CONTENT_SIZE;
+    static constexpr int glyph_width = 0;
+    static constexpr int cgram_slots = 0;
+    static constexpr int digits = 0;
+    static constexpr int rows = 0;
+    static constexpr int frame_ms = 10;
+    // Segments revealed at each step of a transition
+    static constexpr uint32_t steps[VfdAnimations::MAX][VFD_MAX_STEPS + 1] = {
+        {0x880000, 0xcc0000, 0xee0000, 0xef6000, 0xef6300, 0xef6770, 0xef6ff0, 0xeffff0}, // CLOCKWISE
+        {0x004880, 0x004ca0, 0x004ef0, 0x006ff0, 0x036ff0, 0x676ff0, 0xef6ff0, 0xffeff0}, // ANTICLOCKWISE
+        {0xe00000, 0xff0000, 0xffe000, 0xffff00},                                         // UP2DOWN
+        {0x0000f0, 0x001ff0, 0x00fff0, 0x1ffff0},                                         // DOWN2UP
+        {0x901080, 0xd89880, 0xdcdce0, 0xdefee0},                                         // LEFT2RT
+        {0x210110, 0x632310, 0x676770, 0x6fef70},                                         // RT2LEFT
+    };
+    // Position of each symbol in the display buffer, in the order of HNA_16MM65T::Symbols
+    static constexpr VfdSymbol symbols[] = {
+        {0, 2},     // R_OUTER_B
+        {0, 4},     // R_OUTER_A
+        {0, 8},     // R_CENTER
+        {0, 0x10},  // L_OUTER_B
+        {0, 0x20},  // L_OUTER_A
+        {0, 0x40},  // L_CENTER
+        {0, 0x80},  // STEREO
+        {1, 1},     // MONO
+        {1, 2},     // GIGA
+        {1, 4},     // REC_1
+        {1, 8},     // DOT_MATRIX_4_6
+        {1, 0x10},  // DOT_MATRIX_5_2_5_3_6_3
+        {1, 0x20},  // DOT_MATRIX_0_3_0_5_0_6_1_2_1_3_1_5_1_6
+        {1, 0x40},  // DOT_MATRIX_3_1_3_2_3_3_3_5_3_6_4_0_4_1_4_2_4_3_4_5_4_6_5_1_5_2_5_3_5_5
+        {1, 0x80},  // DOT_MATRIX_5_4
+        {2, 1},     // DOT_MATRIX_0_0_0_1_0_2_0_3_0_5_1_0_1_1_1_3_1_5_5_0_5_1_6_0_6_1_6_2_6_5
+        {2, 2},     // DOT_MATRIX_2_0_2_4_3_4_4_4
+        {2, 4},     // DOT_MATRIX_4_0
+        {2, 8},     // DOT_MATRIX_2_MINUS1_2_7
+        {2, 0x10},  // USB2
+        {2, 0x20},  // USB1
+        {2, 0x40},  // REC_2
+        {2, 0x80},  // LBAR_RBAR
+        {39, 1},    // CENTER_OUTLAY_BLUEA
+        {39, 2},    // CENTER_OUTLAY_BLUEB
+        {39, 4},    // CENTER_OUTLAY_REDA
+        {39, 8},    // CENTER_OUTLAY_REDB
+        {39, 0x10}, // CENTER_INLAY_BLUER
+        {39, 0x20}, // CENTER_INLAY_BLUET
+        {39, 0x40}, // CENTER_INLAY_BLUEL
+        {39, 0x80}, // CENTER_INLAY_BLUEB
+        {40, 1},    // CENTER_INLAY_RED1
+        {40, 2},    // CENTER_INLAY_RED2
+        {40, 4},    // CENTER_INLAY_RED3
+        {40, 8},    // CENTER_INLAY_RED4
+        {40, 0x10}, // CENTER_INLAY_RED5
+        {40, 0x20}, // CENTER_INLAY_RED6
+        {40, 0x40}, // CENTER_INLAY_RED7
+        {40, 0x80}, // CENTER_INLAY_RED8
+        {41, 1},    // CENTER_INLAY_RED9
+        {41, 2},    // CENTER_INLAY_RED10
+        {41, 4},    // CENTER_INLAY_RED11
+        {41, 8},    // CENTER_INLAY_RED12
+        {41, 0x10}, // CENTER_INLAY_RED13
+        {41, 0x20}, // CENTER_INLAY_RED14
+        {41, 0x40}, // CENTER_INLAY_RED15
+        {41, 0x80}, // CENTER_INLAY_RED16
+        {18, 8},    // NUM6_MARK
+        {24, 8},    // NUM8_MARK
+        {24, 4},    // NUM8_POINT
+    };
+};
+
+/**
+ * @class HNA_16MM65T
+ * @brief This class inherits from the PT6324 class and is used to control the display of a specific device.
+ *
+ * It provides methods for displaying spectrum, numbers, symbols, dot matrix and other information, and also supports animation effects.
+ */
+class HNA_16MM65T : protected PT6324, public VfdEngine<HNA_16MM65T, HnaPanel>
+{
+    friend class VfdEngine<HNA_16MM65T, HnaPanel>;
+
+public:
     /**
      * @enum Dots
      * @brief Defines different states of the dot matrix.
@@ -106,18 +184,6 @@ public:
         SYMBOL_MAX // Maximum value of the symbol enumeration
     } Symbols;
 
-    typedef enum
-    {
-        NONE = -1,
-        CLOCKWISE,
-        ANTICLOCKWISE,
-        UP2DOWN,
-        DOWN2UP,
-        LEFT2RT,
-        RT2LEFT,
-        MAX
-    } NumAni;
-
     /**
      * @struct SymbolPosition
      * @brief Defines the position of a symbol in the display buffer, consisting of a byte index and a bit index.
@@ -140,29 +206,12 @@ public:
         int animation_step; // Animation step
     } WaveFFTData;
 
-    /**
-     * @struct ContentData
-     * @brief Stores the data related to content display and animation, including current and last content, animation steps, and animation type.
-     */
-    typedef struct
-    {
-        char current_content;
-        char last_content;
-        int animation_step;
-        NumAni animation_type;
-    } ContentData;
-
 private:
     bool wavebusy = true;
     const int wave_total_steps = 5; // Total number of animation steps
     int64_t wave_start_time = 0;
     WaveFFTData waveData[FFT_SIZE] = {0};
 
-    int64_t content_inhibit_time = 0;
-
-    ContentData currentData[CONTENT_SIZE] = {0};
-    ContentData tempData[CONTENT_SIZE] = {0};
-
     // Hexadecimal code corresponding to each character
     // !"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[]^_`abcdefghijklmnopqrstuvwxyz
     const unsigned int hex_codes[CHAR_SIZE] = {
@@ -226,61 +275,6 @@ private:
         0xaa4420, // Y
         0xe248f0, // Z
     };
-    // Position of each symbol in the display buffer
-    SymbolPosition symbolPositions[100] = {
-        {0, 2},     // R_OUTER_B
-        {0, 4},     // R_OUTER_A
-        {0, 8},     // R_CENTER
-        {0, 0x10},  // L_OUTER_B
-        {0, 0x20},  // L_OUTER_A
-        {0, 0x40},  // L_CENTER
-        {0, 0x80},  // STEREO
-        {1, 1},     // MONO
-        {1, 2},     // GIGA
-        {1, 4},     // REC_1
-        {1, 8},     // DOT_MATRIX_4_6
-        {1, 0x10},  // DOT_MATRIX_5_2_5_3_6_3
-        {1, 0x20},  // DOT_MATRIX_0_3_0_5_0_6_1_2_1_3_1_5_1_6
-        {1, 0x40},  // DOT_MATRIX_3_1_3_2_3_3_3_5_3_6_4_0_4_1_4_2_4_3_4_5_4_6_5_1_5_2_5_3_5_5
-        {1, 0x80},  // DOT_MATRIX_5_4
-        {2, 1},     // DOT_MATRIX_0_0_0_1_0_2_0_3_0_5_1_0_1_1_1_3_1_5_5_0_5_1_6_0_6_1_6_2_6_5
-        {2, 2},     // DOT_MATRIX_2_0_2_4_3_4_4_4
-        {2, 4},     // DOT_MATRIX_4_0
-        {2, 8},     // DOT_MATRIX_2_MINUS1_2_7
-        {2, 0x10},  // USB2
-        {2, 0x20},  // USB1
-        {2, 0x40},  // REC_2
-        {2, 0x80},  // LBAR_RBAR
-        {39, 1},    // CENTER_OUTLAY_BLUEA
-        {39, 2},    // CENTER_OUTLAY_BLUEB
-        {39, 4},    // CENTER_OUTLAY_REDA
-        {39, 8},    // CENTER_OUTLAY_REDB
-        {39, 0x10}, // CENTER_INLAY_BLUER
-        {39, 0x20}, // CENTER_INLAY_BLUET
-        {39, 0x40}, // CENTER_INLAY_BLUEL
-        {39, 0x80}, // CENTER_INLAY_BLUEB
-        {40, 1},    // CENTER_INLAY_RED1
-        {40, 2},    // CENTER_INLAY_RED2
-        {40, 4},    // CENTER_INLAY_RED3
-        {40, 8},    // CENTER_INLAY_RED4
-        {40, 0x10}, // CENTER_INLAY_RED5
-        {40, 0x20}, // CENTER_INLAY_RED6
-        {40, 0x40}, // CENTER_INLAY_RED7
-        {40, 0x80}, // CENTER_INLAY_RED8
-        {41, 1},    // CENTER_INLAY_RED9
-        {41, 2},    // CENTER_INLAY_RED10
-        {41, 4},    // CENTER_INLAY_RED11
-        {41, 8},    // CENTER_INLAY_RED12
-        {41, 0x10}, // CENTER_INLAY_RED13
-        {41, 0x20}, // CENTER_INLAY_RED14
-        {41, 0x40}, // CENTER_INLAY_RED15
-        {41, 0x80}, // CENTER_INLAY_RED16
-        {18, 8},    // NUM6_MARK
-        {24, 8},    // NUM8_MARK
-        {24, 4},    // NUM8_POINT
-    };
-
-
     void init_task();
     /**
      * @brief Performs animation effects and updates the display buffer.
@@ -289,22 +283,16 @@ private:
      */
     void waveanimate();
 
-    /**
-     * @brief Combines the raw data and the previous raw data according to a mask to get a part of the content.
-     *
-     * @param raw The current raw data.
-     * @param before_raw The previous raw data.
-     * @param mask The mask used for combination.
-     * @return uint32_t The combined data.
-     */
-    uint32_t contentgetpart(uint32_t raw, uint32_t before_raw, uint32_t mask);
+    static constexpr Symbols blink_symbols[] = {NUM6_MARK, NUM8_MARK};
 
-    /**
-     * @brief Performs content animation and updates the display buffer.
-     *
-     * Handles the content animation logic, including checking inhibition time, updating content data, and applying animation effects.
-     */
-    void contentanimate();
+    // VfdEngine hooks
+    uint8_t *symbol_ram() { return internal_gram; }
+    uint32_t segments_of(char ch) { return find_hex_code(ch); }
+    void show_segments(int index, uint32_t code) { charhelper(index, code); }
+    void frame() { waveanimate(); }
+    // The core wave keeps rolling even without audio
+    bool moving() { return true; }
+    void flush() { refrash(internal_gram); }
 
 public:
     /**
@@ -333,13 +321,6 @@ public:
      */
     void spectrum_show(float *buf, int size);
 
-    /**
-     * @brief Handles the time blinking effect.
-     *
-     * Toggles the state of specific symbols to create a blinking effect related to time.
-     */
-    void time_blink();
-
     /**
      * @brief Displays a string.
      *
@@ -348,7 +329,10 @@ public:
      * @param size The size of the string.
      * @param ani The animation type for the content display, default is CLOCKWISE.
      */
-    void content_show(int start, char *buf, int size, NumAni ani = CLOCKWISE);
+    void content_show(int start, char *buf, int size, NumAni ani = CLOCKWISE)
+    {
+        VfdEngine::content_show(start, buf, size, false, ani);
+    }
 
     /**
      * @brief Displays a notification string with a specified timeout.
@@ -359,7 +343,10 @@ public:
      * @param ani The animation type for the notification display, default is CLOCKWISE.
      * @param timeout The time (in milliseconds) to inhibit other content display, default is 2000.
      */
-    void noti_show(int start, char *buf, int size, NumAni ani = CLOCKWISE, int timeout = 2000);
+    void noti_show(int start, char *buf, int size, NumAni ani = CLOCKWISE, int timeout = 2000)
+    {
+        VfdEngine::noti_show(start, buf, size, false, ani, timeout);
+    }
 
     /**
      * @brief Displays a symbol on the screen.
@@ -370,7 +357,7 @@ public:
      * @param symbol The enumeration value of the symbol to be displayed.
      * @param is_on A boolean indicating whether the symbol should be shown (true) or hidden (false).
      */
-    void symbolhelper(Symbols symbol, bool is_on);
+    void symbolhelper(Symbols symbol, bool is_on) { set_symbol(symbol, is_on); }
 
     /**
      * @brief Displays a dot matrix pattern on the screen.
@@ -442,18 +429,6 @@ protected:
      * @return The hexadecimal code corresponding to the character. Returns 0 if not found.
      */
     unsigned int find_hex_code(char ch);
-
-    /**
-     * @brief Finds the position of a symbol in the display buffer based on its enumeration value.
-     *
-     * Receives a symbol enumeration value, looks up the corresponding byte index and bit index in the `symbolPositions` array,
-     * and stores them in the variables pointed to by the input pointers.
-     *
-     * @param flag The symbol enumeration value used to identify the symbol to be found.
-     * @param byteIndex A pointer to an integer used to store the byte index of the symbol.
-     * @param bitMask A pointer to an integer used to store the bit index of the symbol.
-     */
-    void find_enum_code(Symbols flag, int *byteIndex, int *bitMask);
 };
 
 #endif // _HNA_16MM65T_H_
@@ -84,45 +84,12 @@ HUV_13SS16T::HUV_13SS16T(spi_device_handle_t spi_device) : spi_device_(spi_devic
 
 void HUV_13SS16T::init_task()
 {
-    xTaskCreate(
-        [](void *arg)
-        {
-            int count = 0;
-            HUV_13SS16T *vfd = static_cast<HUV_13SS16T *>(arg);
-
-            Settings settings("subdisplay", false);
-            vfd->set_fonttype(settings.GetInt("fonttype", 0));
-            vfd->initialize_points();
-            vfd->initSnake(&vfd->snake);
-            vfd->initFood(&vfd->food, &vfd->snake);
-            while (true)
-            {
-                vfd->symnbol_progress();
-                // vfd->clear_point();
-                // for (size_t i = 0; i < MAX_X; i++)
-                // {
-                //     for (size_t j = 0; j < MAX_Y; j++)
-                //     {
-                //         vfd->draw_point(i, j, (j + i + count) % 2);
-                //     }
-                // }
-
-                if (!((++count) % 12))
-                {
-                    vfd->display_buffer();
-                    vfd->scroll_buffer();
-                }
-                vfd->refrash();
-                vTaskDelay(pdMS_TO_TICKS(30));
-                vfd->pixelanimate();
-            }
-            vTaskDelete(NULL);
-        },
-        "vfd",
-        4096,
-        this,
-        6,
-        nullptr);
+    Settings settings("subdisplay", false);
+    set_fonttype(settings.GetInt("fonttype", 0));
+    initialize_points();
+    initSnake(&snake);
+    initFood(&food, &snake);
+    start("vfd", 4096);
 }
 
 void HUV_13SS16T::test()
@@ -152,47 +119,6 @@ void HUV_13SS16T::setsleep(bool en)
     }
 }
 
-void HUV_13SS16T::noti_show(int start, const char *buf, int size, bool forceupdate, NumAni ani, int timeout)
-{
-    content_inhibit_time = esp_timer_get_time() / 1000 + timeout;
-    for (size_t i = 0; i < PIXEL_COUNT; i++)
-    {
-        currentPixelData[i].animation_type = ani;
-        currentPixelData[i].current_content = ' ';
-        if (forceupdate)
-            currentPixelData[i].need_update = true;
-    }
-    for (size_t i = 0; i < size && (start + i) < PIXEL_COUNT; i++)
-    {
-        currentPixelData[start + i].animation_type = ani;
-        currentPixelData[start + i].current_content = buf[i];
-        if (forceupdate)
-            currentPixelData[start + i].need_update = true;
-    }
-}
-
-void HUV_13SS16T::pixel_show(int start, const char *buf, int size, bool forceupdate, NumAni ani)
-{
-    if (content_inhibit_time != 0)
-    {
-        for (size_t i = 0; i < size && (start + i) < PIXEL_COUNT; i++)
-        {
-            tempPixelData[start + i].animation_type = ani;
-            tempPixelData[start + i].current_content = buf[i];
-            if (forceupdate)
-                tempPixelData[start + i].need_update = true;
-        }
-        return;
-    }
-    for (size_t i = 0; i < size && (start + i) < PIXEL_COUNT; i++)
-    {
-        currentPixelData[start + i].animation_type = ani;
-        currentPixelData[start + i].current_content = buf[i];
-        if (forceupdate)
-            currentPixelData[start + i].need_update = true;
-    }
-}
-
 const uint8_t *HUV_13SS16T::find_pixel_hex_code(char ch)
 {
     if (ch >= ' ' && ch <= ('~' + 1))
@@ -209,144 +135,6 @@ uint8_t HUV_13SS16T::find_num_hex_code(char ch)
     return 0;
 }
 
-void HUV_13SS16T::pixelanimate()
-{
-    static int64_t start_time = esp_timer_get_time() / 1000;
-    int64_t current_time = esp_timer_get_time() / 1000;
-    int64_t elapsed_time = current_time - start_time;
-    uint8_t temp_code[5] = {0};
-
-    if (elapsed_time >= 30)
-        start_time = current_time;
-    else
-        return;
-
-    if (content_inhibit_time != 0)
-    {
-        elapsed_time = current_time - content_inhibit_time;
-        if (elapsed_time > 0)
-        {
-            for (size_t i = 0; i < PIXEL_COUNT; i++)
-            {
-                currentPixelData[i].last_content = currentPixelData[i].current_content;
-                currentPixelData[i].animation_type = tempPixelData[i].animation_type;
-                currentPixelData[i].current_content = tempPixelData[i].current_content;
-                currentPixelData[i].need_update = true;
-            }
-            hex_codes = hex_codes_map[fonttype_];
-            content_inhibit_time = 0;
-        }
-    }
-
-    for (int i = 0; i < PIXEL_COUNT; i++)
-    {
-        if (currentPixelData[i].current_content != currentPixelData[i].last_content || currentPixelData[i].need_update)
-        {
-            currentPixelData[i].animation_step++;
-            const uint8_t *before_raw_code = find_pixel_hex_code(currentPixelData[i].last_content);
-            const uint8_t *raw_code = find_pixel_hex_code(currentPixelData[i].current_content);
-            if (currentPixelData[i].animation_type == UP2DOWN)
-            {
-                for (int j = 0; j < 5; j++)
-                    temp_code[j] = (before_raw_code[j] << currentPixelData[i].animation_step) | (raw_code[j] >> (8 - currentPixelData[i].animation_step));
-
-                if (currentPixelData[i].animation_step >= 8)
-                    currentPixelData[i].animation_step = -1;
-            }
-            else if (currentPixelData[i].animation_type == DOWN2UP)
-            {
-                for (int j = 0; j < 5; j++)
-                    temp_code[j] = (before_raw_code[j] >> currentPixelData[i].animation_step) | (raw_code[j] << (8 - currentPixelData[i].animation_step));
-
-                if (currentPixelData[i].animation_step >= 8)
-                    currentPixelData[i].animation_step = -1;
-            }
-            else if (currentPixelData[i].animation_type == LEFT2RT)
-            {
-                switch (currentPixelData[i].animation_step)
-                {
-                case 0:
-                    for (int j = 0; j < 4; j++)
-                        temp_code[j] = before_raw_code[j + 1];
-                    for (int j = 4; j < 5; j++)
-                        temp_code[j] = raw_code[j - 4];
-                    break;
-                case 1:
-                    for (int j = 0; j < 3; j++)
-                        temp_code[j] = before_raw_code[j + 2];
-                    for (int j = 3; j < 5; j++)
-                        temp_code[j] = raw_code[j - 3];
-                    break;
-                case 2:
-                    for (int j = 0; j < 2; j++)
-                        temp_code[j] = before_raw_code[j + 3];
-                    for (int j = 2; j < 5; j++)
-                        temp_code[j] = raw_code[j - 2];
-                    break;
-                case 3:
-                    for (int j = 0; j < 1; j++)
-                        temp_code[j] = before_raw_code[j + 4];
-                    for (int j = 1; j < 5; j++)
-                        temp_code[j] = raw_code[j - 1];
-                    break;
-                default:
-                    currentPixelData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else if (currentPixelData[i].animation_type == RT2LEFT)
-            {
-                switch (currentPixelData[i].animation_step)
-                {
-                case 0:
-                    for (int j = 0; j < 4; j++)
-                        temp_code[j + 1] = before_raw_code[j];
-                    for (int j = 4; j < 5; j++)
-                        temp_code[j - 4] = raw_code[j];
-                    break;
-                case 1:
-                    for (int j = 0; j < 3; j++)
-                        temp_code[j + 2] = before_raw_code[j];
-                    for (int j = 3; j < 5; j++)
-                        temp_code[j - 3] = raw_code[j];
-                    break;
-                case 2:
-                    for (int j = 0; j < 2; j++)
-                        temp_code[j + 3] = before_raw_code[j];
-                    for (int j = 2; j < 5; j++)
-                        temp_code[j - 2] = raw_code[j];
-                    break;
-                case 3:
-                    for (int j = 0; j < 1; j++)
-                        temp_code[j + 4] = before_raw_code[j];
-                    for (int j = 1; j < 5; j++)
-                        temp_code[j - 1] = raw_code[j];
-                    break;
-                default:
-                    currentPixelData[i].animation_step = -1;
-                    break;
-                }
-            }
-            else
-                currentPixelData[i].animation_step = -1;
-
-            if (currentPixelData[i].animation_step == -1)
-            {
-                currentPixelData[i].need_update = false;
-                currentPixelData[i].last_content = currentPixelData[i].current_content;
-                memcpy(temp_code, raw_code, sizeof temp_code);
-            }
-
-            pixelhelper(i, temp_code);
-        }
-    }
-}
-
-uint8_t HUV_13SS16T::contentgetpart(uint8_t raw, uint8_t before_raw, uint8_t mask)
-{
-    return (raw & mask) | (before_raw & (~mask));
-}
-
 void HUV_13SS16T::pixelhelper(int index, uint8_t *code)
 {
     memcpy(pixel_gram + index * 5, code, 5);
@@ -364,10 +152,7 @@ void HUV_13SS16T::set_fonttype(int index, bool needsave)
     fonttype_ = index % 6;
     ESP_LOGI(TAG, "fonttype: %d", fonttype_);
     hex_codes = hex_codes_map[fonttype_];
-    for (size_t i = 0; i < PIXEL_COUNT; i++)
-    {
-        currentPixelData[i].need_update = true;
-    }
+    redraw();
     if (needsave)
     {
         Settings settings("subdisplay", true);
@@ -406,9 +191,17 @@ void HUV_13SS16T::refrash() // origin
             dimming = 5;
         dimming_write(dimming);
     }
-    pixel_write(0, 0, pixel_gram, (sizeof pixel_gram) / 5);
-    vTaskDelay(pdMS_TO_TICKS(10));
-    matrix_write(&matrix_gram[0][0]);
+    // Characters are written from the first changed one, the matrix only when it changed
+    int first, last;
+    bool pixel_changed = pixel_refresh_.take(pixel_gram, &first, &last);
+    if (pixel_changed)
+        pixel_write(first / 5, 0, pixel_gram + first / 5 * 5, last / 5 - first / 5 + 1);
+    if (matrix_refresh_.take(&matrix_gram[0][0], &first, &last))
+    {
+        if (pixel_changed)
+            vTaskDelay(pdMS_TO_TICKS(10));
+        matrix_write(&matrix_gram[0][0]);
+    }
     // num_write(0, num_gram, sizeof num_gram);
     // icon_write(0, icon_gram, sizeof icon_gram);
 }
@@ -458,115 +251,20 @@ void HUV_13SS16T::dimming_write(int val)
     write_data8(temp_gram, 2);
 }
 
-void HUV_13SS16T::display_buffer()
-{
-    int64_t current_time = esp_timer_get_time() / 1000;
-    if (content_inhibit_time != 0)
-    {
-        int64_t elapsed_time = current_time - content_inhibit_time;
-        if (elapsed_time > 0)
-        {
-            memset(cb->buffer, 0, sizeof cb->buffer);
-            cb->start_pos = 0;
-            cb->length = 0;
-            content_inhibit_time = 0;
-        }
-    }
-    else
-        return;
-    if (cb->length)
-    {
-        if (cb->length <= DISPLAY_SIZE)
-        {
-            for (size_t i = 0; i < DISPLAY_SIZE; i++)
-            {
-                currentPixelData[i].current_content = cb->buffer[i];
-                currentPixelData[i].animation_type = DOWN2UP;
-            }
-            // ESP_LOGI(TAG, "%s", cb->buffer);
-        }
-        else
-        {
-            // Scroll display for length > 10
-            char display[DISPLAY_SIZE + 1];
-            for (int i = 0; i < DISPLAY_SIZE; i++)
-            {
-                int pos = (cb->start_pos + i) % cb->length;
-                display[i] = cb->buffer[pos];
-            }
-            for (size_t i = 0; i < DISPLAY_SIZE; i++)
-            {
-                currentPixelData[i].current_content = display[i];
-                currentPixelData[i].animation_type = LEFT2RT;
-                currentPixelData[i].need_update = true;
-            }
-
-            // ESP_LOGI(TAG, "%s", display);
-        }
-    }
-}
-void HUV_13SS16T::scroll_buffer()
-{
-    static int64_t start_time = esp_timer_get_time() / 1000;
-    int64_t current_time = esp_timer_get_time() / 1000;
-
-    int64_t elapsed_time = current_time - start_time;
-
-    if (elapsed_time >= 100)
-        start_time = current_time;
-    else
-        return;
-
-    if (cb->length > DISPLAY_SIZE)
-    {
-        cb->start_pos = (cb->start_pos + 1) % cb->length;
-    }
-}
-
-bool HUV_13SS16T::noti_busy()
+void HUV_13SS16T::noti_show(const char *str, int timeout)
 {
-    if (content_inhibit_time != 0)
-        return true;
-    else
-        return false;
+#if USE_MUTI_FONTS
+    hex_codes = hex_codes_map[0];
+#endif
+    VfdEngine::noti_show(str, timeout);
 }
 
-void HUV_13SS16T::noti_show(const char *str, int timeout)
+// Notifications are shown in the first font, the content gets the chosen one back
+void HUV_13SS16T::notification_done()
 {
-    hex_codes = hex_codes_map[0];
-    content_inhibit_time = esp_timer_get_time() / 1000 + timeout;
-    int str_len = strlen(str);
-    if (str_len > BUFFER_SIZE)
-    {
-        // Only keep the last BUFFER_SIZE characters if input is too long
-        str += (str_len - BUFFER_SIZE);
-        str_len = BUFFER_SIZE;
-    }
-    {
-        memset(cb->buffer, 0, sizeof cb->buffer);
-        cb->start_pos = 0;
-        cb->length = 0;
-        if (str_len + cb->length <= (BUFFER_SIZE - 2))
-        {
-            // Simple append
-            strncpy(cb->buffer + cb->length, str, str_len);
-            cb->length += str_len;
-            if (str_len > DISPLAY_SIZE)
-            {
-                memset(cb->buffer + cb->length, ' ', 2);
-                cb->length += 2;
-            }
-        }
-        else
-        {
-            // Need to wrap around
-            int remaining = BUFFER_SIZE - cb->length;
-            strncpy(cb->buffer + cb->length, str, remaining);
-            strncpy(cb->buffer, str + remaining, str_len - remaining);
-            cb->length = BUFFER_SIZE;
-            cb->buffer[cb->length] = '\0';
-        }
-    }
+#if USE_MUTI_FONTS
+    hex_codes = hex_codes_map[fonttype_];
+#endif
 }
 
 void HUV_13SS16T::liquid_pixels(float AcX, float AcY, float AcZ)
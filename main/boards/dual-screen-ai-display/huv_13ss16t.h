@@ -10,6 +10,8 @@
 #include <driver/spi_master.h>
 #include <driver/gpio.h>
 #include <esp_log.h>
+#include "vfd_refresh.h"
+#include "vfd_engine.h"
 
 #define USE_MUTI_FONTS true
 // uint8_t reverseBits0To6(uint8_t byte)
@@ -38,16 +40,34 @@
 //     }
 //     return 0;
 // }
+#define PIXEL_COUNT (8)
+
+// Eight 5x7 characters and a 10x9 dot matrix driven by the panel's own controller
+struct HuvPanel
+{
+    static constexpr VfdController controller = VFD_CONTROLLER_PANEL;
+    static constexpr int cells = PIXEL_COUNT;
+    static constexpr int glyph_width = 5;
+    static constexpr int cgram_slots = 0;
+    static constexpr int digits = 0;
+    static constexpr int rows = 1;
+    static constexpr int frame_ms = 30;
+    static constexpr int scroll_ms = 360;
+    static constexpr VfdAnimations::NumAni scroll_enter = VfdAnimations::DOWN2UP;
+    static constexpr VfdAnimations::NumAni scroll_move = VfdAnimations::LEFT2RT;
+};
+
 /**
  * @class HUV_13SS16T
  * @brief A class for interacting with the HUV_13SS16T device using SPI communication.
  *
  * This class provides methods to initialize the HUV_13SS16T device, write data to it, and refresh its display.
  */
-class HUV_13SS16T
+class HUV_13SS16T : public VfdEngine<HUV_13SS16T, HuvPanel>
 {
+    friend class VfdEngine<HUV_13SS16T, HuvPanel>;
+
 public:
-#define PIXEL_COUNT (8)
 #define MAX_X 10
 #define MAX_Y 9
 #define CHAR_SIZE (95 + 1)
@@ -739,38 +759,9 @@ public:
         Symbol
     } States;
 
-    typedef enum
-    {
-        NONE = -1,
-        CLOCKWISE,
-        ANTICLOCKWISE,
-        UP2DOWN,
-        DOWN2UP,
-        LEFT2RT,
-        RT2LEFT,
-        MAX
-    } NumAni;
-
-    typedef struct
-    {
-        char current_content;
-        char last_content;
-        int animation_step;
-        NumAni animation_type;
-        bool need_update;
-    } ContentData;
     States states = Snake_;
 
     void symbol_helper(Symbols symbol_);
-#define BUFFER_SIZE 256
-#define DISPLAY_SIZE 8
-
-    typedef struct
-    {
-        char buffer[BUFFER_SIZE + 1]; // +1 for null terminator
-        int start_pos;
-        int length;
-    } CircularBuffer;
 
     HUV_13SS16T(gpio_num_t din, gpio_num_t clk, gpio_num_t cs, spi_host_device_t spi_num);
     HUV_13SS16T(spi_device_handle_t spi_device);
@@ -778,7 +769,6 @@ public:
     void test();
     void setbrightness(uint8_t brightness);
     void setsleep(bool en);
-    void noti_show(int start, const char *buf, int size, bool forceupdate = false, NumAni ani = LEFT2RT, int timeout = 2000);
     void liquid_pixels(float AcX, float AcY, float AcZ);
     void pixelhelper(int index, uint8_t *code);
     void time_blink();
@@ -794,8 +784,10 @@ public:
         acceCallback = callback;
     }
     void noti_show(const char *str, int timeout);
-    void pixel_show(int start, const char *buf, int size, bool forceupdate = false, NumAni ani = LEFT2RT);
-    bool noti_busy();
+    void pixel_show(int start, const char *buf, int size, bool forceupdate = false, NumAni ani = LEFT2RT)
+    {
+        content_show(start, buf, size, forceupdate, ani);
+    }
 
 private:
     typedef struct
@@ -825,24 +817,25 @@ private:
 #endif
     uint8_t dimming = 0;
     spi_device_handle_t spi_device_;
-    int64_t content_inhibit_time = 0;
-    ContentData currentPixelData[DISPLAY_SIZE] = {0};
-    ContentData tempPixelData[DISPLAY_SIZE] = {0};
     uint8_t pixel_gram[5 * PIXEL_COUNT] = {0};
     uint8_t matrix_gram[MAX_X][MAX_Y] = {0};
-    CircularBuffer *cb = new CircularBuffer();
+    VfdRefresh<sizeof(pixel_gram)> pixel_refresh_;
+    VfdRefresh<sizeof(matrix_gram)> matrix_refresh_;
     int fonttype_ = 0;
     void init_task();
-    void pixelanimate();
     void refrash();
-    void display_buffer();
-    void scroll_buffer();
-
-
-    uint8_t contentgetpart(uint8_t raw, uint8_t before_raw, uint8_t mask);
     void write_data8(uint8_t *dat, int len);
     const uint8_t *find_pixel_hex_code(char ch);
     uint8_t find_num_hex_code(char ch);
+
+    // VfdEngine hooks
+    const uint8_t *glyph_of(char ch) { return find_pixel_hex_code(ch); }
+    void show_glyph(int index, const uint8_t *code) { memcpy(pixel_gram + index * 5, code, 5); }
+    void frame() { symnbol_progress(); }
+    // The snake or the liquid always moves
+    bool moving() { return true; }
+    void flush() { refrash(); }
+    void notification_done();
     void initialize_points()
     {
         for (int i = 0; i < MAXDOTS; i++)
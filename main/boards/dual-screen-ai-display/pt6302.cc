@@ -159,5 +159,6 @@ void PT6302::setbrightness(uint8_t brightness)
 {
     dimming = brightness * 8 / 100;
     // ESP_LOGI(TAG, "dimming %d", dimming);
+    refresh_.invalidate();
     return;
 }
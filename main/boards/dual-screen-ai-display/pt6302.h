@@ -10,6 +10,7 @@
 #include <driver/spi_master.h>
 #include <driver/gpio.h>
 #include <esp_log.h>
+#include "vfd_refresh.h"
 
 /**
  * @class PT6302
@@ -56,6 +57,7 @@ private:
 
 protected:
     Gram internal_gram; // Display buffer 10 num + 15 ad + 5 cgram
+    VfdRefresh<sizeof(Gram)> refresh_; // What refrash already sent of internal_gram
     virtual void refrash(Gram *gram) {};
     void write_dcram(int index, uint8_t *dat, int len);
     void write_adram(int index, uint8_t *dat, int len);
@@ -77,6 +77,7 @@ void PT6324::setbrightness(uint8_t brightness)
 {
     dimming = brightness * 8 / 100;
     // ESP_LOGI(TAG, "dimming %d", dimming);
+    refresh_.invalidate();
 }
 
 void PT6324::setsleep(bool en)
@@ -89,18 +90,21 @@ void PT6324::setsleep(bool en)
 
 void PT6324::refrash(uint8_t *gram)
 {
-    // Create a buffer to hold the data to be sent for refreshing the display
-    uint8_t data_gram[48 + 1] = {0};
+    // Only the bytes changed since the last refresh are sent, the address auto-increments
+    int first, last;
+    if (!refresh_.take(gram, &first, &last))
+        return;
+
+    uint8_t data_gram[48 + 1];
 
     // Set the start address command
-    data_gram[0] = 0xC0;
+    data_gram[0] = 0xC0 | first;
 
     // Copy the graphics RAM data to the buffer
-    for (size_t i = 1; i < sizeof data_gram; i++)
-        data_gram[i] = gram[i - 1];
+    memcpy(data_gram + 1, gram + first, last - first + 1);
 
     // Send the graphics RAM data to the PT6324 device
-    write_data8(data_gram, (sizeof data_gram));
+    write_data8(data_gram, last - first + 2);
 
     // Define the command to turn on the display
     uint8_t data[1] = {0x80};
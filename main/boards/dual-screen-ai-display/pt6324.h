@@ -10,6 +10,7 @@
 #include <driver/spi_master.h>
 #include <driver/gpio.h>
 #include <esp_log.h>
+#include "vfd_refresh.h"
 
 /**
  * @class PT6324
@@ -29,6 +30,7 @@ public:
 private:
     uint8_t dimming = 0;
     spi_device_handle_t spi_device_;
+    VfdRefresh<48> refresh_;
 
     void write_data8(uint8_t *dat, int len);
 
@@ -1,16 +1,10 @@
 #ifndef SPECTRUM_DISPLAY_H
 #define SPECTRUM_DISPLAY_H
 
-#include <freertos/FreeRTOS.h>
-#include <freertos/task.h>
-#include <freertos/event_groups.h>
-#include <functional>
-#include <cmath>
+#include <array>
+#include <cstdint>
 #include <cstring>
 
-// 定义 DrawPoint 回调函数类型
-typedef std::function<void(int x, int y, uint8_t dot)> DrawPointCallback;
-
 // 频谱风格枚举
 enum SpectrumStyle
 {
@@ -24,202 +18,162 @@ enum SpectrumStyle
 };
 
 #define FFT_FACTOR 0.5f
+#define SPECTRUM_STYLE_MS 5000 // 每种风格显示的时长
+
+/**
+ * 频谱渲染器，直接写入 Sink 的帧缓冲
+ *
+ * Sink 需要提供：
+ * - void clear(): 清除频谱区域
+ * - void fill_column(int x, int y1, int y2, uint8_t level): 点亮第 x 列的 y1..y2 行（含两端），
+ *   坐标已裁剪到屏幕内，level 为渐变风格的亮度，其余风格为 1
+ *
+ * 每种风格每列只发出一次填充，不再逐点回调
+ */
+template <typename Sink>
 class SpectrumDisplay
 {
 private:
+    static constexpr int fftSize = 512 / 2;
+    static constexpr int totalAnimationSteps = 5;
+
+    // 非线性动画曲线 1 - (1 - t)^4，先快后慢，按步预先算好，最后一项为终点
+    static constexpr std::array<float, totalAnimationSteps + 1> easing = []
+    {
+        std::array<float, totalAnimationSteps + 1> table = {};
+        for (int step = 0; step <= totalAnimationSteps; ++step)
+        {
+            float rest = 1 - static_cast<float>(step) / totalAnimationSteps;
+            table[step] = 1 - rest * rest * rest * rest;
+        }
+        return table;
+    }();
+
+    Sink &sink;
     int screenWidth;
     int screenHeight;
-    SpectrumStyle currentStyle = STYLE_DOT;
-    DrawPointCallback drawPointCallback;
-    float currentFFTData[512 / 2];
-    float interpolatedData[512 / 2];
-    float targetFFTData[512 / 2];
-    const int fftSize = 512 / 2;
-    int animationStep = 0;
-    const int totalAnimationSteps = 5;
+    SpectrumStyle currentStyle = STYLE_BAR;
+    float currentFFTData[fftSize] = {};
+    float deltaFFTData[fftSize] = {}; // 目标减去起点，插值只剩一次乘加
+    float interpolatedData[fftSize] = {};
+    int animationStep = totalAnimationSteps;
+    bool redraw = false;
+    int64_t styleStart = -1;
 
-    // 非线性动画函数，先快后慢
-    float easeOutQuart(float t)
+    // 计算当前进度的插值数据，没有分支的循环便于编译器向量化
+    void calculateInterpolatedData(float *__restrict out, float eased) const
     {
-        return 1 - std::pow(1 - t, 4);
+        const float *__restrict from = currentFFTData;
+        const float *__restrict delta = deltaFFTData;
+        for (int i = 0; i < fftSize; ++i)
+            out[i] = from[i] + delta[i] * eased;
     }
 
-    // 计算当前步的插值数据
-    void calculateInterpolatedData(float *interpolatedData)
+    int heightAt(const float *data, int bin) const
     {
-        float progress = static_cast<float>(animationStep) / totalAnimationSteps;
-        float easedProgress = easeOutQuart(progress);
-        for (int i = 0; i < fftSize; ++i)
+        int height = static_cast<int>(data[bin] * FFT_FACTOR);
+        return height > 0 ? height : 0;
+    }
+
+    void fillColumn(int x, int y1, int y2, uint8_t level)
+    {
+        if (y1 < 0)
+            y1 = 0;
+        if (y2 >= screenHeight)
+            y2 = screenHeight - 1;
+        if (y1 <= y2)
+            sink.fill_column(x, y1, y2, level);
+    }
+
+    // 每根柱子 4 列宽，后面的柱子叠在前面的上面，每列取覆盖它的最高一根
+    template <typename Fill>
+    void drawWideBars(Fill fill)
+    {
+        int window[4] = {};
+        for (int x = 0; x < screenWidth; ++x)
         {
-            interpolatedData[i] = currentFFTData[i] + (targetFFTData[i] - currentFFTData[i]) * easedProgress;
+            window[x % 4] = heightAt(interpolatedData, x * fftSize / screenWidth);
+            int barHeight = window[0];
+            for (int k = 1; k < 4; ++k)
+                barHeight = window[k] > barHeight ? window[k] : barHeight;
+            if (barHeight > 0)
+                fill(x, barHeight);
         }
     }
+
     // 绘制柱状图
-    void drawBarSpectrum(const float *data)
+    void drawBarSpectrum()
     {
-        for (int i = 0; i < screenWidth; ++i)
-        {
-            int x = i * fftSize / screenWidth;
-            float scaledHeight = (data[x] * FFT_FACTOR);
-            int barHeight = static_cast<int>(scaledHeight);
-            for (int xPos = i; xPos < i + 4; ++xPos)
-            {
-                for (int y = 0; y < barHeight; ++y)
-                {
-                    drawPointCallback(xPos, screenHeight - y - 1, 1);
-                    if (y > screenHeight)
-                        break;
-                }
-            }
-        }
+        drawWideBars([this](int x, int barHeight)
+                     { fillColumn(x, screenHeight - barHeight, screenHeight - 1, 1); });
     }
 
-    // 绘制折线图
-    void drawLineSpectrum(const float *data)
+    // 绘制折线图，相邻两点之间竖直相连
+    void drawLineSpectrum()
     {
-        for (int i = 0; i < screenWidth - 1; ++i)
+        int last = -1;
+        for (int x = 0; x < screenWidth; ++x)
         {
-            int x1 = i * (fftSize - 40) / screenWidth + 40;
-            int x2 = (i + 1) * (fftSize - 40) / screenWidth + 40;
-            float scaledY1 = (data[x1] * FFT_FACTOR);
-            float scaledY2 = (data[x2] * FFT_FACTOR);
-            int y1 = static_cast<int>(scaledY1);
-            int y2 = static_cast<int>(scaledY2);
-
-            if (x2 - x1 == 0)
-            {
-                continue;
-            }
-            for (int x = i; x <= i + 1; ++x)
-            {
-                int y = y1 + (y2 - y1) * (x - i) / (1);
-                drawPointCallback(x, screenHeight - y - 1, 1);
-                if (y > screenHeight)
-                    break;
-            }
+            int y = screenHeight - 1 - heightAt(interpolatedData, x * (fftSize - 40) / screenWidth + 40);
+            if (y < 0)
+                y = 0;
+            if (last < 0 || last == y)
+                fillColumn(x, y, y, 1);
+            else if (last < y)
+                fillColumn(x, last + 1, y, 1);
+            else
+                fillColumn(x, y, last - 1, 1);
+            last = y;
         }
     }
 
     // 绘制点状图
-    // 原函数已经是这种形式，无需修改
-    void drawDotSpectrum(const float *data)
+    void drawDotSpectrum()
     {
-        for (int i = 0; i < screenWidth; ++i)
+        for (int x = 0; x < screenWidth; ++x)
         {
-            int x = i * (fftSize - 40) / screenWidth + 40;
-            int y = static_cast<int>(data[x] * FFT_FACTOR);
-
-            if (y > (screenHeight - 1))
+            int y = heightAt(interpolatedData, x * (fftSize - 40) / screenWidth + 40);
+            if (y > screenHeight - 1)
                 y = screenHeight - 1;
-            if (y < 1)
-                y = 0;
             int startY = (screenHeight - y) / 2;
-
-            for (int j = startY; j < startY + y; j++)
-            {
-                drawPointCallback(i, j, 1);
-                if (j > screenHeight)
-                    break;
-            }
+            fillColumn(x, startY, startY + y - 1, 1);
         }
     }
 
     // 绘制多边形图
-    void drawPolygonSpectrum(const float *data)
+    void drawPolygonSpectrum()
     {
-        for (int i = 0; i < screenWidth - 1; ++i)
-        {
-            int x1 = i * fftSize / screenWidth;
-            int x2 = (i + 1) * fftSize / screenWidth;
-            float scaledY1 = (data[x1] * FFT_FACTOR);
-            float scaledY2 = (data[x2] * FFT_FACTOR);
-            int y1 = static_cast<int>(scaledY1);
-            int y2 = static_cast<int>(scaledY2);
-
-            if (x2 - x1 == 0)
-            {
-                continue;
-            }
-
-            for (int x = i; x <= i + 1; ++x)
-            {
-                int y = y1 + (y2 - y1) * (x - i) / (1);
-                if (x >= 0 && x < screenWidth && screenHeight - y - 1 >= 0 && screenHeight - y - 1 < screenHeight)
-                {
-                    drawPointCallback(x, y, 1);
-                    if (y > screenHeight)
-                        break;
-                }
-                // 填充多边形内部
-                for (int j = y; j < screenHeight; ++j)
-                {
-                    if (x >= 0 && x < screenWidth && screenHeight - j - 1 >= 0 && screenHeight - j - 1 < screenHeight)
-                    {
-                        drawPointCallback(x, j, 1);
-                    }
-                    if (y > screenHeight)
-                        break;
-                }
-            }
-        }
+        for (int x = 0; x < screenWidth; ++x)
+            fillColumn(x, heightAt(interpolatedData, x * fftSize / screenWidth), screenHeight - 1, 1);
     }
 
     // 绘制垂直居中的柱状图
-    void drawCenteredBarSpectrum(const float *data)
+    void drawCenteredBarSpectrum()
     {
-        for (int i = 0; i < screenWidth; ++i)
-        {
-            int x = i * fftSize / screenWidth;
-            float scaledHeight = (data[x] * FFT_FACTOR);
-            int barHeight = static_cast<int>(scaledHeight);
-            int centerY = screenHeight / 2;
-            int startY = centerY - barHeight / 2;
-            for (int xPos = i; xPos < i + 4; ++xPos)
-            {
-                for (int y = startY; y < startY + barHeight; ++y)
-                {
-                    drawPointCallback(xPos, y, 1);
-                    if (y > screenHeight)
-                        break;
-                }
-            }
-        }
+        drawWideBars([this](int x, int barHeight)
+                     {
+                         int startY = screenHeight / 2 - barHeight / 2;
+                         fillColumn(x, startY, startY + barHeight - 1, 1);
+                     });
     }
 
-    // 绘制渐变柱状图
-    void drawGradientBarSpectrum(const float *data)
+    // 绘制渐变柱状图，亮度随柱高变化
+    void drawGradientBarSpectrum()
     {
-        for (int i = 0; i < screenWidth; ++i)
-        {
-            int x = i * fftSize / screenWidth;
-            float scaledHeight = (data[x] * FFT_FACTOR);
-            int barHeight = static_cast<int>(scaledHeight);
-            for (int xPos = i; xPos < i + 4; ++xPos)
-            {
-                for (int y = 0; y < barHeight; ++y)
-                {
-                    drawPointCallback(xPos, screenHeight - y - 1, barHeight);
-                    if (y > screenHeight)
-                        break;
-                }
-            }
-        }
+        drawWideBars([this](int x, int barHeight)
+                     { fillColumn(x, screenHeight - barHeight, screenHeight - 1, barHeight > 255 ? 255 : barHeight); });
     }
 
 public:
-    SpectrumDisplay(int width, int height) : screenWidth(width), screenHeight(height), currentStyle(STYLE_BAR)
-    {
-    }
-
-    void setDrawPointCallback(DrawPointCallback callback)
+    SpectrumDisplay(Sink &sink, int width, int height) : sink(sink), screenWidth(width), screenHeight(height)
     {
-        drawPointCallback = callback;
     }
 
     void setScreenSize(int width, int height)
     {
         screenWidth = width;
         screenHeight = height;
+        redraw = true;
     }
 
     void setSpectrumStyle(SpectrumStyle style)
@@ -228,61 +182,77 @@ public:
         animationStep = 0;
     }
 
+    SpectrumStyle spectrumStyle() const { return currentStyle; }
+
+    // 下一次 spectrumProcess 重画当前帧，用于屏幕被其他内容覆盖之后
+    void invalidate() { redraw = true; }
+
+    // 还有动画帧或重画未完成
+    bool animating() const { return animationStep < totalAnimationSteps || redraw; }
+
     void inputFFTData(const float *data, int size)
     {
-        if (animationStep < totalAnimationSteps)
-        {
-            calculateInterpolatedData(currentFFTData);
-        }
-        else
-        {
-            std::memcpy(currentFFTData, targetFFTData, fftSize * sizeof(float));
-        }
-        std::memcpy(targetFFTData, data, fftSize * sizeof(float));
+        float eased = easing[animationStep < totalAnimationSteps ? animationStep : totalAnimationSteps];
+        calculateInterpolatedData(currentFFTData, eased);
+        if (size > fftSize)
+            size = fftSize;
+        for (int i = 0; i < size; ++i)
+            deltaFFTData[i] = data[i] - currentFFTData[i];
+        for (int i = size; i < fftSize; ++i)
+            deltaFFTData[i] = -currentFFTData[i];
         animationStep = 0;
     }
 
-    void spectrumProcess(void)
+    /**
+     * 画出动画的下一帧，每 SPECTRUM_STYLE_MS 毫秒切换一种风格
+     *
+     * @param now_ms 当前时间
+     * @return 没有新的帧时返回 false，屏幕上的内容保持不变
+     */
+    bool spectrumProcess(int64_t now_ms)
     {
-        static int64_t start_time = esp_timer_get_time() / 1000;
-        int64_t current_time = esp_timer_get_time() / 1000;
-
-        int64_t elapsed_time = current_time - start_time;
-
-        if (elapsed_time >= 5000)
+        if (styleStart < 0)
+            styleStart = now_ms;
+        if (now_ms - styleStart >= SPECTRUM_STYLE_MS)
         {
-            start_time = current_time;
+            styleStart = now_ms;
             currentStyle = (SpectrumStyle)((currentStyle + 1) % STYLE_MAX);
+            redraw = true;
         }
 
+        if (!animating())
+            return false;
         if (animationStep < totalAnimationSteps)
+            calculateInterpolatedData(interpolatedData, easing[animationStep++]);
+        else
+            calculateInterpolatedData(interpolatedData, easing[totalAnimationSteps]);
+        redraw = false;
+
+        sink.clear();
+        switch (currentStyle)
         {
-            calculateInterpolatedData(interpolatedData);
-            // switch (currentStyle)
-            // {
-            // case STYLE_BAR:
-            //    drawBarSpectrum(interpolatedData);
-            //     break;
-            // case STYLE_LINE:
-                 drawLineSpectrum(interpolatedData);
-            //     break;
-            // case STYLE_DOT:
-            //    drawDotSpectrum(interpolatedData);
-            //     break;
-            // case STYLE_POLYGON:
-            //     drawPolygonSpectrum(interpolatedData);
-            //     break;
-            // case STYLE_CENTERED_BAR:
-            //     drawCenteredBarSpectrum(interpolatedData);
-            //     break;
-            // case STYLE_GRADIENT_BAR:
-            //     drawGradientBarSpectrum(interpolatedData);
-            //     break;
-            // default:
-            //     break;
-            // }
-            animationStep++;
+        case STYLE_BAR:
+            drawBarSpectrum();
+            break;
+        case STYLE_LINE:
+            drawLineSpectrum();
+            break;
+        case STYLE_DOT:
+            drawDotSpectrum();
+            break;
+        case STYLE_POLYGON:
+            drawPolygonSpectrum();
+            break;
+        case STYLE_CENTERED_BAR:
+            drawCenteredBarSpectrum();
+            break;
+        case STYLE_GRADIENT_BAR:
+            drawGradientBarSpectrum();
+            break;
+        default:
+            break;
         }
+        return true;
     }
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,680 @@
+/**
+ * @file vfd_engine.h
+ * @brief Rendering engine shared by the VFD drivers of this board.
+ *
+ * A driver describes its panel with a descriptor of constexpr members and derives from
+ * VfdEngine<Driver, Panel>. The engine keeps the character cells and their transitions,
+ * notifications, scrolling text, symbols, level meters and the refresh task, the driver only
+ * looks up glyphs or segment codes and writes its controller.
+ *
+ * Descriptor members:
+ * - controller: VFD_CONTROLLER_PT6302 keeps transition frames in CGRAM slots, the others
+ *   write the frames straight to the cells
+ * - cells: character cells of the text line
+ * - glyph_width: columns of a dot-matrix cell, 0 when the cells are segment digits
+ * - cgram_slots: CGRAM slots the PT6302 panels lend to transitions and to characters beyond ASCII
+ * - digits: segment digits next to dot-matrix cells
+ * - rows: rows of scrolling text, cells / rows cells each
+ * - frame_ms: frame period while driver animations such as spectra run
+ * and the ones only needed by the features a driver uses:
+ * - steps: segments revealed at each step of a transition, one 0 terminated row per NumAni
+ * - scroll_ms, scroll_enter, scroll_move: scrolling period and transitions
+ * - symbols: byte and bit of every symbol in the RAM returned by symbol_ram()
+ *
+ * Text on dot-matrix cells is UTF-8, the characters beyond ASCII are drawn from vfd_font.h and on
+ * PT6302 panels take a CGRAM slot from a VfdGlyphCache. Segment digits take the bytes as they are.
+ *
+ * Driver hooks, resolved at compile time and declared private with the engine as friend:
+ * - const uint8_t *glyph_of(char), void show_glyph(int, const uint8_t *): dot-matrix cells, ASCII only
+ * - void show_char(int, char), void show_cgram(int, int, const uint8_t *): PT6302 cells
+ * - uint32_t segments_of(char), void show_segments(int, uint32_t), void show_digit(int, uint32_t)
+ * - uint8_t *symbol_ram()
+ * - void frame(), bool moving(), void flush(), void notification_done(): while moving() the task runs
+ *   every frame_ms, stretched by the FrameGovernor when the device is idle
+ * - blink_symbols: the symbols time_blink() toggles, they stay off while a notification is shown
+ *
+ * The cells and rows are shared with the refresh task under a mutex, so the show functions may be
+ * called from any task. The hooks called by the task under it, notification_done() and the show_*
+ * ones, must not call them back.
+ */
+
+#ifndef _VFD_ENGINE_H_
+#define _VFD_ENGINE_H_
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include "frame_governor.h"
+#include "vfd_font.h"
+#include "vfd_glyph_cache.h"
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+
+#define VFD_STEP_MS 30         // Period of the transition steps
+#define VFD_IDLE_PERIOD_MS 500 // Longest sleep of the refresh task
+#define VFD_SCROLL_SIZE 256    // Characters kept of a scrolling text
+#define VFD_MAX_STEPS 8        // Longest segment transition
+
+typedef enum
+{
+    VFD_CONTROLLER_PT6302, // Dot-matrix cells drawn from DCRAM, frames go through CGRAM
+    VFD_CONTROLLER_PT6324, // Segment cells in a display RAM
+    VFD_CONTROLLER_PANEL,  // Panels with their own controller, frames are sent as columns
+} VfdController;
+
+typedef struct
+{
+    int byteIndex; // Byte index
+    int bitMask;   // Bit mask
+} VfdSymbol;
+
+/**
+ * @brief Transitions of the cells, a base of its own so that Driver::UP2DOWN keeps working.
+ */
+class VfdAnimations
+{
+public:
+    typedef enum
+    {
+        NONE = -1,
+        CLOCKWISE,
+        ANTICLOCKWISE,
+        UP2DOWN,
+        DOWN2UP,
+        LEFT2RT,
+        RT2LEFT,
+        MAX
+    } NumAni;
+};
+
+// Segments of a seven segment digit revealed at each step, shared by the panels that have them
+inline constexpr uint32_t vfd_seven_segment_steps[VfdAnimations::MAX][VFD_MAX_STEPS + 1] = {
+    {0x01, 0x03, 0x43, 0x47, 0x4f, 0x5f}, // CLOCKWISE
+    {0x01, 0x21, 0x61, 0x71, 0x79, 0x7d}, // ANTICLOCKWISE
+    {0x01, 0x21, 0x73},                   // UP2DOWN
+    {0x08, 0x0c, 0x5e},                   // DOWN2UP
+    {0x10, 0x18, 0x7c},                   // LEFT2RT
+    {0x04, 0x0c, 0x5e},                   // RT2LEFT
+};
+
+// One symbol per byte, for panels whose controller takes a flag per icon
+template <size_t Count>
+constexpr std::array<VfdSymbol, Count> vfd_symbol_bytes()
+{
+    std::array<VfdSymbol, Count> symbols = {};
+    for (size_t i = 0; i < Count; i++)
+        symbols[i] = {(int)i, 1};
+    return symbols;
+}
+
+template <typename Driver, typename Panel>
+class VfdEngine : public VfdAnimations
+{
+    static_assert(Panel::glyph_width == 0 || Panel::glyph_width == VFD_FONT_WIDTH, "vfd_font.h draws 5 column glyphs");
+
+public:
+    VfdEngine()
+    {
+        for (int i = 0; i < cell_count; i++)
+            cells_[i].slot = -1;
+    }
+
+    /**
+     * @brief Shows characters on the text cells.
+     *
+     * The characters become the content of the cells, which a notification covers until it times out.
+     *
+     * @param start The first cell.
+     * @param buf The characters.
+     * @param size The number of characters.
+     * @param forceupdate Rewrites the cells even when the characters did not change.
+     * @param ani The transition to the new characters.
+     */
+    void content_show(int start, const char *buf, int size, bool forceupdate = false, NumAni ani = LEFT2RT)
+    {
+        uint16_t codes[cell_count];
+        int count = decode(buf, buf + size, codes, cell_count, utf8);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            set_cells(content_, Panel::cells, start, codes, count, forceupdate, ani);
+            if (inhibit_until_ == 0)
+                set_cells(cells_, Panel::cells, start, codes, count, forceupdate, ani);
+        }
+        wake();
+    }
+
+    /**
+     * @brief Shows characters over the content for a while, the other cells are blanked.
+     *
+     * @param timeout How long the notification stays, in milliseconds.
+     */
+    void noti_show(int start, const char *buf, int size, bool forceupdate = false, NumAni ani = LEFT2RT, int timeout = 2000)
+    {
+        uint16_t codes[cell_count];
+        int count = decode(buf, buf + size, codes, cell_count, utf8);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            inhibit_until_ = esp_timer_get_time() / 1000 + timeout;
+            for (int i = 0; i < Panel::cells; i++)
+                set_cell(cells_[i], ' ', forceupdate, ani);
+            set_cells(cells_, Panel::cells, start, codes, count, forceupdate, ani);
+        }
+        wake();
+    }
+
+    /**
+     * @brief Shows a text over the content for a while, scrolling it when it does not fit the first row.
+     */
+    void noti_show(const char *str, int timeout)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            inhibit_until_ = esp_timer_get_time() / 1000 + timeout;
+            set_row(0, str, true);
+        }
+        wake();
+    }
+
+    bool noti_busy() { return inhibit_until_ != 0; }
+
+    /**
+     * @brief Keeps a text on a row, scrolling it when it does not fit.
+     */
+    void row_show(int row, const char *str)
+    {
+        if (row < 0 || row >= Panel::rows)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            set_row(row, str, false);
+        }
+        wake();
+    }
+
+    // Shows characters on the segment digits
+    void digit_show(int start, const char *buf, int size, bool forceupdate = false, NumAni ani = ANTICLOCKWISE)
+    {
+        uint16_t codes[digit_count];
+        int count = decode(buf, buf + size, codes, digit_count, false);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            set_cells(digits_, Panel::digits, start, codes, count, forceupdate, ani);
+        }
+        wake();
+    }
+
+    void set_symbol(int symbol, bool on)
+    {
+        if (symbol < 0 || symbol >= (int)std::size(Panel::symbols))
+            return;
+        const VfdSymbol &position = Panel::symbols[symbol];
+        uint8_t *ram = driver()->symbol_ram();
+        if (on)
+            ram[position.byteIndex] |= position.bitMask;
+        else
+            ram[position.byteIndex] &= ~position.bitMask;
+        wake();
+    }
+
+    // Lights symbols[i] while the level is above thresholds[i]
+    template <typename Symbol, size_t Count>
+    void meter(const Symbol (&symbols)[Count], const int (&thresholds)[Count], int level)
+    {
+        for (size_t i = 0; i < Count; i++)
+            set_symbol(symbols[i], level > thresholds[i]);
+    }
+
+    void time_blink()
+    {
+        blink_ = !blink_;
+        for (auto symbol : Driver::blink_symbols)
+            set_symbol(symbol, blink_ && inhibit_until_ == 0);
+    }
+
+    // Lets the refresh task run now, it picks up the changes made by any writer
+    void wake()
+    {
+        TaskHandle_t task = task_;
+        if (task != nullptr && task != xTaskGetCurrentTaskHandle())
+            xTaskNotifyGive(task);
+    }
+
+protected:
+    // Mean of buf[from, to), every stride-th value
+    static float band_mean(const float *buf, int from, int to, int stride = 1)
+    {
+        float sum = 0;
+        int count = 0;
+        for (int i = from; i < to; i += stride, count++)
+            sum += buf[i];
+        return count ? sum / count : 0;
+    }
+
+    static float band_peak(const float *buf, int from, int to)
+    {
+        float peak = 0;
+        for (int i = from; i < to; i++)
+            peak = buf[i] > peak ? buf[i] : peak;
+        return peak;
+    }
+
+    void start(const char *name = "vfd", uint32_t stack = 4096 - 1024)
+    {
+        xTaskCreate(&VfdEngine::task, name, stack, this, 6, nullptr);
+        // The task sleeps by the frame rate it saw last, a faster one takes effect at once
+        FrameGovernor::GetInstance().Subscribe([this]()
+                                               { wake(); });
+    }
+
+    // Redraws every cell, for instance after the font changed
+    void redraw()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int i = 0; i < Panel::cells; i++)
+                cells_[i].need_update = true;
+        }
+        wake();
+    }
+
+    // Hooks the driver may hide
+    void frame() {}
+    bool moving() { return false; }
+    void notification_done() {}
+
+private:
+    typedef struct
+    {
+        uint16_t current; // Code point on dot-matrix cells, byte on segment digits
+        uint16_t last;
+        int8_t step;
+        int8_t slot; // CGRAM slot holding the glyph or the frames, -1 when none
+        bool frames; // The slot holds the frames of a transition
+        NumAni type;
+        bool need_update;
+    } Cell;
+
+    typedef struct
+    {
+        uint16_t text[VFD_SCROLL_SIZE];
+        int length;
+        int start;
+        bool notification; // Cleared when the notification times out
+    } Row;
+
+    static constexpr int row_count = Panel::rows > 0 ? Panel::rows : 1;
+    static constexpr int cell_count = Panel::cells > 0 ? Panel::cells : 1;
+    static constexpr int digit_count = Panel::digits > 0 ? Panel::digits : 1;
+    static constexpr int slot_count = Panel::cgram_slots > 0 ? Panel::cgram_slots : 1;
+    static constexpr bool utf8 = Panel::glyph_width > 0;
+
+    Cell cells_[cell_count] = {};   // What the cells show
+    Cell content_[cell_count] = {}; // What they show once no notification covers them
+    Cell digits_[digit_count] = {};
+    Row rows_[row_count] = {};
+    VfdGlyphCache<slot_count> cache_;
+    int framing_ = 0;     // Slots holding transition frames
+    bool starved_ = false; // A cell found no free slot and shows a placeholder
+    int64_t inhibit_until_ = 0;
+    int64_t last_step_ = 0;
+    int64_t last_scroll_ = 0;
+    bool blink_ = true;
+    volatile TaskHandle_t task_ = nullptr;
+    std::mutex mutex_; // Held by the writers and by the task while it reads the cells and rows
+
+    Driver *driver() { return static_cast<Driver *>(this); }
+
+    // Characters of a text, at most capacity of them
+    static int decode(const char *text, const char *end, uint16_t *codes, int capacity, bool utf8)
+    {
+        int count = 0;
+        while (text < end && count < capacity)
+            codes[count++] = utf8 ? vfd_utf8_next(text, end) : (uint8_t)*text++;
+        return count;
+    }
+
+    static void set_cell(Cell &cell, uint16_t code, bool forceupdate, NumAni ani)
+    {
+        cell.type = ani;
+        cell.current = code;
+        if (forceupdate)
+            cell.need_update = true;
+    }
+
+    static void set_cells(Cell *cells, int count, int start, const uint16_t *codes, int size, bool forceupdate, NumAni ani)
+    {
+        for (int i = 0; i < size && start + i < count; i++)
+        {
+            if (start + i >= 0)
+                set_cell(cells[start + i], codes[i], forceupdate, ani);
+        }
+    }
+
+    void set_row(int row, const char *str, bool notification)
+    {
+        constexpr int width = Panel::cells / row_count;
+        const char *end = str + strlen(str);
+        // Only the end of a long text is kept
+        int skip = -VFD_SCROLL_SIZE;
+        for (const char *p = str; p < end; p++)
+            skip += !utf8 || ((uint8_t)*p & 0xc0) != 0x80;
+        for (; skip > 0 && str < end; skip--)
+        {
+            if (utf8)
+                vfd_utf8_next(str, end);
+            else
+                str++;
+        }
+        Row &r = rows_[row];
+        memset(r.text, 0, sizeof r.text);
+        int length = decode(str, end, r.text, VFD_SCROLL_SIZE, utf8);
+        // A scrolling text gets two blanks before it starts over
+        if (length > width && length + 2 <= VFD_SCROLL_SIZE)
+        {
+            r.text[length++] = ' ';
+            r.text[length++] = ' ';
+        }
+        r.start = 0;
+        r.notification = notification;
+        r.length = length;
+    }
+
+    // Puts the visible part of every row on its cells and moves the rows that do not fit
+    void scroll()
+    {
+        constexpr int width = Panel::cells / row_count;
+        for (int row = 0; row < Panel::rows; row++)
+        {
+            Row &r = rows_[row];
+            if (r.length == 0)
+                continue;
+            uint16_t display[width];
+            bool moving = r.length > width;
+            for (int i = 0; i < width; i++)
+                display[i] = moving ? r.text[(r.start + i) % r.length] : r.text[i];
+            NumAni ani = moving ? Panel::scroll_move : Panel::scroll_enter;
+            if (r.notification || inhibit_until_ == 0)
+                set_cells(cells_, Panel::cells, row * width, display, width, moving, ani);
+            if (!r.notification)
+                set_cells(content_, Panel::cells, row * width, display, width, moving, ani);
+            if (moving)
+                r.start = (r.start + 1) % r.length;
+        }
+    }
+
+    // Brings the content back once the notification timed out
+    void expire(int64_t now)
+    {
+        if (inhibit_until_ == 0 || now <= inhibit_until_)
+            return;
+        for (int i = 0; i < Panel::cells; i++)
+        {
+            Cell &cell = cells_[i];
+            cell.last = cell.current;
+            cell.type = content_[i].type;
+            cell.current = content_[i].current;
+            cell.need_update = true;
+        }
+        for (int row = 0; row < Panel::rows; row++)
+        {
+            if (rows_[row].notification)
+                rows_[row].length = 0;
+        }
+        inhibit_until_ = 0;
+        driver()->notification_done();
+    }
+
+    static bool changing(const Cell &cell) { return cell.current != cell.last || cell.need_update; }
+
+    // Takes a CGRAM slot for the frames of a PT6302 cell
+    bool take_frames(Cell &cell)
+    {
+        if (cell.frames)
+            return true;
+        int slot = cache_.acquire(0);
+        if (slot < 0)
+            return false;
+        release_slot(cell);
+        cell.slot = slot;
+        cell.frames = true;
+        framing_++;
+        return true;
+    }
+
+    void release_slot(Cell &cell)
+    {
+        if (cell.slot < 0)
+            return;
+        cache_.release(cell.slot);
+        if (cell.frames)
+            framing_--;
+        cell.slot = -1;
+        cell.frames = false;
+        if (!starved_)
+            return;
+        // The cells left with a placeholder try again
+        starved_ = false;
+        for (int i = 0; i < Panel::cells; i++)
+        {
+            if (cells_[i].current >= 0x80 && cells_[i].slot < 0)
+                cells_[i].need_update = true;
+        }
+    }
+
+    // Shows a PT6302 cell from the character ROM, or from a CGRAM slot beyond ASCII
+    void show_pt6302(int index, Cell &cell)
+    {
+        uint16_t code = cell.current;
+        if (code < 0x80)
+        {
+            release_slot(cell);
+            driver()->show_char(index, code);
+            return;
+        }
+        // Acquired before the old slot is released so that a glyph kept on the cell keeps its slot
+        int slot = cache_.acquire(code);
+        release_slot(cell);
+        if (slot < 0)
+            slot = cache_.acquire(code);
+        if (slot < 0)
+        {
+            starved_ = true;
+            driver()->show_char(index, '?');
+            return;
+        }
+        cell.slot = slot;
+        uint8_t columns[Panel::glyph_width];
+        driver()->show_cgram(index, slot, glyph(code, columns));
+    }
+
+    // Columns of a character, from the driver's font for ASCII and from vfd_font.h beyond
+    const uint8_t *glyph(uint16_t code, uint8_t *columns)
+    {
+        if (code < 0x80)
+            return driver()->glyph_of(code);
+        vfd_font_render(code, columns);
+        return columns;
+    }
+
+    // Frames of a transition between two glyphs, the last one is the new glyph itself
+    static int glyph_frames(NumAni type)
+    {
+        switch (type)
+        {
+        case UP2DOWN:
+        case DOWN2UP:
+            return 7;
+        case LEFT2RT:
+        case RT2LEFT:
+            return Panel::glyph_width - 1;
+        default:
+            return 0;
+        }
+    }
+
+    static void glyph_frame(NumAni type, int s, const uint8_t *before, const uint8_t *after, uint8_t *frame)
+    {
+        constexpr int w = Panel::glyph_width;
+        for (int j = 0; j < w; j++)
+        {
+            switch (type)
+            {
+            case UP2DOWN:
+                frame[j] = (before[j] << s) | (after[j] >> (8 - s));
+                break;
+            case DOWN2UP:
+                frame[j] = (before[j] >> s) | (after[j] << (8 - s));
+                break;
+            case LEFT2RT:
+                frame[j] = j < w - s ? before[j + s] : after[j - (w - s)];
+                break;
+            default:
+                frame[j] = j >= s ? before[j - s] : after[j + w - s];
+                break;
+            }
+        }
+    }
+
+    void step_glyphs()
+    {
+        constexpr int w = Panel::glyph_width;
+        for (int i = 0; i < Panel::cells; i++)
+        {
+            Cell &cell = cells_[i];
+            if (!changing(cell))
+                continue;
+            int frames = cell.current == cell.last ? 0 : glyph_frames(cell.type);
+            if constexpr (Panel::controller == VFD_CONTROLLER_PT6302)
+            {
+                if (frames > cell.step && !take_frames(cell))
+                {
+                    // The cells wait in order while transitions hold the slots, the glyphs on screen hold them for good
+                    if (framing_ > 0)
+                        return;
+                    frames = 0;
+                }
+            }
+            if (cell.step >= frames)
+            {
+                cell.need_update = false;
+                cell.last = cell.current;
+                cell.step = 0;
+                if constexpr (Panel::controller == VFD_CONTROLLER_PT6302)
+                    show_pt6302(i, cell);
+                else
+                {
+                    uint8_t columns[w];
+                    driver()->show_glyph(i, glyph(cell.current, columns));
+                }
+                continue;
+            }
+            cell.step++;
+            uint8_t before[w], after[w], frame[w];
+            glyph_frame(cell.type, cell.step, glyph(cell.last, before), glyph(cell.current, after), frame);
+            if constexpr (Panel::controller == VFD_CONTROLLER_PT6302)
+                driver()->show_cgram(i, cell.slot, frame);
+            else
+                driver()->show_glyph(i, frame);
+        }
+    }
+
+    template <typename Show>
+    void step_segments(Cell *cells, int count, Show show)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            Cell &cell = cells[i];
+            if (!changing(cell))
+                continue;
+            cell.need_update = false;
+            uint32_t before = driver()->segments_of((char)cell.last);
+            uint32_t after = driver()->segments_of((char)cell.current);
+            uint32_t mask = cell.type == NONE || cell.current == cell.last ? 0 : Panel::steps[cell.type][cell.step];
+            if (mask != 0)
+            {
+                show(i, (after & mask) | (before & ~mask));
+                cell.step++;
+            }
+            else
+            {
+                show(i, after);
+                cell.last = cell.current;
+                cell.step = 0;
+            }
+        }
+    }
+
+    void step()
+    {
+        if constexpr (Panel::glyph_width > 0)
+            step_glyphs();
+        else
+            step_segments(cells_, Panel::cells, [this](int i, uint32_t code)
+                          { driver()->show_segments(i, code); });
+        if constexpr (Panel::digits > 0)
+            step_segments(digits_, Panel::digits, [this](int i, uint32_t code)
+                          { driver()->show_digit(i, code); });
+    }
+
+    // Sleeps until the next step, scroll or timeout that is due, or until woken
+    int next_wait()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now = esp_timer_get_time() / 1000;
+        int64_t wait = driver()->moving() ? FrameGovernor::GetInstance().Period(Panel::frame_ms) : VFD_IDLE_PERIOD_MS;
+        bool transition = false;
+        for (int i = 0; i < Panel::cells && !transition; i++)
+            transition = changing(cells_[i]);
+        for (int i = 0; i < Panel::digits && !transition; i++)
+            transition = changing(digits_[i]);
+        if (transition && last_step_ + VFD_STEP_MS - now < wait)
+            wait = last_step_ + VFD_STEP_MS - now;
+        if constexpr (Panel::rows > 0)
+        {
+            for (int row = 0; row < Panel::rows; row++)
+            {
+                if (rows_[row].length > 0 && last_scroll_ + Panel::scroll_ms - now < wait)
+                    wait = last_scroll_ + Panel::scroll_ms - now;
+            }
+        }
+        if (inhibit_until_ != 0 && inhibit_until_ + 1 - now < wait)
+            wait = inhibit_until_ + 1 - now;
+        return wait > 0 ? wait : 0;
+    }
+
+    static void task(void *arg)
+    {
+        VfdEngine *self = static_cast<VfdEngine *>(arg);
+        self->task_ = xTaskGetCurrentTaskHandle();
+        while (true)
+        {
+            int64_t now = esp_timer_get_time() / 1000;
+            self->driver()->frame();
+            {
+                std::lock_guard<std::mutex> lock(self->mutex_);
+                self->expire(now);
+                if constexpr (Panel::rows > 0)
+                {
+                    if (now - self->last_scroll_ >= Panel::scroll_ms)
+                    {
+                        self->last_scroll_ = now;
+                        self->scroll();
+                    }
+                }
+                if (now - self->last_step_ >= VFD_STEP_MS)
+                {
+                    self->last_step_ = now;
+                    self->step();
+                }
+            }
+            self->driver()->flush();
+            TickType_t ticks = pdMS_TO_TICKS(self->next_wait());
+            ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,206 @@
+/**
+ * @file vfd_font.h
+ * @brief 5x7 glyphs of the characters beyond ASCII and the UTF-8 decoding of the VFD text.
+ *
+ * The drivers keep their own ASCII fonts. Other characters are looked up in a sorted table that
+ * packs the code point and the seven rows of a glyph into one 64-bit word, and rendered on demand
+ * into the column bytes the panels take, bit 0 being the top row. Full-width forms and CJK
+ * punctuation map to their ASCII look-alikes.
+ *
+ * CJK ideographs are not supported on the 5x7 character panels: no ideograph is readable in five
+ * by seven dots, so every one of them is shown as the box glyph and Chinese text comes out as a
+ * row of boxes. Only the FORD_VFD dot matrix, 16 dots high, shows Chinese, drawn by LVGL from the
+ * text font of the board.
+ */
+
+#ifndef _VFD_FONT_H_
+#define _VFD_FONT_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+#define VFD_FONT_WIDTH 5
+#define VFD_FONT_HEIGHT 7
+#define VFD_GLYPH_MISSING 0x25A1 // White square, drawn for the characters without a glyph
+
+// Code point in bits 35 and up, then the rows from the top, five bits each with the left column first
+constexpr uint64_t vfd_glyph(uint32_t code, uint8_t r0, uint8_t r1, uint8_t r2, uint8_t r3, uint8_t r4, uint8_t r5, uint8_t r6)
+{
+    uint64_t glyph = code;
+    for (uint8_t row : {r0, r1, r2, r3, r4, r5, r6})
+        glyph = glyph << 5 | (row & 0x1f);
+    return glyph;
+}
+
+inline constexpr uint64_t vfd_font_glyphs[] = {
+    vfd_glyph(0x00A1, 0b00100, 0b00000, 0b00100, 0b00100, 0b00100, 0b00100, 0b00100), // ¡
+    vfd_glyph(0x00AB, 0b00000, 0b00101, 0b01010, 0b10100, 0b01010, 0b00101, 0b00000), // «
+    vfd_glyph(0x00B0, 0b01100, 0b10010, 0b10010, 0b01100, 0b00000, 0b00000, 0b00000), // °
+    vfd_glyph(0x00B1, 0b00100, 0b00100, 0b11111, 0b00100, 0b00100, 0b00000, 0b11111), // ±
+    vfd_glyph(0x00B7, 0b00000, 0b00000, 0b00000, 0b00100, 0b00000, 0b00000, 0b00000), // ·
+    vfd_glyph(0x00BB, 0b00000, 0b10100, 0b01010, 0b00101, 0b01010, 0b10100, 0b00000), // »
+    vfd_glyph(0x00BF, 0b00100, 0b00000, 0b00100, 0b01000, 0b10000, 0b10001, 0b01110), // ¿
+    vfd_glyph(0x00C0, 0b01000, 0b00100, 0b01110, 0b10001, 0b11111, 0b10001, 0b10001), // À
+    vfd_glyph(0x00C1, 0b00010, 0b00100, 0b01110, 0b10001, 0b11111, 0b10001, 0b10001), // Á
+    vfd_glyph(0x00C2, 0b00100, 0b01010, 0b01110, 0b10001, 0b11111, 0b10001, 0b10001), // Â
+    vfd_glyph(0x00C4, 0b01010, 0b00000, 0b01110, 0b10001, 0b11111, 0b10001, 0b10001), // Ä
+    vfd_glyph(0x00C7, 0b01110, 0b10001, 0b10000, 0b10000, 0b10001, 0b01110, 0b00100), // Ç
+    vfd_glyph(0x00C8, 0b01000, 0b00100, 0b11111, 0b10000, 0b11110, 0b10000, 0b11111), // È
+    vfd_glyph(0x00C9, 0b00010, 0b00100, 0b11111, 0b10000, 0b11110, 0b10000, 0b11111), // É
+    vfd_glyph(0x00CA, 0b00100, 0b01010, 0b11111, 0b10000, 0b11110, 0b10000, 0b11111), // Ê
+    vfd_glyph(0x00CB, 0b01010, 0b00000, 0b11111, 0b10000, 0b11110, 0b10000, 0b11111), // Ë
+    vfd_glyph(0x00CC, 0b01000, 0b00100, 0b01110, 0b00100, 0b00100, 0b00100, 0b01110), // Ì
+    vfd_glyph(0x00CD, 0b00010, 0b00100, 0b01110, 0b00100, 0b00100, 0b00100, 0b01110), // Í
+    vfd_glyph(0x00CE, 0b00100, 0b01010, 0b01110, 0b00100, 0b00100, 0b00100, 0b01110), // Î
+    vfd_glyph(0x00CF, 0b01010, 0b00000, 0b01110, 0b00100, 0b00100, 0b00100, 0b01110), // Ï
+    vfd_glyph(0x00D1, 0b01101, 0b10110, 0b10001, 0b11001, 0b10101, 0b10011, 0b10001), // Ñ
+    vfd_glyph(0x00D2, 0b01000, 0b00100, 0b01110, 0b10001, 0b10001, 0b10001, 0b01110), // Ò
+    vfd_glyph(0x00D3, 0b00010, 0b00100, 0b01110, 0b10001, 0b10001, 0b10001, 0b01110), // Ó
+    vfd_glyph(0x00D4, 0b00100, 0b01010, 0b01110, 0b10001, 0b10001, 0b10001, 0b01110), // Ô
+    vfd_glyph(0x00D6, 0b01010, 0b00000, 0b01110, 0b10001, 0b10001, 0b10001, 0b01110), // Ö
+    vfd_glyph(0x00D7, 0b00000, 0b10001, 0b01010, 0b00100, 0b01010, 0b10001, 0b00000), // ×
+    vfd_glyph(0x00D9, 0b01000, 0b00100, 0b10001, 0b10001, 0b10001, 0b10001, 0b01110), // Ù
+    vfd_glyph(0x00DA, 0b00010, 0b00100, 0b10001, 0b10001, 0b10001, 0b10001, 0b01110), // Ú
+    vfd_glyph(0x00DB, 0b00100, 0b01010, 0b10001, 0b10001, 0b10001, 0b10001, 0b01110), // Û
+    vfd_glyph(0x00DC, 0b01010, 0b00000, 0b10001, 0b10001, 0b10001, 0b10001, 0b01110), // Ü
+    vfd_glyph(0x00DF, 0b01110, 0b10001, 0b10010, 0b10100, 0b10010, 0b10001, 0b10110), // ß
+    vfd_glyph(0x00E0, 0b01000, 0b00100, 0b01110, 0b00001, 0b01111, 0b10001, 0b01111), // à
+    vfd_glyph(0x00E1, 0b00010, 0b00100, 0b01110, 0b00001, 0b01111, 0b10001, 0b01111), // á
+    vfd_glyph(0x00E2, 0b00100, 0b01010, 0b01110, 0b00001, 0b01111, 0b10001, 0b01111), // â
+    vfd_glyph(0x00E4, 0b01010, 0b00000, 0b01110, 0b00001, 0b01111, 0b10001, 0b01111), // ä
+    vfd_glyph(0x00E7, 0b00000, 0b01110, 0b10000, 0b10000, 0b10001, 0b01110, 0b00100), // ç
+    vfd_glyph(0x00E8, 0b01000, 0b00100, 0b01110, 0b10001, 0b11111, 0b10000, 0b01110), // è
+    vfd_glyph(0x00E9, 0b00010, 0b00100, 0b01110, 0b10001, 0b11111, 0b10000, 0b01110), // é
+    vfd_glyph(0x00EA, 0b00100, 0b01010, 0b01110, 0b10001, 0b11111, 0b10000, 0b01110), // ê
+    vfd_glyph(0x00EB, 0b01010, 0b00000, 0b01110, 0b10001, 0b11111, 0b10000, 0b01110), // ë
+    vfd_glyph(0x00EC, 0b01000, 0b00100, 0b01100, 0b00100, 0b00100, 0b00100, 0b01110), // ì
+    vfd_glyph(0x00ED, 0b00010, 0b00100, 0b01100, 0b00100, 0b00100, 0b00100, 0b01110), // í
+    vfd_glyph(0x00EE, 0b00100, 0b01010, 0b01100, 0b00100, 0b00100, 0b00100, 0b01110), // î
+    vfd_glyph(0x00EF, 0b01010, 0b00000, 0b01100, 0b00100, 0b00100, 0b00100, 0b01110), // ï
+    vfd_glyph(0x00F1, 0b01101, 0b10110, 0b10110, 0b11001, 0b10001, 0b10001, 0b10001), // ñ
+    vfd_glyph(0x00F2, 0b01000, 0b00100, 0b01110, 0b10001, 0b10001, 0b10001, 0b01110), // ò
+    vfd_glyph(0x00F3, 0b00010, 0b00100, 0b01110, 0b10001, 0b10001, 0b10001, 0b01110), // ó
+    vfd_glyph(0x00F4, 0b00100, 0b01010, 0b01110, 0b10001, 0b10001, 0b10001, 0b01110), // ô
+    vfd_glyph(0x00F6, 0b01010, 0b00000, 0b01110, 0b10001, 0b10001, 0b10001, 0b01110), // ö
+    vfd_glyph(0x00F7, 0b00000, 0b00100, 0b00000, 0b11111, 0b00000, 0b00100, 0b00000), // ÷
+    vfd_glyph(0x00F9, 0b01000, 0b00100, 0b10001, 0b10001, 0b10001, 0b10011, 0b01101), // ù
+    vfd_glyph(0x00FA, 0b00010, 0b00100, 0b10001, 0b10001, 0b10001, 0b10011, 0b01101), // ú
+    vfd_glyph(0x00FB, 0b00100, 0b01010, 0b10001, 0b10001, 0b10001, 0b10011, 0b01101), // û
+    vfd_glyph(0x00FC, 0b01010, 0b00000, 0b10001, 0b10001, 0b10001, 0b10011, 0b01101), // ü
+    vfd_glyph(0x2026, 0b00000, 0b00000, 0b00000, 0b00000, 0b00000, 0b00000, 0b10101), // …
+    vfd_glyph(0x2103, 0b11000, 0b11011, 0b00100, 0b00100, 0b00100, 0b00100, 0b00011), // ℃
+    vfd_glyph(0x2190, 0b00000, 0b00100, 0b01000, 0b11111, 0b01000, 0b00100, 0b00000), // ←
+    vfd_glyph(0x2191, 0b00100, 0b01110, 0b10101, 0b00100, 0b00100, 0b00100, 0b00100), // ↑
+    vfd_glyph(0x2192, 0b00000, 0b00100, 0b00010, 0b11111, 0b00010, 0b00100, 0b00000), // →
+    vfd_glyph(0x2193, 0b00100, 0b00100, 0b00100, 0b00100, 0b10101, 0b01110, 0b00100), // ↓
+    vfd_glyph(0x25A1, 0b00000, 0b11111, 0b10001, 0b10001, 0b10001, 0b11111, 0b00000), // □
+    vfd_glyph(0x266A, 0b00100, 0b00110, 0b00101, 0b00100, 0b01100, 0b11100, 0b11000), // ♪
+    vfd_glyph(0x3002, 0b00000, 0b00000, 0b00000, 0b01100, 0b10010, 0b10010, 0b01100), // 。
+    vfd_glyph(0x300C, 0b11100, 0b10000, 0b10000, 0b10000, 0b00000, 0b00000, 0b00000), // 「
+    vfd_glyph(0x300D, 0b00000, 0b00000, 0b00000, 0b00001, 0b00001, 0b00001, 0b00111), // 」
+};
+
+constexpr bool vfd_font_sorted()
+{
+    for (size_t i = 1; i < std::size(vfd_font_glyphs); i++)
+    {
+        if ((vfd_font_glyphs[i - 1] >> 35) >= (vfd_font_glyphs[i] >> 35))
+            return false;
+    }
+    return true;
+}
+static_assert(vfd_font_sorted(), "vfd_font_glyphs must be sorted by code point");
+
+// The packed glyph of a code point, nullptr if the font has none
+inline const uint64_t *vfd_font_find(uint32_t code)
+{
+    auto it = std::lower_bound(std::begin(vfd_font_glyphs), std::end(vfd_font_glyphs), code,
+                               [](uint64_t glyph, uint32_t code)
+                               { return (glyph >> 35) < code; });
+    return it != std::end(vfd_font_glyphs) && (*it >> 35) == code ? it : nullptr;
+}
+
+/**
+ * @brief Renders the glyph of a code point into VFD_FONT_WIDTH column bytes.
+ *
+ * @return false if the font has no glyph for it, the missing glyph box is rendered instead.
+ */
+inline bool vfd_font_render(uint32_t code, uint8_t *columns)
+{
+    const uint64_t *glyph = vfd_font_find(code);
+    if (glyph == nullptr)
+    {
+        vfd_font_render(VFD_GLYPH_MISSING, columns);
+        return false;
+    }
+    for (int x = 0; x < VFD_FONT_WIDTH; x++)
+    {
+        uint8_t column = 0;
+        for (int y = 0; y < VFD_FONT_HEIGHT; y++)
+            column |= ((*glyph >> ((VFD_FONT_HEIGHT - 1 - y) * 5 + VFD_FONT_WIDTH - 1 - x)) & 1) << y;
+        columns[x] = column;
+    }
+    return true;
+}
+
+// Characters shown with the ASCII glyph they look like, so that they need no CGRAM
+inline uint32_t vfd_font_fold(uint32_t code)
+{
+    if (code >= 0xff01 && code <= 0xff5e) // Full-width forms
+        return code - 0xfee0;
+    switch (code)
+    {
+    case 0x00a0: // No-break space
+    case 0x3000: // Ideographic space
+        return ' ';
+    case 0x3001: // Ideographic comma
+    case 0xff64:
+        return ',';
+    case 0x2010:
+    case 0x2013:
+    case 0x2014:
+    case 0x2212:
+        return '-';
+    case 0x2018:
+    case 0x2019:
+        return '\'';
+    case 0x201c:
+    case 0x201d:
+        return '"';
+    case 0x30fb: // Katakana middle dot
+        return 0x00b7;
+    default:
+        return code;
+    }
+}
+
+/**
+ * @brief Decodes the next character of a UTF-8 text.
+ *
+ * Malformed sequences and the characters the font has no glyph for, CJK ideographs included, come
+ * out as VFD_GLYPH_MISSING, so that they all share one CGRAM slot.
+ *
+ * @param text Moved past the character.
+ * @param end The end of the text.
+ */
+inline uint16_t vfd_utf8_next(const char *&text, const char *end)
+{
+    uint8_t lead = *text++;
+    if (lead < 0x80)
+        return lead;
+    int extra = lead >= 0xf0 ? 3 : lead >= 0xe0 ? 2 : lead >= 0xc0 ? 1 : 0;
+    if (extra == 0)
+        return VFD_GLYPH_MISSING;
+    uint32_t code = lead & (0x3f >> extra);
+    for (int i = 0; i < extra; i++)
+    {
+        if (text == end || ((uint8_t)*text & 0xc0) != 0x80)
+            return VFD_GLYPH_MISSING;
+        code = code << 6 | (*text++ & 0x3f);
+    }
+    code = vfd_font_fold(code);
+    return code < 0x80 || vfd_font_find(code) != nullptr ? code : VFD_GLYPH_MISSING;
+}
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * @file vfd_glyph_cache.h
+ * @brief Assignment of the few free CGRAM characters of a PT6302 to the glyphs on screen.
+ *
+ * A slot holds either the glyph of a code point, shared by every cell showing that character, or
+ * the frames of one cell in transition. Slots are reference counted by the cells using them, a slot
+ * no cell uses keeps its glyph until it is the least recently used one and another glyph needs it.
+ * Since the frame sent last is remembered, a glyph that comes back into a slot still holding it costs
+ * no CGRAM write, and the glyphs loaded in one refresh go out in a single write_cgram.
+ */
+
+#ifndef _VFD_GLYPH_CACHE_H_
+#define _VFD_GLYPH_CACHE_H_
+
+#include <cstdint>
+
+template <int Slots>
+class VfdGlyphCache
+{
+public:
+    /**
+     * @brief Takes a reference to the slot holding a glyph, loading it into the least recently used free slot.
+     *
+     * @param code The code point, 0 for transition frames which are never shared.
+     * @return The slot, or -1 if every slot is in use.
+     */
+    int acquire(uint16_t code)
+    {
+        int victim = -1;
+        for (int i = 0; i < Slots; i++)
+        {
+            Slot &slot = slots_[i];
+            if (code != 0 && slot.code == code)
+            {
+                victim = i;
+                break;
+            }
+            if (slot.refs == 0 && (victim < 0 || slot.used < slots_[victim].used))
+                victim = i;
+        }
+        if (victim < 0)
+            return -1;
+        Slot &slot = slots_[victim];
+        slot.code = code;
+        slot.refs++;
+        slot.used = ++clock_;
+        return victim;
+    }
+
+    // Drops a reference, the glyph stays in the slot until the slot is reused
+    void release(int slot)
+    {
+        if (slot >= 0 && slot < Slots && slots_[slot].refs > 0)
+            slots_[slot].refs--;
+    }
+
+private:
+    typedef struct
+    {
+        uint16_t code; // Glyph in the slot, 0 when empty or holding transition frames
+        uint8_t refs;  // Cells showing the slot
+        uint32_t used; // Clock of the last acquire
+    } Slot;
+
+    Slot slots_[Slots] = {};
+    uint32_t clock_ = 0;
+};
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * @file vfd_refresh.h
+ * @brief Dirty tracking of the VFD frames.
+ *
+ * A driver keeps its frame in a RAM buffer that the refresh task of VfdEngine sends to the
+ * controller over SPI. VfdRefresh remembers what was sent last, so the task writes only the
+ * bytes that changed, or nothing at all.
+ */
+
+#ifndef _VFD_REFRESH_H_
+#define _VFD_REFRESH_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+template <size_t Size>
+class VfdRefresh
+{
+public:
+    /**
+     * @brief Finds the bytes that differ from the frame sent last and records them as sent.
+     *
+     * @param gram The frame about to be sent.
+     * @param first Set to the first changed byte.
+     * @param last Set to the last changed byte.
+     * @return false if nothing changed and the frame does not need to be sent.
+     */
+    bool take(const uint8_t *gram, int *first, int *last)
+    {
+        int begin = 0;
+        int end = Size - 1;
+        if (synced_.exchange(true))
+        {
+            while (begin < (int)Size && gram[begin] == sent_[begin])
+                begin++;
+            if (begin == (int)Size)
+                return false;
+            while (gram[end] == sent_[end])
+                end--;
+        }
+        memcpy(sent_ + begin, gram + begin, end - begin + 1);
+        *first = begin;
+        *last = end;
+        return true;
+    }
+
+    // Sends the whole frame next time, for settings written along with it such as the brightness
+    void invalidate() { synced_ = false; }
+
+private:
+    uint8_t sent_[Size] = {0};
+    std::atomic<bool> synced_ = false;
+};
+
+#endif
@@ -270,7 +270,15 @@ public:
         sdcard->Write("/sdcard/log.txt", logMessage.c_str());
         ESP_LOGI(TAG, "%s", logMessage.c_str());
 
-        DisplayLockGuard lock(this);
+        // The bubble is drawn by ApplyChatMessage on the LVGL task
+        QspiLcdDisplay::SetChatMessage(role, content);
+    }
+
+    // Called with the display locked, in the order the messages were set
+    virtual void ApplyChatMessage(const char *role, const char *content) override
+    {
+        if (content_ == nullptr || *content == '\0')
+            return;
         if (labelContainer.size() >= 10)
         {
             RemoveOldestLabel(); // 当 label 数量达到 10 时移除最早的
@@ -0,0 +1,104 @@
+#include "boot_profiler.h"
+#include "event_trace.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <cstring>
+#include <algorithm>
+
+#define TAG "BootProfiler"
+
+#define BOOT_PROFILER_BAR_WIDTH 40
+
+int BootProfiler::Begin(const char* name, uint32_t budget_ms) {
+    int64_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (phase_count_ >= BOOT_PROFILER_MAX_PHASES) {
+        return -1;
+    }
+    auto& phase = phases_[phase_count_];
+    phase.name = name;
+    phase.start_us = now;
+    phase.end_us = 0;
+    phase.budget_ms = budget_ms;
+    strncpy(phase.task, pcTaskGetName(nullptr), sizeof(phase.task) - 1);
+    phase.task[sizeof(phase.task) - 1] = '\0';
+#if CONFIG_USE_EVENT_TRACE
+    phase.trace_id = EventTrace::GetInstance().Intern(name);
+    EventTrace::GetInstance().Record(kTraceEventBegin, phase.trace_id);
+#endif
+    return phase_count_++;
+}
+
+void BootProfiler::End(int index) {
+    int64_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index < 0 || index >= phase_count_) {
+        return;
+    }
+    auto& phase = phases_[index];
+    phase.end_us = now;
+#if CONFIG_USE_EVENT_TRACE
+    EventTrace::GetInstance().Record(kTraceEventEnd, phase.trace_id);
+#endif
+    uint32_t duration_ms = (phase.end_us - phase.start_us) / 1000;
+    if (phase.budget_ms > 0 && duration_ms > phase.budget_ms) {
+        ESP_LOGW(TAG, "%s took %lu ms, budget %lu ms", phase.name, (unsigned long)duration_ms, (unsigned long)phase.budget_ms);
+    }
+}
+
+bool BootProfiler::Report(uint32_t total_budget_ms) {
+    int64_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Phase* sorted[BOOT_PROFILER_MAX_PHASES];
+    for (int i = 0; i < phase_count_; i++) {
+        sorted[i] = &phases_[i];
+    }
+    std::stable_sort(sorted, sorted + phase_count_, [](const Phase* a, const Phase* b) {
+        return a->start_us < b->start_us;
+    });
+
+    // esp_timer starts counting before app_main, so the timeline begins at 0 like the log timestamps
+    uint32_t ready_ms = now / 1000;
+    bool within_budget = total_budget_ms == 0 || ready_ms <= total_budget_ms;
+    ESP_LOGI(TAG, "Ready at %lu ms, budget %lu ms", (unsigned long)ready_ms, (unsigned long)total_budget_ms);
+    ESP_LOGI(TAG, "%-16s %-14s %7s %7s %7s", "phase", "task", "start", "ms", "budget");
+    for (int i = 0; i < phase_count_; i++) {
+        auto phase = sorted[i];
+        int64_t end_us = phase->end_us != 0 ? phase->end_us : now;
+        uint32_t start_ms = phase->start_us / 1000;
+        uint32_t duration_ms = (end_us - phase->start_us) / 1000;
+        bool over = phase->budget_ms > 0 && duration_ms > phase->budget_ms;
+        within_budget = within_budget && !over;
+
+        char bar[BOOT_PROFILER_BAR_WIDTH + 1];
+        int first = ready_ms > 0 ? (int64_t)start_ms * BOOT_PROFILER_BAR_WIDTH / ready_ms : 0;
+        int last = ready_ms > 0 ? (int64_t)(end_us / 1000) * BOOT_PROFILER_BAR_WIDTH / ready_ms : 0;
+        first = std::min(first, BOOT_PROFILER_BAR_WIDTH - 1);
+        last = std::max(first, std::min(last, BOOT_PROFILER_BAR_WIDTH - 1));
+        for (int j = 0; j < BOOT_PROFILER_BAR_WIDTH; j++) {
+            bar[j] = j >= first && j <= last ? '#' : '.';
+        }
+        bar[BOOT_PROFILER_BAR_WIDTH] = '\0';
+
+        char budget[12] = "-";
+        if (phase->budget_ms > 0) {
+            snprintf(budget, sizeof(budget), "%lu", (unsigned long)phase->budget_ms);
+        }
+        if (over) {
+            ESP_LOGW(TAG, "%-16s %-14s %7lu %7lu %7s |%s| over budget", phase->name, phase->task,
+                (unsigned long)start_ms, (unsigned long)duration_ms, budget, bar);
+        } else {
+            ESP_LOGI(TAG, "%-16s %-14s %7lu %7lu %7s |%s|%s", phase->name, phase->task,
+                (unsigned long)start_ms, (unsigned long)duration_ms, budget, bar, phase->end_us == 0 ? " running" : "");
+        }
+    }
+    if (total_budget_ms > 0 && ready_ms > total_budget_ms) {
+        ESP_LOGW(TAG, "Boot took %lu ms, budget %lu ms", (unsigned long)ready_ms, (unsigned long)total_budget_ms);
+    }
+    return within_budget;
+}
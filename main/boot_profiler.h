@@ -0,0 +1,84 @@
+#ifndef _BOOT_PROFILER_H_
+#define _BOOT_PROFILER_H_
+
+#include <cstdint>
+#include <mutex>
+
+/*
+ * Boot phase timeline.
+ *
+ * Phases may overlap and run on different tasks, each one is timed with
+ * esp_timer_get_time() and checked against its own budget. Report() prints the
+ * timeline once the device is ready and warns about every phase over budget.
+ *
+ * Usage:
+ *   BOOT_PHASE("board_init", 1500);          // Scope, budget in ms (0 for none)
+ *   int phase = BOOT_PHASE_BEGIN("network", 8000); ... BOOT_PHASE_END(phase);
+ *
+ * Phase names must be string literals. With CONFIG_USE_EVENT_TRACE the phases
+ * also show up in the event trace.
+ */
+
+#define BOOT_PROFILER_MAX_PHASES 32
+
+class BootProfiler {
+public:
+    static BootProfiler& GetInstance() {
+        static BootProfiler instance;
+        return instance;
+    }
+    // 删除拷贝构造函数和赋值运算符
+    BootProfiler(const BootProfiler&) = delete;
+    BootProfiler& operator=(const BootProfiler&) = delete;
+
+    int Begin(const char* name, uint32_t budget_ms = 0);
+    void End(int phase);
+
+    // Prints the timeline up to now against the total budget, returns false if
+    // the total or any phase went over budget
+    bool Report(uint32_t total_budget_ms);
+
+private:
+    BootProfiler() = default;
+    ~BootProfiler() = default;
+
+    struct Phase {
+        const char* name;
+        int64_t start_us;
+        int64_t end_us;       // 0 while running
+        uint32_t budget_ms;
+        uint16_t trace_id;
+        char task[16];
+    };
+
+    std::mutex mutex_;
+    Phase phases_[BOOT_PROFILER_MAX_PHASES];
+    int phase_count_ = 0;
+};
+
+class BootPhaseScope {
+public:
+    BootPhaseScope(const char* name, uint32_t budget_ms) {
+        phase_ = BootProfiler::GetInstance().Begin(name, budget_ms);
+    }
+    ~BootPhaseScope() {
+        BootProfiler::GetInstance().End(phase_);
+    }
+
+private:
+    int phase_;
+};
+
+#if CONFIG_USE_BOOT_PROFILER
+#define BOOT_CONCAT_INNER(a, b) a##b
+#define BOOT_CONCAT(a, b) BOOT_CONCAT_INNER(a, b)
+#define BOOT_PHASE(name, budget_ms) BootPhaseScope BOOT_CONCAT(boot_phase_, __LINE__)(name, budget_ms)
+#define BOOT_PHASE_BEGIN(name, budget_ms) BootProfiler::GetInstance().Begin(name, budget_ms)
+#define BOOT_PHASE_END(phase) BootProfiler::GetInstance().End(phase)
+#else
+#define BOOT_PHASE(name, budget_ms) do {} while (0)
+#define BOOT_PHASE_BEGIN(name, budget_ms) (-1)
+#define BOOT_PHASE_END(phase) do { (void)(phase); } while (0)
+#endif
+
+#endif // _BOOT_PROFILER_H_
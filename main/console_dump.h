@@ -0,0 +1,61 @@
+#ifndef CONSOLE_DUMP_H
+#define CONSOLE_DUMP_H
+
+#include <mbedtls/base64.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+/*
+ * Prints a binary dump on the console as base64 between BEGIN/END markers, the form
+ * scripts/trace_tools reads back. Usage:
+ *   ConsoleDump console("TRACE");
+ *   Dump([&console](const uint8_t* data, size_t size) { console.Write(data, size); });
+ */
+class ConsoleDump {
+public:
+    explicit ConsoleDump(const char* label) : label_(label) {
+        printf("-----BEGIN XIAOZHI %s-----\n", label_);
+    }
+
+    ~ConsoleDump() {
+        if (chunk_size_ > 0) {
+            Flush();
+        }
+        printf("-----END XIAOZHI %s-----\n", label_);
+    }
+
+    ConsoleDump(const ConsoleDump&) = delete;
+    ConsoleDump& operator=(const ConsoleDump&) = delete;
+
+    void Write(const uint8_t* data, size_t size) {
+        while (size > 0) {
+            size_t n = std::min(size, sizeof(chunk_) - chunk_size_);
+            memcpy(chunk_ + chunk_size_, data, n);
+            chunk_size_ += n;
+            data += n;
+            size -= n;
+            if (chunk_size_ == sizeof(chunk_)) {
+                Flush();
+            }
+        }
+    }
+
+private:
+    const char* label_;
+    // 48 raw bytes encode into exactly one 64 character base64 line
+    uint8_t chunk_[48];
+    size_t chunk_size_ = 0;
+
+    void Flush() {
+        unsigned char line[68];
+        size_t line_size = 0;
+        mbedtls_base64_encode(line, sizeof(line), &line_size, chunk_, chunk_size_);
+        printf("%.*s\n", (int)line_size, line);
+        chunk_size_ = 0;
+    }
+};
+
+#endif // CONSOLE_DUMP_H
@@ -0,0 +1,319 @@
+#include "deferred_log.h"
+#include "console_dump.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_heap_caps.h>
+
+#include <cstdio>
+#include <cinttypes>
+#include <algorithm>
+
+#define TAG "DeferredLog"
+
+#ifndef CONFIG_DEFERRED_LOG_RECORDS
+#define CONFIG_DEFERRED_LOG_RECORDS 128
+#endif
+
+#define DEFERRED_LOG_MAGIC "XZLG"
+#define DEFERRED_LOG_VERSION 1
+#define DEFERRED_LOG_PRINT_INTERVAL_MS 100
+
+DeferredLog::DeferredLog() {
+    // Round down to a power of two so that the slot index is a simple mask
+    capacity_ = 1;
+    while (capacity_ * 2 <= CONFIG_DEFERRED_LOG_RECORDS) {
+        capacity_ *= 2;
+    }
+
+    size_t size = capacity_ * sizeof(DeferredLogRecord);
+    auto records = (DeferredLogRecord*)heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM);
+    if (records == nullptr) {
+        records = (DeferredLogRecord*)heap_caps_calloc(1, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (records == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes", size);
+        return;
+    }
+    records_ = records;
+    ESP_LOGI(TAG, "Deferred log enabled, %lu records", capacity_);
+
+#if CONFIG_DEFERRED_LOG_PRINT
+    xTaskCreate([](void* arg) {
+        auto self = (DeferredLog*)arg;
+        self->PrintTask();
+        vTaskDelete(NULL);
+    }, "deferred_log", 4096, this, 1, nullptr);
+#endif
+}
+
+DeferredLog::~DeferredLog() {
+    if (records_ != nullptr) {
+        heap_caps_free(records_);
+    }
+}
+
+uint16_t DeferredLog::Register(LogSite& site) {
+    std::lock_guard<std::mutex> lock(sites_mutex_);
+    uint16_t id = site.id_.load(std::memory_order_relaxed);
+    if (id != 0xffff) {
+        return id;
+    }
+    if (site_count_ >= DEFERRED_LOG_MAX_SITES) {
+        ESP_LOGW(TAG, "Too many log sites, dropping %s", site.format);
+        return DEFERRED_LOG_MAX_SITES - 1;
+    }
+    id = site_count_++;
+    sites_[id] = &site;
+    site.id_.store(id, std::memory_order_relaxed);
+    return id;
+}
+
+void DeferredLog::EncodeString(uint8_t*& p, uint8_t* end, const char* value) {
+    if (end - p < 2) {
+        p = end;
+        return;
+    }
+    if (value == nullptr) {
+        value = "(null)";
+    }
+    size_t length = strnlen(value, std::min<size_t>(end - p - 2, 255));
+    // A cut text ends with the last complete UTF-8 character, not in the middle of one
+    if (value[length] != '\0') {
+        while (length > 0 && ((uint8_t)value[length] & 0xc0) == 0x80) {
+            length--;
+        }
+    }
+    *p++ = kDeferredLogArgString;
+    *p++ = length;
+    memcpy(p, value, length);
+    p += length;
+}
+
+// Copies a record out of the ring, fails if it is not complete or was overwritten
+bool DeferredLog::ReadRecord(uint32_t index, DeferredLogRecord& record) {
+    auto& slot = records_[index & (capacity_ - 1)];
+    uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != index + 1) {
+        return false;
+    }
+    memcpy(&record.timestamp_ms, &slot.timestamp_ms, sizeof(DeferredLogRecord) - offsetof(DeferredLogRecord, timestamp_ms));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+/*
+ * Walks the format and prints every conversion with the matching recorded argument.
+ * Length modifiers are replaced by the ones of the recorded type, so "%lu" works
+ * for both a uint32_t on the chip and a size_t on the host.
+ */
+static int FormatRecord(const char* format, const uint8_t* args, size_t args_size, char* out, size_t out_size) {
+    const uint8_t* arg = args;
+    const uint8_t* args_end = args + args_size;
+    size_t length = 0;
+    auto append = [&](int n) {
+        if (n > 0) {
+            length = std::min(length + n, out_size - 1);
+        }
+    };
+
+    while (*format != '\0' && length < out_size - 1) {
+        if (*format != '%') {
+            out[length++] = *format++;
+            continue;
+        }
+        if (format[1] == '%') {
+            out[length++] = '%';
+            format += 2;
+            continue;
+        }
+
+        // Copy flags, width and precision, skip the length modifiers
+        char spec[24];
+        size_t spec_length = 0;
+        spec[spec_length++] = *format++;
+        while (*format != '\0' && strchr("-+ #0123456789.", *format) != nullptr && spec_length < sizeof(spec) - 4) {
+            spec[spec_length++] = *format++;
+        }
+        while (*format != '\0' && strchr("hlLqjzt", *format) != nullptr) {
+            format++;
+        }
+        char conversion = *format;
+        if (conversion == '\0') {
+            break;
+        }
+        format++;
+
+        uint8_t type = arg < args_end ? *arg++ : (uint8_t)kDeferredLogArgEnd;
+        char* dest = out + length;
+        size_t available = out_size - length;
+        if (type == kDeferredLogArgString && arg < args_end) {
+            size_t string_length = *arg++;
+            string_length = std::min<size_t>(string_length, args_end - arg);
+            char value[256];
+            memcpy(value, arg, string_length);
+            value[string_length] = '\0';
+            arg += string_length;
+            spec[spec_length++] = 's';
+            spec[spec_length] = '\0';
+            append(snprintf(dest, available, spec, value));
+        } else if (type == kDeferredLogArgInt32 && args_end - arg >= 4) {
+            uint32_t value;
+            memcpy(&value, arg, sizeof(value));
+            arg += sizeof(value);
+            if (conversion == 'p') {
+                append(snprintf(dest, available, "0x%08" PRIx32, value));
+                continue;
+            }
+            spec[spec_length++] = conversion;
+            spec[spec_length] = '\0';
+            if (conversion == 'd' || conversion == 'i') {
+                append(snprintf(dest, available, spec, (int)(int32_t)value));
+            } else {
+                append(snprintf(dest, available, spec, (unsigned int)value));
+            }
+        } else if (type == kDeferredLogArgInt64 && args_end - arg >= 8) {
+            uint64_t value;
+            memcpy(&value, arg, sizeof(value));
+            arg += sizeof(value);
+            if (conversion == 'p') {
+                append(snprintf(dest, available, "0x%" PRIx64, value));
+                continue;
+            }
+            spec[spec_length++] = 'l';
+            spec[spec_length++] = 'l';
+            spec[spec_length++] = conversion;
+            spec[spec_length] = '\0';
+            if (conversion == 'd' || conversion == 'i') {
+                append(snprintf(dest, available, spec, (long long)value));
+            } else {
+                append(snprintf(dest, available, spec, (unsigned long long)value));
+            }
+        } else if (type == kDeferredLogArgDouble && args_end - arg >= 8) {
+            double value;
+            memcpy(&value, arg, sizeof(value));
+            arg += sizeof(value);
+            spec[spec_length++] = conversion;
+            spec[spec_length] = '\0';
+            append(snprintf(dest, available, spec, value));
+        } else {
+            // The argument did not fit into the record
+            arg = args_end;
+            append(snprintf(dest, available, "?"));
+        }
+    }
+    out[length] = '\0';
+    return length;
+}
+
+void DeferredLog::PrintTask() {
+    static const char letters[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+    DeferredLogRecord record;
+    char message[256];
+
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(DEFERRED_LOG_PRINT_INTERVAL_MS));
+
+        uint32_t head = head_.load(std::memory_order_acquire);
+        uint32_t lost = 0;
+        if (head - tail_ > capacity_) {
+            lost = head - tail_ - capacity_;
+            tail_ = head - capacity_;
+        }
+        while (tail_ != head) {
+            if (!ReadRecord(tail_, record)) {
+                auto sequence = records_[tail_ & (capacity_ - 1)].sequence.load(std::memory_order_relaxed);
+                if (sequence == 0 || (int32_t)(sequence - (tail_ + 1)) <= 0) {
+                    // Still being written, try again on the next round
+                    break;
+                }
+                lost++;
+                tail_++;
+                continue;
+            }
+            tail_++;
+
+            LogSite* site = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(sites_mutex_);
+                if (record.site_id < site_count_) {
+                    site = sites_[record.site_id];
+                }
+            }
+            if (site == nullptr) {
+                continue;
+            }
+            FormatRecord(site->format, record.args, sizeof(record.args), message, sizeof(message));
+            if (record.suppressed > 0) {
+                esp_log_write(site->level, site->tag, "%c (%lu) %s: %s (%u suppressed)\n", letters[site->level],
+                              (unsigned long)record.timestamp_ms, site->tag, message, record.suppressed);
+            } else {
+                esp_log_write(site->level, site->tag, "%c (%lu) %s: %s\n", letters[site->level],
+                              (unsigned long)record.timestamp_ms, site->tag, message);
+            }
+        }
+
+        if (lost > 0) {
+            lost_.fetch_add(lost, std::memory_order_relaxed);
+            ESP_LOGW(TAG, "%lu records lost, %lu in total", (unsigned long)lost, (unsigned long)lost_.load());
+        }
+    }
+}
+
+/*
+ * Dump layout (little endian):
+ * |magic 4|version 2u|site_count 2u|record_size 2u|record_count 4u|
+ * site_count x |site_id 2u|level 1u|suppressed_total 4u|tag_length 1u|tag|format_length 1u|format|
+ * record_count x DeferredLogRecord, oldest first
+ */
+void DeferredLog::Dump(std::function<void(const uint8_t* data, size_t size)> writer) {
+    auto write_u8 = [&writer](uint8_t value) {
+        writer(&value, sizeof(value));
+    };
+    auto write_u16 = [&writer](uint16_t value) {
+        writer((const uint8_t*)&value, sizeof(value));
+    };
+    auto write_u32 = [&writer](uint32_t value) {
+        writer((const uint8_t*)&value, sizeof(value));
+    };
+    auto write_string = [&writer, &write_u8](const char* str) {
+        size_t length = strnlen(str, 255);
+        write_u8(length);
+        writer((const uint8_t*)str, length);
+    };
+
+    uint32_t head = head_.load(std::memory_order_acquire);
+    uint32_t count = head < capacity_ ? head : capacity_;
+
+    writer((const uint8_t*)DEFERRED_LOG_MAGIC, 4);
+    write_u16(DEFERRED_LOG_VERSION);
+    {
+        std::lock_guard<std::mutex> lock(sites_mutex_);
+        write_u16(site_count_);
+        write_u16(sizeof(DeferredLogRecord));
+        write_u32(count);
+        for (uint16_t i = 0; i < site_count_; i++) {
+            write_u16(i);
+            write_u8(sites_[i]->level);
+            write_u32(sites_[i]->suppressed_total());
+            write_string(sites_[i]->tag);
+            write_string(sites_[i]->format);
+        }
+    }
+
+    // Records that are incomplete or were overwritten meanwhile go out with sequence 0
+    DeferredLogRecord record;
+    for (uint32_t index = head - count; index != head; index++) {
+        if (ReadRecord(index, record)) {
+            record.sequence.store(index + 1, std::memory_order_relaxed);
+        } else {
+            memset((void*)&record, 0, sizeof(record));
+        }
+        writer((const uint8_t*)&record, sizeof(record));
+    }
+}
+
+void DeferredLog::DumpToConsole() {
+    ConsoleDump console("LOG");
+    Dump([&console](const uint8_t* data, size_t size) { console.Write(data, size); });
+}
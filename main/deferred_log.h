@@ -0,0 +1,245 @@
+#ifndef _DEFERRED_LOG_H_
+#define _DEFERRED_LOG_H_
+
+#include <esp_log.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <type_traits>
+
+/*
+ * Rate-limited, deferred-format logging for hot paths.
+ *
+ * Usage, same arguments as ESP_LOGx:
+ *   DLOGW(TAG, "Received audio packet with wrong sequence: %lu", sequence);
+ *
+ * Every call site lets through at most CONFIG_LOG_RATE_LIMIT_PER_SECOND messages
+ * per second, the arguments of dropped messages are not even evaluated. The number
+ * of dropped messages is reported with the next one that gets through.
+ *
+ * With CONFIG_USE_DEFERRED_LOG the calling task only copies the call site id and
+ * the raw arguments into a ring buffer. A low priority task formats and prints
+ * them, and the "log" system command dumps the ring as base64 for
+ * scripts/trace_tools/decode_log.py. Without it the messages go to ESP_LOGx.
+ *
+ * Formats must be string literals. %s arguments are copied and truncated to fit
+ * into a record, %n and * widths are not supported.
+ */
+
+#ifndef CONFIG_LOG_RATE_LIMIT_PER_SECOND
+#define CONFIG_LOG_RATE_LIMIT_PER_SECOND 5
+#endif
+
+#define DEFERRED_LOG_RECORD_SIZE 128
+#define DEFERRED_LOG_MAX_SITES 128
+
+class LogSite {
+public:
+    constexpr LogSite(const char* tag, const char* format, esp_log_level_t level)
+        : tag(tag), format(format), level(level) {}
+
+    const char* const tag;
+    const char* const format;
+    const esp_log_level_t level;
+
+    // Returns false if the message is over the rate limit, otherwise stores the
+    // number of messages dropped since the previous one into *suppressed
+    bool Allow(uint32_t* suppressed) {
+#if CONFIG_LOG_RATE_LIMIT_PER_SECOND > 0
+        uint32_t now = esp_log_timestamp();
+        uint32_t start = window_start_ms_.load(std::memory_order_relaxed);
+        if (now - start >= 1000 && window_start_ms_.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+            window_count_.store(0, std::memory_order_relaxed);
+        }
+        if (window_count_.fetch_add(1, std::memory_order_relaxed) >= CONFIG_LOG_RATE_LIMIT_PER_SECOND) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            suppressed_total_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+#endif
+        *suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    uint32_t suppressed_total() const { return suppressed_total_.load(std::memory_order_relaxed); }
+
+private:
+    friend class DeferredLog;
+
+    std::atomic<uint32_t> window_start_ms_{0};
+    std::atomic<uint32_t> window_count_{0};
+    std::atomic<uint32_t> suppressed_{0};
+    std::atomic<uint32_t> suppressed_total_{0};
+    std::atomic<uint16_t> id_{0xffff};
+};
+
+#if CONFIG_USE_DEFERRED_LOG
+
+enum DeferredLogArg : uint8_t {
+    kDeferredLogArgEnd = 0,
+    kDeferredLogArgInt32 = 1,
+    kDeferredLogArgInt64 = 2,
+    kDeferredLogArgDouble = 3,
+    kDeferredLogArgString = 4,   // |length 1u|bytes|
+};
+
+struct DeferredLogRecord {
+    std::atomic<uint32_t> sequence;  // Index + 1 once the record is complete, 0 while it is written
+    uint32_t timestamp_ms;           // esp_log_timestamp() of the call
+    uint16_t site_id;
+    uint16_t suppressed;             // Messages dropped at this site before this one
+    uint8_t args[DEFERRED_LOG_RECORD_SIZE - 12];
+};
+
+static_assert(sizeof(DeferredLogRecord) == DEFERRED_LOG_RECORD_SIZE, "DeferredLogRecord must stay 128 bytes");
+
+class DeferredLog {
+public:
+    static DeferredLog& GetInstance() {
+        static DeferredLog instance;
+        return instance;
+    }
+    // 删除拷贝构造函数和赋值运算符
+    DeferredLog(const DeferredLog&) = delete;
+    DeferredLog& operator=(const DeferredLog&) = delete;
+
+    template <typename... Args>
+    void Write(LogSite& site, uint32_t suppressed, Args... args) {
+        if (records_ == nullptr) {
+            return;
+        }
+        uint16_t site_id = site.id_.load(std::memory_order_relaxed);
+        if (site_id == 0xffff) {
+            site_id = Register(site);
+        }
+        uint32_t index = head_.fetch_add(1, std::memory_order_relaxed);
+        auto& record = records_[index & (capacity_ - 1)];
+        record.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        record.timestamp_ms = esp_log_timestamp();
+        record.site_id = site_id;
+        record.suppressed = suppressed > 0xffff ? 0xffff : suppressed;
+        uint8_t* p = record.args;
+        uint8_t* end = record.args + sizeof(record.args);
+        (Encode(p, end, args), ...);
+        if (p < end) {
+            *p = kDeferredLogArgEnd;
+        }
+        record.sequence.store(index + 1, std::memory_order_release);
+    }
+
+    // Records overwritten before the print task got to them
+    uint32_t lost() const { return lost_.load(std::memory_order_relaxed); }
+
+    // Write the binary dump through the writer in small chunks
+    void Dump(std::function<void(const uint8_t* data, size_t size)> writer);
+    // Print the dump as base64 between BEGIN/END markers on the console
+    void DumpToConsole();
+
+private:
+    DeferredLog();
+    ~DeferredLog();
+
+    DeferredLogRecord* records_ = nullptr;
+    uint32_t capacity_ = 0;
+    std::atomic<uint32_t> head_{0};
+    uint32_t tail_ = 0;
+    std::atomic<uint32_t> lost_{0};
+
+    std::mutex sites_mutex_;
+    LogSite* sites_[DEFERRED_LOG_MAX_SITES] = {};
+    uint16_t site_count_ = 0;
+
+    uint16_t Register(LogSite& site);
+    bool ReadRecord(uint32_t index, DeferredLogRecord& record);
+    void PrintTask();
+
+    static void EncodeString(uint8_t*& p, uint8_t* end, const char* value);
+
+    template <typename T>
+    static void EncodeValue(uint8_t*& p, uint8_t* end, DeferredLogArg type, T value) {
+        if (end - p < (ptrdiff_t)(1 + sizeof(T))) {
+            p = end;
+            return;
+        }
+        *p++ = type;
+        memcpy(p, &value, sizeof(T));
+        p += sizeof(T);
+    }
+
+    template <typename T>
+    static void Encode(uint8_t*& p, uint8_t* end, T value) {
+        if constexpr (std::is_convertible_v<T, const char*>) {
+            EncodeString(p, end, value);
+        } else if constexpr (std::is_floating_point_v<T>) {
+            EncodeValue(p, end, kDeferredLogArgDouble, (double)value);
+        } else if constexpr (std::is_pointer_v<T>) {
+            EncodeValue(p, end, kDeferredLogArgInt64, (uint64_t)(uintptr_t)value);
+        } else if constexpr (sizeof(T) <= 4) {
+            EncodeValue(p, end, kDeferredLogArgInt32, (uint32_t)value);
+        } else {
+            EncodeValue(p, end, kDeferredLogArgInt64, (uint64_t)value);
+        }
+    }
+};
+
+// Never called, only lets the compiler check the format against the arguments
+#if CONFIG_IDF_TARGET_LINUX
+static inline void DeferredLogCheckFormat(const char*, ...) {}
+#else
+static inline void DeferredLogCheckFormat(const char* format, ...) __attribute__((format(printf, 1, 2)));
+static inline void DeferredLogCheckFormat(const char*, ...) {}
+#endif
+
+#define DLOG_OUTPUT(esp_log_macro, site, suppressed, tag, format, ...) do {                  \
+        if (false) {                                                                         \
+            DeferredLogCheckFormat(format, ##__VA_ARGS__);                                   \
+        }                                                                                    \
+        DeferredLog::GetInstance().Write(site, suppressed, ##__VA_ARGS__);                   \
+    } while (0)
+
+#else
+
+#define DLOG_OUTPUT(esp_log_macro, site, suppressed, tag, format, ...) do {                  \
+        esp_log_macro(tag, format, ##__VA_ARGS__);                                           \
+        if (suppressed > 0) {                                                                \
+            esp_log_macro(tag, "%lu similar messages suppressed", (unsigned long)suppressed); \
+        }                                                                                    \
+    } while (0)
+
+#endif // CONFIG_USE_DEFERRED_LOG
+
+#ifdef LOG_LOCAL_LEVEL
+#define DLOG_LEVEL_ENABLED(level) (LOG_LOCAL_LEVEL >= level)
+#else
+#define DLOG_LEVEL_ENABLED(level) (true)
+#endif
+
+// The runtime level of esp_log_level_set, checked before a record takes a slot of the ring.
+// ESP_LOGx checks it by itself when the records are not deferred
+#if CONFIG_USE_DEFERRED_LOG
+#define DLOG_RUNTIME_ENABLED(tag, level) (esp_log_level_get(tag) >= level)
+#else
+#define DLOG_RUNTIME_ENABLED(tag, level) (true)
+#endif
+
+#define DLOG_LEVEL(level, esp_log_macro, tag, format, ...) do {                              \
+        if (DLOG_LEVEL_ENABLED(level)) {                                                     \
+            static LogSite dlog_site(tag, format, level);                                    \
+            uint32_t dlog_suppressed;                                                        \
+            if (DLOG_RUNTIME_ENABLED(tag, level) && dlog_site.Allow(&dlog_suppressed)) {     \
+                DLOG_OUTPUT(esp_log_macro, dlog_site, dlog_suppressed, tag, format, ##__VA_ARGS__); \
+            }                                                                                \
+        }                                                                                    \
+    } while (0)
+
+#define DLOGE(tag, format, ...) DLOG_LEVEL(ESP_LOG_ERROR, ESP_LOGE, tag, format, ##__VA_ARGS__)
+#define DLOGW(tag, format, ...) DLOG_LEVEL(ESP_LOG_WARN, ESP_LOGW, tag, format, ##__VA_ARGS__)
+#define DLOGI(tag, format, ...) DLOG_LEVEL(ESP_LOG_INFO, ESP_LOGI, tag, format, ##__VA_ARGS__)
+#define DLOGD(tag, format, ...) DLOG_LEVEL(ESP_LOG_DEBUG, ESP_LOGD, tag, format, ##__VA_ARGS__)
+
+#endif // _DEFERRED_LOG_H_
@@ -10,6 +10,8 @@
 #include "font_awesome_symbols.h"
 #include "audio_codec.h"
 #include "settings.h"
+#include "event_trace.h"
+#include "frame_governor.h"
 #include "assets/lang_config.h"
 
 #define TAG "Display"
@@ -27,9 +29,16 @@ Display::Display()
         .callback = [](void *arg)
         {
             Display *display = static_cast<Display *>(arg);
-            DisplayLockGuard lock(display);
-            lv_obj_add_flag(display->notification_label_, LV_OBJ_FLAG_HIDDEN);
-            lv_obj_clear_flag(display->status_label_, LV_OBJ_FLAG_HIDDEN);
+            bool queued = display->PostUpdate([display](DisplayUpdates &pending)
+                                              {
+                pending.notification_order = ++display->updates_order_;
+                pending.notification.clear();
+                pending.notification_duration_ms = 0; });
+            if (!queued)
+            {
+                DisplayLockGuard lock(display);
+                display->ApplyNotification("", 0);
+            }
         },
         .arg = this,
         .dispatch_method = ESP_TIMER_TASK,
@@ -51,7 +60,16 @@ Display::Display()
         .skip_unhandled_events = true,
     };
     ESP_ERROR_CHECK(esp_timer_create(&update_display_timer_args, &update_timer_));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(update_timer_, 500000));
+    auto &governor = FrameGovernor::GetInstance();
+    ESP_ERROR_CHECK(esp_timer_start_periodic(update_timer_, governor.Period(DISPLAY_STATUS_PERIOD_MS) * 1000));
+    // The status keeps being updated while paused, the auto dimming may turn the backlight back on.
+    // The subscriber runs on whatever task changed the rate, LVGL picks the change up from the queue
+    frame_rate_subscription_ = governor.Subscribe([this]()
+                                                  {
+        esp_timer_stop(update_timer_);
+        esp_timer_start_periodic(update_timer_, FrameGovernor::GetInstance().Period(DISPLAY_STATUS_PERIOD_MS) * 1000);
+        PostUpdate([](DisplayUpdates &pending)
+                   { pending.frame_rate = true; }); });
 
     // Create a power management lock
     auto ret = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "display_update", &pm_lock_);
@@ -67,6 +85,7 @@ Display::Display()
 
 Display::~Display()
 {
+    FrameGovernor::GetInstance().Unsubscribe(frame_rate_subscription_);
     if (notification_timer_ != nullptr)
     {
         esp_timer_stop(notification_timer_);
@@ -77,6 +96,11 @@ Display::~Display()
         esp_timer_stop(update_timer_);
         esp_timer_delete(update_timer_);
     }
+    if (updates_timer_ != nullptr)
+    {
+        DisplayLockGuard lock(this);
+        lv_timer_delete(updates_timer_);
+    }
 
     if (network_label_ != nullptr)
     {
@@ -95,9 +119,134 @@ Display::~Display()
     }
 }
 
+void DisplayUpdates::Clear()
+{
+    // The strings keep their capacity, posting the next update does not allocate
+    status_order = 0;
+    status.clear();
+    notification_order = 0;
+    notification.clear();
+    notification_duration_ms = 0;
+    emotion_pending = false;
+    emotion.clear();
+    chat_messages.clear();
+    battery_icon = nullptr;
+    network_icon = nullptr;
+    muted = -1;
+    low_battery = -1;
+    frame_rate = false;
+}
+
+void Display::StartUpdateQueue()
+{
+    std::lock_guard<std::mutex> lock(updates_mutex_);
+    if (updates_timer_ != nullptr)
+    {
+        return;
+    }
+    updates_timer_ = lv_timer_create([](lv_timer_t *timer)
+                                     {
+        auto display = static_cast<Display *>(lv_timer_get_user_data(timer));
+        display->ApplyUpdates(); }, DISPLAY_UPDATE_PERIOD_MS, this);
+    // A rate change before this was not queued
+    ApplyFrameRate();
+}
+
+void Display::ApplyFrameRate()
+{
+    auto &governor = FrameGovernor::GetInstance();
+    if (updates_timer_ != nullptr)
+    {
+        lv_timer_set_period(updates_timer_, governor.Period(DISPLAY_UPDATE_PERIOD_MS));
+    }
+    if (display_ == nullptr)
+    {
+        return;
+    }
+    // Invalidated areas pile up while paused and are drawn once the refresh resumes
+    lv_timer_t *refresh_timer = lv_display_get_refr_timer(display_);
+    if (governor.paused())
+    {
+        lv_timer_pause(refresh_timer);
+    }
+    else
+    {
+        lv_timer_set_period(refresh_timer, governor.Period(LV_DEF_REFR_PERIOD));
+        lv_timer_resume(refresh_timer);
+    }
+}
+
+void Display::ApplyUpdates()
+{
+    if (!updates_pending_.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    {
+        // Swapped out so that the setters can post while the updates are drawn
+        std::lock_guard<std::mutex> lock(updates_mutex_);
+        std::swap(pending_updates_, applying_updates_);
+        updates_pending_.store(false, std::memory_order_relaxed);
+    }
+    auto &updates = applying_updates_;
+
+    if (updates.frame_rate)
+    {
+        ApplyFrameRate();
+    }
+
+    // Status and notification share the place in the status bar, the later one wins
+    bool status_first = updates.status_order < updates.notification_order;
+    if (updates.status_order != 0 && status_first)
+    {
+        ApplyStatus(updates.status.c_str());
+    }
+    if (updates.notification_order != 0)
+    {
+        ApplyNotification(updates.notification.c_str(), updates.notification_duration_ms);
+    }
+    if (updates.status_order != 0 && !status_first)
+    {
+        ApplyStatus(updates.status.c_str());
+    }
+    if (updates.emotion_pending)
+    {
+        if (updates.emotion_is_icon)
+        {
+            ApplyIcon(updates.emotion.c_str());
+        }
+        else
+        {
+            ApplyEmotion(updates.emotion.c_str());
+        }
+    }
+    for (auto &message : updates.chat_messages)
+    {
+        ApplyChatMessage(message.first.c_str(), message.second.c_str());
+    }
+    ApplyStatusBar(updates);
+    updates.Clear();
+}
+
 void Display::SetStatus(const char *status)
 {
-    DisplayLockGuard lock(this);
+    if (status == nullptr)
+    {
+        status = "";
+    }
+    bool queued = PostUpdate([this, status](DisplayUpdates &pending)
+                             {
+        pending.status_order = ++updates_order_;
+        pending.status = status; });
+    if (!queued)
+    {
+        DisplayLockGuard lock(this);
+        ApplyStatus(status);
+    }
+}
+
+void Display::ApplyStatus(const char *status)
+{
     if (status_label_ == nullptr)
     {
         return;
@@ -114,11 +263,34 @@ void Display::ShowNotification(const std::string &notification, int duration_ms)
 
 void Display::ShowNotification(const char *notification, int duration_ms)
 {
-    DisplayLockGuard lock(this);
+    if (notification == nullptr)
+    {
+        notification = "";
+    }
+    bool queued = PostUpdate([this, notification, duration_ms](DisplayUpdates &pending)
+                             {
+        pending.notification_order = ++updates_order_;
+        pending.notification = notification;
+        pending.notification_duration_ms = duration_ms; });
+    if (!queued)
+    {
+        DisplayLockGuard lock(this);
+        ApplyNotification(notification, duration_ms);
+    }
+}
+
+void Display::ApplyNotification(const char *notification, int duration_ms)
+{
     if (notification_label_ == nullptr)
     {
         return;
     }
+    if (duration_ms <= 0)
+    {
+        lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_clear_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
     lv_label_set_text(notification_label_, notification);
     lv_obj_clear_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
     lv_obj_add_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
@@ -136,25 +308,15 @@ void Display::Update()
 
     auto &board = Board::GetInstance();
     auto codec = board.GetAudioCodec();
+    // Only what changed since the last run is posted
+    DisplayUpdates changes;
 
+    // 如果静音状态改变，则更新图标
+    bool muted = codec->output_volume() == 0;
+    if (muted != muted_)
     {
-        DisplayLockGuard lock(this);
-        if (mute_label_ == nullptr)
-        {
-            return;
-        }
-
-        // 如果静音状态改变，则更新图标
-        if (codec->output_volume() == 0 && !muted_)
-        {
-            muted_ = true;
-            lv_label_set_text(mute_label_, FONT_AWESOME_VOLUME_MUTE);
-        }
-        else if (codec->output_volume() > 0 && muted_)
-        {
-            muted_ = false;
-            lv_label_set_text(mute_label_, "");
-        }
+        muted_ = muted;
+        changes.muted = muted;
     }
 
     esp_pm_lock_acquire(pm_lock_);
@@ -180,32 +342,25 @@ void Display::Update()
             };
             icon = levels[battery_level / 20];
         }
-        DisplayLockGuard lock(this);
-        if (battery_label_ != nullptr && battery_icon_ != icon)
+        if (battery_icon_ != icon)
         {
             battery_icon_ = icon;
-            lv_label_set_text(battery_label_, battery_icon_);
+            changes.battery_icon = icon;
         }
 
         if (low_battery_popup_ != nullptr)
         {
-            if (strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging)
-            {
-                if (lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN))
-                { // 如果低电量提示框隐藏，则显示
-                    lv_obj_clear_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+            bool low_battery = strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging;
+            if (low_battery != low_battery_shown_)
+            { // 低电量时显示提示框，否则隐藏
+                low_battery_shown_ = low_battery;
+                changes.low_battery = low_battery;
+                if (low_battery)
+                {
                     auto &app = Application::GetInstance();
                     app.PlaySound(Lang::Sounds::P3_LOW_BATTERY);
                 }
             }
-            else
-            {
-                // Hide the low battery popup when the battery is not empty
-                if (!lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN))
-                { // 如果低电量提示框显示，则隐藏
-                    lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                }
-            }
         }
     }
     if (!timeOffline_ && !board.TimeUpdate())
@@ -226,18 +381,78 @@ void Display::Update()
     if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end())
     {
         icon = board.GetNetworkStateIcon();
-        if (network_label_ != nullptr && icon != nullptr && network_icon_ != icon)
+        if (icon != nullptr && network_icon_ != icon)
         {
-            DisplayLockGuard lock(this);
             network_icon_ = icon;
-            lv_label_set_text(network_label_, network_icon_);
+            changes.network_icon = icon;
         }
     }
 
     esp_pm_lock_release(pm_lock_);
+
+    if (changes.muted < 0 && changes.low_battery < 0 && changes.battery_icon == nullptr && changes.network_icon == nullptr)
+    {
+        return;
+    }
+    bool queued = PostUpdate([&changes](DisplayUpdates &pending)
+                             {
+        if (changes.muted >= 0) pending.muted = changes.muted;
+        if (changes.low_battery >= 0) pending.low_battery = changes.low_battery;
+        if (changes.battery_icon != nullptr) pending.battery_icon = changes.battery_icon;
+        if (changes.network_icon != nullptr) pending.network_icon = changes.network_icon; });
+    if (!queued)
+    {
+        DisplayLockGuard lock(this);
+        ApplyStatusBar(changes);
+    }
+}
+
+void Display::ApplyStatusBar(const DisplayUpdates &updates)
+{
+    if (mute_label_ != nullptr && updates.muted >= 0)
+    {
+        lv_label_set_text(mute_label_, updates.muted ? FONT_AWESOME_VOLUME_MUTE : "");
+    }
+    if (battery_label_ != nullptr && updates.battery_icon != nullptr)
+    {
+        lv_label_set_text(battery_label_, updates.battery_icon);
+    }
+    if (low_battery_popup_ != nullptr && updates.low_battery >= 0)
+    {
+        if (updates.low_battery)
+        {
+            lv_obj_clear_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+        }
+        else
+        {
+            lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+    if (network_label_ != nullptr && updates.network_icon != nullptr)
+    {
+        lv_label_set_text(network_label_, updates.network_icon);
+    }
 }
 
 void Display::SetEmotion(const char *emotion)
+{
+    if (emotion == nullptr)
+    {
+        emotion = "";
+    }
+    bool queued = PostUpdate([emotion](DisplayUpdates &pending)
+                             {
+        pending.emotion_pending = true;
+        pending.emotion_is_icon = false;
+        pending.emotion = emotion; });
+    if (!queued)
+    {
+        DisplayLockGuard lock(this);
+        ApplyEmotion(emotion);
+    }
+}
+
+void Display::ApplyEmotion(const char *emotion)
 {
     struct Emotion
     {
@@ -268,8 +483,6 @@ void Display::SetEmotion(const char *emotion)
         {FONT_AWESOME_EMOJI_SILLY, "silly"},
         {FONT_AWESOME_EMOJI_CONFUSED, "confused"}};
 
-    DisplayLockGuard lock(this);
-
     // 查找匹配的表情
     std::string_view emotion_view(emotion);
     auto it = std::find_if(emotions.begin(), emotions.end(),
@@ -294,7 +507,24 @@ void Display::SetEmotion(const char *emotion)
 
 void Display::SetIcon(const char *icon)
 {
-    DisplayLockGuard lock(this);
+    if (icon == nullptr)
+    {
+        icon = "";
+    }
+    bool queued = PostUpdate([icon](DisplayUpdates &pending)
+                             {
+        pending.emotion_pending = true;
+        pending.emotion_is_icon = true;
+        pending.emotion = icon; });
+    if (!queued)
+    {
+        DisplayLockGuard lock(this);
+        ApplyIcon(icon);
+    }
+}
+
+void Display::ApplyIcon(const char *icon)
+{
     if (emotion_label_ == nullptr)
     {
         return;
@@ -304,7 +534,30 @@ void Display::SetIcon(const char *icon)
 
 void Display::SetChatMessage(const char *role, const char *content)
 {
-    DisplayLockGuard lock(this);
+    if (role == nullptr)
+    {
+        role = "";
+    }
+    if (content == nullptr)
+    {
+        content = "";
+    }
+    bool queued = PostUpdate([role, content](DisplayUpdates &pending)
+                             {
+        if (pending.chat_messages.size() >= DISPLAY_CHAT_QUEUE_SIZE)
+        {
+            pending.chat_messages.pop_front();
+        }
+        pending.chat_messages.emplace_back(role, content); });
+    if (!queued)
+    {
+        DisplayLockGuard lock(this);
+        ApplyChatMessage(role, content);
+    }
+}
+
+void Display::ApplyChatMessage(const char *role, const char *content)
+{
     if (chat_message_label_ == nullptr)
     {
         return;
@@ -312,10 +565,43 @@ void Display::SetChatMessage(const char *role, const char *content)
     lv_label_set_text(chat_message_label_, content);
 }
 
+void Display::ApplyClearChat()
+{
+    ApplyChatMessage("system", "");
+}
+
 void Display::Notification(const std::string &content, int timeout)
 {
 }
 
+void Display::AddTraceEvents()
+{
+#if CONFIG_USE_EVENT_TRACE
+    if (display_ == nullptr)
+    {
+        return;
+    }
+    lv_display_add_event_cb(display_, [](lv_event_t *e)
+                            {
+        switch (lv_event_get_code(e)) {
+            case LV_EVENT_REFR_START:
+                TRACE_BEGIN("lvgl_refresh");
+                break;
+            case LV_EVENT_REFR_READY:
+                TRACE_END("lvgl_refresh");
+                break;
+            case LV_EVENT_FLUSH_START:
+                TRACE_BEGIN("lvgl_flush");
+                break;
+            case LV_EVENT_FLUSH_FINISH:
+                TRACE_END("lvgl_flush");
+                break;
+            default:
+                break;
+        } }, LV_EVENT_ALL, nullptr);
+#endif
+}
+
 void Display::SetTheme(const std::string &theme_name, bool permanent)
 {
     current_theme_name_ = theme_name;
@@ -7,8 +7,18 @@
 #include <esp_pm.h>
 
 #include <string>
+#include <deque>
+#include <mutex>
+#include <atomic>
 #include "settings.h"
 
+// Chat messages waiting for the LVGL task, the oldest is dropped beyond this
+#define DISPLAY_CHAT_QUEUE_SIZE 8
+// How often the LVGL task looks for queued updates, one refresh period of LVGL
+#define DISPLAY_UPDATE_PERIOD_MS 33
+// How often the status bar icons, the clock and the auto dimming are updated, at full frame rate
+#define DISPLAY_STATUS_PERIOD_MS 500
+
 struct DisplayFonts
 {
     const lv_font_t *text_font = nullptr;
@@ -16,6 +26,28 @@ struct DisplayFonts
     const lv_font_t *emoji_font = nullptr;
 };
 
+// Updates posted by the setters and not applied yet. Every kind keeps only its latest
+// value, chat messages are kept in order because each may add a bubble
+struct DisplayUpdates
+{
+    uint32_t status_order = 0;              // Post order, 0 if nothing is pending
+    std::string status;
+    uint32_t notification_order = 0;
+    std::string notification;
+    int notification_duration_ms = 0;       // 0 hides the notification
+    bool emotion_pending = false;
+    bool emotion_is_icon = false;
+    std::string emotion;
+    std::deque<std::pair<std::string, std::string>> chat_messages;
+    const char *battery_icon = nullptr;     // nullptr if unchanged
+    const char *network_icon = nullptr;
+    int8_t muted = -1;                      // -1 if unchanged
+    int8_t low_battery = -1;
+    bool frame_rate = false;                // The frame rate of the FrameGovernor changed
+
+    void Clear();
+};
+
 class Display
 {
 private:
@@ -26,6 +58,9 @@ public:
     Display();
     virtual ~Display();
 
+    // The setters do not wait for LVGL: once the UI is set up they queue the update and
+    // the LVGL task applies it with its next timer run
+
     virtual void SetStatus(const char *status);
     virtual void ShowNotification(const char *notification, int duration_ms = 3000);
     virtual void ShowNotification(const std::string &notification, int duration_ms = 3000);
@@ -94,10 +129,55 @@ protected:
     esp_timer_handle_t update_timer_ = nullptr;
 
     friend class DisplayLockGuard;
+    friend class DisplayBenchmark;
     virtual bool Lock(int timeout_ms = 0) = 0;
     virtual void Unlock() = 0;
 
+    // Draw the update, called with the display locked, normally on the LVGL task
+    virtual void ApplyStatus(const char *status);
+    virtual void ApplyNotification(const char *notification, int duration_ms);
+    virtual void ApplyEmotion(const char *emotion);
+    virtual void ApplyIcon(const char *icon);
+    virtual void ApplyChatMessage(const char *role, const char *content);
+    // Removes every chat message, by default an empty message in the single chat label
+    virtual void ApplyClearChat();
+
+    // Queues the setters from now on, called with the display locked once the UI exists.
+    // Until then, and on displays that never call it, the setters draw under the lock
+    void StartUpdateQueue();
+    // Mute, battery and network icons and the low battery popup
+    void ApplyStatusBar(const DisplayUpdates &updates);
+
     virtual void Update();
+    // Sets the LVGL refresh and update periods from the frame rate, called with the display locked
+    void ApplyFrameRate();
+    // Record LVGL refresh and flush spans into the event trace
+    void AddTraceEvents();
+
+private:
+    std::mutex updates_mutex_;
+    DisplayUpdates pending_updates_;
+    DisplayUpdates applying_updates_;
+    uint32_t updates_order_ = 0;
+    std::atomic<bool> updates_pending_ = false;
+    lv_timer_t *updates_timer_ = nullptr;
+    int frame_rate_subscription_ = 0;
+    bool low_battery_shown_ = false;
+
+    // False if the queue is not started, the caller then applies the update itself
+    template <typename Post>
+    bool PostUpdate(Post post)
+    {
+        std::lock_guard<std::mutex> lock(updates_mutex_);
+        if (updates_timer_ == nullptr)
+        {
+            return false;
+        }
+        post(pending_updates_);
+        updates_pending_.store(true, std::memory_order_release);
+        return true;
+    }
+    void ApplyUpdates();
 };
 
 class DisplayLockGuard
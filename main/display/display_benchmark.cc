@@ -0,0 +1,100 @@
+#include "display_benchmark.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "DisplayBenchmark"
+
+void DisplayBenchmark::OnDisplayEvent(lv_event_t* e) {
+    auto self = static_cast<DisplayBenchmark*>(lv_event_get_user_data(e));
+    auto& stats = self->stats_;
+    int64_t now = esp_timer_get_time();
+    switch (lv_event_get_code(e)) {
+        case LV_EVENT_REFR_START:
+            stats.refresh_start_us = now;
+            break;
+        case LV_EVENT_REFR_READY:
+            if (stats.refresh_start_us != 0) {
+                stats.refresh_us += now - stats.refresh_start_us;
+                stats.frames++;
+            }
+            break;
+        case LV_EVENT_FLUSH_START:
+            stats.flush_start_us = now;
+            break;
+        case LV_EVENT_FLUSH_FINISH:
+            if (stats.flush_start_us != 0) {
+                stats.flush_us += now - stats.flush_start_us;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void DisplayBenchmark::RunScene(const char* name, int step_ms, const std::function<void(int index)>& step) {
+    {
+        DisplayLockGuard lock(display_);
+        stats_ = Stats();
+    }
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; esp_timer_get_time() - start < DISPLAY_BENCHMARK_SCENE_MS * 1000; i++) {
+        step(i);
+        vTaskDelay(step_ms > 0 ? pdMS_TO_TICKS(step_ms) : 1);
+    }
+
+    Stats stats;
+    {
+        DisplayLockGuard lock(display_);
+        stats = stats_;
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start;
+    uint32_t frames = stats.frames > 0 ? stats.frames : 1;
+    ESP_LOGI(TAG, "%-12s %5.1f fps, refresh %5.1f ms, flush %5.1f ms per frame, %lu frames", name,
+             stats.frames * 1000000.0f / elapsed_us, stats.refresh_us / 1000.0f / frames,
+             stats.flush_us / 1000.0f / frames, (unsigned long)stats.frames);
+}
+
+void DisplayBenchmark::Run() {
+    lv_display_t* display = display_->display_;
+    if (display == nullptr) {
+        ESP_LOGW(TAG, "No LVGL display, nothing to measure");
+        return;
+    }
+    ESP_LOGI(TAG, "Rendering benchmark, %dx%d, %d ms per scene", display_->width(), display_->height(),
+             DISPLAY_BENCHMARK_SCENE_MS);
+
+    lv_timer_t* refresh_timer;
+    {
+        DisplayLockGuard lock(display_);
+        lv_display_add_event_cb(display, OnDisplayEvent, LV_EVENT_ALL, this);
+        refresh_timer = lv_display_get_refr_timer(display);
+        lv_timer_set_period(refresh_timer, 1);
+    }
+
+    RunScene("full_screen", 0, [this](int index) {
+        DisplayLockGuard lock(display_);
+        lv_obj_invalidate(lv_screen_active());
+    });
+
+    static const char* const roles[] = {"user", "assistant", "assistant"};
+    RunScene("chat", 300, [this](int index) {
+        char text[96];
+        snprintf(text, sizeof(text), "Message %d: the quick brown fox jumps over the lazy dog", index);
+        display_->SetChatMessage(roles[index % 3], text);
+    });
+
+    display_->SetStatus("Benchmark: a status text long enough to scroll around the status bar");
+    RunScene("status_bar", 100, [](int index) {});
+
+    {
+        DisplayLockGuard lock(display_);
+        display_->ApplyFrameRate();
+        lv_display_remove_event_cb_with_user_data(display, OnDisplayEvent, this);
+        // An empty message leaves the bubbles of the chat scene in the WeChat style
+        display_->ApplyClearChat();
+    }
+    display_->SetStatus("");
+}
@@ -0,0 +1,46 @@
+#ifndef DISPLAY_BENCHMARK_H
+#define DISPLAY_BENCHMARK_H
+
+#include "display.h"
+
+#include <functional>
+
+#define DISPLAY_BENCHMARK_SCENE_MS 5000
+
+/*
+ * Rendering benchmark, run once at boot with CONFIG_DISPLAY_BENCHMARK to compare draw
+ * buffer policies on a board.
+ *
+ * The refresh period of LVGL is lowered to 1 ms for the run, so a scene renders as fast
+ * as drawing and flushing allow:
+ * - full_screen: the whole screen is invalidated for every frame
+ * - chat: a chat message is added every 300 ms and scrolled into view
+ * - status_bar: a long status text scrolls around in the status bar
+ * Per scene the log shows frames per second, the average time of a refresh (render and
+ * flush, including waiting for the previous transfer) and the average time spent in the
+ * flush callback.
+ */
+class DisplayBenchmark {
+public:
+    explicit DisplayBenchmark(Display* display) : display_(display) {}
+
+    void Run();
+
+private:
+    struct Stats {
+        uint32_t frames = 0;
+        int64_t refresh_us = 0;
+        int64_t flush_us = 0;
+        int64_t refresh_start_us = 0;
+        int64_t flush_start_us = 0;
+    };
+
+    Display* display_;
+    Stats stats_;
+
+    // Calls step every step_ms for the duration of the scene, step takes the display lock itself
+    void RunScene(const char* name, int step_ms, const std::function<void(int index)>& step);
+    static void OnDisplayEvent(lv_event_t* e);
+};
+
+#endif // DISPLAY_BENCHMARK_H
@@ -80,8 +80,40 @@ static ThemeColors current_theme = LIGHT_THEME;
 
 LV_FONT_DECLARE(font_awesome_30_4);
 
+// The policy of the board, else the one from Kconfig, else the default of the panel type
+static DisplayBufferPolicy GetBufferPolicy(const DisplayBufferPolicy* board_policy, const DisplayBufferPolicy& panel_default,
+                                           int width, int height, uint32_t* buffer_pixels)
+{
+    DisplayBufferPolicy policy = panel_default;
+    if (board_policy != nullptr) {
+        policy = *board_policy;
+    } else {
+#if CONFIG_DISPLAY_BUFFER_OVERRIDE
+        policy.lines = CONFIG_DISPLAY_BUFFER_LINES;
+        policy.double_buffer = CONFIG_DISPLAY_BUFFER_DOUBLE;
+        policy.spiram = CONFIG_DISPLAY_BUFFER_SPIRAM;
+        policy.full_refresh = CONFIG_DISPLAY_BUFFER_FULL_REFRESH;
+        policy.bounce_buffer = CONFIG_DISPLAY_RGB_BOUNCE_BUFFER;
+#endif
+    }
+    if (policy.lines <= 0 || policy.lines > height) {
+        policy.lines = height;
+    }
+    if (policy.full_refresh && policy.lines != height) {
+        // LVGL renders every frame in one pass, a partial buffer fails its assert
+        ESP_LOGW(TAG, "Full refresh needs a full frame buffer, using %d lines instead of %d", height, policy.lines);
+        policy.lines = height;
+    }
+    *buffer_pixels = width * policy.lines;
+    ESP_LOGI(TAG, "Draw buffer: %d lines x%d in %s, %u bytes each%s", policy.lines, policy.double_buffer ? 2 : 1,
+             policy.spiram ? "PSRAM" : "internal DMA RAM", (unsigned)(*buffer_pixels * sizeof(uint16_t)),
+             policy.full_refresh ? ", full refresh" : "");
+    return policy;
+}
+
 QspiLcdDisplay::QspiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel, int width, int height, int offset_x, 
-    int offset_y, bool mirror_x, bool mirror_y, bool swap_xy, DisplayFonts fonts, esp_lcd_touch_handle_t tp)
+    int offset_y, bool mirror_x, bool mirror_y, bool swap_xy, DisplayFonts fonts, esp_lcd_touch_handle_t tp,
+    const DisplayBufferPolicy* buffer_policy)
     : LcdDisplay(panel_io, panel, fonts)
 {
     width_ = width;
@@ -108,12 +140,19 @@ QspiLcdDisplay::QspiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
     lvgl_port_init(&port_cfg);
 
     ESP_LOGI(TAG, "Adding LCD screen");
+    uint32_t buffer_pixels;
+    DisplayBufferPolicy policy = GetBufferPolicy(buffer_policy, DisplayBufferPolicy{
+        .lines = 20,
+        .double_buffer = false,
+        .spiram = false,
+        .full_refresh = false,
+    }, width_, height_, &buffer_pixels);
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
         .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
-        .double_buffer = false,
+        .buffer_size = buffer_pixels,
+        .double_buffer = policy.double_buffer,
         .trans_size = 0,
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
@@ -125,11 +164,11 @@ QspiLcdDisplay::QspiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
         },
         .color_format = LV_COLOR_FORMAT_RGB565,
         .flags = {
-            .buff_dma = 1,
-            .buff_spiram = 0,
+            .buff_dma = !policy.spiram,
+            .buff_spiram = policy.spiram,
             .sw_rotate = 0,
             .swap_bytes = 1,
-            .full_refresh = 0,
+            .full_refresh = policy.full_refresh,
             .direct_mode = 0,
         },
     };
@@ -168,7 +207,8 @@ QspiLcdDisplay::QspiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
 SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                              int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy,
                              DisplayFonts fonts,
-                             esp_lcd_touch_handle_t tp)
+                             esp_lcd_touch_handle_t tp,
+                             const DisplayBufferPolicy* buffer_policy)
     : LcdDisplay(panel_io, panel, fonts)
 {
     width_ = width;
@@ -193,12 +233,19 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
     lvgl_port_init(&port_cfg);
 
     ESP_LOGI(TAG, "Adding LCD screen");
+    uint32_t buffer_pixels;
+    DisplayBufferPolicy policy = GetBufferPolicy(buffer_policy, DisplayBufferPolicy{
+        .lines = 0,
+        .double_buffer = false,
+        .spiram = true,
+        .full_refresh = true,
+    }, width_, height_, &buffer_pixels);
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
         .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_*height_),
-        .double_buffer = false,
+        .buffer_size = buffer_pixels,
+        .double_buffer = policy.double_buffer,
         .trans_size = 0,
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
@@ -210,11 +257,11 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         },
         .color_format = LV_COLOR_FORMAT_RGB565,
         .flags = {
-            .buff_dma = 0,
-            .buff_spiram = 1,
+            .buff_dma = !policy.spiram,
+            .buff_spiram = policy.spiram,
             .sw_rotate = 0,
             .swap_bytes = 1,
-            .full_refresh = 1,
+            .full_refresh = policy.full_refresh,
             .direct_mode = 0,
         },
 
@@ -245,7 +292,8 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
 RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                            int width, int height, int offset_x, int offset_y,
                            bool mirror_x, bool mirror_y, bool swap_xy,
-                           DisplayFonts fonts)
+                           DisplayFonts fonts,
+                           const DisplayBufferPolicy* buffer_policy)
     : LcdDisplay(panel_io, panel, fonts) {
     width_ = width;
     height_ = height;
@@ -267,11 +315,19 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
     lvgl_port_init(&port_cfg);
 
     ESP_LOGI(TAG, "Adding LCD screen");
+    uint32_t buffer_pixels;
+    DisplayBufferPolicy policy = GetBufferPolicy(buffer_policy, DisplayBufferPolicy{
+        .lines = 20,
+        .double_buffer = true,
+        .spiram = false,
+        .full_refresh = true,
+        .bounce_buffer = true,
+    }, width_, height_, &buffer_pixels);
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
-        .double_buffer = true,
+        .buffer_size = buffer_pixels,
+        .double_buffer = policy.double_buffer,
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
         .rotation = {
@@ -280,16 +336,17 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
             .mirror_y = mirror_y,
         },
         .flags = {
-            .buff_dma = 1,
+            .buff_dma = !policy.spiram,
+            .buff_spiram = policy.spiram,
             .swap_bytes = 0,
-            .full_refresh = 1,
+            .full_refresh = policy.full_refresh,
             .direct_mode = 1,
         },
     };
 
     const lvgl_port_display_rgb_cfg_t rgb_cfg = {
         .flags = {
-            .bb_mode = true,
+            .bb_mode = policy.bounce_buffer,
             .avoid_tearing = true,
         }};
 
@@ -333,6 +390,16 @@ LcdDisplay::~LcdDisplay() {
     {
         lv_obj_del(container_);
     }
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    // The bubbles were deleted with the content, the styles are no longer referenced
+    if (chat_bubbles_[0].row != nullptr) {
+        for (int role = 0; role < kChatRoleCount; role++) {
+            lv_style_reset(&chat_row_styles_[role]);
+            lv_style_reset(&chat_bubble_styles_[role]);
+        }
+        lv_style_reset(&chat_label_style_);
+    }
+#endif
     if (display_ != nullptr)
     {
         lv_display_delete(display_);
@@ -361,6 +428,7 @@ void LcdDisplay::Unlock()
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
+    AddTraceEvents();
 
     auto screen = lv_screen_active();
     lv_obj_set_style_text_font(screen, fonts_.text_font, 0);
@@ -402,8 +470,9 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
     lv_obj_set_style_pad_row(content_, 10, 0); // Space between messages
 
-    // We'll create chat messages dynamically in SetChatMessage
+    // Message rows are created up front and reused, see ApplyChatMessage
     chat_message_label_ = nullptr;
+    SetupChatBubbles();
 
     /* Status bar */
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
@@ -467,194 +536,144 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_text_color(low_battery_label_, lv_color_white(), 0);
     lv_obj_center(low_battery_label_);
     lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+
+    StartUpdateQueue();
 }
 
-#define  MAX_MESSAGES 20
-void LcdDisplay::SetChatMessage(const char* role, const char* content) {
-    DisplayLockGuard lock(this);
-    if (content_ == nullptr) {
-        return;
-    }
-    
-    //避免出现空的消息框
-    if(strlen(content) == 0) return;
-    
-    // 检查消息数量是否超过限制
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // 删除最早的消息（第一个子对象）
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
-        }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
-        }
+void LcdDisplay::SetupChatBubbles() {
+    for (int role = 0; role < kChatRoleCount; role++) {
+        auto row_style = &chat_row_styles_[role];
+        lv_style_init(row_style);
+        lv_style_set_width(row_style, lv_pct(100));
+        lv_style_set_height(row_style, LV_SIZE_CONTENT);
+        lv_style_set_bg_opa(row_style, LV_OPA_TRANSP);
+        lv_style_set_border_width(row_style, 0);
+        lv_style_set_pad_all(row_style, 0);
+        lv_style_set_layout(row_style, LV_LAYOUT_FLEX);
+        lv_style_set_flex_flow(row_style, LV_FLEX_FLOW_ROW);
+        lv_style_set_flex_cross_place(row_style, LV_FLEX_ALIGN_CENTER);
+
+        auto bubble_style = &chat_bubble_styles_[role];
+        lv_style_init(bubble_style);
+        lv_style_set_width(bubble_style, LV_SIZE_CONTENT);
+        lv_style_set_height(bubble_style, LV_SIZE_CONTENT);
+        lv_style_set_radius(bubble_style, 8);
+        lv_style_set_bg_opa(bubble_style, LV_OPA_COVER);
+        lv_style_set_border_width(bubble_style, 1);
+        lv_style_set_pad_all(bubble_style, 8);
+    }
+    // User messages on the right, assistant on the left, system centered
+    lv_style_set_flex_main_place(&chat_row_styles_[kChatRoleUser], LV_FLEX_ALIGN_END);
+    lv_style_set_pad_right(&chat_row_styles_[kChatRoleUser], 25);
+    lv_style_set_flex_main_place(&chat_row_styles_[kChatRoleAssistant], LV_FLEX_ALIGN_START);
+    lv_style_set_flex_main_place(&chat_row_styles_[kChatRoleSystem], LV_FLEX_ALIGN_CENTER);
+
+    // The label sizes itself to the text up to 85% of the screen and wraps beyond
+    lv_style_init(&chat_label_style_);
+    lv_style_set_width(&chat_label_style_, LV_SIZE_CONTENT);
+    lv_style_set_min_width(&chat_label_style_, 20);
+    lv_style_set_max_width(&chat_label_style_, LV_HOR_RES * 85 / 100 - 16);
+    lv_style_set_text_font(&chat_label_style_, fonts_.text_font);
+    UpdateChatStyles();
+
+    for (auto& item : chat_bubbles_) {
+        item.row = lv_obj_create(content_);
+        lv_obj_add_style(item.row, &chat_row_styles_[item.role], 0);
+        lv_obj_remove_flag(item.row, LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_add_flag(item.row, LV_OBJ_FLAG_HIDDEN);
+
+        item.bubble = lv_obj_create(item.row);
+        lv_obj_add_style(item.bubble, &chat_bubble_styles_[item.role], 0);
+        lv_obj_set_scrollbar_mode(item.bubble, LV_SCROLLBAR_MODE_OFF);
+
+        item.label = lv_label_create(item.bubble);
+        lv_obj_add_style(item.label, &chat_label_style_, 0);
+        lv_label_set_long_mode(item.label, LV_LABEL_LONG_WRAP);
+    }
+    chat_bubble_count_ = 0;
+    chat_bubble_last_ = 0;
+}
+
+void LcdDisplay::UpdateChatStyles() {
+    const lv_color_t backgrounds[kChatRoleCount] = {
+        current_theme.user_bubble, current_theme.assistant_bubble, current_theme.system_bubble,
+    };
+    for (int role = 0; role < kChatRoleCount; role++) {
+        auto style = &chat_bubble_styles_[role];
+        lv_style_set_bg_color(style, backgrounds[role]);
+        lv_style_set_border_color(style, current_theme.border);
+        // The label inherits the text color from its bubble
+        lv_style_set_text_color(style, role == kChatRoleSystem ? current_theme.system_text : current_theme.text);
+        lv_obj_report_style_change(style);
     }
-    
-    // 折叠系统消息（如果是系统消息，检查最后一个消息是否也是系统消息）
-    if (strcmp(role, "system") == 0 && child_count > 0) {
-        // 获取最后一个消息容器
-        lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-        if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-            // 获取容器内的气泡
-            lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-            if (last_bubble != nullptr) {
-                // 检查气泡类型是否为系统消息
-                void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                    // 如果最后一个消息也是系统消息，则删除它
-                    lv_obj_del(last_container);
-                }
-            }
-        }
+}
+
+void LcdDisplay::SetChatBubbleRole(ChatBubble& item, ChatRole role) {
+    if (item.role == role) {
+        return;
     }
-    
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 1, 0);
-    lv_obj_set_style_border_color(msg_bubble, current_theme.border, 0);
-    lv_obj_set_style_pad_all(msg_bubble, 8, 0);
-
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // 计算文本实际宽度
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), fonts_.text_font, 0);
+    lv_obj_remove_style(item.row, &chat_row_styles_[item.role], 0);
+    lv_obj_add_style(item.row, &chat_row_styles_[role], 0);
+    lv_obj_remove_style(item.bubble, &chat_bubble_styles_[item.role], 0);
+    lv_obj_add_style(item.bubble, &chat_bubble_styles_[role], 0);
+    item.role = role;
+}
 
-    // 计算气泡宽度
-    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 屏幕宽度的85%
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // 确保文本宽度不小于最小宽度
-    if (text_width < min_width) {
-        text_width = min_width;
+void LcdDisplay::ApplyClearChat() {
+    if (content_ == nullptr) {
+        return;
     }
+    // Back in pool order, reused rows were moved to the end of the chat
+    for (auto& item : chat_bubbles_) {
+        lv_obj_add_flag(item.row, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_move_foreground(item.row);
+    }
+    chat_bubble_count_ = 0;
+    chat_bubble_last_ = 0;
+}
 
-    // 如果文本宽度小于最大宽度，使用文本宽度
-    if (text_width < max_width) {
-        bubble_width = text_width; 
-    } else {
-        bubble_width = max_width;
+void LcdDisplay::ApplyChatMessage(const char* role, const char* content) {
+    if (content_ == nullptr) {
+        return;
     }
     
-    // 设置消息文本的宽度
-    lv_obj_set_width(msg_text, bubble_width);  // 减去padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
-    lv_obj_set_style_text_font(msg_text, fonts_.text_font, 0);
-
-    // 设置气泡宽度
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
+    //避免出现空的消息框
+    if(strlen(content) == 0) return;
 
-    // Set alignment and style based on message role
+    ChatRole chat_role = kChatRoleAssistant;
     if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme.user_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme.assistant_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
+        chat_role = kChatRoleUser;
     } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme.system_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme.system_text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
+        chat_role = kChatRoleSystem;
     }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // 为系统消息创建全宽容器以确保居中对齐
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // 使容器透明且无边框
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // 将消息气泡移入此容器
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // 将气泡居中对齐在容器中
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        
-        // 自动滚动底部
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
 
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
+    ChatBubble* item;
+    if (chat_role == kChatRoleSystem && chat_bubble_count_ > 0 &&
+        chat_bubbles_[chat_bubble_last_].role == kChatRoleSystem) {
+        // 折叠系统消息：上一条也是系统消息时直接替换它的内容
+        item = &chat_bubbles_[chat_bubble_last_];
+    } else {
+        // The rows are used in turn, once all are shown the oldest becomes the newest
+        chat_bubble_last_ = chat_bubble_count_ == 0 ? 0 : (chat_bubble_last_ + 1) % CHAT_BUBBLE_POOL_SIZE;
+        item = &chat_bubbles_[chat_bubble_last_];
+        if (chat_bubble_count_ < CHAT_BUBBLE_POOL_SIZE) {
+            chat_bubble_count_++;
+            lv_obj_remove_flag(item->row, LV_OBJ_FLAG_HIDDEN);
+        } else {
+            lv_obj_move_foreground(item->row);
+        }
+        SetChatBubbleRole(*item, chat_role);
     }
-    
+    lv_label_set_text(item->label, content);
+    lv_obj_scroll_to_view_recursive(item->row, LV_ANIM_ON);
+
     // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    chat_message_label_ = item->label;
 }
 #else
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
+    AddTraceEvents();
 
     auto screen = lv_screen_active();
     lv_obj_set_style_text_font(screen, fonts_.text_font, 0);
@@ -750,10 +769,12 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_text_color(low_battery_label_, lv_color_white(), 0);
     lv_obj_center(low_battery_label_);
     lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+
+    StartUpdateQueue();
 }
 #endif
 
-void LcdDisplay::SetEmotion(const char *emotion)
+void LcdDisplay::ApplyEmotion(const char *emotion)
 {
     struct Emotion
     {
@@ -790,7 +811,6 @@ void LcdDisplay::SetEmotion(const char *emotion)
                            [&emotion_view](const Emotion &e)
                            { return e.text == emotion_view; });
 
-    DisplayLockGuard lock(this);
     if (emotion_label_ == nullptr)
     {
         return;
@@ -808,9 +828,8 @@ void LcdDisplay::SetEmotion(const char *emotion)
     }
 }
 
-void LcdDisplay::SetIcon(const char *icon)
+void LcdDisplay::ApplyIcon(const char *icon)
 {
-    DisplayLockGuard lock(this);
     if (emotion_label_ == nullptr)
     {
         return;
@@ -876,121 +895,9 @@ void LcdDisplay::SetTheme(const std::string& theme_name, bool permanent) {
         lv_obj_set_style_bg_color(content_, current_theme.chat_background, 0);
         lv_obj_set_style_border_color(content_, current_theme.border, 0);
         
-        // If we have the chat message style, update all message bubbles
+        // The bubbles share one style per role, updating the styles restyles all of them
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
-        // Iterate through all children of content (message containers or bubbles)
-        uint32_t child_count = lv_obj_get_child_cnt(content_);
-        for (uint32_t i = 0; i < child_count; i++) {
-            lv_obj_t* obj = lv_obj_get_child(content_, i);
-            if (obj == nullptr) continue;
-            
-            lv_obj_t* bubble = nullptr;
-            
-            // 检查这个对象是容器还是气泡
-            // 如果是容器（用户或系统消息），则获取其子对象作为气泡
-            // 如果是气泡（助手消息），则直接使用
-            if (lv_obj_get_child_cnt(obj) > 0) {
-                // 可能是容器，检查它是否为用户或系统消息容器
-                // 用户和系统消息容器是透明的
-                lv_opa_t bg_opa = lv_obj_get_style_bg_opa(obj, 0);
-                if (bg_opa == LV_OPA_TRANSP) {
-                    // 这是用户或系统消息的容器
-                    bubble = lv_obj_get_child(obj, 0);
-                } else {
-                    // 这可能是助手消息的气泡自身
-                    bubble = obj;
-                }
-            } else {
-                // 没有子元素，可能是其他UI元素，跳过
-                continue;
-            }
-            
-            if (bubble == nullptr) continue;
-            
-            // 使用保存的用户数据来识别气泡类型
-            void* bubble_type_ptr = lv_obj_get_user_data(bubble);
-            if (bubble_type_ptr != nullptr) {
-                const char* bubble_type = static_cast<const char*>(bubble_type_ptr);
-                
-                // 根据气泡类型应用正确的颜色
-                if (strcmp(bubble_type, "user") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme.user_bubble, 0);
-                } else if (strcmp(bubble_type, "assistant") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme.assistant_bubble, 0); 
-                } else if (strcmp(bubble_type, "system") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme.system_bubble, 0);
-                }
-                
-                // Update border color
-                lv_obj_set_style_border_color(bubble, current_theme.border, 0);
-                
-                // Update text color for the message
-                if (lv_obj_get_child_cnt(bubble) > 0) {
-                    lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                    if (text != nullptr) {
-                        // 根据气泡类型设置文本颜色
-                        if (strcmp(bubble_type, "system") == 0) {
-                            lv_obj_set_style_text_color(text, current_theme.system_text, 0);
-                        } else {
-                            lv_obj_set_style_text_color(text, current_theme.text, 0);
-                        }
-                    }
-                }
-            } else {
-                // 如果没有标记，回退到之前的逻辑（颜色比较）
-                // ...保留原有的回退逻辑...
-                lv_color_t bg_color = lv_obj_get_style_bg_color(bubble, 0);
-            
-                // 改进bubble类型检测逻辑，不仅使用颜色比较
-                bool is_user_bubble = false;
-                bool is_assistant_bubble = false;
-                bool is_system_bubble = false;
-            
-                // 检查用户bubble
-                if (lv_color_eq(bg_color, DARK_USER_BUBBLE_COLOR) || 
-                    lv_color_eq(bg_color, LIGHT_USER_BUBBLE_COLOR) ||
-                    lv_color_eq(bg_color, current_theme.user_bubble)) {
-                    is_user_bubble = true;
-                }
-                // 检查系统bubble
-                else if (lv_color_eq(bg_color, DARK_SYSTEM_BUBBLE_COLOR) || 
-                         lv_color_eq(bg_color, LIGHT_SYSTEM_BUBBLE_COLOR) ||
-                         lv_color_eq(bg_color, current_theme.system_bubble)) {
-                    is_system_bubble = true;
-                }
-                // 剩余的都当作助手bubble处理
-                else {
-                    is_assistant_bubble = true;
-                }
-            
-                // 根据bubble类型应用正确的颜色
-                if (is_user_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme.user_bubble, 0);
-                } else if (is_assistant_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme.assistant_bubble, 0);
-                } else if (is_system_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme.system_bubble, 0);
-                }
-                
-                // Update border color
-                lv_obj_set_style_border_color(bubble, current_theme.border, 0);
-                
-                // Update text color for the message
-                if (lv_obj_get_child_cnt(bubble) > 0) {
-                    lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                    if (text != nullptr) {
-                        // 回退到颜色检测逻辑
-                        if (lv_color_eq(bg_color, current_theme.system_bubble) ||
-                            lv_color_eq(bg_color, DARK_SYSTEM_BUBBLE_COLOR) || 
-                            lv_color_eq(bg_color, LIGHT_SYSTEM_BUBBLE_COLOR)) {
-                            lv_obj_set_style_text_color(text, current_theme.system_text, 0);
-                        } else {
-                            lv_obj_set_style_text_color(text, current_theme.text, 0);
-                        }
-                    }
-                }
-            }
-        }
+        UpdateChatStyles();
 #else
         // Simple UI mode - just update the main chat message
         if (chat_message_label_ != nullptr) {
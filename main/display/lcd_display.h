@@ -10,6 +10,20 @@
 
 #include <atomic>
 
+// Messages kept on screen in the WeChat style
+#define CHAT_BUBBLE_POOL_SIZE 20
+
+// Draw buffers of LVGL. Every panel type has its own default, a board can pass its own
+// policy to the constructor, e.g. built from values in its config.h.
+// CONFIG_DISPLAY_BUFFER_OVERRIDE replaces the defaults of boards that do not
+struct DisplayBufferPolicy {
+    int lines = 20;                 // Lines per buffer, 0 for the full frame
+    bool double_buffer = false;     // Render into one buffer while the other is flushed
+    bool spiram = false;            // PSRAM, otherwise internal DMA capable memory
+    bool full_refresh = false;      // Redraw the whole screen every frame
+    bool bounce_buffer = true;      // RGB panels: feed the PSRAM frame through internal buffers
+};
+
 class LcdDisplay : public Display
 {
 protected:
@@ -27,10 +41,46 @@ protected:
 
     DisplayFonts fonts_;
 
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    enum ChatRole {
+        kChatRoleUser,
+        kChatRoleAssistant,
+        kChatRoleSystem,
+        kChatRoleCount
+    };
+
+    // A message row of the chat, created once and reused for later messages
+    struct ChatBubble {
+        lv_obj_t* row = nullptr;        // Full width, places the bubble by role
+        lv_obj_t* bubble = nullptr;
+        lv_obj_t* label = nullptr;
+        ChatRole role = kChatRoleAssistant;
+    };
+
+    ChatBubble chat_bubbles_[CHAT_BUBBLE_POOL_SIZE];
+    size_t chat_bubble_count_ = 0;      // Rows shown, the oldest is reused once all are
+    size_t chat_bubble_last_ = 0;       // Row of the latest message
+    lv_style_t chat_row_styles_[kChatRoleCount];
+    lv_style_t chat_bubble_styles_[kChatRoleCount];
+    lv_style_t chat_label_style_;
+
+    void SetupChatBubbles();
+    // Colors of the shared styles, every bubble follows without being touched
+    void UpdateChatStyles();
+    void SetChatBubbleRole(ChatBubble& bubble, ChatRole role);
+#endif
+
     void SetupUI();
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
+    virtual void ApplyEmotion(const char* emotion) override;
+    virtual void ApplyIcon(const char* icon) override;
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    virtual void ApplyChatMessage(const char* role, const char* content) override;
+    virtual void ApplyClearChat() override;
+#endif
+
 protected:
     // 添加protected构造函数
     LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
@@ -40,11 +90,6 @@ protected:
 
 public:
     ~LcdDisplay();
-    virtual void SetEmotion(const char* emotion) override;
-    virtual void SetIcon(const char* icon) override;
-#if CONFIG_USE_WECHAT_MESSAGE_STYLE
-    virtual void SetChatMessage(const char* role, const char* content) override; 
-#endif  
 
     // Add theme switching function
     virtual void SetTheme(const std::string& theme_name, bool permanent = true) override;
@@ -57,7 +102,8 @@ public:
     RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                   int width, int height, int offset_x, int offset_y,
                   bool mirror_x, bool mirror_y, bool swap_xy,
-                  DisplayFonts fonts);
+                  DisplayFonts fonts,
+                  const DisplayBufferPolicy* buffer_policy = nullptr);
 };
 
 // MIPI LCD显示器
@@ -78,7 +124,8 @@ public:
                   int width, int height, int offset_x, int offset_y,
                   bool mirror_x, bool mirror_y, bool swap_xy,
                   DisplayFonts fonts,
-                  esp_lcd_touch_handle_t tp = nullptr);
+                  esp_lcd_touch_handle_t tp = nullptr,
+                  const DisplayBufferPolicy* buffer_policy = nullptr);
 };
 
 // QSPI LCD显示器
@@ -89,7 +136,8 @@ public:
                    int width, int height, int offset_x, int offset_y,
                    bool mirror_x, bool mirror_y, bool swap_xy,
                    DisplayFonts fonts,
-                   esp_lcd_touch_handle_t tp = nullptr);
+                   esp_lcd_touch_handle_t tp = nullptr,
+                   const DisplayBufferPolicy* buffer_policy = nullptr);
 };
 
 // MCU8080 LCD显示器
@@ -22,6 +22,7 @@ private:
 
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
+    virtual void ApplyChatMessage(const char* role, const char* content) override;
 
     void SetupUI_128x64();
     void SetupUI_128x32();
@@ -30,8 +31,6 @@ public:
     OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel, int width, int height, bool mirror_x, bool mirror_y,
                 DisplayFonts fonts);
     ~OledDisplay();
-
-    virtual void SetChatMessage(const char* role, const char* content) override;
 };
 
 #endif // OLED_DISPLAY_H
@@ -0,0 +1,164 @@
+#include "event_trace.h"
+#include "console_dump.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+#define TAG "EventTrace"
+
+#ifndef CONFIG_EVENT_TRACE_EVENTS_PER_CORE
+#define CONFIG_EVENT_TRACE_EVENTS_PER_CORE 4096
+#endif
+
+#define EVENT_TRACE_MAGIC "XZTR"
+#define EVENT_TRACE_VERSION 1
+
+EventTrace::EventTrace() {
+    // Round down to a power of two so that the slot index is a simple mask
+    capacity_ = 1;
+    while (capacity_ * 2 <= CONFIG_EVENT_TRACE_EVENTS_PER_CORE) {
+        capacity_ *= 2;
+    }
+
+    for (int i = 0; i < portNUM_PROCESSORS && i < EVENT_TRACE_MAX_CORES; i++) {
+        size_t size = capacity_ * sizeof(TraceEvent);
+        auto events = (TraceEvent*)heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM);
+        if (events == nullptr) {
+            events = (TraceEvent*)heap_caps_calloc(1, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        }
+        if (events == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate %u bytes for core %d", size, i);
+            return;
+        }
+        rings_[i].events = events;
+    }
+    ESP_LOGI(TAG, "Event trace enabled, %lu events per core", capacity_);
+    enabled_ = true;
+}
+
+EventTrace::~EventTrace() {
+    for (auto& ring : rings_) {
+        if (ring.events != nullptr) {
+            heap_caps_free(ring.events);
+        }
+    }
+}
+
+uint16_t EventTrace::Intern(const char* name) {
+    std::lock_guard<std::mutex> lock(names_mutex_);
+    for (uint16_t i = 0; i < name_count_; i++) {
+        if (names_[i] == name || strcmp(names_[i], name) == 0) {
+            return i;
+        }
+    }
+    if (name_count_ >= EVENT_TRACE_MAX_NAMES) {
+        ESP_LOGW(TAG, "Too many trace names, dropping %s", name);
+        return EVENT_TRACE_MAX_NAMES - 1;
+    }
+    names_[name_count_] = name;
+    return name_count_++;
+}
+
+void EventTrace::Record(TraceEventType type, uint16_t name_id, int32_t value) {
+    if (!enabled_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    uint8_t core = xPortGetCoreID();
+    auto& ring = rings_[core];
+    // The task may be preempted between fetch_add and the store below, but the
+    // slot is owned exclusively, so concurrent writers never share an event
+    uint32_t slot = ring.head.fetch_add(1, std::memory_order_relaxed) & (capacity_ - 1);
+    auto& event = ring.events[slot];
+    event.timestamp_us = (uint32_t)esp_timer_get_time();
+    event.name_id = name_id;
+    event.type = type;
+    event.core = core;
+    event.task = (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle();
+    event.value = value;
+}
+
+void EventTrace::Clear() {
+    for (auto& ring : rings_) {
+        ring.head = 0;
+    }
+}
+
+/*
+ * Dump layout (little endian):
+ * |magic 4|version 2u|name_count 2u|task_count 2u|core_count 2u|
+ * name_count x |name_id 2u|length 1u|name length|
+ * task_count x |task 4u|length 1u|name length|
+ * core_count x |event_count 4u|event_count x TraceEvent|
+ */
+void EventTrace::Dump(std::function<void(const uint8_t* data, size_t size)> writer) {
+    bool was_enabled = enabled_.exchange(false);
+
+    auto write_u8 = [&writer](uint8_t value) {
+        writer(&value, sizeof(value));
+    };
+    auto write_u16 = [&writer](uint16_t value) {
+        writer((const uint8_t*)&value, sizeof(value));
+    };
+    auto write_u32 = [&writer](uint32_t value) {
+        writer((const uint8_t*)&value, sizeof(value));
+    };
+    auto write_string = [&writer, &write_u8](const char* str) {
+        size_t length = strnlen(str, 255);
+        write_u8(length);
+        writer((const uint8_t*)str, length);
+    };
+
+    // Resolve the names of tasks that are still alive
+    UBaseType_t task_count = uxTaskGetNumberOfTasks() + 5;
+    std::vector<TaskStatus_t> tasks(task_count);
+    task_count = uxTaskGetSystemState(tasks.data(), task_count, nullptr);
+
+    int core_count = 0;
+    while (core_count < EVENT_TRACE_MAX_CORES && rings_[core_count].events != nullptr) {
+        core_count++;
+    }
+
+    writer((const uint8_t*)EVENT_TRACE_MAGIC, 4);
+    write_u16(EVENT_TRACE_VERSION);
+    {
+        std::lock_guard<std::mutex> lock(names_mutex_);
+        write_u16(name_count_);
+        write_u16(task_count);
+        write_u16(core_count);
+        for (uint16_t i = 0; i < name_count_; i++) {
+            write_u16(i);
+            write_string(names_[i]);
+        }
+    }
+    for (UBaseType_t i = 0; i < task_count; i++) {
+        write_u32((uint32_t)(uintptr_t)tasks[i].xHandle);
+        write_string(tasks[i].pcTaskName);
+    }
+
+    for (int i = 0; i < core_count; i++) {
+        auto& ring = rings_[i];
+        uint32_t head = ring.head.load();
+        uint32_t count = head < capacity_ ? head : capacity_;
+        write_u32(count);
+        // Oldest event first
+        for (uint32_t j = head - count; j != head; j++) {
+            writer((const uint8_t*)&ring.events[j & (capacity_ - 1)], sizeof(TraceEvent));
+        }
+    }
+
+    enabled_ = was_enabled;
+}
+
+void EventTrace::DumpToConsole() {
+    ConsoleDump console("TRACE");
+    Dump([&console](const uint8_t* data, size_t size) { console.Write(data, size); });
+}
@@ -0,0 +1,118 @@
+#ifndef _EVENT_TRACE_H_
+#define _EVENT_TRACE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <functional>
+
+/*
+ * Compact binary event trace.
+ *
+ * Events are written lock-free into one ring per core (PSRAM when available),
+ * dumped as a binary blob and converted on the host by
+ * scripts/trace_tools/trace_to_chrome.py into Chrome trace JSON, which can be
+ * opened in chrome://tracing or https://ui.perfetto.dev
+ *
+ * Usage:
+ *   TRACE_SCOPE("opus_decode");
+ *   TRACE_BEGIN("hello"); ... TRACE_END("hello");
+ *   TRACE_INSTANT("wake_word");
+ *   TRACE_COUNTER("decode_queue", queue.size());
+ *
+ * Event names must be string literals, they are interned once per call site.
+ */
+
+enum TraceEventType : uint8_t {
+    kTraceEventBegin = 0,
+    kTraceEventEnd = 1,
+    kTraceEventInstant = 2,
+    kTraceEventCounter = 3,
+};
+
+struct TraceEvent {
+    uint32_t timestamp_us;  // Low 32 bits of esp_timer_get_time()
+    uint16_t name_id;
+    uint8_t type;           // TraceEventType
+    uint8_t core;
+    uint32_t task;          // TaskHandle_t of the recording task
+    int32_t value;          // Counter value, 0 for other events
+} __attribute__((packed));
+
+static_assert(sizeof(TraceEvent) == 16, "TraceEvent must stay 16 bytes");
+
+#define EVENT_TRACE_MAX_CORES 2
+#define EVENT_TRACE_MAX_NAMES 256
+
+class EventTrace {
+public:
+    static EventTrace& GetInstance() {
+        static EventTrace instance;
+        return instance;
+    }
+    // 删除拷贝构造函数和赋值运算符
+    EventTrace(const EventTrace&) = delete;
+    EventTrace& operator=(const EventTrace&) = delete;
+
+    uint16_t Intern(const char* name);
+    void Record(TraceEventType type, uint16_t name_id, int32_t value = 0);
+
+    void SetEnabled(bool enabled) { enabled_ = enabled; }
+    bool IsEnabled() const { return enabled_; }
+    void Clear();
+
+    // Write the binary dump through the writer in small chunks
+    void Dump(std::function<void(const uint8_t* data, size_t size)> writer);
+    // Print the dump as base64 between BEGIN/END markers on the console
+    void DumpToConsole();
+
+private:
+    EventTrace();
+    ~EventTrace();
+
+    struct Ring {
+        TraceEvent* events = nullptr;
+        std::atomic<uint32_t> head{0};
+    };
+
+    Ring rings_[EVENT_TRACE_MAX_CORES];
+    uint32_t capacity_ = 0;
+    std::atomic<bool> enabled_{false};
+
+    std::mutex names_mutex_;
+    const char* names_[EVENT_TRACE_MAX_NAMES] = {};
+    uint16_t name_count_ = 0;
+};
+
+class EventTraceScope {
+public:
+    EventTraceScope(uint16_t name_id) : name_id_(name_id) {
+        EventTrace::GetInstance().Record(kTraceEventBegin, name_id_);
+    }
+    ~EventTraceScope() {
+        EventTrace::GetInstance().Record(kTraceEventEnd, name_id_);
+    }
+
+private:
+    uint16_t name_id_;
+};
+
+#if CONFIG_USE_EVENT_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_NAME_ID(name) ([]() { static const uint16_t id = EventTrace::GetInstance().Intern(name); return id; }())
+#define TRACE_BEGIN(name) EventTrace::GetInstance().Record(kTraceEventBegin, TRACE_NAME_ID(name))
+#define TRACE_END(name) EventTrace::GetInstance().Record(kTraceEventEnd, TRACE_NAME_ID(name))
+#define TRACE_INSTANT(name) EventTrace::GetInstance().Record(kTraceEventInstant, TRACE_NAME_ID(name))
+#define TRACE_COUNTER(name, value) EventTrace::GetInstance().Record(kTraceEventCounter, TRACE_NAME_ID(name), (int32_t)(value))
+#define TRACE_SCOPE(name) EventTraceScope TRACE_CONCAT(trace_scope_, __LINE__)(TRACE_NAME_ID(name))
+#else
+#define TRACE_BEGIN(name) do {} while (0)
+#define TRACE_END(name) do {} while (0)
+#define TRACE_INSTANT(name) do {} while (0)
+#define TRACE_COUNTER(name, value) do {} while (0)
+#define TRACE_SCOPE(name) do {} while (0)
+#endif
+
+#endif // _EVENT_TRACE_H_
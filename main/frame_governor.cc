@@ -0,0 +1,90 @@
+#include "frame_governor.h"
+#include "application.h"
+#include "event_trace.h"
+
+#include <esp_log.h>
+
+#define TAG "FrameGovernor"
+
+static const char* const rate_names[] = {"paused", "low", "full"};
+
+void FrameGovernor::OnStateChanged() {
+    auto device_state = Application::GetInstance().GetDeviceState();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        device_state_ = device_state;
+    }
+    Update();
+}
+
+void FrameGovernor::SetSleepMode(bool sleeping) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sleeping_ = sleeping;
+    }
+    Update();
+}
+
+void FrameGovernor::SetBacklight(uint8_t brightness) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        backlight_off_ = brightness == 0;
+    }
+    Update();
+}
+
+void FrameGovernor::SetSpectrumShown(bool shown) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        spectrum_shown_ = shown;
+    }
+    Update();
+}
+
+int FrameGovernor::Subscribe(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscribers_.emplace_back(++next_id_, std::move(callback));
+    return next_id_;
+}
+
+void FrameGovernor::Unsubscribe(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = subscribers_.begin(); it != subscribers_.end(); ++it) {
+        if (it->first == id) {
+            subscribers_.erase(it);
+            return;
+        }
+    }
+}
+
+void FrameGovernor::Update() {
+    std::vector<std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        FrameRate rate;
+        if (backlight_off_) {
+            rate = kFrameRatePaused;
+        } else if (sleeping_) {
+            rate = kFrameRateLow;
+        } else if (spectrum_shown_) {
+            rate = kFrameRateFull;
+        } else if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateUnknown ||
+                   device_state_ == kDeviceStateFatalError) {
+            rate = kFrameRateLow;
+        } else {
+            rate = kFrameRateFull;
+        }
+        if (rate_.exchange(rate, std::memory_order_relaxed) == rate) {
+            return;
+        }
+        ESP_LOGI(TAG, "Frame rate: %s", rate_names[rate]);
+        TRACE_COUNTER("frame_rate", rate);
+        // Called without the lock, a subscriber may take locks that are held while the inputs change
+        for (auto& subscriber : subscribers_) {
+            callbacks.push_back(subscriber.second);
+        }
+    }
+    for (auto& callback : callbacks) {
+        callback();
+    }
+}
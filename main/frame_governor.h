@@ -0,0 +1,75 @@
+#ifndef FRAME_GOVERNOR_H
+#define FRAME_GOVERNOR_H
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <functional>
+
+/*
+ * One frame rate for every display and LED animation, chosen from what the device is doing.
+ *
+ * Full while a conversation runs, the spectrum is shown or the device is starting, configuring
+ * or upgrading. Low, every period CONFIG_FRAME_RATE_LOW_DIVIDER times longer, when idle or in
+ * the sleep mode of the power save timer. Paused when the backlight is off, which stops the
+ * display refresh only: LED animations keep running at the low rate.
+ *
+ * Subscribers are called from the task that changed the rate, after the change, and read the
+ * new rate themselves. They must not assume they run on any particular task, nor block on locks
+ * such as the display lock.
+ */
+
+#ifndef CONFIG_FRAME_RATE_LOW_DIVIDER
+#define CONFIG_FRAME_RATE_LOW_DIVIDER 4
+#endif
+
+enum FrameRate {
+    kFrameRatePaused,
+    kFrameRateLow,
+    kFrameRateFull,
+};
+
+class FrameGovernor {
+public:
+    static FrameGovernor& GetInstance() {
+        static FrameGovernor instance;
+        return instance;
+    }
+    // Delete copy constructor and assignment operator
+    FrameGovernor(const FrameGovernor&) = delete;
+    FrameGovernor& operator=(const FrameGovernor&) = delete;
+
+    // Inputs
+    void OnStateChanged();
+    void SetSleepMode(bool sleeping);
+    void SetBacklight(uint8_t brightness);
+    void SetSpectrumShown(bool shown);
+
+    FrameRate rate() const { return rate_.load(std::memory_order_relaxed); }
+    bool paused() const { return rate() == kFrameRatePaused; }
+    // Period of something running every full_ms at full rate, longer at low rate and while paused
+    uint32_t Period(uint32_t full_ms) const {
+        return rate() == kFrameRateFull ? full_ms : full_ms * CONFIG_FRAME_RATE_LOW_DIVIDER;
+    }
+
+    // Returns an id for Unsubscribe
+    int Subscribe(std::function<void()> callback);
+    void Unsubscribe(int id);
+
+private:
+    FrameGovernor() = default;
+
+    std::mutex mutex_;
+    std::vector<std::pair<int, std::function<void()>>> subscribers_;
+    int next_id_ = 0;
+    std::atomic<FrameRate> rate_ = kFrameRateFull;
+    int device_state_ = 0;
+    bool sleeping_ = false;
+    bool backlight_off_ = false;
+    bool spectrum_shown_ = false;
+
+    void Update();
+};
+
+#endif // FRAME_GOVERNOR_H
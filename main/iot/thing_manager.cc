@@ -8,18 +8,34 @@ namespace iot {
 
 void ThingManager::AddThing(Thing* thing) {
     things_.push_back(thing);
+    descriptors_json_.clear();
 }
 
-std::string ThingManager::GetDescriptorsJson() {
-    std::string json_str = "[";
+const std::string& ThingManager::GetDescriptorsJson() {
+    if (!descriptors_json_.empty()) {
+        return descriptors_json_;
+    }
+    descriptors_json_ = "[";
     for (auto& thing : things_) {
-        json_str += thing->GetDescriptorJson() + ",";
+        descriptors_json_ += thing->GetDescriptorJson() + ",";
+    }
+    if (descriptors_json_.back() == ',') {
+        descriptors_json_.pop_back();
     }
-    if (json_str.back() == ',') {
-        json_str.pop_back();
+    descriptors_json_ += "]";
+
+    // FNV-1a, only has to tell a changed set of descriptors from the uploaded one
+    descriptors_hash_ = 2166136261u;
+    for (unsigned char c : descriptors_json_) {
+        descriptors_hash_ = (descriptors_hash_ ^ c) * 16777619u;
     }
-    json_str += "]";
-    return json_str;
+    ESP_LOGI(TAG, "IoT descriptors: %u bytes, hash %08lx", (unsigned)descriptors_json_.size(), (unsigned long)descriptors_hash_);
+    return descriptors_json_;
+}
+
+uint32_t ThingManager::GetDescriptorsHash() {
+    GetDescriptorsJson();
+    return descriptors_hash_;
 }
 
 bool ThingManager::GetStatesJson(std::string& json, bool delta) {
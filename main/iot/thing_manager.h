@@ -24,7 +24,9 @@ public:
 
     void AddThing(Thing* thing);
 
-    std::string GetDescriptorsJson();
+    // Built once and cached until a thing is added, the hash identifies the content
+    const std::string& GetDescriptorsJson();
+    uint32_t GetDescriptorsHash();
     bool GetStatesJson(std::string& json, bool delta = false);
     void Invoke(const cJSON* command);
 
@@ -34,6 +36,8 @@ private:
 
     std::vector<Thing*> things_;
     std::map<std::string, std::string> last_states_;
+    std::string descriptors_json_;
+    uint32_t descriptors_hash_ = 0;
 };
 
 
@@ -1,7 +1,7 @@
 #include "iot/thing.h"
 #include "board.h"
 #include "audio_codec.h"
-#include "display/lcd_display.h"
+#include "display.h"
 #include <string>
 
 #include <esp_log.h>
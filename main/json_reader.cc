@@ -0,0 +1,364 @@
+#include "json_reader.h"
+
+#include <esp_log.h>
+
+#include <cstring>
+
+#define TAG "JsonReader"
+
+// Nested values are skipped by bracket matching up to this depth
+#define JSON_READER_MAX_DEPTH 32
+
+JsonValue::JsonValue(const char* data, size_t length) {
+    const char* end = data + length;
+    JsonValue value;
+    const char* p = Parse(SkipWhitespace(data, end), end, value);
+    if (p != nullptr && SkipWhitespace(p, end) == end) {
+        *this = value;
+    }
+}
+
+const char* JsonValue::SkipWhitespace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+// Returns the character after the closing quote of the string starting at p
+static const char* SkipString(const char* p, const char* end) {
+    for (p++; p < end; p++) {
+        if (*p == '\\') {
+            p++;
+        } else if (*p == '"') {
+            return p + 1;
+        }
+    }
+    return nullptr;
+}
+
+const char* JsonValue::Parse(const char* p, const char* end, JsonValue& value) {
+    if (p >= end) {
+        return nullptr;
+    }
+    const char* start = p;
+    JsonType type;
+    switch (*p) {
+    case '"':
+        type = kJsonString;
+        p = SkipString(p, end);
+        break;
+    case '{':
+    case '[': {
+        // Only the brackets are checked, the members are validated when they are read
+        type = *p == '{' ? kJsonObject : kJsonArray;
+        char stack[JSON_READER_MAX_DEPTH];
+        int depth = 0;
+        while (p != nullptr && p < end) {
+            char c = *p;
+            if (c == '"') {
+                p = SkipString(p, end);
+                continue;
+            }
+            if (c == '{' || c == '[') {
+                if (depth == JSON_READER_MAX_DEPTH) {
+                    return nullptr;
+                }
+                stack[depth++] = c == '{' ? '}' : ']';
+            } else if (c == '}' || c == ']') {
+                if (depth == 0 || stack[depth - 1] != c) {
+                    return nullptr;
+                }
+                if (--depth == 0) {
+                    p++;
+                    break;
+                }
+            }
+            p++;
+        }
+        if (depth != 0) {
+            return nullptr;
+        }
+        break;
+    }
+    case 't':
+        type = kJsonBool;
+        p = end - p >= 4 && memcmp(p, "true", 4) == 0 ? p + 4 : nullptr;
+        break;
+    case 'f':
+        type = kJsonBool;
+        p = end - p >= 5 && memcmp(p, "false", 5) == 0 ? p + 5 : nullptr;
+        break;
+    case 'n':
+        type = kJsonNull;
+        p = end - p >= 4 && memcmp(p, "null", 4) == 0 ? p + 4 : nullptr;
+        break;
+    default:
+        if (*p != '-' && (*p < '0' || *p > '9')) {
+            return nullptr;
+        }
+        type = kJsonNumber;
+        while (p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) {
+            p++;
+        }
+        break;
+    }
+    if (p == nullptr) {
+        return nullptr;
+    }
+    value = JsonValue(type, start, p - start);
+    return p;
+}
+
+JsonValue JsonValue::Get(const char* key) const {
+    if (type_ != kJsonObject) {
+        return JsonValue();
+    }
+    size_t key_length = strlen(key);
+    const char* end = data_ + size_;
+    const char* p = data_ + 1;
+    while (true) {
+        p = SkipWhitespace(p, end);
+        if (p >= end || *p != '"') {
+            return JsonValue();
+        }
+        JsonValue name;
+        p = Parse(p, end, name);
+        if (p == nullptr) {
+            return JsonValue();
+        }
+        p = SkipWhitespace(p, end);
+        if (p >= end || *p != ':') {
+            return JsonValue();
+        }
+        JsonValue value;
+        p = Parse(SkipWhitespace(p + 1, end), end, value);
+        if (p == nullptr) {
+            return JsonValue();
+        }
+        // Keys are compared raw first, escaped keys are rare
+        if ((name.size_ == key_length + 2 && memcmp(name.data_ + 1, key, key_length) == 0) ||
+            (memchr(name.data_, '\\', name.size_) != nullptr && name.Equals(key))) {
+            return value;
+        }
+        p = SkipWhitespace(p, end);
+        if (p >= end || *p != ',') {
+            return JsonValue();
+        }
+        p++;
+    }
+}
+
+static int HexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static int ParseHex4(const char* p, const char* end) {
+    if (end - p < 4) {
+        return -1;
+    }
+    int value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = HexDigit(p[i]);
+        if (digit < 0) {
+            return -1;
+        }
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+template <typename Output>
+void JsonValue::Unescape(Output out) const {
+    const char* p = data_ + 1;
+    const char* end = data_ + size_ - 1;
+    while (p < end) {
+        const char* escape = (const char*)memchr(p, '\\', end - p);
+        if (escape == nullptr) {
+            out(p, end - p);
+            return;
+        }
+        if (escape > p) {
+            out(p, escape - p);
+        }
+        p = escape + 1;
+        if (p >= end) {
+            return;
+        }
+        char c = *p++;
+        switch (c) {
+        case 'b': out("\b", 1); break;
+        case 'f': out("\f", 1); break;
+        case 'n': out("\n", 1); break;
+        case 'r': out("\r", 1); break;
+        case 't': out("\t", 1); break;
+        case 'u': {
+            int code = ParseHex4(p, end);
+            if (code < 0) {
+                return;
+            }
+            p += 4;
+            // Surrogate pair
+            if (code >= 0xd800 && code < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                int low = ParseHex4(p + 2, end);
+                if (low >= 0xdc00 && low < 0xe000) {
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                    p += 6;
+                }
+            }
+            char utf8[4];
+            size_t length;
+            if (code < 0x80) {
+                utf8[0] = code;
+                length = 1;
+            } else if (code < 0x800) {
+                utf8[0] = 0xc0 | (code >> 6);
+                utf8[1] = 0x80 | (code & 0x3f);
+                length = 2;
+            } else if (code < 0x10000) {
+                utf8[0] = 0xe0 | (code >> 12);
+                utf8[1] = 0x80 | ((code >> 6) & 0x3f);
+                utf8[2] = 0x80 | (code & 0x3f);
+                length = 3;
+            } else {
+                utf8[0] = 0xf0 | (code >> 18);
+                utf8[1] = 0x80 | ((code >> 12) & 0x3f);
+                utf8[2] = 0x80 | ((code >> 6) & 0x3f);
+                utf8[3] = 0x80 | (code & 0x3f);
+                length = 4;
+            }
+            out(utf8, length);
+            break;
+        }
+        default:
+            // \" \\ \/
+            out(&c, 1);
+            break;
+        }
+    }
+}
+
+bool JsonValue::Equals(const char* text) const {
+    if (type_ != kJsonString) {
+        return false;
+    }
+    size_t length = strlen(text);
+    if (memchr(data_, '\\', size_) == nullptr) {
+        return size_ == length + 2 && memcmp(data_ + 1, text, length) == 0;
+    }
+    size_t offset = 0;
+    bool equal = true;
+    Unescape([&](const char* chunk, size_t size) {
+        if (equal && (size > length - offset || memcmp(text + offset, chunk, size) != 0)) {
+            equal = false;
+        }
+        offset += size;
+    });
+    return equal && offset == length;
+}
+
+std::string JsonValue::ToString() const {
+    if (type_ == kJsonMissing) {
+        return std::string();
+    }
+    if (type_ != kJsonString) {
+        return std::string(data_, size_);
+    }
+    std::string result;
+    result.reserve(size_ - 2);
+    Unescape([&result](const char* chunk, size_t size) {
+        result.append(chunk, size);
+    });
+    return result;
+}
+
+int64_t JsonValue::ToInt(int64_t default_value) const {
+    if (type_ == kJsonBool) {
+        return data_[0] == 't';
+    }
+    if (type_ != kJsonNumber) {
+        return default_value;
+    }
+    const char* p = data_;
+    const char* end = data_ + size_;
+    bool negative = *p == '-';
+    if (negative) {
+        p++;
+    }
+    // Fractions are truncated, exponents are not expected in the protocol
+    uint64_t value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        value = value * 10 + (*p - '0');
+    }
+    return negative ? -(int64_t)value : (int64_t)value;
+}
+
+bool JsonValue::ToBool(bool default_value) const {
+    if (type_ == kJsonBool) {
+        return data_[0] == 't';
+    }
+    if (type_ == kJsonNumber) {
+        return ToInt() != 0;
+    }
+    return default_value;
+}
+
+uint32_t JsonDispatcher::Hash(const char* data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void JsonDispatcher::On(const char* type, Handler handler) {
+    uint32_t hash = Hash(type, strlen(type));
+    size_t index = hash & (JSON_DISPATCHER_SLOTS - 1);
+    while (slots_[index].type != nullptr) {
+        if (slots_[index].hash == hash && strcmp(slots_[index].type, type) == 0) {
+            slots_[index].handler = handler;
+            return;
+        }
+        index = (index + 1) & (JSON_DISPATCHER_SLOTS - 1);
+    }
+    // Keep one slot free so that lookups of unknown types terminate
+    if (count_ + 1 >= JSON_DISPATCHER_SLOTS) {
+        ESP_LOGE(TAG, "Too many message types, dropping %s", type);
+        return;
+    }
+    slots_[index] = Slot{hash, type, handler};
+    count_++;
+}
+
+bool JsonDispatcher::Dispatch(const char* data, size_t length) const {
+    JsonValue root(data, length);
+    auto type = root.Get("type");
+    if (!type.IsString()) {
+        ESP_LOGE(TAG, "Missing message type, data: %.*s", (int)length, data);
+        return false;
+    }
+
+    const char* name = type.raw() + 1;
+    size_t name_length = type.raw_size() - 2;
+    uint32_t hash = Hash(name, name_length);
+    size_t index = hash & (JSON_DISPATCHER_SLOTS - 1);
+    while (slots_[index].type != nullptr) {
+        auto& slot = slots_[index];
+        if (slot.hash == hash && strncmp(slot.type, name, name_length) == 0 && slot.type[name_length] == '\0') {
+            slot.handler(root);
+            return true;
+        }
+        index = (index + 1) & (JSON_DISPATCHER_SLOTS - 1);
+    }
+    ESP_LOGD(TAG, "No handler for message type %.*s", (int)name_length, name);
+    return false;
+}
@@ -0,0 +1,108 @@
+#ifndef _JSON_READER_H_
+#define _JSON_READER_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <functional>
+
+/*
+ * Non-allocating reader for incoming JSON messages.
+ *
+ * A JsonValue is a view into the received text, nothing is parsed up front.
+ * Get() walks the object only as far as the requested key and skips nested
+ * values by bracket matching, so a handler pays only for the fields it reads:
+ *   JsonValue root(data, length);
+ *   auto state = root.Get("state");
+ *   if (state.Equals("start")) { ... }
+ *   std::string text = root.Get("text").ToString();
+ *
+ * Missing fields and type mismatches yield an empty value whose accessors return
+ * the defaults, so chained lookups need no null checks. The text must outlive the
+ * values taken from it.
+ */
+
+enum JsonType : uint8_t {
+    kJsonMissing,
+    kJsonNull,
+    kJsonBool,
+    kJsonNumber,
+    kJsonString,
+    kJsonArray,
+    kJsonObject,
+};
+
+class JsonValue {
+public:
+    JsonValue() = default;
+    // Root of a message, an empty value if the text is not a valid JSON value
+    JsonValue(const char* data, size_t length);
+
+    JsonType type() const { return type_; }
+    explicit operator bool() const { return type_ != kJsonMissing; }
+    bool IsString() const { return type_ == kJsonString; }
+    bool IsNumber() const { return type_ == kJsonNumber; }
+    bool IsObject() const { return type_ == kJsonObject; }
+    bool IsArray() const { return type_ == kJsonArray; }
+
+    // Encoded text of the value, strings include the quotes
+    const char* raw() const { return data_; }
+    size_t raw_size() const { return size_; }
+
+    // Member of an object
+    JsonValue Get(const char* key) const;
+
+    // Compares the unescaped string with text, false for other types
+    bool Equals(const char* text) const;
+    // Unescaped string, numbers and literals as they are written, empty for missing values
+    std::string ToString() const;
+    int64_t ToInt(int64_t default_value = 0) const;
+    bool ToBool(bool default_value = false) const;
+
+private:
+    JsonValue(JsonType type, const char* data, size_t size) : type_(type), data_(data), size_(size) {}
+
+    JsonType type_ = kJsonMissing;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+
+    // Parses the value at p, returns the character after it or nullptr if it is malformed
+    static const char* Parse(const char* p, const char* end, JsonValue& value);
+    static const char* SkipWhitespace(const char* p, const char* end);
+    // Unescapes the string body into out, calls out for every chunk
+    template <typename Output>
+    void Unescape(Output out) const;
+};
+
+/*
+ * Routes messages to a handler by their "type" field.
+ *
+ * Types are looked up in a small open addressing table keyed by the FNV-1a hash
+ * of the name, adding a message type is one On() call:
+ *   dispatcher.On("tts", [](const JsonValue& root) { ... });
+ *   dispatcher.Dispatch(data, length);
+ */
+#define JSON_DISPATCHER_SLOTS 16
+
+class JsonDispatcher {
+public:
+    using Handler = std::function<void(const JsonValue& root)>;
+
+    // Type names must stay valid, they are usually literals
+    void On(const char* type, Handler handler);
+    // False if the message is malformed, has no type or no handler for it
+    bool Dispatch(const char* data, size_t length) const;
+
+    static uint32_t Hash(const char* data, size_t length);
+
+private:
+    struct Slot {
+        uint32_t hash;
+        const char* type;
+        Handler handler;
+    };
+    Slot slots_[JSON_DISPATCHER_SLOTS] = {};
+    size_t count_ = 0;
+};
+
+#endif // _JSON_READER_H_
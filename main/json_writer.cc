@@ -0,0 +1,232 @@
+#include "json_writer.h"
+
+#include <algorithm>
+
+#define JSON_WRITER_MAX_DEPTH 31
+
+// Extra bytes each character takes once escaped, 0 for characters copied as they are
+struct EscapeTable {
+    uint8_t extra[256];
+
+    constexpr EscapeTable() : extra() {
+        for (int c = 0; c < 0x20; c++) {
+            extra[c] = 5;   // \u00XX
+        }
+        extra[(uint8_t)'\b'] = 1;
+        extra[(uint8_t)'\f'] = 1;
+        extra[(uint8_t)'\n'] = 1;
+        extra[(uint8_t)'\r'] = 1;
+        extra[(uint8_t)'\t'] = 1;
+        extra[(uint8_t)'"'] = 1;
+        extra[(uint8_t)'\\'] = 1;
+    }
+};
+
+static constexpr EscapeTable kEscapeTable;
+
+JsonWriter::JsonWriter(std::string& out) : string_(&out) {
+    // Write straight into the capacity that is already there, the size is trimmed at the end
+    size_ = out.size();
+    out.resize(out.capacity());
+    buffer_ = &out[0];
+    capacity_ = out.size();
+}
+
+JsonWriter::~JsonWriter() {
+    if (string_ != nullptr) {
+        string_->resize(size_);
+    }
+}
+
+bool JsonWriter::Grow(size_t size) {
+    if (string_ == nullptr) {
+        return false;
+    }
+    string_->resize(std::max(size, capacity_ * 2));
+    buffer_ = &(*string_)[0];
+    capacity_ = string_->size();
+    return true;
+}
+
+// True if any byte of the word is a control character, '"' or '\\'
+static inline bool WordNeedsEscape(size_t word) {
+    constexpr size_t ones = ~(size_t)0 / 255;
+    constexpr size_t highs = ones * 0x80;
+    size_t quote = word ^ (ones * '"');
+    size_t backslash = word ^ (ones * '\\');
+    size_t control = (word - ones * 0x20) & ~word;
+    size_t zero_quote = (quote - ones) & ~quote;
+    size_t zero_backslash = (backslash - ones) & ~backslash;
+    return ((control | zero_quote | zero_backslash) & highs) != 0;
+}
+
+// Plain text is checked a word at a time, only words that need escaping go through the table
+static size_t EscapedExtra(const uint8_t* bytes, size_t length) {
+    size_t extra = 0;
+    size_t i = 0;
+    for (; i + sizeof(size_t) <= length; i += sizeof(size_t)) {
+        size_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        if (!WordNeedsEscape(word)) {
+            continue;
+        }
+        for (size_t j = 0; j < sizeof(size_t); j++) {
+            extra += kEscapeTable.extra[bytes[i + j]];
+        }
+    }
+    for (; i < length; i++) {
+        extra += kEscapeTable.extra[bytes[i]];
+    }
+    return extra;
+}
+
+/*
+ * Measures the escaped length first so that the output is reserved exactly once,
+ * strings without anything to escape are copied with a single memcpy.
+ */
+void JsonWriter::AppendString(const char* value, size_t length, bool key) {
+    static const char hex[] = "0123456789abcdef";
+    auto bytes = (const uint8_t*)value;
+    size_t extra = EscapedExtra(bytes, length);
+
+    size_t comma = Separator();
+    char* p = Reserve(comma + length + extra + (key ? 3 : 2));
+    if (p == nullptr) {
+        return;
+    }
+    if (comma) {
+        *p++ = ',';
+    }
+    *p++ = '"';
+    if (extra == 0) {
+        memcpy(p, value, length);
+        p += length;
+    } else {
+        for (size_t i = 0; i < length; i++) {
+            uint8_t c = bytes[i];
+            if (kEscapeTable.extra[c] == 0) {
+                *p++ = c;
+                continue;
+            }
+            *p++ = '\\';
+            switch (c) {
+            case '"': *p++ = '"'; break;
+            case '\\': *p++ = '\\'; break;
+            case '\b': *p++ = 'b'; break;
+            case '\f': *p++ = 'f'; break;
+            case '\n': *p++ = 'n'; break;
+            case '\r': *p++ = 'r'; break;
+            case '\t': *p++ = 't'; break;
+            default:
+                *p++ = 'u';
+                *p++ = '0';
+                *p++ = '0';
+                *p++ = hex[c >> 4];
+                *p++ = hex[c & 0xf];
+                break;
+            }
+        }
+    }
+    *p++ = '"';
+    if (key) {
+        *p = ':';
+        after_key_ = true;
+    }
+}
+
+JsonWriter& JsonWriter::Open(char c) {
+    Append(&c, 1);
+    if (depth_ >= JSON_WRITER_MAX_DEPTH) {
+        ok_ = false;
+        return *this;
+    }
+    depth_++;
+    empty_ |= 1u << depth_;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Close(char c) {
+    if (depth_ == 0) {
+        ok_ = false;
+        return *this;
+    }
+    empty_ &= ~(1u << depth_);
+    depth_--;
+    // Closing brackets never take a comma
+    char* p = Reserve(1);
+    if (p != nullptr) {
+        *p = c;
+    }
+    if (depth_ == 0 && string_ != nullptr) {
+        // Anything written after this grows the string again
+        string_->resize(size_);
+        capacity_ = size_;
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::Key(const char* key, size_t length) {
+    AppendString(key, length, true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::String(const char* value, size_t length) {
+    AppendString(value != nullptr ? value : "", value != nullptr ? length : 0, false);
+    return *this;
+}
+
+// Writes the digits backwards from end, 32 bit values avoid the 64 bit division on the chip
+static char* FormatDigits(char* end, uint64_t value) {
+    if (value <= UINT32_MAX) {
+        uint32_t small = value;
+        do {
+            *--end = '0' + small % 10;
+            small /= 10;
+        } while (small != 0);
+        return end;
+    }
+    do {
+        *--end = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+    return end;
+}
+
+JsonWriter& JsonWriter::UInt(uint64_t value) {
+    char digits[21];
+    char* end = digits + sizeof(digits);
+    char* start = FormatDigits(end, value);
+    Append(start, end - start);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Int(int64_t value) {
+    if (value >= 0) {
+        return UInt(value);
+    }
+    char digits[21];
+    char* end = digits + sizeof(digits);
+    char* start = FormatDigits(end, 0 - (uint64_t)value);
+    *--start = '-';
+    Append(start, end - start);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Bool(bool value) {
+    if (value) {
+        Append("true", 4);
+    } else {
+        Append("false", 5);
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::Null() {
+    Append("null", 4);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Raw(const char* json, size_t length) {
+    Append(json, length);
+    return *this;
+}
@@ -0,0 +1,133 @@
+#ifndef _JSON_WRITER_H_
+#define _JSON_WRITER_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+/*
+ * Streaming JSON writer for outbound messages.
+ *
+ * Commas, colons and string escaping are handled by the writer:
+ *   char buffer[256];
+ *   JsonWriter json(buffer, sizeof(buffer));
+ *   json.BeginObject();
+ *   json.Key("type").String("listen");
+ *   json.Key("state").String("start");
+ *   json.EndObject();
+ *   if (json.ok()) {
+ *       SendText(json.data(), json.size());
+ *   }
+ *
+ * With a fixed buffer nothing is allocated, a message that does not fit marks the
+ * writer as failed instead of producing truncated JSON. The std::string variant
+ * appends to the string and writes into its capacity, so a reserved or reused
+ * string is not reallocated either. The string has its final size once the top
+ * level value is closed or the writer goes out of scope. The output is not null
+ * terminated. Nesting is limited to 32 levels.
+ */
+class JsonWriter {
+public:
+    JsonWriter(char* buffer, size_t capacity) : buffer_(buffer), capacity_(capacity) {}
+    explicit JsonWriter(std::string& out);
+    ~JsonWriter();
+    // 删除拷贝构造函数和赋值运算符
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    JsonWriter& BeginObject() { return Open('{'); }
+    JsonWriter& EndObject() { return Close('}'); }
+    JsonWriter& BeginArray() { return Open('['); }
+    JsonWriter& EndArray() { return Close(']'); }
+
+    // Keys are usually literals: their length is known at compile time and they are copied
+    // with the quotes and the colon without looking for characters to escape. A key that
+    // needs escaping is passed with its length
+    template <size_t N>
+    JsonWriter& Key(const char (&key)[N]) {
+        size_t comma = Separator();
+        char* p = Reserve(comma + N + 2);
+        if (p != nullptr) {
+            if (comma) {
+                *p++ = ',';
+            }
+            *p++ = '"';
+            memcpy(p, key, N - 1);
+            p[N - 1] = '"';
+            p[N] = ':';
+            after_key_ = true;
+        }
+        return *this;
+    }
+    JsonWriter& Key(const char* key, size_t length);
+
+    JsonWriter& String(const char* value, size_t length);
+    JsonWriter& String(const char* value) { return String(value, value != nullptr ? strlen(value) : 0); }
+    JsonWriter& String(const std::string& value) { return String(value.data(), value.size()); }
+    JsonWriter& Int(int64_t value);
+    JsonWriter& UInt(uint64_t value);
+    JsonWriter& Bool(bool value);
+    JsonWriter& Null();
+    // Insert an already encoded JSON value
+    JsonWriter& Raw(const char* json, size_t length);
+    JsonWriter& Raw(const std::string& json) { return Raw(json.data(), json.size()); }
+
+    const char* data() const { return buffer_; }
+    size_t size() const { return size_; }
+    // False if the buffer ran full or the nesting was unbalanced
+    bool ok() const { return ok_ && depth_ == 0; }
+
+private:
+    char* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    std::string* string_ = nullptr;   // Grown on demand, buffer_ points into it
+    uint32_t empty_ = 0;   // Bit per nesting level, set until the first element
+    uint8_t depth_ = 0;
+    bool after_key_ = false;
+    bool ok_ = true;
+
+    // Returns where to write length bytes, nullptr if they do not fit
+    char* Reserve(size_t length) {
+        if (length > capacity_ - size_ && !Grow(size_ + length)) {
+            ok_ = false;
+            return nullptr;
+        }
+        char* p = buffer_ + size_;
+        size_ += length;
+        return p;
+    }
+
+    // Bytes needed for the comma before the next element
+    size_t Separator() {
+        if (after_key_) {
+            after_key_ = false;
+            return 0;
+        }
+        uint32_t bit = 1u << depth_;
+        if (depth_ == 0 || (empty_ & bit)) {
+            empty_ &= ~bit;
+            return 0;
+        }
+        return 1;
+    }
+
+    void Append(const char* data, size_t length) {
+        size_t comma = Separator();
+        char* p = Reserve(comma + length);
+        if (p != nullptr) {
+            if (comma) {
+                *p = ',';
+            }
+            memcpy(p + comma, data, length);
+        }
+    }
+
+    bool Grow(size_t size);
+    JsonWriter& Open(char c);
+    JsonWriter& Close(char c);
+    void AppendString(const char* value, size_t length, bool key);
+};
+
+#endif // _JSON_WRITER_H_
@@ -1,5 +1,6 @@
 #include "circular_strip.h"
 #include "application.h"
+#include "frame_governor.h"
 #include <esp_log.h>
 
 #define TAG "CircularStrip"
@@ -38,9 +39,17 @@ CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_
         .skip_unhandled_events = false,
     };
     ESP_ERROR_CHECK(esp_timer_create(&strip_timer_args, &strip_timer_));
+
+    frame_rate_subscription_ = FrameGovernor::GetInstance().Subscribe([this]() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (strip_interval_ms_ > 0) {
+            StartStripTimer();
+        }
+    });
 }
 
 CircularStrip::~CircularStrip() {
+    FrameGovernor::GetInstance().Unsubscribe(frame_rate_subscription_);
     esp_timer_stop(strip_timer_);
     if (led_strip_ != nullptr) {
         led_strip_del(led_strip_);
@@ -50,7 +59,7 @@ CircularStrip::~CircularStrip() {
 
 void CircularStrip::SetAllColor(StripColor color) {
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
+    StopStripTimer();
     for (int i = 0; i < max_leds_; i++) {
         colors_[i] = color;
         led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
@@ -60,7 +69,7 @@ void CircularStrip::SetAllColor(StripColor color) {
 
 void CircularStrip::SetSingleColor(uint8_t index, StripColor color) {
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
+    StopStripTimer();
     colors_[index] = color;
     led_strip_set_pixel(led_strip_, index, color.red, color.green, color.blue);
     led_strip_refresh(led_strip_);
@@ -98,7 +107,7 @@ void CircularStrip::FadeOut(int interval_ms) {
         }
         if (all_off) {
             led_strip_clear(led_strip_);
-            esp_timer_stop(strip_timer_);
+            StopStripTimer();
         } else {
             led_strip_refresh(led_strip_);
         }
@@ -170,10 +179,21 @@ void CircularStrip::StartStripTask(int interval_ms, std::function<void()> cb) {
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    
     strip_callback_ = cb;
-    esp_timer_start_periodic(strip_timer_, interval_ms * 1000);
+    strip_interval_ms_ = interval_ms;
+    StartStripTimer();
+}
+
+// Runs the animation at the frame rate, slower when idle. A paused rate only means the
+// backlight is off, the LEDs stay visible and animate at the low rate
+void CircularStrip::StartStripTimer() {
+    esp_timer_stop(strip_timer_);
+    esp_timer_start_periodic(strip_timer_, FrameGovernor::GetInstance().Period(strip_interval_ms_) * 1000);
+}
+
+void CircularStrip::StopStripTimer() {
+    esp_timer_stop(strip_timer_);
+    strip_interval_ms_ = 0;
 }
 
 void CircularStrip::SetBrightness(uint8_t default_brightness, uint8_t low_brightness) {
@@ -39,11 +39,15 @@ private:
     int blink_interval_ms_ = 0;
     esp_timer_handle_t strip_timer_ = nullptr;
     std::function<void()> strip_callback_ = nullptr;
+    int strip_interval_ms_ = 0; // Animation period at full frame rate, 0 when stopped
+    int frame_rate_subscription_ = 0;
 
     uint8_t default_brightness_ = DEFAULT_BRIGHTNESS;
     uint8_t low_brightness_ = LOW_BRIGHTNESS;
 
     void StartStripTask(int interval_ms, std::function<void()> cb);
+    void StartStripTimer();
+    void StopStripTimer();
     void Rainbow(StripColor low, StripColor high, int interval_ms);
     void FadeOut(int interval_ms);
 };
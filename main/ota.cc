@@ -170,6 +170,11 @@ bool Ota::CheckVersion() {
             }
         }
         has_websocket_config_ = true;
+        if (!has_mqtt_config_) {
+            // The broker of an older config is stale, the next boot must not connect to it early
+            Settings mqtt_settings("mqtt", true);
+            mqtt_settings.EraseAll();
+        }
     } else {
         ESP_LOGI(TAG, "No websocket section found!");
     }
@@ -0,0 +1,102 @@
+#include "audio_frame_cipher.h"
+
+#include <esp_log.h>
+
+#include <cstring>
+#include <arpa/inet.h>
+
+#define TAG "AudioFrameCipher"
+
+AudioFrameCipher::AudioFrameCipher() {
+    mbedtls_aes_init(&aes_ctx_);
+}
+
+AudioFrameCipher::~AudioFrameCipher() {
+    mbedtls_aes_free(&aes_ctx_);
+}
+
+// 辅助函数，将单个十六进制字符转换为对应的数值
+static inline int CharToHex(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Decodes exactly size bytes, false on a wrong length or an invalid digit
+static bool DecodeHex(const std::string& hex, uint8_t* out, size_t size) {
+    if (hex.size() != size * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+        int high = CharToHex(hex[i * 2]);
+        int low = CharToHex(hex[i * 2 + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        out[i] = (high << 4) | low;
+    }
+    return true;
+}
+
+bool AudioFrameCipher::SetKey(const std::string& key_hex, const std::string& nonce_hex) {
+    ready_ = false;
+    uint8_t key[16];
+    if (!DecodeHex(key_hex, key, sizeof(key)) || !DecodeHex(nonce_hex, nonce_, sizeof(nonce_))) {
+        ESP_LOGE(TAG, "Invalid key or nonce");
+        return false;
+    }
+    // Expanding the key replaces the schedule of the previous session, the context is reused
+    int ret = mbedtls_aes_setkey_enc(&aes_ctx_, key, 128);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to set key, ret: %d", ret);
+        return false;
+    }
+    ready_ = true;
+    return true;
+}
+
+bool AudioFrameCipher::Seal(const uint8_t* payload, size_t size, uint32_t timestamp, uint32_t sequence, uint8_t* frame, uint8_t flags) {
+    if (!ready_ || size > UINT16_MAX) {
+        return false;
+    }
+    // The header is the nonce of the session with the per packet fields filled in
+    memcpy(frame, nonce_, AUDIO_FRAME_HEADER_SIZE);
+    frame[1] |= flags;
+    uint16_t length = htons(size);
+    timestamp = htonl(timestamp);
+    sequence = htonl(sequence);
+    memcpy(frame + 2, &length, sizeof(length));
+    memcpy(frame + 8, &timestamp, sizeof(timestamp));
+    memcpy(frame + 12, &sequence, sizeof(sequence));
+
+    // The counter is advanced by mbedtls, so it runs on a copy of the header
+    uint8_t counter[AUDIO_FRAME_HEADER_SIZE];
+    uint8_t stream_block[AUDIO_FRAME_HEADER_SIZE];
+    memcpy(counter, frame, AUDIO_FRAME_HEADER_SIZE);
+    size_t nc_off = 0;
+    return mbedtls_aes_crypt_ctr(&aes_ctx_, size, &nc_off, counter, stream_block, payload, frame + AUDIO_FRAME_HEADER_SIZE) == 0;
+}
+
+bool AudioFrameCipher::ParseHeader(const uint8_t* frame, size_t size, uint32_t* timestamp, uint32_t* sequence) {
+    if (size < AUDIO_FRAME_HEADER_SIZE || frame[0] != AUDIO_FRAME_TYPE_OPUS) {
+        return false;
+    }
+    memcpy(timestamp, frame + 8, sizeof(*timestamp));
+    memcpy(sequence, frame + 12, sizeof(*sequence));
+    *timestamp = ntohl(*timestamp);
+    *sequence = ntohl(*sequence);
+    return true;
+}
+
+bool AudioFrameCipher::Open(const uint8_t* frame, size_t size, uint8_t* out) {
+    if (!ready_ || size < AUDIO_FRAME_HEADER_SIZE) {
+        return false;
+    }
+    uint8_t counter[AUDIO_FRAME_HEADER_SIZE];
+    uint8_t stream_block[AUDIO_FRAME_HEADER_SIZE];
+    memcpy(counter, frame, AUDIO_FRAME_HEADER_SIZE);
+    size_t nc_off = 0;
+    return mbedtls_aes_crypt_ctr(&aes_ctx_, size - AUDIO_FRAME_HEADER_SIZE, &nc_off, counter, stream_block,
+        frame + AUDIO_FRAME_HEADER_SIZE, out) == 0;
+}
@@ -0,0 +1,51 @@
+#ifndef AUDIO_FRAME_CIPHER_H
+#define AUDIO_FRAME_CIPHER_H
+
+#include <mbedtls/aes.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+/*
+ * AES-CTR framing of the encrypted UDP audio channel:
+ * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|payload payload_len|
+ *
+ * The header doubles as the initial counter block. The key is expanded once per
+ * session into a context that lives as long as the protocol, with
+ * CONFIG_MBEDTLS_HARDWARE_AES the blocks are encrypted by the AES engine. Payloads
+ * are encrypted or decrypted in one pass straight into their final place, the
+ * input and output may be the same buffer.
+ */
+
+#define AUDIO_FRAME_HEADER_SIZE 16
+#define AUDIO_FRAME_TYPE_OPUS 0x01
+// The payload holds several frames, see AUDIO_AGGREGATE_ENTRY_SIZE in protocol.h
+#define AUDIO_FRAME_FLAG_AGGREGATED 0x01
+
+class AudioFrameCipher {
+public:
+    AudioFrameCipher();
+    ~AudioFrameCipher();
+    // 删除拷贝构造函数和赋值运算符
+    AudioFrameCipher(const AudioFrameCipher&) = delete;
+    AudioFrameCipher& operator=(const AudioFrameCipher&) = delete;
+
+    // Key and nonce as hex strings from the server hello
+    bool SetKey(const std::string& key_hex, const std::string& nonce_hex);
+
+    // Writes the header to frame and the encrypted payload right behind it
+    bool Seal(const uint8_t* payload, size_t size, uint32_t timestamp, uint32_t sequence, uint8_t* frame, uint8_t flags = 0);
+
+    // Checks the type and reads the header fields, false if this is not an audio frame
+    static bool ParseHeader(const uint8_t* frame, size_t size, uint32_t* timestamp, uint32_t* sequence);
+    // Decrypts the payload of a frame into out, which must hold size - AUDIO_FRAME_HEADER_SIZE bytes
+    bool Open(const uint8_t* frame, size_t size, uint8_t* out);
+
+private:
+    mbedtls_aes_context aes_ctx_;
+    uint8_t nonce_[AUDIO_FRAME_HEADER_SIZE] = {0};
+    bool ready_ = false;
+};
+
+#endif // AUDIO_FRAME_CIPHER_H
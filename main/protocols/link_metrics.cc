@@ -0,0 +1,102 @@
+#include "link_metrics.h"
+#include "json_writer.h"
+
+#include <esp_timer.h>
+
+#include <cstdlib>
+
+void LinkMetrics::Reset() {
+    session_start_us_.store(esp_timer_get_time(), std::memory_order_relaxed);
+    last_arrival_us_.store(0, std::memory_order_relaxed);
+    jitter_us16_.store(0, std::memory_order_relaxed);
+    downlink_packets_.store(0, std::memory_order_relaxed);
+    downlink_bytes_.store(0, std::memory_order_relaxed);
+    uplink_packets_.store(0, std::memory_order_relaxed);
+    uplink_bytes_.store(0, std::memory_order_relaxed);
+    uplink_blocked_us_.store(0, std::memory_order_relaxed);
+    uplink_blocked_max_us_.store(0, std::memory_order_relaxed);
+}
+
+void LinkMetrics::OnConnected(int64_t handshake_us) {
+    connect_us_.store(handshake_us, std::memory_order_relaxed);
+}
+
+void LinkMetrics::OnProbeSent(uint32_t id) {
+    probe_sent_us_.store(0, std::memory_order_relaxed);
+    probe_id_.store(id, std::memory_order_relaxed);
+    probe_sent_us_.store(esp_timer_get_time(), std::memory_order_relaxed);
+}
+
+void LinkMetrics::OnProbeAnswered(uint32_t id) {
+    int64_t sent = probe_sent_us_.exchange(0, std::memory_order_relaxed);
+    if (sent == 0 || probe_id_.load(std::memory_order_relaxed) != id) {
+        return;
+    }
+    uint32_t rtt = esp_timer_get_time() - sent;
+    // Smoothed like the TCP SRTT, the first sample is taken as it is
+    uint32_t srtt = srtt_us_.load(std::memory_order_relaxed);
+    srtt_us_.store(srtt == 0 ? rtt : srtt - srtt / 8 + rtt / 8, std::memory_order_relaxed);
+    uint32_t min_rtt = min_rtt_us_.load(std::memory_order_relaxed);
+    if (min_rtt == 0 || rtt < min_rtt) {
+        min_rtt_us_.store(rtt, std::memory_order_relaxed);
+    }
+    rtt_samples_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LinkMetrics::OnDownlinkAudio(size_t bytes, int frame_duration_ms) {
+    int64_t now = esp_timer_get_time();
+    int64_t last = last_arrival_us_.exchange(now, std::memory_order_relaxed);
+    downlink_packets_.fetch_add(1, std::memory_order_relaxed);
+    downlink_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    if (last == 0) {
+        return;
+    }
+    // J += (|D| - J) / 16, kept scaled by 16 so that the update stays in integers
+    int64_t deviation = std::llabs(now - last - frame_duration_ms * 1000LL);
+    uint32_t jitter = jitter_us16_.load(std::memory_order_relaxed);
+    jitter_us16_.store(jitter + deviation - ((jitter + 8) >> 4), std::memory_order_relaxed);
+}
+
+void LinkMetrics::OnUplinkAudio(size_t bytes, int64_t blocked_us) {
+    uplink_packets_.fetch_add(1, std::memory_order_relaxed);
+    uplink_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    uplink_blocked_us_.fetch_add(blocked_us, std::memory_order_relaxed);
+    if (blocked_us > uplink_blocked_max_us_.load(std::memory_order_relaxed)) {
+        uplink_blocked_max_us_.store(blocked_us, std::memory_order_relaxed);
+    }
+}
+
+void LinkMetrics::Write(JsonWriter& json, const SequenceWindow* sequence) const {
+    int64_t duration_us = esp_timer_get_time() - session_start_us_.load(std::memory_order_relaxed);
+    if (duration_us <= 0) {
+        duration_us = 1;
+    }
+    auto per_second = [duration_us](uint64_t bytes) {
+        return bytes * 1000000 / duration_us;
+    };
+
+    json.Key("duration_ms").UInt(duration_us / 1000);
+    json.Key("connect_ms").UInt(connect_us_.load(std::memory_order_relaxed) / 1000);
+    if (rtt_samples_.load(std::memory_order_relaxed) > 0) {
+        json.Key("rtt_ms").UInt(rtt_ms());
+        json.Key("rtt_min_ms").UInt(min_rtt_us_.load(std::memory_order_relaxed) / 1000);
+    }
+    json.Key("jitter_ms").UInt(jitter_ms());
+    json.Key("downlink_packets").UInt(downlink_packets_.load(std::memory_order_relaxed));
+    json.Key("downlink_bps").UInt(per_second(downlink_bytes_.load(std::memory_order_relaxed)));
+    if (sequence != nullptr) {
+        // Gaps still inside the window count as lost, the stream is being reported as it is
+        auto& stats = sequence->stats();
+        uint32_t lost = stats.lost + sequence->missing();
+        uint32_t expected = stats.received + lost;
+        json.Key("lost").UInt(lost);
+        json.Key("reordered").UInt(stats.reordered);
+        json.Key("duplicate").UInt(stats.duplicate);
+        json.Key("loss_permille").UInt(expected > 0 ? lost * 1000ULL / expected : 0);
+        json.Key("reorder_permille").UInt(stats.received > 0 ? stats.reordered * 1000ULL / stats.received : 0);
+    }
+    json.Key("uplink_packets").UInt(uplink_packets_.load(std::memory_order_relaxed));
+    json.Key("uplink_bps").UInt(per_second(uplink_bytes_.load(std::memory_order_relaxed)));
+    json.Key("uplink_blocked_ms").UInt(uplink_blocked_us_.load(std::memory_order_relaxed) / 1000);
+    json.Key("uplink_blocked_max_ms").UInt(uplink_blocked_max_us_.load(std::memory_order_relaxed) / 1000);
+}
@@ -0,0 +1,69 @@
+#ifndef LINK_METRICS_H
+#define LINK_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "sequence_window.h"
+
+class JsonWriter;
+
+/*
+ * Link quality of one audio session, reported to the server in the goodbye and
+ * on a telemetry request.
+ *
+ * Every field is a relaxed atomic written from the protocol callbacks, the
+ * receive thread of the transport and the main loop never share a lock with the
+ * reader. Each field has a single writer, so a snapshot may mix two updates but
+ * never tears a value.
+ *
+ * - rtt: hello and ping round trips on the control channel, smoothed as in TCP
+ * - jitter: RFC 3550 interarrival jitter of downlink audio against the frame duration
+ * - uplink blocked: time spent inside the audio send of the transport
+ * - connect: TCP, TLS and protocol handshake of the connection the session runs on
+ */
+class LinkMetrics {
+public:
+    // Starts a new session. The connect time and the round trip belong to the link and
+    // are kept, so a hello sent before the session started still counts
+    void Reset();
+
+    void OnConnected(int64_t handshake_us);
+    // A request the server answers right away, one is tracked at a time
+    void OnProbeSent(uint32_t id);
+    void OnProbeAnswered(uint32_t id);
+
+    void OnDownlinkAudio(size_t bytes, int frame_duration_ms);
+    void OnDownlinkBytes(size_t bytes) { downlink_bytes_.fetch_add(bytes, std::memory_order_relaxed); }
+    void OnUplinkAudio(size_t bytes, int64_t blocked_us);
+    void OnUplinkBytes(size_t bytes) { uplink_bytes_.fetch_add(bytes, std::memory_order_relaxed); }
+
+    uint32_t rtt_ms() const { return srtt_us_.load(std::memory_order_relaxed) / 1000; }
+    uint32_t jitter_ms() const { return (jitter_us16_.load(std::memory_order_relaxed) >> 4) / 1000; }
+
+    // Members of the "metrics" object, loss and reorder only for transports that number packets
+    void Write(JsonWriter& json, const SequenceWindow* sequence) const;
+
+private:
+    std::atomic<int64_t> session_start_us_ = 0;
+    std::atomic<uint32_t> connect_us_ = 0;
+
+    std::atomic<uint32_t> probe_id_ = 0;
+    std::atomic<int64_t> probe_sent_us_ = 0;
+    std::atomic<uint32_t> srtt_us_ = 0;
+    std::atomic<uint32_t> min_rtt_us_ = 0;
+    std::atomic<uint32_t> rtt_samples_ = 0;
+
+    std::atomic<int64_t> last_arrival_us_ = 0;
+    std::atomic<uint32_t> jitter_us16_ = 0;     // Jitter in microseconds scaled by 16
+    std::atomic<uint32_t> downlink_packets_ = 0;
+    std::atomic<uint64_t> downlink_bytes_ = 0;
+
+    std::atomic<uint32_t> uplink_packets_ = 0;
+    std::atomic<uint64_t> uplink_bytes_ = 0;
+    std::atomic<uint64_t> uplink_blocked_us_ = 0;
+    std::atomic<uint32_t> uplink_blocked_max_us_ = 0;
+};
+
+#endif // LINK_METRICS_H
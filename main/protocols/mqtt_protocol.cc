@@ -2,11 +2,16 @@
 #include "board.h"
 #include "application.h"
 #include "settings.h"
+#include "event_trace.h"
+#include "deferred_log.h"
+#include "json_writer.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <ml307_mqtt.h>
 #include <ml307_udp.h>
 #include <cstring>
+#include <algorithm>
 #include <arpa/inet.h>
 #include "assets/lang_config.h"
 
@@ -14,6 +19,28 @@
 
 MqttProtocol::MqttProtocol() {
     event_group_handle_ = xEventGroupCreate();
+
+    OnIncomingJson("hello", [this](const JsonValue& root) {
+        ParseServerHello(root);
+    });
+    OnIncomingJson("goodbye", [this](const JsonValue& root) {
+        auto session_id = root.Get("session_id");
+        std::string session = session_id.ToString();
+        ESP_LOGI(TAG, "Received goodbye message, session_id: %s", session_id ? session.c_str() : "null");
+        if (!session_id || session_id_ == session) {
+            Application::GetInstance().Schedule([this]() {
+#if CONFIG_AUDIO_CHANNEL_LEASE_SECONDS > 0
+                // The server dropped a session we only held in reserve
+                if (udp_ == nullptr && lease_held_) {
+                    lease_held_ = false;
+                    xEventGroupClearBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
+                    return;
+                }
+#endif
+                CloseAudioChannel();
+            });
+        }
+    });
 }
 
 MqttProtocol::~MqttProtocol() {
@@ -28,13 +55,52 @@ MqttProtocol::~MqttProtocol() {
 }
 
 bool MqttProtocol::Start() {
-    return StartMqttClient(false);
+    return StartMqttClient(true);
+}
+
+Mqtt* MqttProtocol::CreateMqttClient() {
+    auto mqtt = Board::GetInstance().CreateMqtt();
+    mqtt->SetKeepAlive(90);
+
+    mqtt->OnDisconnected([this]() {
+        ESP_LOGI(TAG, "Disconnected from endpoint");
+    });
+
+    mqtt->OnMessage([this](const std::string& topic, const std::string& payload) {
+        TRACE_SCOPE("mqtt_recv");
+        link_metrics_.OnDownlinkBytes(payload.size());
+        json_dispatcher_.Dispatch(payload.data(), payload.size());
+        last_incoming_time_ = std::chrono::steady_clock::now();
+    });
+    return mqtt;
+}
+
+// Touches nothing but its arguments, the pre-warm task runs it too
+static bool ConnectMqttClient(Mqtt* mqtt, const std::string& endpoint, const std::string& client_id,
+    const std::string& username, const std::string& password) {
+    ESP_LOGI(TAG, "Connecting to endpoint %s", endpoint.c_str());
+    std::string broker_address;
+    int broker_port = 8883;
+    size_t pos = endpoint.find(':');
+    if (pos != std::string::npos) {
+        broker_address = endpoint.substr(0, pos);
+        broker_port = std::stoi(endpoint.substr(pos + 1));
+    } else {
+        broker_address = endpoint;
+    }
+    if (!mqtt->Connect(broker_address, broker_port, client_id, username, password)) {
+        ESP_LOGE(TAG, "Failed to connect to endpoint");
+        return false;
+    }
+    ESP_LOGI(TAG, "Connected to endpoint");
+    return true;
 }
 
 bool MqttProtocol::StartMqttClient(bool report_error) {
     if (mqtt_ != nullptr) {
         ESP_LOGW(TAG, "Mqtt client already started");
         delete mqtt_;
+        mqtt_ = nullptr;
     }
 
     Settings settings("mqtt", false);
@@ -52,72 +118,119 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
         return false;
     }
 
-    mqtt_ = Board::GetInstance().CreateMqtt();
-    mqtt_->SetKeepAlive(90);
-
-    mqtt_->OnDisconnected([this]() {
-        ESP_LOGI(TAG, "Disconnected from endpoint");
-    });
-
-    mqtt_->OnMessage([this](const std::string& topic, const std::string& payload) {
-        cJSON* root = cJSON_Parse(payload.c_str());
-        if (root == nullptr) {
-            ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
-            return;
-        }
-        cJSON* type = cJSON_GetObjectItem(root, "type");
-        if (type == nullptr) {
-            ESP_LOGE(TAG, "Message type is not specified");
-            cJSON_Delete(root);
-            return;
-        }
-
-        if (strcmp(type->valuestring, "hello") == 0) {
-            ParseServerHello(root);
-        } else if (strcmp(type->valuestring, "goodbye") == 0) {
-            auto session_id = cJSON_GetObjectItem(root, "session_id");
-            ESP_LOGI(TAG, "Received goodbye message, session_id: %s", session_id ? session_id->valuestring : "null");
-            if (session_id == nullptr || session_id_ == session_id->valuestring) {
-                Application::GetInstance().Schedule([this]() {
-                    CloseAudioChannel();
-                });
-            }
-        } else if (on_incoming_json_ != nullptr) {
-            on_incoming_json_(root);
+#if CONFIG_AUDIO_CHANNEL_LEASE_SECONDS > 0
+    // A session negotiated over the previous connection is not reused
+    lease_held_ = false;
+#endif
+    mqtt_ = CreateMqttClient();
+    int64_t connect_start = esp_timer_get_time();
+    if (!ConnectMqttClient(mqtt_, endpoint_, client_id_, username_, password_)) {
+        if (report_error) {
+            SetError(Lang::Strings::SERVER_NOT_CONNECTED);
         }
-        cJSON_Delete(root);
-        last_incoming_time_ = std::chrono::steady_clock::now();
-    });
+        return false;
+    }
+    link_metrics_.OnConnected(esp_timer_get_time() - connect_start);
+    return true;
+}
 
-    ESP_LOGI(TAG, "Connecting to endpoint %s", endpoint_.c_str());
-    std::string broker_address;
-    int broker_port = 8883;
-    size_t pos = endpoint_.find(':');
-    if (pos != std::string::npos) {
-        broker_address = endpoint_.substr(0, pos);
-        broker_port = std::stoi(endpoint_.substr(pos + 1));
-    } else {
-        broker_address = endpoint_;
+struct MqttPreWarm {
+    MqttProtocol* protocol;
+    Mqtt* mqtt;
+    std::string endpoint;
+    std::string client_id;
+    std::string username;
+    std::string password;
+    std::string publish_topic;
+    bool connected;
+    int64_t connect_us;
+};
+
+/*
+ * The connect takes seconds, or much longer while the broker is unreachable. The client is
+ * created here and connected on a task of its own, the main loop takes it over once it is done.
+ */
+void MqttProtocol::StartPreWarmConnect() {
+    Settings settings("mqtt", false);
+    auto prewarm = new MqttPreWarm();
+    prewarm->protocol = this;
+    prewarm->endpoint = settings.GetString("endpoint");
+    prewarm->client_id = settings.GetString("client_id");
+    prewarm->username = settings.GetString("username");
+    prewarm->password = settings.GetString("password");
+    prewarm->publish_topic = settings.GetString("publish_topic");
+    if (prewarm->endpoint.empty()) {
+        delete prewarm;
+        return;
     }
-    if (!mqtt_->Connect(broker_address, broker_port, client_id_, username_, password_)) {
-        ESP_LOGE(TAG, "Failed to connect to endpoint");
-        SetError(Lang::Strings::SERVER_NOT_CONNECTED);
-        return false;
+    prewarm->mqtt = CreateMqttClient();
+    ESP_LOGI(TAG, "Reconnecting to keep the session warm");
+    xEventGroupClearBits(event_group_handle_, MQTT_PROTOCOL_PREWARM_DONE_EVENT);
+    prewarm_ = prewarm;
+    auto result = xTaskCreate([](void* arg) {
+        auto prewarm = (MqttPreWarm*)arg;
+        auto protocol = prewarm->protocol;
+        int64_t connect_start = esp_timer_get_time();
+        prewarm->connected = ConnectMqttClient(prewarm->mqtt, prewarm->endpoint, prewarm->client_id,
+            prewarm->username, prewarm->password);
+        prewarm->connect_us = esp_timer_get_time() - connect_start;
+        xEventGroupSetBits(protocol->event_group_handle_, MQTT_PROTOCOL_PREWARM_DONE_EVENT);
+        Application::GetInstance().Schedule([protocol]() {
+            protocol->FinishPreWarmConnect();
+        });
+        vTaskDelete(NULL);
+    }, "mqtt_prewarm", 4096, prewarm, 2, nullptr);
+    if (result != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the reconnect task");
+        prewarm->connected = false;
+        xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_PREWARM_DONE_EVENT);
+        FinishPreWarmConnect();
     }
+}
 
-    ESP_LOGI(TAG, "Connected to endpoint");
-    return true;
+void MqttProtocol::FinishPreWarmConnect() {
+    // OpenAudioChannel may have taken the client over already
+    if (prewarm_ == nullptr) {
+        return;
+    }
+    auto prewarm = prewarm_;
+    prewarm_ = nullptr;
+    if (!prewarm->connected) {
+        delete prewarm->mqtt;
+        // An unreachable broker is retried less and less often
+        reconnect_interval_ms_ = std::min(reconnect_interval_ms_ * 2, MQTT_RECONNECT_MAX_INTERVAL_MS);
+        ESP_LOGW(TAG, "Next reconnect in %d seconds", reconnect_interval_ms_ / 1000);
+    } else {
+        if (mqtt_ != nullptr) {
+            delete mqtt_;
+        }
+        mqtt_ = prewarm->mqtt;
+        endpoint_ = std::move(prewarm->endpoint);
+        client_id_ = std::move(prewarm->client_id);
+        username_ = std::move(prewarm->username);
+        password_ = std::move(prewarm->password);
+        publish_topic_ = std::move(prewarm->publish_topic);
+#if CONFIG_AUDIO_CHANNEL_LEASE_SECONDS > 0
+        lease_held_ = false;
+#endif
+        link_metrics_.OnConnected(prewarm->connect_us);
+        reconnect_interval_ms_ = MQTT_RECONNECT_INTERVAL_MS;
+    }
+    delete prewarm;
 }
 
-bool MqttProtocol::SendText(const std::string& text) {
-    if (publish_topic_.empty()) {
+bool MqttProtocol::SendText(const char* text, size_t length) {
+    if (mqtt_ == nullptr || publish_topic_.empty()) {
         return false;
     }
-    if (!mqtt_->Publish(publish_topic_, text)) {
-        ESP_LOGE(TAG, "Failed to publish message: %s", text.c_str());
+    TRACE_SCOPE("mqtt_publish");
+    // The MQTT client takes the payload as a string, this is the only copy of the message
+    if (!mqtt_->Publish(publish_topic_, std::string(text, length))) {
+        ESP_LOGE(TAG, "Failed to publish message: %.*s", (int)length, text);
         SetError(Lang::Strings::SERVER_ERROR);
         return false;
     }
+    link_metrics_.OnUplinkBytes(length);
     return true;
 }
 
@@ -127,49 +240,147 @@ void MqttProtocol::SendAudio(const AudioStreamPacket& packet) {
         return;
     }
 
-    std::string nonce(aes_nonce_);
-    *(uint16_t*)&nonce[2] = htons(packet.payload.size());
-    *(uint32_t*)&nonce[8] = htonl(packet.timestamp);
-    *(uint32_t*)&nonce[12] = htonl(++local_sequence_);
+    size_t size = packet.payload.size();
+    udp_frame_.resize(AUDIO_FRAME_HEADER_SIZE + size);
+    if (!cipher_.Seal(packet.payload.data(), size, packet.timestamp, ++local_sequence_, (uint8_t*)&udp_frame_[0])) {
+        ESP_LOGE(TAG, "Failed to encrypt audio data");
+        return;
+    }
+
+    TRACE_SCOPE("udp_send");
+    busy_sending_audio_ = true;
+    int64_t send_start = esp_timer_get_time();
+    udp_->Send(udp_frame_);
+    link_metrics_.OnUplinkAudio(udp_frame_.size(), esp_timer_get_time() - send_start);
+    busy_sending_audio_ = false;
+}
 
-    std::string encrypted;
-    encrypted.resize(aes_nonce_.size() + packet.payload.size());
-    memcpy(encrypted.data(), nonce.data(), nonce.size());
+void MqttProtocol::SendAudioFrames(const std::vector<AudioStreamPacket>& packets) {
+    std::lock_guard<std::mutex> lock(channel_mutex_);
+    if (udp_ == nullptr) {
+        return;
+    }
 
-    size_t nc_off = 0;
-    uint8_t stream_block[16] = {0};
-    if (mbedtls_aes_crypt_ctr(&aes_ctx_, packet.payload.size(), &nc_off, (uint8_t*)nonce.c_str(), stream_block,
-        (uint8_t*)packet.payload.data(), (uint8_t*)&encrypted[nonce.size()]) != 0) {
+    // The entries are packed behind the header and encrypted where they are
+    size_t size = PackAudioFrames(packets, udp_frame_, AUDIO_FRAME_HEADER_SIZE);
+    auto frame = (uint8_t*)&udp_frame_[0];
+    if (!cipher_.Seal(frame + AUDIO_FRAME_HEADER_SIZE, size, packets.front().timestamp, ++local_sequence_, frame,
+        AUDIO_FRAME_FLAG_AGGREGATED)) {
         ESP_LOGE(TAG, "Failed to encrypt audio data");
         return;
     }
 
+    TRACE_SCOPE("udp_send");
     busy_sending_audio_ = true;
-    udp_->Send(encrypted);
+    int64_t send_start = esp_timer_get_time();
+    udp_->Send(udp_frame_);
+    link_metrics_.OnUplinkAudio(udp_frame_.size(), esp_timer_get_time() - send_start);
     busy_sending_audio_ = false;
 }
 
 void MqttProtocol::CloseAudioChannel() {
+    SendQueuedAudio();
     {
         std::lock_guard<std::mutex> lock(channel_mutex_);
         if (udp_ != nullptr) {
             delete udp_;
             udp_ = nullptr;
+            std::lock_guard<std::mutex> receive_lock(receive_mutex_);
+            auto& stats = remote_window_.stats();
+            ESP_LOGI(TAG, "Audio packets received: %lu, lost: %lu, duplicate: %lu, reordered: %lu, late: %lu",
+                stats.received, stats.lost + remote_window_.missing(), stats.duplicate, stats.reordered, stats.late);
         }
     }
 
-    std::string message = "{";
-    message += "\"session_id\":\"" + session_id_ + "\",";
-    message += "\"type\":\"goodbye\"";
-    message += "}";
-    SendText(message);
+    SendGoodbye();
+#if CONFIG_AUDIO_CHANNEL_LEASE_SECONDS > 0
+    lease_wanted_ = true;
+#endif
 
     if (on_audio_channel_closed_ != nullptr) {
         on_audio_channel_closed_();
     }
 }
 
+void MqttProtocol::PreWarm() {
+    // Keep the broker connection up so that opening the channel skips the reconnect
+    if (mqtt_ == nullptr || !mqtt_->IsConnected()) {
+        auto now = std::chrono::steady_clock::now();
+        if (prewarm_ != nullptr || now - last_reconnect_time_ < std::chrono::milliseconds(reconnect_interval_ms_)) {
+            return;
+        }
+        last_reconnect_time_ = now;
+        StartPreWarmConnect();
+        return;
+    }
+    reconnect_interval_ms_ = MQTT_RECONNECT_INTERVAL_MS;
+
+#if CONFIG_AUDIO_CHANNEL_LEASE_SECONDS > 0
+    if (udp_ != nullptr) {
+        return;
+    }
+    if (lease_held_) {
+        if (std::chrono::steady_clock::now() >= lease_expiry_) {
+            ReleaseLease();
+        }
+        return;
+    }
+    // One lease per idle period, the server session is not renewed forever
+    if (lease_wanted_) {
+        lease_wanted_ = false;
+        if (SendHello()) {
+            lease_held_ = true;
+            lease_expiry_ = std::chrono::steady_clock::now() + std::chrono::seconds(CONFIG_AUDIO_CHANNEL_LEASE_SECONDS);
+        }
+    }
+#endif
+}
+
+#if CONFIG_AUDIO_CHANNEL_LEASE_SECONDS > 0
+void MqttProtocol::ReleaseLease() {
+    ESP_LOGI(TAG, "Releasing the pre-negotiated session");
+    lease_held_ = false;
+    xEventGroupClearBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
+    if (!session_id_.empty()) {
+        SendGoodbye(false);
+        session_id_ = "";
+    }
+}
+#endif
+
+bool MqttProtocol::SendHello() {
+    // 发送 hello 消息申请 UDP 通道
+    session_id_ = "";
+    xEventGroupClearBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
+    link_metrics_.OnProbeSent(0);
+
+    char buffer[256];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.BeginObject();
+    json.Key("type").String("hello");
+    json.Key("version").Int(3);
+    json.Key("transport").String("udp");
+    WriteHelloFeatures(json);
+    WriteIotDescriptorsHash(json);
+    json.Key("audio_params").BeginObject();
+    json.Key("format").String("opus");
+    json.Key("sample_rate").Int(16000);
+    json.Key("channels").Int(1);
+    json.Key("frame_duration").Int(OPUS_FRAME_DURATION_MS);
+#if CONFIG_AUDIO_AGGREGATION_MAX_FRAMES > 1
+    json.Key("max_frames_per_packet").Int(CONFIG_AUDIO_AGGREGATION_MAX_FRAMES);
+#endif
+    json.EndObject();
+    json.EndObject();
+    return SendJson(json);
+}
+
 bool MqttProtocol::OpenAudioChannel() {
+    if (prewarm_ != nullptr) {
+        // A second client with the same id would kick this one off the broker, take it over instead
+        xEventGroupWaitBits(event_group_handle_, MQTT_PROTOCOL_PREWARM_DONE_EVENT, pdFALSE, pdFALSE, portMAX_DELAY);
+        FinishPreWarmConnect();
+    }
     if (mqtt_ == nullptr || !mqtt_->IsConnected()) {
         ESP_LOGI(TAG, "MQTT is not connected, try to connect now");
         if (!StartMqttClient(true)) {
@@ -179,23 +390,27 @@ bool MqttProtocol::OpenAudioChannel() {
 
     busy_sending_audio_ = false;
     error_occurred_ = false;
-    session_id_ = "";
-    xEventGroupClearBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
-
-    // 发送 hello 消息申请 UDP 通道
-    std::string message = "{";
-    message += "\"type\":\"hello\",";
-    message += "\"version\": 3,";
-    message += "\"transport\":\"udp\",";
-#if CONFIG_USE_SERVER_AEC
-    message += "\"features\":{\"aec\":true},";
-#endif
-    message += "\"audio_params\":{";
-    message += "\"format\":\"opus\", \"sample_rate\":16000, \"channels\":1, \"frame_duration\":" + std::to_string(OPUS_FRAME_DURATION_MS);
-    message += "}}";
-    if (!SendText(message)) {
+    link_metrics_.Reset();
+
+#if CONFIG_AUDIO_CHANNEL_LEASE_SECONDS > 0
+    // A hello sent while idle is reused even if its answer is still on the way
+    bool leased = lease_held_ && std::chrono::steady_clock::now() < lease_expiry_;
+    if (leased) {
+        ESP_LOGI(TAG, "Using the pre-negotiated session %s", session_id_.c_str());
+        lease_held_ = false;
+    } else {
+        if (lease_held_) {
+            ReleaseLease();
+        }
+        if (!SendHello()) {
+            return false;
+        }
+    }
+#else
+    if (!SendHello()) {
         return false;
     }
+#endif
 
     // 等待服务器响应
     EventBits_t bits = xEventGroupWaitBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
@@ -216,41 +431,40 @@ bool MqttProtocol::OpenAudioChannel() {
          * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|
          * |payload payload_len|
          */
-        if (data.size() < sizeof(aes_nonce_)) {
-            ESP_LOGE(TAG, "Invalid audio packet size: %zu", data.size());
-            return;
-        }
-        if (data[0] != 0x01) {
-            ESP_LOGE(TAG, "Invalid audio packet type: %x", data[0]);
-            return;
-        }
-        uint32_t timestamp = ntohl(*(uint32_t*)&data[8]);
-        uint32_t sequence = ntohl(*(uint32_t*)&data[12]);
-        if (sequence < remote_sequence_) {
-            ESP_LOGW(TAG, "Received audio packet with old sequence: %lu, expected: %lu", sequence, remote_sequence_);
+        TRACE_SCOPE("udp_recv");
+        auto frame = (const uint8_t*)data.data();
+        uint32_t timestamp, sequence;
+        if (!AudioFrameCipher::ParseHeader(frame, data.size(), &timestamp, &sequence)) {
+            DLOGE(TAG, "Invalid audio packet, size: %zu, type: %x", data.size(), data.empty() ? 0 : data[0]);
             return;
         }
-        if (sequence != remote_sequence_ + 1) {
-            ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
-        }
-
-        size_t decrypted_size = data.size() - aes_nonce_.size();
-        size_t nc_off = 0;
-        uint8_t stream_block[16] = {0};
-        auto nonce = (uint8_t*)data.data();
-        auto encrypted = (uint8_t*)data.data() + aes_nonce_.size();
         AudioStreamPacket packet;
         packet.timestamp = timestamp;
-        packet.payload.resize(decrypted_size);
-        int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, decrypted_size, &nc_off, nonce, stream_block, encrypted, (uint8_t*)packet.payload.data());
-        if (ret != 0) {
-            ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
-            return;
+        {
+            // A server hello may set a new key and reset the window meanwhile
+            std::lock_guard<std::mutex> lock(receive_mutex_);
+            // Duplicates and packets that fell out of the window are dropped before any decryption
+            auto check = remote_window_.Check(sequence);
+            if (check == kSequenceDuplicate || check == kSequenceLate) {
+                DLOGW(TAG, "Dropped %s audio packet: %lu, highest: %lu", check == kSequenceDuplicate ? "duplicate" : "late",
+                    sequence, remote_window_.highest());
+                return;
+            }
+
+            // Decrypted straight into a recycled buffer that goes to the decoder as it is
+            packet.payload = AcquireAudioBuffer();
+            packet.payload.resize(data.size() - AUDIO_FRAME_HEADER_SIZE);
+            if (!cipher_.Open(frame, data.size(), packet.payload.data())) {
+                DLOGE(TAG, "Failed to decrypt audio data");
+                ReleaseAudioBuffer(std::move(packet.payload));
+                return;
+            }
+            remote_window_.Update(sequence);
         }
+        link_metrics_.OnDownlinkAudio(data.size(), server_frame_duration_);
         if (on_incoming_audio_ != nullptr) {
             on_incoming_audio_(std::move(packet));
         }
-        remote_sequence_ = sequence;
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
@@ -262,69 +476,59 @@ bool MqttProtocol::OpenAudioChannel() {
     return true;
 }
 
-void MqttProtocol::ParseServerHello(const cJSON* root) {
-    auto transport = cJSON_GetObjectItem(root, "transport");
-    if (transport == nullptr || strcmp(transport->valuestring, "udp") != 0) {
-        ESP_LOGE(TAG, "Unsupported transport: %s", transport->valuestring);
+void MqttProtocol::ParseServerHello(const JsonValue& root) {
+    auto transport = root.Get("transport");
+    if (!transport.Equals("udp")) {
+        ESP_LOGE(TAG, "Unsupported transport: %s", transport.ToString().c_str());
         return;
     }
 
-    auto session_id = cJSON_GetObjectItem(root, "session_id");
-    if (session_id != nullptr) {
-        session_id_ = session_id->valuestring;
+    auto session_id = root.Get("session_id");
+    if (session_id) {
+        session_id_ = session_id.ToString();
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
 
     // Get sample rate from hello message
-    auto audio_params = cJSON_GetObjectItem(root, "audio_params");
-    if (audio_params != NULL) {
-        auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
-        if (sample_rate != NULL) {
-            server_sample_rate_ = sample_rate->valueint;
-        }
-        auto frame_duration = cJSON_GetObjectItem(audio_params, "frame_duration");
-        if (frame_duration != NULL) {
-            server_frame_duration_ = frame_duration->valueint;
-        }
+    auto audio_params = root.Get("audio_params");
+    auto sample_rate = audio_params.Get("sample_rate");
+    if (sample_rate) {
+        server_sample_rate_ = sample_rate.ToInt();
     }
-
-    auto udp = cJSON_GetObjectItem(root, "udp");
-    if (udp == nullptr) {
+    auto frame_duration = audio_params.Get("frame_duration");
+    if (frame_duration) {
+        server_frame_duration_ = frame_duration.ToInt();
+    }
+    ParseMaxFramesPerPacket(audio_params);
+    ParseIotDescriptorsHash(root);
+    ParseHelloFeatures(root);
+
+    auto udp = root.Get("udp");
+    auto server = udp.Get("server");
+    auto port = udp.Get("port");
+    auto key = udp.Get("key");
+    auto nonce = udp.Get("nonce");
+    if (!server.IsString() || !port.IsNumber() || !key.IsString() || !nonce.IsString()) {
         ESP_LOGE(TAG, "UDP is not specified");
         return;
     }
-    udp_server_ = cJSON_GetObjectItem(udp, "server")->valuestring;
-    udp_port_ = cJSON_GetObjectItem(udp, "port")->valueint;
-    auto key = cJSON_GetObjectItem(udp, "key")->valuestring;
-    auto nonce = cJSON_GetObjectItem(udp, "nonce")->valuestring;
+    udp_server_ = server.ToString();
+    udp_port_ = port.ToInt();
 
     // auto encryption = cJSON_GetObjectItem(udp, "encryption")->valuestring;
     // ESP_LOGI(TAG, "UDP server: %s, port: %d, encryption: %s", udp_server_.c_str(), udp_port_, encryption);
-    aes_nonce_ = DecodeHexString(nonce);
-    mbedtls_aes_init(&aes_ctx_);
-    mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key).c_str(), 128);
-    local_sequence_ = 0;
-    remote_sequence_ = 0;
-    xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
-}
-
-static const char hex_chars[] = "0123456789ABCDEF";
-// 辅助函数，将单个十六进制字符转换为对应的数值
-static inline uint8_t CharToHex(char c) {
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
-    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-    return 0;  // 对于无效输入，返回0
-}
-
-std::string MqttProtocol::DecodeHexString(const std::string& hex_string) {
-    std::string decoded;
-    decoded.reserve(hex_string.size() / 2);
-    for (size_t i = 0; i < hex_string.size(); i += 2) {
-        char byte = (CharToHex(hex_string[i]) << 4) | CharToHex(hex_string[i + 1]);
-        decoded.push_back(byte);
+    {
+        // The channel of the previous session may still be sending and receiving with the old key
+        std::lock_guard<std::mutex> lock(channel_mutex_);
+        std::lock_guard<std::mutex> receive_lock(receive_mutex_);
+        if (!cipher_.SetKey(key.ToString(), nonce.ToString())) {
+            return;
+        }
+        local_sequence_ = 0;
+        remote_window_.Reset();
     }
-    return decoded;
+    link_metrics_.OnProbeAnswered(0);
+    xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 }
 
 bool MqttProtocol::IsAudioChannelOpened() const {
@@ -3,10 +3,11 @@
 
 
 #include "protocol.h"
+#include "audio_frame_cipher.h"
+#include "sequence_window.h"
 #include <mqtt.h>
 #include <udp.h>
 #include <cJSON.h>
-#include <mbedtls/aes.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 
@@ -17,8 +18,12 @@
 
 #define MQTT_PING_INTERVAL_SECONDS 90
 #define MQTT_RECONNECT_INTERVAL_MS 10000
+#define MQTT_RECONNECT_MAX_INTERVAL_MS 320000
 
 #define MQTT_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
+#define MQTT_PROTOCOL_PREWARM_DONE_EVENT (1 << 1)
+
+struct MqttPreWarm;
 
 class MqttProtocol : public Protocol {
 public:
@@ -30,6 +35,9 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    void PreWarm() override;
+
+    const SequenceWindow* audio_sequence_window() const override { return &remote_window_; }
 
 private:
     EventGroupHandle_t event_group_handle_;
@@ -41,20 +49,42 @@ private:
     std::string publish_topic_;
 
     std::mutex channel_mutex_;
+    // Guards cipher_ opening and remote_window_ against the UDP receive callback, which does not
+    // take channel_mutex_ so that deleting udp_ under it cannot wait on a blocked callback.
+    // Taken after channel_mutex_ when both are needed
+    std::mutex receive_mutex_;
     Mqtt* mqtt_ = nullptr;
     Udp* udp_ = nullptr;
-    mbedtls_aes_context aes_ctx_;
-    std::string aes_nonce_;
+    AudioFrameCipher cipher_;
+    std::string udp_frame_;   // Keeps its capacity, outgoing frames are built in place
     std::string udp_server_;
     int udp_port_;
     uint32_t local_sequence_;
-    uint32_t remote_sequence_;
+    SequenceWindow remote_window_;
+    std::chrono::steady_clock::time_point last_reconnect_time_;
+    int reconnect_interval_ms_ = MQTT_RECONNECT_INTERVAL_MS;
+    // Set on the main loop while the reconnect task runs, the client is taken over once it is done
+    MqttPreWarm* prewarm_ = nullptr;
+#if CONFIG_AUDIO_CHANNEL_LEASE_SECONDS > 0
+    // A hello sent while idle, used by the next OpenAudioChannel or released when it expires
+    bool lease_held_ = false;
+    bool lease_wanted_ = true;
+    std::chrono::steady_clock::time_point lease_expiry_;
+#endif
 
+    // Creates the client with its callbacks, not connected yet
+    Mqtt* CreateMqttClient();
     bool StartMqttClient(bool report_error=false);
-    void ParseServerHello(const cJSON* root);
-    std::string DecodeHexString(const std::string& hex_string);
+    void StartPreWarmConnect();
+    void FinishPreWarmConnect();
+    void ParseServerHello(const JsonValue& root);
+    bool SendHello();
+#if CONFIG_AUDIO_CHANNEL_LEASE_SECONDS > 0
+    void ReleaseLease();
+#endif
 
-    bool SendText(const std::string& text) override;
+    bool SendText(const char* text, size_t length) override;
+    void SendAudioFrames(const std::vector<AudioStreamPacket>& packets) override;
 };
 
 
@@ -1,11 +1,37 @@
 #include "protocol.h"
+#include "application.h"
+#include "json_writer.h"
+#include "iot/thing_manager.h"
 
 #include <esp_log.h>
+#include <arpa/inet.h>
+#include <cstring>
+#include <cstdio>
 
 #define TAG "Protocol"
 
-void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
-    on_incoming_json_ = callback;
+// Control messages are built on the stack, the writer fails instead of truncating
+#define PROTOCOL_MESSAGE_BUFFER_SIZE 256
+// Goodbye and telemetry messages carry the link metrics
+#define PROTOCOL_METRICS_BUFFER_SIZE 640
+// Enough for a full decode queue plus the packets in flight, extra buffers are freed
+#define PROTOCOL_AUDIO_BUFFER_POOL_SIZE 16
+
+Protocol::Protocol() {
+    OnIncomingJson("pong", [this](const JsonValue& root) {
+        link_metrics_.OnProbeAnswered(root.Get("id").ToInt());
+    });
+    OnIncomingJson("telemetry", [this](const JsonValue&) {
+        // Not from the receive callback: a publish there can stall the modem's receive thread,
+        // and the session state belongs to the main loop
+        Application::GetInstance().Schedule([this]() {
+            SendTelemetry();
+        });
+    });
+}
+
+void Protocol::OnIncomingJson(const char* type, std::function<void(const JsonValue& root)> callback) {
+    json_dispatcher_.On(type, callback);
 }
 
 void Protocol::OnIncomingAudio(std::function<void(AudioStreamPacket&& packet)> callback) {
@@ -24,6 +50,95 @@ void Protocol::OnNetworkError(std::function<void(const std::string& message)> ca
     on_network_error_ = callback;
 }
 
+std::vector<uint8_t> Protocol::AcquireAudioBuffer() {
+    std::lock_guard<std::mutex> lock(audio_buffer_mutex_);
+    if (audio_buffer_pool_.empty()) {
+        return std::vector<uint8_t>();
+    }
+    auto buffer = std::move(audio_buffer_pool_.back());
+    audio_buffer_pool_.pop_back();
+    return buffer;
+}
+
+void Protocol::ReleaseAudioBuffer(std::vector<uint8_t>&& buffer) {
+    if (buffer.capacity() == 0) {
+        return;
+    }
+    buffer.clear();
+    std::lock_guard<std::mutex> lock(audio_buffer_mutex_);
+    if (audio_buffer_pool_.size() < PROTOCOL_AUDIO_BUFFER_POOL_SIZE) {
+        if (audio_buffer_pool_.capacity() == 0) {
+            audio_buffer_pool_.reserve(PROTOCOL_AUDIO_BUFFER_POOL_SIZE);
+        }
+        audio_buffer_pool_.emplace_back(std::move(buffer));
+    }
+}
+
+void Protocol::ParseMaxFramesPerPacket(const JsonValue& audio_params) {
+    int frames = audio_params.Get("max_frames_per_packet").ToInt(1);
+    if (frames > CONFIG_AUDIO_AGGREGATION_MAX_FRAMES) {
+        frames = CONFIG_AUDIO_AGGREGATION_MAX_FRAMES;
+    }
+    // Runs on the receiving thread, sending_audio_ is left to the main loop
+    std::lock_guard<std::mutex> lock(queued_audio_mutex_);
+    max_frames_per_packet_ = frames > 1 ? frames : 1;
+    queued_audio_.clear();
+    queued_audio_.reserve(max_frames_per_packet_);
+    if (max_frames_per_packet_ > 1) {
+        ESP_LOGI(TAG, "Up to %d frames per packet", max_frames_per_packet_);
+    }
+}
+
+void Protocol::QueueAudio(AudioStreamPacket&& packet) {
+    std::lock_guard<std::mutex> lock(queued_audio_mutex_);
+    // The latency bound: nothing waits longer than max_frames_per_packet frames
+    if (queued_audio_.size() >= (size_t)max_frames_per_packet_) {
+        queued_audio_.erase(queued_audio_.begin());
+    }
+    queued_audio_.emplace_back(std::move(packet));
+}
+
+void Protocol::SendQueuedAudio() {
+    {
+        std::lock_guard<std::mutex> lock(queued_audio_mutex_);
+        // The swapped buffer becomes the queue, it must hold a full packet without growing
+        if (sending_audio_.capacity() < (size_t)max_frames_per_packet_) {
+            sending_audio_.reserve(max_frames_per_packet_);
+        }
+        sending_audio_.swap(queued_audio_);
+    }
+    if (sending_audio_.size() == 1) {
+        SendAudio(sending_audio_.front());
+    } else if (sending_audio_.size() > 1) {
+        SendAudioFrames(sending_audio_);
+    }
+    sending_audio_.clear();
+}
+
+void Protocol::SendAudioFrames(const std::vector<AudioStreamPacket>& packets) {
+    for (auto& packet : packets) {
+        SendAudio(packet);
+    }
+}
+
+size_t Protocol::PackAudioFrames(const std::vector<AudioStreamPacket>& packets, std::string& out, size_t offset) {
+    size_t size = 0;
+    for (auto& packet : packets) {
+        size += AUDIO_AGGREGATE_ENTRY_SIZE + packet.payload.size();
+    }
+    out.resize(offset + size);
+    auto p = (uint8_t*)&out[offset];
+    for (auto& packet : packets) {
+        uint32_t timestamp = htonl(packet.timestamp);
+        uint16_t length = htons(packet.payload.size());
+        memcpy(p, &timestamp, sizeof(timestamp));
+        memcpy(p + 4, &length, sizeof(length));
+        memcpy(p + AUDIO_AGGREGATE_ENTRY_SIZE, packet.payload.data(), packet.payload.size());
+        p += AUDIO_AGGREGATE_ENTRY_SIZE + packet.payload.size();
+    }
+    return size;
+}
+
 void Protocol::SetError(const std::string& message) {
     error_occurred_ = true;
     if (on_network_error_ != nullptr) {
@@ -31,88 +146,180 @@ void Protocol::SetError(const std::string& message) {
     }
 }
 
+bool Protocol::SendJson(const JsonWriter& json) {
+    if (!json.ok()) {
+        ESP_LOGE(TAG, "Failed to build message: %.*s", (int)json.size(), json.data());
+        return false;
+    }
+    return SendText(json.data(), json.size());
+}
+
 void Protocol::SendAbortSpeaking(AbortReason reason) {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"abort\"";
+    char buffer[PROTOCOL_MESSAGE_BUFFER_SIZE];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.BeginObject();
+    json.Key("session_id").String(session_id_);
+    json.Key("type").String("abort");
     if (reason == kAbortReasonWakeWordDetected) {
-        message += ",\"reason\":\"wake_word_detected\"";
+        json.Key("reason").String("wake_word_detected");
     }
-    message += "}";
-    SendText(message);
+    json.EndObject();
+    SendJson(json);
 }
 
 void Protocol::SendWakeWordDetected(const std::string& wake_word) {
-    std::string json = "{\"session_id\":\"" + session_id_ + 
-                      "\",\"type\":\"listen\",\"state\":\"detect\",\"text\":\"" + wake_word + "\"}";
-    SendText(json);
+    char buffer[PROTOCOL_MESSAGE_BUFFER_SIZE];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.BeginObject();
+    json.Key("session_id").String(session_id_);
+    json.Key("type").String("listen");
+    json.Key("state").String("detect");
+    json.Key("text").String(wake_word);
+    json.EndObject();
+    SendJson(json);
 }
 
 void Protocol::SendStartListening(ListeningMode mode) {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\"";
-    message += ",\"type\":\"listen\",\"state\":\"start\"";
+    char buffer[PROTOCOL_MESSAGE_BUFFER_SIZE];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.BeginObject();
+    json.Key("session_id").String(session_id_);
+    json.Key("type").String("listen");
+    json.Key("state").String("start");
     if (mode == kListeningModeRealtime) {
-        message += ",\"mode\":\"realtime\"";
+        json.Key("mode").String("realtime");
     } else if (mode == kListeningModeAutoStop) {
-        message += ",\"mode\":\"auto\"";
+        json.Key("mode").String("auto");
     } else {
-        message += ",\"mode\":\"manual\"";
+        json.Key("mode").String("manual");
     }
-    message += "}";
-    SendText(message);
+    json.EndObject();
+    SendJson(json);
+#if CONFIG_LINK_TELEMETRY
+    // One round trip sample per turn
+    if (telemetry_accepted_) {
+        SendPing();
+    }
+#endif
 }
 
-void Protocol::SendStopListening() {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"listen\",\"state\":\"stop\"}";
-    SendText(message);
+void Protocol::SendPing() {
+    char buffer[PROTOCOL_MESSAGE_BUFFER_SIZE];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.BeginObject();
+    json.Key("session_id").String(session_id_);
+    json.Key("type").String("ping");
+    json.Key("id").UInt(++ping_id_);
+    json.EndObject();
+    link_metrics_.OnProbeSent(ping_id_);
+    SendJson(json);
 }
 
-void Protocol::SendIotDescriptors(const std::string& descriptors) {
-    cJSON* root = cJSON_Parse(descriptors.c_str());
-    if (root == nullptr) {
-        ESP_LOGE(TAG, "Failed to parse IoT descriptors: %s", descriptors.c_str());
-        return;
-    }
+void Protocol::SendTelemetry() {
+    char buffer[PROTOCOL_METRICS_BUFFER_SIZE];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.BeginObject();
+    json.Key("session_id").String(session_id_);
+    json.Key("type").String("telemetry");
+    json.Key("metrics").BeginObject();
+    link_metrics_.Write(json, audio_sequence_window());
+    json.EndObject();
+    json.EndObject();
+    SendJson(json);
+}
 
-    if (!cJSON_IsArray(root)) {
-        ESP_LOGE(TAG, "IoT descriptors should be an array");
-        cJSON_Delete(root);
-        return;
+void Protocol::SendGoodbye(bool with_metrics) {
+    char buffer[PROTOCOL_METRICS_BUFFER_SIZE];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.BeginObject();
+    json.Key("session_id").String(session_id_);
+    json.Key("type").String("goodbye");
+#if CONFIG_LINK_TELEMETRY
+    if (with_metrics && telemetry_accepted_) {
+        json.Key("metrics").BeginObject();
+        link_metrics_.Write(json, audio_sequence_window());
+        json.EndObject();
     }
+#endif
+    json.EndObject();
+    SendJson(json);
+}
 
-    int arraySize = cJSON_GetArraySize(root);
-    for (int i = 0; i < arraySize; ++i) {
-        cJSON* descriptor = cJSON_GetArrayItem(root, i);
-        if (descriptor == nullptr) {
-            ESP_LOGE(TAG, "Failed to get IoT descriptor at index %d", i);
-            continue;
-        }
+void Protocol::SendStopListening() {
+    // The last frames of the turn go out before the server is told it ended
+    SendQueuedAudio();
+    char buffer[PROTOCOL_MESSAGE_BUFFER_SIZE];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.BeginObject();
+    json.Key("session_id").String(session_id_);
+    json.Key("type").String("listen");
+    json.Key("state").String("stop");
+    json.EndObject();
+    SendJson(json);
+}
 
-        cJSON* messageRoot = cJSON_CreateObject();
-        cJSON_AddStringToObject(messageRoot, "session_id", session_id_.c_str());
-        cJSON_AddStringToObject(messageRoot, "type", "iot");
-        cJSON_AddBoolToObject(messageRoot, "update", true);
+void Protocol::WriteHelloFeatures(JsonWriter& json) const {
+#if CONFIG_USE_SERVER_AEC || CONFIG_LINK_TELEMETRY
+    json.Key("features").BeginObject();
+#if CONFIG_USE_SERVER_AEC
+    json.Key("aec").Bool(true);
+#endif
+#if CONFIG_LINK_TELEMETRY
+    json.Key("telemetry").Bool(true);
+#endif
+    json.EndObject();
+#endif
+}
 
-        cJSON* descriptorArray = cJSON_CreateArray();
-        cJSON_AddItemToArray(descriptorArray, cJSON_Duplicate(descriptor, 1));
-        cJSON_AddItemToObject(messageRoot, "descriptors", descriptorArray);
+void Protocol::ParseHelloFeatures(const JsonValue& root) {
+    // Pings and metrics only go to a server that answered the offer, others never see them
+    telemetry_accepted_ = root.Get("features").Get("telemetry").ToBool();
+}
 
-        char* message = cJSON_PrintUnformatted(messageRoot);
-        if (message == nullptr) {
-            ESP_LOGE(TAG, "Failed to print JSON message for IoT descriptor at index %d", i);
-            cJSON_Delete(messageRoot);
-            continue;
-        }
+void Protocol::WriteIotDescriptorsHash(JsonWriter& json) {
+    // Taken when the hello is built, things added after the start change it
+    char hex[9];
+    snprintf(hex, sizeof(hex), "%08lx", (unsigned long)iot::ThingManager::GetInstance().GetDescriptorsHash());
+    iot_descriptors_hash_ = hex;
+    json.Key("iot_descriptors_hash").String(iot_descriptors_hash_);
+}
 
-        SendText(std::string(message));
-        cJSON_free(message);
-        cJSON_Delete(messageRoot);
-    }
+void Protocol::ParseIotDescriptorsHash(const JsonValue& root) {
+    // A server that does not cache descriptors leaves the hash out and gets them every session
+    iot_descriptors_synced_ = !iot_descriptors_hash_.empty() &&
+        root.Get("iot_descriptors_hash").Equals(iot_descriptors_hash_.c_str());
+}
 
-    cJSON_Delete(root);
+void Protocol::SendIotDescriptors(const std::string& descriptors) {
+    if (iot_descriptors_synced_) {
+        ESP_LOGI(TAG, "IoT descriptors %s already known by the server", iot_descriptors_hash_.c_str());
+        return;
+    }
+    // All things in one message, the array is inserted as it is without parsing it
+    std::string message;
+    message.reserve(descriptors.size() + 96 + session_id_.size());
+    JsonWriter json(message);
+    json.BeginObject();
+    json.Key("session_id").String(session_id_);
+    json.Key("type").String("iot");
+    json.Key("update").Bool(true);
+    json.Key("descriptors").Raw(descriptors);
+    json.EndObject();
+    SendJson(json);
 }
 
 void Protocol::SendIotStates(const std::string& states) {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"iot\",\"update\":true,\"states\":" + states + "}";
-    SendText(message);
+    // The states can be larger than the stack buffer, reserve once instead
+    std::string message;
+    message.reserve(states.size() + 96 + session_id_.size());
+    JsonWriter json(message);
+    json.BeginObject();
+    json.Key("session_id").String(session_id_);
+    json.Key("type").String("iot");
+    json.Key("update").Bool(true);
+    json.Key("states").Raw(states);
+    json.EndObject();
+    SendJson(json);
 }
 
 bool Protocol::IsTimeout() const {
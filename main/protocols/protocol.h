@@ -2,19 +2,37 @@
 #define PROTOCOL_H
 
 #include <cJSON.h>
+#include "json_reader.h"
+#include "link_metrics.h"
 #include <string>
 #include <functional>
 #include <chrono>
 #include <vector>
+#include <mutex>
+
+class JsonWriter;
 
 struct AudioStreamPacket {
     uint32_t timestamp = 0;
     std::vector<uint8_t> payload;
 };
 
+/*
+ * Several uplink frames in one message, negotiated as max_frames_per_packet in the
+ * hello audio_params. The payload is a sequence of |timestamp 4u|payload_len 2u|payload|
+ * entries in big-endian, sent as BinaryProtocol2/3 type 2 or as a UDP packet with the
+ * aggregated flag set.
+ */
+#define AUDIO_AGGREGATE_ENTRY_SIZE 6
+#define AUDIO_TYPE_OPUS_AGGREGATED 2
+
+#ifndef CONFIG_AUDIO_AGGREGATION_MAX_FRAMES
+#define CONFIG_AUDIO_AGGREGATION_MAX_FRAMES 1
+#endif
+
 struct BinaryProtocol2 {
     uint16_t version;
-    uint16_t type;          // Message type (0: OPUS, 1: JSON)
+    uint16_t type;          // Message type (0: OPUS, 1: JSON, 2: aggregated OPUS)
     uint32_t reserved;      // Reserved for future use
     uint32_t timestamp;     // Timestamp in milliseconds (used for server-side AEC)
     uint32_t payload_size;  // Payload size in bytes
@@ -41,6 +59,7 @@ enum ListeningMode {
 
 class Protocol {
 public:
+    Protocol();
     virtual ~Protocol() = default;
 
     inline int server_sample_rate() const {
@@ -52,9 +71,13 @@ public:
     inline const std::string& session_id() const {
         return session_id_;
     }
+    inline int max_frames_per_packet() const {
+        return max_frames_per_packet_;
+    }
 
     void OnIncomingAudio(std::function<void(AudioStreamPacket&& packet)> callback);
-    void OnIncomingJson(std::function<void(const cJSON* root)> callback);
+    // Handler for the server messages of the given type, see JsonDispatcher
+    void OnIncomingJson(const char* type, std::function<void(const JsonValue& root)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
     void OnNetworkError(std::function<void(const std::string& message)> callback);
@@ -64,16 +87,31 @@ public:
     virtual void CloseAudioChannel() = 0;
     virtual bool IsAudioChannelOpened() const = 0;
     virtual bool IsAudioChannelBusy() const;
+    // Called periodically while idle, prepares what the next OpenAudioChannel would wait for
+    virtual void PreWarm() {}
     virtual void SendAudio(const AudioStreamPacket& packet) = 0;
+    // Uplink with aggregation: frames are queued as they are encoded, a flush sends all
+    // queued frames in one message. The oldest frame is dropped once the queue is full.
+    // SendQueuedAudio runs on the main loop only, stop listening and closing the channel flush too
+    void QueueAudio(AudioStreamPacket&& packet);
+    void SendQueuedAudio();
     virtual void SendWakeWordDetected(const std::string& wake_word);
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
+    // The hello carries the hash of the current descriptors, they are uploaded in one message
+    // unless the server hello answers with the same hash
     virtual void SendIotDescriptors(const std::string& descriptors);
     virtual void SendIotStates(const std::string& states);
 
+    // Hands a decoded payload back so that the next incoming packet reuses its storage
+    void ReleaseAudioBuffer(std::vector<uint8_t>&& buffer);
+
+    const LinkMetrics& link_metrics() const { return link_metrics_; }
+    // Sequence window of the downlink audio, null if the transport does not number packets
+    virtual const SequenceWindow* audio_sequence_window() const { return nullptr; }
+
 protected:
-    std::function<void(const cJSON* root)> on_incoming_json_;
     std::function<void(AudioStreamPacket&& packet)> on_incoming_audio_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
@@ -85,8 +123,39 @@ protected:
     bool busy_sending_audio_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
+    JsonDispatcher json_dispatcher_;
+    std::mutex audio_buffer_mutex_;
+    std::vector<std::vector<uint8_t>> audio_buffer_pool_;
+    int max_frames_per_packet_ = 1;
+    std::mutex queued_audio_mutex_;
+    std::vector<AudioStreamPacket> queued_audio_;
+    std::vector<AudioStreamPacket> sending_audio_;   // Main loop only
+    LinkMetrics link_metrics_;
+    uint32_t ping_id_ = 0;
+    std::string iot_descriptors_hash_;   // The hash sent in the last hello
+    bool iot_descriptors_synced_ = false;
+    bool telemetry_accepted_ = false;
 
-    virtual bool SendText(const std::string& text) = 0;
+    virtual bool SendText(const char* text, size_t length) = 0;
+    bool SendJson(const JsonWriter& json);
+    // Ends the session, with the link metrics unless it never carried a conversation
+    void SendGoodbye(bool with_metrics = true);
+    // Round trip probe on the control channel, answered with a pong of the same id
+    void SendPing();
+    void SendTelemetry();
+    // Features offered in the client hello, the server hello says which of them it accepts
+    void WriteHelloFeatures(JsonWriter& json) const;
+    void ParseHelloFeatures(const JsonValue& root);
+    void WriteIotDescriptorsHash(JsonWriter& json);
+    void ParseIotDescriptorsHash(const JsonValue& root);
+    // Empty payload buffer for an incoming packet, recycled if one was released
+    std::vector<uint8_t> AcquireAudioBuffer();
+    // Takes the smaller of what we offered and what the server hello accepts, 1 if it did not answer
+    void ParseMaxFramesPerPacket(const JsonValue& audio_params);
+    // Sends frames as one aggregated message, the default sends them one by one
+    virtual void SendAudioFrames(const std::vector<AudioStreamPacket>& packets);
+    // Writes the aggregate entries of packets to out from offset on, returns the payload size
+    size_t PackAudioFrames(const std::vector<AudioStreamPacket>& packets, std::string& out, size_t offset);
     virtual void SetError(const std::string& message);
     virtual bool IsTimeout() const;
 };
@@ -0,0 +1,47 @@
+#include "sequence_window.h"
+
+void SequenceWindow::Reset() {
+    bitmap_ = ~0ULL;
+    highest_ = 0;
+    stats_ = SequenceStats();
+}
+
+SequenceCheck SequenceWindow::Check(uint32_t sequence) {
+    if (sequence > highest_) {
+        return kSequenceNew;
+    }
+    uint32_t offset = highest_ - sequence;
+    if (offset >= SEQUENCE_WINDOW_SIZE) {
+        stats_.late++;
+        return kSequenceLate;
+    }
+    if (bitmap_ & (1ULL << offset)) {
+        stats_.duplicate++;
+        return kSequenceDuplicate;
+    }
+    return kSequenceReordered;
+}
+
+void SequenceWindow::Update(uint32_t sequence) {
+    stats_.received++;
+    if (sequence <= highest_) {
+        uint32_t offset = highest_ - sequence;
+        if (offset < SEQUENCE_WINDOW_SIZE) {
+            bitmap_ |= 1ULL << offset;
+            stats_.reordered++;
+        }
+        return;
+    }
+
+    // Every sequence pushed out of the window that was never marked is lost
+    uint32_t shift = sequence - highest_;
+    if (shift >= SEQUENCE_WINDOW_SIZE) {
+        stats_.lost += missing() + (shift - SEQUENCE_WINDOW_SIZE);
+        bitmap_ = 1;
+    } else {
+        uint64_t leaving = bitmap_ >> (SEQUENCE_WINDOW_SIZE - shift);
+        stats_.lost += shift - __builtin_popcountll(leaving);
+        bitmap_ = (bitmap_ << shift) | 1;
+    }
+    highest_ = sequence;
+}
@@ -0,0 +1,55 @@
+#ifndef SEQUENCE_WINDOW_H
+#define SEQUENCE_WINDOW_H
+
+#include <cstdint>
+
+/*
+ * Anti-replay window over the sequence numbers of incoming audio packets.
+ *
+ * Bit i of the bitmap records whether highest - i has been received, so packets
+ * up to 63 behind the newest one are still accepted once and go to the decoder
+ * as they arrive. Check() is cheap and runs before a packet is decrypted, Update()
+ * marks it once it has been decrypted. Sequences that leave the window without
+ * being seen are counted as lost. Sequence numbers of a session start at 1.
+ */
+
+#define SEQUENCE_WINDOW_SIZE 64
+
+struct SequenceStats {
+    uint32_t received = 0;
+    uint32_t lost = 0;
+    uint32_t duplicate = 0;
+    uint32_t reordered = 0;     // Accepted behind the newest packet
+    uint32_t late = 0;          // Too far behind, already counted as lost
+};
+
+enum SequenceCheck {
+    kSequenceNew,
+    kSequenceReordered,
+    kSequenceDuplicate,
+    kSequenceLate,
+};
+
+class SequenceWindow {
+public:
+    // Starts a new session, the stats are cleared
+    void Reset();
+
+    // Whether the packet should be accepted, counts the rejected ones
+    SequenceCheck Check(uint32_t sequence);
+    // Marks an accepted packet as received and slides the window forward
+    void Update(uint32_t sequence);
+
+    uint32_t highest() const { return highest_; }
+    const SequenceStats& stats() const { return stats_; }
+    // Sequences inside the window that have not arrived yet, not counted as lost so far
+    uint32_t missing() const { return SEQUENCE_WINDOW_SIZE - __builtin_popcountll(bitmap_); }
+
+private:
+    // Everything before the first sequence counts as received
+    uint64_t bitmap_ = ~0ULL;
+    uint32_t highest_ = 0;
+    SequenceStats stats_;
+};
+
+#endif // SEQUENCE_WINDOW_H
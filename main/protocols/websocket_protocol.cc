@@ -3,10 +3,15 @@
 #include "system_info.h"
 #include "application.h"
 #include "settings.h"
+#include "event_trace.h"
+#include "deferred_log.h"
+#include "json_writer.h"
 
 #include <cstring>
+#include <algorithm>
 #include <cJSON.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <arpa/inet.h>
 #include "assets/lang_config.h"
 
@@ -14,6 +19,10 @@
 
 WebsocketProtocol::WebsocketProtocol() {
     event_group_handle_ = xEventGroupCreate();
+
+    OnIncomingJson("hello", [this](const JsonValue& root) {
+        ParseServerHello(root);
+    });
 }
 
 WebsocketProtocol::~WebsocketProtocol() {
@@ -24,179 +33,404 @@ WebsocketProtocol::~WebsocketProtocol() {
 }
 
 bool WebsocketProtocol::Start() {
-    // Only connect to server when audio channel is needed
+    // Only connect to server when audio channel is needed, or when PreWarm keeps it up
+    idle_since_ = std::chrono::steady_clock::now();
     return true;
 }
 
-void WebsocketProtocol::SendAudio(const AudioStreamPacket& packet) {
-    if (websocket_ == nullptr) {
-        return;
-    }
-
+size_t WebsocketProtocol::SerializeAudioHeader(const AudioStreamPacket& packet, uint8_t* header) {
+    size_t payload_size = packet.payload.size();
     if (version_ == 2) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol2) + packet.payload.size());
-        auto bp2 = (BinaryProtocol2*)serialized.data();
+        auto bp2 = (BinaryProtocol2*)header;
         bp2->version = htons(version_);
         bp2->type = 0;
         bp2->reserved = 0;
         bp2->timestamp = htonl(packet.timestamp);
-        bp2->payload_size = htonl(packet.payload.size());
-        memcpy(bp2->payload, packet.payload.data(), packet.payload.size());
-
-        busy_sending_audio_ = true;
-        websocket_->Send(serialized.data(), serialized.size(), true);
-        busy_sending_audio_ = false;
+        bp2->payload_size = htonl(payload_size);
+        return sizeof(BinaryProtocol2);
     } else if (version_ == 3) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol3) + packet.payload.size());
-        auto bp3 = (BinaryProtocol3*)serialized.data();
+        auto bp3 = (BinaryProtocol3*)header;
         bp3->type = 0;
         bp3->reserved = 0;
-        bp3->payload_size = htons(packet.payload.size());
-        memcpy(bp3->payload, packet.payload.data(), packet.payload.size());
+        bp3->payload_size = htons(payload_size);
+        return sizeof(BinaryProtocol3);
+    }
+    // Version 1 frames are the bare payload
+    return 0;
+}
 
-        busy_sending_audio_ = true;
-        websocket_->Send(serialized.data(), serialized.size(), true);
-        busy_sending_audio_ = false;
-    } else {
-        busy_sending_audio_ = true;
+void WebsocketProtocol::SendAudio(const AudioStreamPacket& packet) {
+    if (websocket_ == nullptr) {
+        return;
+    }
+
+    TRACE_SCOPE("ws_send_audio");
+    uint8_t header[sizeof(BinaryProtocol2)];
+    size_t header_size = SerializeAudioHeader(packet, header);
+    size_t size = header_size + packet.payload.size();
+    busy_sending_audio_ = true;
+    int64_t send_start = esp_timer_get_time();
+#ifdef WEB_SOCKET_HAS_GATHER_SEND
+    // Only the host WebSocket shim has this overload
+    websocket_->Send(header, header_size, packet.payload.data(), packet.payload.size(), true);
+#else
+    // The WebSocket of the esp-ml307 component sends one contiguous buffer, so the device still
+    // copies the payload once behind the header. The component copies it again while masking
+    if (header_size == 0) {
         websocket_->Send(packet.payload.data(), packet.payload.size(), true);
-        busy_sending_audio_ = false;
+    } else {
+        send_buffer_.assign((const char*)header, header_size);
+        send_buffer_.append((const char*)packet.payload.data(), packet.payload.size());
+        websocket_->Send(send_buffer_.data(), send_buffer_.size(), true);
     }
+#endif
+    link_metrics_.OnUplinkAudio(size, esp_timer_get_time() - send_start);
+    busy_sending_audio_ = false;
 }
 
-bool WebsocketProtocol::SendText(const std::string& text) {
+void WebsocketProtocol::SendAudioFrames(const std::vector<AudioStreamPacket>& packets) {
     if (websocket_ == nullptr) {
+        return;
+    }
+    if (version_ < 2) {
+        Protocol::SendAudioFrames(packets);
+        return;
+    }
+
+    TRACE_SCOPE("ws_send_audio");
+    if (version_ == 2) {
+        size_t size = PackAudioFrames(packets, send_buffer_, sizeof(BinaryProtocol2));
+        auto bp2 = (BinaryProtocol2*)&send_buffer_[0];
+        bp2->version = htons(version_);
+        bp2->type = htons(AUDIO_TYPE_OPUS_AGGREGATED);
+        bp2->reserved = 0;
+        bp2->timestamp = htonl(packets.front().timestamp);
+        bp2->payload_size = htonl(size);
+    } else {
+        size_t size = PackAudioFrames(packets, send_buffer_, sizeof(BinaryProtocol3));
+        auto bp3 = (BinaryProtocol3*)&send_buffer_[0];
+        bp3->type = AUDIO_TYPE_OPUS_AGGREGATED;
+        bp3->reserved = 0;
+        bp3->payload_size = htons(size);
+    }
+    busy_sending_audio_ = true;
+    int64_t send_start = esp_timer_get_time();
+    websocket_->Send(send_buffer_.data(), send_buffer_.size(), true);
+    link_metrics_.OnUplinkAudio(send_buffer_.size(), esp_timer_get_time() - send_start);
+    busy_sending_audio_ = false;
+}
+
+/*
+ * The receive buffer belongs to the WebSocket client, so the header fields are read
+ * into locals instead of being swapped in place. The payload is copied once, into a
+ * recycled buffer that goes to the decoder as it is.
+ */
+bool WebsocketProtocol::ParseAudio(const char* data, size_t len, AudioStreamPacket& packet) {
+    const char* payload = data;
+    size_t payload_size = len;
+    packet.timestamp = 0;
+    if (version_ == 2) {
+        if (len < sizeof(BinaryProtocol2)) {
+            return false;
+        }
+        BinaryProtocol2 bp2;
+        memcpy(&bp2, data, sizeof(bp2));
+        packet.timestamp = ntohl(bp2.timestamp);
+        payload = data + sizeof(BinaryProtocol2);
+        payload_size = ntohl(bp2.payload_size);
+    } else if (version_ == 3) {
+        if (len < sizeof(BinaryProtocol3)) {
+            return false;
+        }
+        BinaryProtocol3 bp3;
+        memcpy(&bp3, data, sizeof(bp3));
+        payload = data + sizeof(BinaryProtocol3);
+        payload_size = ntohs(bp3.payload_size);
+    }
+    if (payload_size > len - (payload - data)) {
         return false;
     }
+    packet.payload = AcquireAudioBuffer();
+    packet.payload.assign((const uint8_t*)payload, (const uint8_t*)payload + payload_size);
+    return true;
+}
 
-    if (!websocket_->Send(text)) {
-        ESP_LOGE(TAG, "Failed to send text: %s", text.c_str());
-        SetError(Lang::Strings::SERVER_ERROR);
+bool WebsocketProtocol::SendText(const char* text, size_t length) {
+    if (websocket_ == nullptr) {
         return false;
     }
 
+    TRACE_SCOPE("ws_send_text");
+    if (!websocket_->Send(text, length, false)) {
+        ESP_LOGE(TAG, "Failed to send text: %.*s", (int)length, text);
+        SetError(Lang::Strings::SERVER_ERROR);
+        return false;
+    }
+    link_metrics_.OnUplinkBytes(length);
     return true;
 }
 
 bool WebsocketProtocol::IsAudioChannelOpened() const {
-    return websocket_ != nullptr && websocket_->IsConnected() && !error_occurred_ && !IsTimeout();
+    return websocket_ != nullptr && websocket_->IsConnected() && session_active_ && !error_occurred_ && !IsTimeout();
 }
 
 void WebsocketProtocol::CloseAudioChannel() {
-    if (websocket_ != nullptr) {
-        delete websocket_;
-        websocket_ = nullptr;
+    if (session_active_) {
+        SendQueuedAudio();
+    }
+    // Reported once, a connection lost during the session has already done it
+    bool was_active = session_active_.exchange(false);
+#if CONFIG_WEBSOCKET_KEEP_ALIVE_SECONDS > 0
+    // End the session only, the connection is kept for the next one
+    if (websocket_ != nullptr && websocket_->IsConnected()) {
+        if (was_active) {
+            SendGoodbye();
+        }
+        idle_since_ = std::chrono::steady_clock::now();
+        last_ping_time_ = idle_since_;
+    } else {
+        Disconnect();
+    }
+#else
+#if CONFIG_LINK_TELEMETRY
+    // The goodbye only carries the metrics here, the connection goes away anyway
+    if (was_active && telemetry_accepted_ && websocket_ != nullptr && websocket_->IsConnected()) {
+        SendGoodbye();
+    }
+#endif
+    Disconnect();
+#endif
+    if (was_active && on_audio_channel_closed_ != nullptr) {
+        on_audio_channel_closed_();
     }
 }
 
-bool WebsocketProtocol::OpenAudioChannel() {
+void WebsocketProtocol::Disconnect() {
+    session_active_ = false;
     if (websocket_ != nullptr) {
         delete websocket_;
+        websocket_ = nullptr;
     }
+}
 
+WebSocket* WebsocketProtocol::CreateWebSocket(std::string& url, int& version) {
     Settings settings("websocket", false);
-    std::string url = settings.GetString("url");
+    url = settings.GetString("url");
     std::string token = settings.GetString("token");
-    int version = settings.GetInt("version");
-    if (version != 0) {
-        version_ = version;
-    }
+    int saved_version = settings.GetInt("version");
+    version = saved_version != 0 ? saved_version : version_;
 
-    busy_sending_audio_ = false;
-    error_occurred_ = false;
-
-    websocket_ = Board::GetInstance().CreateWebSocket();
+    auto websocket = Board::GetInstance().CreateWebSocket();
     
     if (!token.empty()) {
         // If token not has a space, add "Bearer " prefix
         if (token.find(" ") == std::string::npos) {
             token = "Bearer " + token;
         }
-        websocket_->SetHeader("Authorization", token.c_str());
-    }
-    websocket_->SetHeader("Protocol-Version", std::to_string(version_).c_str());
-    websocket_->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
-    websocket_->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
-
-    websocket_->OnData([this](const char* data, size_t len, bool binary) {
-        if (binary) {
-            if (on_incoming_audio_ != nullptr) {
-                if (version_ == 2) {
-                    BinaryProtocol2* bp2 = (BinaryProtocol2*)data;
-                    bp2->version = ntohs(bp2->version);
-                    bp2->type = ntohs(bp2->type);
-                    bp2->timestamp = ntohl(bp2->timestamp);
-                    bp2->payload_size = ntohl(bp2->payload_size);
-                    auto payload = (uint8_t*)bp2->payload;
-                    on_incoming_audio_(AudioStreamPacket{
-                        .timestamp = bp2->timestamp,
-                        .payload = std::vector<uint8_t>(payload, payload + bp2->payload_size)
-                    });
-                } else if (version_ == 3) {
-                    BinaryProtocol3* bp3 = (BinaryProtocol3*)data;
-                    bp3->type = bp3->type;
-                    bp3->payload_size = ntohs(bp3->payload_size);
-                    auto payload = (uint8_t*)bp3->payload;
-                    on_incoming_audio_(AudioStreamPacket{
-                        .timestamp = 0,
-                        .payload = std::vector<uint8_t>(payload, payload + bp3->payload_size)
-                    });
-                } else {
-                    on_incoming_audio_(AudioStreamPacket{
-                        .timestamp = 0,
-                        .payload = std::vector<uint8_t>((uint8_t*)data, (uint8_t*)data + len)
-                    });
-                }
-            }
-        } else {
-            // Parse JSON data
-            auto root = cJSON_Parse(data);
-            auto type = cJSON_GetObjectItem(root, "type");
-            if (type != NULL) {
-                if (strcmp(type->valuestring, "hello") == 0) {
-                    ParseServerHello(root);
-                } else {
-                    if (on_incoming_json_ != nullptr) {
-                        on_incoming_json_(root);
-                    }
-                }
-            } else {
-                ESP_LOGE(TAG, "Missing message type, data: %s", data);
-            }
-            cJSON_Delete(root);
+        websocket->SetHeader("Authorization", token.c_str());
+    }
+    websocket->SetHeader("Protocol-Version", std::to_string(version).c_str());
+    websocket->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+    websocket->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
+
+    // A connection the pre-warm task has not handed over yet carries no session
+    websocket->OnData([this, websocket](const char* data, size_t len, bool binary) {
+        if (websocket == websocket_) {
+            OnData(data, len, binary);
         }
-        last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
-    websocket_->OnDisconnected([this]() {
+    websocket->OnDisconnected([this, websocket]() {
         ESP_LOGI(TAG, "Websocket disconnected");
-        if (on_audio_channel_closed_ != nullptr) {
+        // An idle connection is brought back by PreWarm, only a session is reported
+        if (websocket == websocket_ && session_active_.exchange(false) && on_audio_channel_closed_ != nullptr) {
             on_audio_channel_closed_();
         }
     });
+    return websocket;
+}
+
+bool WebsocketProtocol::Connect() {
+    Disconnect();
+
+    std::string url;
+    websocket_ = CreateWebSocket(url, version_);
 
     ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d", url.c_str(), version_);
+    int64_t connect_start = esp_timer_get_time();
     if (!websocket_->Connect(url.c_str())) {
         ESP_LOGE(TAG, "Failed to connect to websocket server");
+        Disconnect();
+        return false;
+    }
+    link_metrics_.OnConnected(esp_timer_get_time() - connect_start);
+    last_ping_time_ = std::chrono::steady_clock::now();
+    return true;
+}
+
+void WebsocketProtocol::OnData(const char* data, size_t len, bool binary) {
+    TRACE_SCOPE("ws_recv");
+    if (binary) {
+        // Audio still in flight from an ended session is not played
+        if (on_incoming_audio_ != nullptr && session_active_) {
+            AudioStreamPacket packet;
+            if (ParseAudio(data, len, packet)) {
+                link_metrics_.OnDownlinkAudio(len, server_frame_duration_);
+                on_incoming_audio_(std::move(packet));
+            } else {
+                DLOGE(TAG, "Invalid audio frame, size: %zu", len);
+            }
+        }
+    } else {
+        // Without a session only the hello that starts one is accepted, and a session
+        // ignores messages addressed to another one
+        JsonValue root(data, len);
+        if (!session_active_) {
+            if (!root.Get("type").Equals("hello")) {
+                DLOGW(TAG, "Dropped message outside of a session: %.*s", (int)std::min(len, (size_t)64), data);
+                return;
+            }
+        } else {
+            auto session_id = root.Get("session_id");
+            if (session_id.IsString() && !session_id_.empty() && !session_id.Equals(session_id_.c_str())) {
+                DLOGW(TAG, "Dropped message of another session: %.*s", (int)std::min(len, (size_t)64), data);
+                return;
+            }
+        }
+        link_metrics_.OnDownlinkBytes(len);
+        json_dispatcher_.Dispatch(data, len);
+    }
+    last_incoming_time_ = std::chrono::steady_clock::now();
+}
+
+void WebsocketProtocol::PreWarm() {
+#if CONFIG_WEBSOCKET_KEEP_ALIVE_SECONDS > 0
+    auto now = std::chrono::steady_clock::now();
+    if (now - idle_since_ >= std::chrono::seconds(CONFIG_WEBSOCKET_KEEP_ALIVE_SECONDS)) {
+        if (websocket_ != nullptr) {
+            ESP_LOGI(TAG, "Closing the idle connection");
+            Disconnect();
+        }
+        return;
+    }
+
+    if (websocket_ != nullptr && websocket_->IsConnected()) {
+        if (now - last_ping_time_ >= std::chrono::seconds(WEBSOCKET_PING_INTERVAL_SECONDS)) {
+            last_ping_time_ = now;
+            websocket_->Ping();
+        }
+        return;
+    }
+
+    // Dropped while idle, reconnect before it is needed
+    if (now < next_reconnect_time_ || prewarm_connecting_) {
+        return;
+    }
+    StartPreWarmConnect();
+#endif
+}
+
+#if CONFIG_WEBSOCKET_KEEP_ALIVE_SECONDS > 0
+struct WebsocketPreWarm {
+    WebsocketProtocol* protocol;
+    WebSocket* websocket;
+    std::string url;
+    int version;
+    bool connected;
+    int64_t connect_us;
+};
+
+/*
+ * TCP, TLS and the upgrade take seconds, or much longer while the server is unreachable.
+ * The socket is created here and connected on a task of its own, the main loop takes it
+ * over once it is done.
+ */
+void WebsocketProtocol::StartPreWarmConnect() {
+    auto prewarm = new WebsocketPreWarm();
+    prewarm->protocol = this;
+    prewarm->websocket = CreateWebSocket(prewarm->url, prewarm->version);
+    ESP_LOGI(TAG, "Reconnecting to websocket server: %s", prewarm->url.c_str());
+    prewarm_connecting_ = true;
+    auto result = xTaskCreate([](void* arg) {
+        auto prewarm = (WebsocketPreWarm*)arg;
+        int64_t connect_start = esp_timer_get_time();
+        prewarm->connected = prewarm->websocket->Connect(prewarm->url.c_str());
+        prewarm->connect_us = esp_timer_get_time() - connect_start;
+        Application::GetInstance().Schedule([prewarm]() {
+            prewarm->protocol->FinishPreWarmConnect(prewarm);
+        });
+        vTaskDelete(NULL);
+    }, "ws_prewarm", 4096 * 2, prewarm, 2, nullptr);
+    if (result != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the reconnect task");
+        prewarm->connected = false;
+        FinishPreWarmConnect(prewarm);
+    }
+}
+
+void WebsocketProtocol::FinishPreWarmConnect(WebsocketPreWarm* prewarm) {
+    prewarm_connecting_ = false;
+    auto now = std::chrono::steady_clock::now();
+    if (!prewarm->connected) {
+        delete prewarm->websocket;
+        next_reconnect_time_ = now + std::chrono::milliseconds(reconnect_delay_ms_);
+        ESP_LOGW(TAG, "Reconnect failed, retrying in %d ms", reconnect_delay_ms_);
+        reconnect_delay_ms_ = std::min(reconnect_delay_ms_ * 2, WEBSOCKET_RECONNECT_MAX_MS);
+    } else if (websocket_ != nullptr && websocket_->IsConnected()) {
+        // OpenAudioChannel connected meanwhile
+        delete prewarm->websocket;
+    } else {
+        Disconnect();
+        websocket_ = prewarm->websocket;
+        version_ = prewarm->version;
+        link_metrics_.OnConnected(prewarm->connect_us);
+        last_ping_time_ = now;
+        reconnect_delay_ms_ = WEBSOCKET_RECONNECT_MIN_MS;
+        ESP_LOGI(TAG, "Reconnected with version: %d", version_);
+    }
+    delete prewarm;
+}
+#endif
+
+bool WebsocketProtocol::OpenAudioChannel() {
+    busy_sending_audio_ = false;
+    error_occurred_ = false;
+    session_active_ = false;
+    link_metrics_.Reset();
+
+    if (websocket_ != nullptr && websocket_->IsConnected()) {
+        ESP_LOGI(TAG, "Reusing the websocket connection");
+    } else if (!Connect()) {
         SetError(Lang::Strings::SERVER_NOT_FOUND);
         return false;
     }
+    reconnect_delay_ms_ = WEBSOCKET_RECONNECT_MIN_MS;
 
     // Send hello message to describe the client
     // keys: message type, version, audio_params (format, sample_rate, channels)
-    std::string message = "{";
-    message += "\"type\":\"hello\",";
-    message += "\"version\": " + std::to_string(version_) + ",";
-#if CONFIG_USE_SERVER_AEC
-    message += "\"features\":{\"aec\":true},";
+    xEventGroupClearBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
+    char buffer[256];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.BeginObject();
+    json.Key("type").String("hello");
+    json.Key("version").Int(version_);
+    WriteHelloFeatures(json);
+    json.Key("transport").String("websocket");
+    WriteIotDescriptorsHash(json);
+    json.Key("audio_params").BeginObject();
+    json.Key("format").String("opus");
+    json.Key("sample_rate").Int(16000);
+    json.Key("channels").Int(1);
+    json.Key("frame_duration").Int(OPUS_FRAME_DURATION_MS);
+#if CONFIG_AUDIO_AGGREGATION_MAX_FRAMES > 1
+    if (version_ >= 2) {
+        json.Key("max_frames_per_packet").Int(CONFIG_AUDIO_AGGREGATION_MAX_FRAMES);
+    }
 #endif
-    message += "\"transport\":\"websocket\",";
-    message += "\"audio_params\":{";
-    message += "\"format\":\"opus\", \"sample_rate\":16000, \"channels\":1, \"frame_duration\":" + std::to_string(OPUS_FRAME_DURATION_MS);
-    message += "}}";
-    if (!SendText(message)) {
+    json.EndObject();
+    json.EndObject();
+    link_metrics_.OnProbeSent(0);
+    if (!SendJson(json)) {
         return false;
     }
 
@@ -215,30 +449,36 @@ bool WebsocketProtocol::OpenAudioChannel() {
     return true;
 }
 
-void WebsocketProtocol::ParseServerHello(const cJSON* root) {
-    auto transport = cJSON_GetObjectItem(root, "transport");
-    if (transport == nullptr || strcmp(transport->valuestring, "websocket") != 0) {
-        ESP_LOGE(TAG, "Unsupported transport: %s", transport->valuestring);
+void WebsocketProtocol::ParseServerHello(const JsonValue& root) {
+    auto transport = root.Get("transport");
+    if (!transport.Equals("websocket")) {
+        ESP_LOGE(TAG, "Unsupported transport: %s", transport.ToString().c_str());
         return;
     }
 
-    auto session_id = cJSON_GetObjectItem(root, "session_id");
-    if (session_id != nullptr) {
-        session_id_ = session_id->valuestring;
+    auto session_id = root.Get("session_id");
+    if (session_id) {
+        session_id_ = session_id.ToString();
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
 
-    auto audio_params = cJSON_GetObjectItem(root, "audio_params");
-    if (audio_params != NULL) {
-        auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
-        if (sample_rate != NULL) {
-            server_sample_rate_ = sample_rate->valueint;
-        }
-        auto frame_duration = cJSON_GetObjectItem(audio_params, "frame_duration");
-        if (frame_duration != NULL) {
-            server_frame_duration_ = frame_duration->valueint;
-        }
+    auto audio_params = root.Get("audio_params");
+    auto sample_rate = audio_params.Get("sample_rate");
+    if (sample_rate) {
+        server_sample_rate_ = sample_rate.ToInt();
+    }
+    auto frame_duration = audio_params.Get("frame_duration");
+    if (frame_duration) {
+        server_frame_duration_ = frame_duration.ToInt();
+    }
+    // Version 1 frames have no header to mark an aggregated message
+    if (version_ >= 2) {
+        ParseMaxFramesPerPacket(audio_params);
     }
+    ParseIotDescriptorsHash(root);
+    ParseHelloFeatures(root);
 
+    link_metrics_.OnProbeAnswered(0);
+    session_active_ = true;
     xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
 }
@@ -8,8 +8,28 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 
+#include <atomic>
+
 #define WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
 
+#ifndef CONFIG_WEBSOCKET_KEEP_ALIVE_SECONDS
+#define CONFIG_WEBSOCKET_KEEP_ALIVE_SECONDS 0
+#endif
+#define WEBSOCKET_PING_INTERVAL_SECONDS 20
+#define WEBSOCKET_RECONNECT_MIN_MS 1000
+#define WEBSOCKET_RECONNECT_MAX_MS 60000
+
+struct WebsocketPreWarm;
+
+/*
+ * With CONFIG_WEBSOCKET_KEEP_ALIVE_SECONDS > 0 the connection outlives the audio
+ * channel: closing the channel only ends the session with a goodbye, and the next
+ * OpenAudioChannel sends its hello over the same connection. While idle the
+ * connection is pinged, dropped connections are reconnected with backoff on a task
+ * of their own, and it is closed once it has been idle for that long. Messages of an ended session and
+ * messages carrying another session_id are dropped.
+ */
+
 class WebsocketProtocol : public Protocol {
 public:
     WebsocketProtocol();
@@ -20,14 +40,37 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    void PreWarm() override;
 
 private:
     EventGroupHandle_t event_group_handle_;
     WebSocket* websocket_ = nullptr;
     int version_ = 1;
+    // Set by the server hello, cleared when the session ends, the connection may stay
+    std::atomic<bool> session_active_ = false;
+    std::chrono::steady_clock::time_point idle_since_;
+    std::chrono::steady_clock::time_point last_ping_time_;
+    std::chrono::steady_clock::time_point next_reconnect_time_;
+    int reconnect_delay_ms_ = WEBSOCKET_RECONNECT_MIN_MS;
+    // Set while the reconnect task runs, it hands the socket back through the main loop
+    std::atomic<bool> prewarm_connecting_ = false;
+    std::string send_buffer_;   // Keeps its capacity, binary frames are built in place
 
-    void ParseServerHello(const cJSON* root);
-    bool SendText(const std::string& text) override;
+    // Reads the connection settings and creates the socket with its headers and callbacks
+    WebSocket* CreateWebSocket(std::string& url, int& version);
+    bool Connect();
+#if CONFIG_WEBSOCKET_KEEP_ALIVE_SECONDS > 0
+    void StartPreWarmConnect();
+    void FinishPreWarmConnect(WebsocketPreWarm* prewarm);
+#endif
+    void Disconnect();
+    void OnData(const char* data, size_t len, bool binary);
+    void ParseServerHello(const JsonValue& root);
+    // Writes the header of the binary protocol version, returns its size, 0 for version 1
+    size_t SerializeAudioHeader(const AudioStreamPacket& packet, uint8_t* header);
+    bool ParseAudio(const char* data, size_t len, AudioStreamPacket& packet);
+    bool SendText(const char* text, size_t length) override;
+    void SendAudioFrames(const std::vector<AudioStreamPacket>& packets) override;
 };
 
 #endif
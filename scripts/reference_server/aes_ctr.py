@@ -0,0 +1,85 @@
+"""AES-128-CTR matching mbedtls_aes_crypt_ctr() with a 16 byte nonce counter block.
+
+Uses the `cryptography` package when it is installed and falls back to a small
+pure Python AES so that the reference server runs on a bare Python install.
+"""
+
+try:
+    from cryptography.hazmat.primitives.ciphers import Cipher, algorithms, modes
+except ImportError:  # pragma: no cover - depends on the environment
+    Cipher = None
+
+
+def _build_tables():
+    sbox = [0] * 256
+    p = q = 1
+    # Walk the multiplicative group of GF(2^8) to build the S-box
+    while True:
+        p = p ^ ((p << 1) & 0xff) ^ (0x1b if p & 0x80 else 0)
+        q ^= q << 1
+        q ^= q << 2
+        q ^= q << 4
+        q &= 0xff
+        if q & 0x80:
+            q ^= 0x09
+        x = q ^ ((q << 1) | (q >> 7)) ^ ((q << 2) | (q >> 6)) ^ ((q << 3) | (q >> 5)) ^ ((q << 4) | (q >> 4))
+        sbox[p] = (x ^ 0x63) & 0xff
+        if p == 1:
+            break
+    sbox[0] = 0x63
+    return sbox
+
+
+_SBOX = _build_tables()
+
+
+def _xtime(a):
+    return ((a << 1) ^ 0x1b) & 0xff if a & 0x80 else a << 1
+
+
+class _PyAes128:
+    def __init__(self, key):
+        words = [list(key[i:i + 4]) for i in range(0, 16, 4)]
+        rcon = 1
+        for i in range(4, 44):
+            word = list(words[i - 1])
+            if i % 4 == 0:
+                word = word[1:] + word[:1]
+                word = [_SBOX[b] for b in word]
+                word[0] ^= rcon
+                rcon = _xtime(rcon)
+            words.append([a ^ b for a, b in zip(words[i - 4], word)])
+        self.round_keys = [sum(words[r * 4:r * 4 + 4], []) for r in range(11)]
+
+    def encrypt_block(self, block):
+        s = [b ^ k for b, k in zip(block, self.round_keys[0])]
+        for r in range(1, 11):
+            s = [_SBOX[b] for b in s]
+            # ShiftRows on the column-major state
+            s = [s[(i + 4 * (i % 4)) % 16] for i in range(16)]
+            if r != 10:
+                mixed = []
+                for c in range(4):
+                    a = s[c * 4:c * 4 + 4]
+                    t = a[0] ^ a[1] ^ a[2] ^ a[3]
+                    mixed += [a[i] ^ t ^ _xtime(a[i] ^ a[(i + 1) % 4]) for i in range(4)]
+                s = mixed
+            s = [b ^ k for b, k in zip(s, self.round_keys[r])]
+        return bytes(s)
+
+
+def aes_ctr(key, nonce, data):
+    """Encrypts or decrypts data, the counter block starts at nonce and counts up big-endian."""
+    if Cipher is not None:
+        encryptor = Cipher(algorithms.AES(key), modes.CTR(nonce)).encryptor()
+        return encryptor.update(data) + encryptor.finalize()
+
+    aes = _PyAes128(key)
+    counter = int.from_bytes(nonce, 'big')
+    out = bytearray()
+    for offset in range(0, len(data), 16):
+        stream = aes.encrypt_block(counter.to_bytes(16, 'big'))
+        chunk = data[offset:offset + 16]
+        out += bytes(a ^ b for a, b in zip(chunk, stream))
+        counter = (counter + 1) & ((1 << 128) - 1)
+    return bytes(out)
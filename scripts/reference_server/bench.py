@@ -0,0 +1,309 @@
+#!/usr/bin/env python3
+"""End-to-end latency benchmark against the local reference server.
+
+Starts reference_server in process and either launches the host simulation build
+(host/, xiaozhi_host) or waits for a real board on the LAN to talk to it, runs a
+number of conversation turns and reports:
+
+  - time to first audio: end of the user turn until the first reply frame is played
+    (host, "Playback started") or sent (board)
+  - turn latency: end of the user turn until the device leaves the speaking state
+    (host) or the server sends tts stop (board)
+  - underruns: speaker gaps reported by the host audio codec during the reply
+"""
+
+import argparse
+import asyncio
+import json
+import logging
+import os
+import re
+import statistics
+import sys
+import tempfile
+import time
+
+import reference_server
+
+STATE_RE = re.compile(r'Application: STATE: (\w+)')
+UNDERRUN_RE = re.compile(r'HostAudioCodec: Underrun (\d+) ms')
+PLAYBACK_RE = re.compile(r'HostAudioCodec: Playback started')
+
+
+class Turn:
+    def __init__(self, index, start):
+        self.index = index
+        self.start = start
+        self.first_downlink = None
+        self.first_audio = None
+        self.tts_stop = None
+        self.end = None
+        self.speaking = False
+        self.underruns = 0
+        self.underrun_ms = 0
+        self.downlink = {}
+
+    def as_dict(self):
+        def ms(value):
+            return None if value is None else round((value - self.start) * 1000, 1)
+        return {
+            'turn': self.index,
+            'first_downlink_ms': ms(self.first_downlink),
+            'time_to_first_audio_ms': ms(self.first_audio),
+            'tts_stop_ms': ms(self.tts_stop),
+            'turn_latency_ms': ms(self.end),
+            'underruns': self.underruns,
+            'underrun_ms': self.underrun_ms,
+            'downlink': self.downlink,
+        }
+
+
+class Benchmark:
+    def __init__(self, args, server):
+        self.args = args
+        self.server = server
+        self.events = asyncio.Queue()
+        self.turns = []
+        self.current = None
+        self.state = None
+        self.uplink = {'frames': 0, 'lost': 0}
+        self.trigger = None         # When the last conversation was started from idle
+        self.first_uplink = []      # Trigger to the first audio message of the session at the server, ms
+        self.connections = 0        # WebSocket connections accepted by the server
+        self.link_metrics = None    # Last metrics the device reported in a goodbye or telemetry message
+        self.iot_descriptors = {'messages': 0, 'bytes': 0}
+        self.log_file = None
+        server.listeners.append(self.on_server_event)
+
+    def on_server_event(self, now, name, session, fields):
+        self.events.put_nowait(('server', now, name, session, fields))
+
+    async def read_host_output(self, stream):
+        while True:
+            line = await stream.readline()
+            if not line:
+                self.events.put_nowait(('exit', time.monotonic(), None, None, None))
+                return
+            now = time.monotonic()
+            text = line.decode(errors='replace').rstrip()
+            if self.log_file is not None:
+                self.log_file.write('%.3f %s\n' % (now, text))
+            self.events.put_nowait(('log', now, text, None, None))
+
+    def finish_turn(self, now):
+        turn = self.current
+        turn.end = now
+        self.turns.append(turn)
+        self.current = None
+        result = turn.as_dict()
+        logging.info('Turn %d: first audio %s ms, turn %s ms, underruns %d (%d ms)', turn.index,
+                     result['time_to_first_audio_ms'] if self.args.device == 'host' else result['first_downlink_ms'],
+                     result['turn_latency_ms'], turn.underruns, turn.underrun_ms)
+
+    def handle(self, kind, now, name, session, fields):
+        """Feeds one server event or host log line into the turn bookkeeping."""
+        if kind == 'server':
+            if name == 'connected':
+                self.connections += 1
+            elif name == 'iot_descriptors':
+                self.iot_descriptors['messages'] += 1
+                self.iot_descriptors['bytes'] += fields['bytes']
+            elif name in ('goodbye', 'telemetry') and fields.get('metrics'):
+                self.link_metrics = fields['metrics']
+            elif name == 'session_first_uplink' and self.trigger is not None:
+                self.first_uplink.append(round((now - self.trigger) * 1000, 1))
+                self.trigger = None
+            elif name == 'end_of_turn':
+                self.current = Turn(len(self.turns) + 1, now)
+            elif self.current is not None and name == 'first_downlink':
+                self.current.first_downlink = now
+            elif self.current is not None and name == 'tts_stop':
+                self.current.tts_stop = now
+                self.current.downlink = fields
+                if session is not None:
+                    self.uplink = {'frames': session.uplink_frames, 'messages': session.uplink_messages,
+                                   'lost': session.uplink_lost}
+                if self.args.device == 'board':
+                    self.finish_turn(now)
+            elif name == 'downlink_no_address':
+                logging.warning('Downlink audio dropped, the device has not sent any UDP packet yet')
+            return
+
+        line = name
+        match = STATE_RE.search(line)
+        if match:
+            self.state = match.group(1)
+            if self.current is not None:
+                if self.state == 'speaking':
+                    self.current.speaking = True
+                elif self.current.speaking and self.state in ('idle', 'listening'):
+                    self.finish_turn(now)
+            return
+        if self.current is None:
+            # Ignore the startup sounds
+            return
+        if PLAYBACK_RE.search(line) and self.current.first_audio is None:
+            self.current.first_audio = now
+            return
+        match = UNDERRUN_RE.search(line)
+        if match and self.current.first_audio is not None:
+            self.current.underruns += 1
+            self.current.underrun_ms += int(match.group(1))
+
+    async def wait_for(self, predicate, timeout):
+        deadline = time.monotonic() + timeout
+        while not predicate():
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                return False
+            try:
+                event = await asyncio.wait_for(self.events.get(), remaining)
+            except asyncio.TimeoutError:
+                return False
+            if event[0] == 'exit':
+                raise RuntimeError('Host process exited')
+            self.handle(*event)
+        return True
+
+    async def run_host(self):
+        args = self.args
+        workdir = tempfile.mkdtemp(prefix='xiaozhi_bench_')
+        command = [args.host_binary, '--nvs', os.path.join(workdir, 'nvs.txt'), '--ota-url', self.server.ota_url,
+                   '--log-level', 'info']
+        if args.input:
+            command += ['--input', args.input]
+        if args.output:
+            command += ['--output', args.output]
+        logging.info('Starting %s', ' '.join(command))
+        process = await asyncio.create_subprocess_exec(*command, stdin=asyncio.subprocess.PIPE,
+                                                       stdout=asyncio.subprocess.PIPE,
+                                                       stderr=asyncio.subprocess.STDOUT)
+        reader = asyncio.ensure_future(self.read_host_output(process.stdout))
+
+        def send(command):
+            if self.state == 'idle' and command.split()[0] in ('toggle', 'listen', 'wake'):
+                self.trigger = time.monotonic()
+            process.stdin.write((command + '\n').encode())
+
+        try:
+            if not await self.wait_for(lambda: self.state == 'idle', args.timeout):
+                raise RuntimeError('Device did not become idle, is the OTA URL reachable?')
+            # Let the startup sound finish so that it does not count as the first reply
+            await asyncio.sleep(1.0)
+            if args.mode == 'auto':
+                send('toggle')
+            for i in range(args.turns):
+                if args.mode == 'auto' and args.reopen and i > 0:
+                    send('toggle')
+                if args.mode == 'manual':
+                    send('listen')
+                    if not await self.wait_for(lambda: self.state == 'listening', args.timeout):
+                        raise RuntimeError('Device did not start listening')
+                    await asyncio.sleep(args.utterance_ms / 1000)
+                    send('stop')
+                elif args.mode == 'wake':
+                    send('wake ' + args.stt_text)
+                done = len(self.turns) + 1
+                if not await self.wait_for(lambda: len(self.turns) >= done, args.timeout):
+                    raise RuntimeError('Turn %d timed out in state %s' % (i + 1, self.state))
+                if args.mode == 'wake' or (args.mode == 'auto' and args.reopen):
+                    # Wake word turns continue in auto mode, close the channel before the next one
+                    send('toggle')
+                    await self.wait_for(lambda: self.state == 'idle', args.timeout)
+                    if args.reopen:
+                        await asyncio.sleep(args.idle_ms / 1000)
+        finally:
+            send('quit')
+            try:
+                await asyncio.wait_for(process.wait(), 5)
+            except asyncio.TimeoutError:
+                process.kill()
+            reader.cancel()
+
+    async def run_board(self):
+        logging.info('Waiting for %d turns from a board, OTA URL %s', self.args.turns, self.server.ota_url)
+        while len(self.turns) < self.args.turns:
+            if not await self.wait_for(lambda: len(self.turns) >= self.args.turns, 3600):
+                break
+
+    def report(self):
+        results = [turn.as_dict() for turn in self.turns]
+        first_audio_key = 'time_to_first_audio_ms' if self.args.device == 'host' else 'first_downlink_ms'
+        latency_key = 'turn_latency_ms' if self.args.device == 'host' else 'tts_stop_ms'
+
+        def summary(key):
+            return summary_of([r[key] for r in results if r[key] is not None])
+
+        def summary_of(values):
+            values = sorted(values)
+            if not values:
+                return None
+            p90 = values[min(len(values) - 1, int(round(0.9 * (len(values) - 1))))]
+            return {'p50': round(statistics.median(values), 1), 'p90': p90, 'max': values[-1], 'n': len(values)}
+
+        report = {
+            'device': self.args.device,
+            'mode': self.args.mode,
+            'turns': results,
+            'time_to_first_uplink_ms': summary_of(self.first_uplink),
+            'time_to_first_audio_ms': summary(first_audio_key),
+            'turn_latency_ms': summary(latency_key),
+            'underruns': sum(r['underruns'] for r in results) if self.args.device == 'host' else None,
+            'underrun_ms': sum(r['underrun_ms'] for r in results) if self.args.device == 'host' else None,
+            'uplink': self.uplink,
+            'connections': self.connections if self.server.config.transport == 'websocket' else None,
+            'link_metrics': self.link_metrics,
+            'iot_descriptors': self.iot_descriptors,
+        }
+        print(json.dumps(report, ensure_ascii=False, indent=2))
+        if self.args.report:
+            with open(self.args.report, 'w') as f:
+                json.dump(report, f, ensure_ascii=False, indent=2)
+        return report
+
+
+async def run(args):
+    server = reference_server.ReferenceServer(reference_server.build_config(args))
+    benchmark = Benchmark(args, server)
+    await server.start()
+    if args.host_log:
+        benchmark.log_file = open(args.host_log, 'w')
+    try:
+        if args.device == 'host':
+            await benchmark.run_host()
+        else:
+            await benchmark.run_board()
+    except RuntimeError as e:
+        logging.error('%s', e)
+    finally:
+        server.stop()
+        if benchmark.log_file is not None:
+            benchmark.log_file.close()
+    report = benchmark.report()
+    return 0 if len(report['turns']) >= args.turns else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--device', choices=['host', 'board'], default='host')
+    parser.add_argument('--host-binary', default=os.path.join('build-host', 'xiaozhi_host'))
+    parser.add_argument('--input', help='raw s16le 16 kHz microphone input for the host build')
+    parser.add_argument('--output', help='raw s16le speaker output of the host build')
+    parser.add_argument('--host-log', help='write the timestamped host log to this file')
+    parser.add_argument('--mode', choices=['auto', 'manual', 'wake'], default='auto',
+                        help='auto: toggle once and let the server end each turn, '
+                             'manual: listen/stop per turn, wake: one wake word turn at a time')
+    parser.add_argument('--reopen', action='store_true',
+                        help='auto mode: close the audio channel after each turn and open it again')
+    parser.add_argument('--idle-ms', type=int, default=2000, help='idle time between turns with --reopen')
+    parser.add_argument('--turns', type=int, default=10)
+    parser.add_argument('--timeout', type=float, default=60)
+    parser.add_argument('--report', help='write the JSON report to this file')
+    reference_server.add_server_arguments(parser)
+    args = parser.parse_args()
+    logging.basicConfig(level=logging.INFO, format='%(asctime)s %(levelname)s %(message)s')
+    sys.exit(asyncio.run(run(args)))
+
+
+if __name__ == '__main__':
+    main()
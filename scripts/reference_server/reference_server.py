@@ -0,0 +1,785 @@
+#!/usr/bin/env python3
+"""Local stand-in for the xiaozhi cloud, for end-to-end load and latency benchmarks.
+
+Serves on one host:
+  - HTTP OTA endpoint handing out the MQTT and WebSocket settings
+  - MQTT 3.1.1 control channel plus the AES-CTR encrypted UDP audio channel (MqttProtocol)
+  - WebSocket protocol v1/v2/v3 (WebsocketProtocol, docs/websocket.md)
+
+Each turn echoes a canned STT text, streams canned Opus TTS from a .p3 file and can
+inject IoT commands. Downlink audio can be impaired with jitter, loss and reordering.
+Only the Python standard library is required.
+"""
+
+import argparse
+import asyncio
+import base64
+import hashlib
+import json
+import logging
+import os
+import random
+import socket
+import struct
+import time
+import uuid
+from dataclasses import dataclass, field
+
+from aes_ctr import aes_ctr
+
+logger = logging.getLogger('reference_server')
+
+ASSETS_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'main', 'assets')
+WS_GUID = '258EAFA5-E914-47DA-95CA-C5AB0DC85B11'
+
+
+@dataclass
+class ServerConfig:
+    bind: str = '0.0.0.0'
+    public_host: str = '127.0.0.1'     # Address written into the OTA response and the UDP hello
+    http_port: int = 8002
+    mqtt_port: int = 1883
+    udp_port: int = 8884
+    ws_port: int = 8000
+    transport: str = 'mqtt'            # Which channel the OTA response advertises: mqtt or websocket
+    ws_version: int = 1
+    ws_token: str = 'test-token'
+    tts_files: list = field(default_factory=list)
+    tts_repeat: int = 3
+    stt_text: str = '你好'
+    reply_text: str = '这是本地参考服务器的测试回复。'
+    think_ms: int = 0                  # Simulated ASR and LLM latency before the reply starts
+    hello_delay_ms: int = 0            # Simulated round trip and session setup before the hello reply
+    ws_connect_delay_ms: int = 0       # Simulated TCP and TLS setup before the WebSocket upgrade completes
+    request_telemetry: bool = False    # Ask the device for its link metrics after every reply
+    utterance_ms: int = 1200           # Auto and realtime mode end the user turn after this much uplink audio
+    prebuffer_frames: int = 3          # Frames sent back to back before real-time pacing, like the cloud does
+    iot_every: int = 0                 # Inject iot_command every N turns, 0 disables it
+    iot_cache: bool = True             # Remember uploaded IoT descriptors by their hash, per device
+    iot_command: dict = field(default_factory=lambda: {
+        'name': 'Speaker', 'method': 'SetVolume', 'parameters': {'volume': 60}})
+    jitter_ms: int = 0
+    loss: float = 0.0
+    reorder: float = 0.0
+    seed: int = 1
+    max_frames_per_packet: int = 8     # Accepted uplink aggregation, 1 turns it down
+
+
+def load_p3(path):
+    """Reads a .p3 file: |type 1u|reserved 1u|length 2u (big-endian)|opus payload|."""
+    packets = []
+    with open(path, 'rb') as f:
+        data = f.read()
+    offset = 0
+    while offset + 4 <= len(data):
+        _, _, length = struct.unpack_from('>BBH', data, offset)
+        offset += 4
+        packets.append(data[offset:offset + length])
+        offset += length
+    return packets
+
+
+def split_aggregated(payload):
+    """Splits an aggregated uplink payload: |timestamp 4u|payload_len 2u|payload| entries."""
+    frames = []
+    offset = 0
+    while offset + 6 <= len(payload):
+        _, length = struct.unpack_from('>IH', payload, offset)
+        offset += 6
+        frames.append(payload[offset:offset + length])
+        offset += length
+    return frames
+
+
+def default_tts_files():
+    common = os.path.join(ASSETS_DIR, 'common')
+    names = sorted(name for name in os.listdir(common) if name.endswith('.p3'))
+    return [os.path.join(common, name) for name in names]
+
+
+class Session:
+    """One device conversation, independent of the MQTT+UDP or WebSocket transport."""
+
+    def __init__(self, server, transport_name, device_id):
+        self.server = server
+        self.config = server.config
+        self.transport_name = transport_name
+        self.device_id = device_id
+        self.session_id = str(uuid.uuid4())
+        self.listen_mode = None
+        self.listening = False
+        self.uplink_frames = 0
+        self.uplink_turn_frames = 0
+        self.uplink_lost = 0
+        self.uplink_messages = 0
+        self.max_frames_per_packet = 1
+        self.iot_descriptors_hash = None
+        self.last_uplink_sequence = None
+        self.turns = 0
+        self.downlink_sequence = 0
+        self.reply_task = None
+        self.send_json = None      # Coroutine function set by the transport
+        self.send_audio = None     # Coroutine function set by the transport
+        self.closed = False
+
+    def event(self, name, **fields):
+        self.server.emit(name, self, **fields)
+
+    def hello_audio_params(self, message):
+        """Audio params of the hello reply, accepts uplink aggregation up to what the device offered."""
+        params = {'format': 'opus', 'sample_rate': 16000, 'channels': 1, 'frame_duration': 60}
+        offered = message.get('audio_params', {}).get('max_frames_per_packet', 1)
+        self.max_frames_per_packet = max(1, min(offered, self.config.max_frames_per_packet))
+        if self.max_frames_per_packet > 1:
+            params['max_frames_per_packet'] = self.max_frames_per_packet
+        return params
+
+    def hello_iot(self, message, reply):
+        """Echoes the descriptors hash of the hello if this device already uploaded those descriptors."""
+        self.iot_descriptors_hash = message.get('iot_descriptors_hash')
+        if self.config.iot_cache and self.iot_descriptors_hash is not None and \
+                self.server.iot_descriptors.get(self.device_id) == self.iot_descriptors_hash:
+            reply['iot_descriptors_hash'] = self.iot_descriptors_hash
+        return reply
+
+    def hello_features(self, message, reply):
+        """Accepts the link telemetry the device offered, it is reported in goodbye messages."""
+        if message.get('features', {}).get('telemetry'):
+            reply['features'] = {'telemetry': True}
+        return reply
+
+    async def handle_json(self, message):
+        msg_type = message.get('type')
+        if msg_type == 'listen':
+            state = message.get('state')
+            if state == 'start':
+                self.listen_mode = message.get('mode')
+                self.listening = True
+                self.uplink_turn_frames = 0
+                self.event('listen_start', mode=self.listen_mode)
+            elif state == 'stop':
+                self.listening = False
+                self.event('listen_stop')
+                self.end_of_turn(self.config.stt_text)
+            elif state == 'detect':
+                self.event('wake_word', text=message.get('text', ''))
+                self.end_of_turn(message.get('text', self.config.stt_text))
+        elif msg_type == 'abort':
+            self.event('abort', reason=message.get('reason'))
+            if self.reply_task is not None and not self.reply_task.done():
+                self.reply_task.cancel()
+                await self.send_json({'type': 'tts', 'state': 'stop', 'session_id': self.session_id})
+        elif msg_type == 'iot':
+            if 'descriptors' in message:
+                self.event('iot_descriptors', count=len(message['descriptors']),
+                           bytes=len(json.dumps(message['descriptors'])))
+                if self.iot_descriptors_hash is not None:
+                    self.server.iot_descriptors[self.device_id] = self.iot_descriptors_hash
+            if 'states' in message:
+                self.event('iot_states', states=message['states'])
+        elif msg_type == 'ping':
+            await self.send_json({'type': 'pong', 'id': message.get('id'), 'session_id': self.session_id})
+        elif msg_type == 'telemetry':
+            self.event('telemetry', metrics=message.get('metrics', {}))
+        elif msg_type == 'goodbye':
+            self.event('goodbye', metrics=message.get('metrics'))
+            self.close()
+        else:
+            logger.debug('Unhandled message: %s', message)
+
+    def on_uplink_message(self, frames, sequence=None):
+        self.uplink_messages += 1
+        if self.uplink_messages == 1:
+            # Also counts the wake word audio sent before listen start
+            self.event('session_first_uplink')
+        for i, payload in enumerate(frames):
+            self.on_uplink_audio(payload, sequence if i == 0 else None)
+
+    def on_uplink_audio(self, payload, sequence=None):
+        self.uplink_frames += 1
+        if sequence is not None:
+            if self.last_uplink_sequence is not None and sequence > self.last_uplink_sequence + 1:
+                self.uplink_lost += sequence - self.last_uplink_sequence - 1
+            self.last_uplink_sequence = sequence
+        if not self.listening:
+            return
+        self.uplink_turn_frames += 1
+        if self.uplink_turn_frames == 1:
+            self.event('first_uplink')
+        # There is no VAD here, auto and realtime turns end after a fixed amount of audio
+        if self.listen_mode in ('auto', 'realtime'):
+            if self.uplink_turn_frames * 60 >= self.config.utterance_ms:
+                self.listening = False
+                self.event('endpoint')
+                self.end_of_turn(self.config.stt_text)
+
+    def end_of_turn(self, stt_text):
+        if self.reply_task is not None and not self.reply_task.done():
+            self.reply_task.cancel()
+        self.reply_task = asyncio.ensure_future(self.reply(stt_text))
+
+    async def reply(self, stt_text):
+        self.turns += 1
+        turn = self.turns
+        self.event('end_of_turn', turn=turn)
+        if self.config.think_ms > 0:
+            await asyncio.sleep(self.config.think_ms / 1000)
+        await self.send_json({'type': 'stt', 'text': stt_text, 'session_id': self.session_id})
+        await self.send_json({'type': 'llm', 'text': '😀', 'emotion': 'happy', 'session_id': self.session_id})
+        await self.send_json({'type': 'tts', 'state': 'start', 'sample_rate': 16000, 'session_id': self.session_id})
+        await self.send_json({'type': 'tts', 'state': 'sentence_start', 'text': self.config.reply_text,
+                              'session_id': self.session_id})
+        self.event('tts_start', turn=turn)
+        if self.config.iot_every > 0 and turn % self.config.iot_every == 0:
+            await self.send_json({'type': 'iot', 'commands': [self.config.iot_command], 'session_id': self.session_id})
+            self.event('iot_command', turn=turn)
+
+        stats = await self.stream_tts(turn)
+
+        await self.send_json({'type': 'tts', 'state': 'sentence_end', 'text': self.config.reply_text,
+                              'session_id': self.session_id})
+        await self.send_json({'type': 'tts', 'state': 'stop', 'session_id': self.session_id})
+        self.event('tts_stop', turn=turn, **stats)
+        if self.config.request_telemetry:
+            await self.send_json({'type': 'telemetry', 'session_id': self.session_id})
+
+    async def stream_tts(self, turn):
+        packets = self.server.tts_packets * max(1, self.config.tts_repeat)
+        rng = self.server.rng
+        frame = 0.060
+        # Work out when each frame leaves, then send in that order so reordering falls out naturally
+        schedule = []
+        lost = reordered = 0
+        for i, payload in enumerate(packets):
+            if rng.random() < self.config.loss:
+                lost += 1
+                continue
+            due = max(0, i - self.config.prebuffer_frames) * frame
+            if self.config.jitter_ms > 0:
+                due += rng.uniform(0, self.config.jitter_ms) / 1000
+            if rng.random() < self.config.reorder:
+                due += frame * 1.5
+                reordered += 1
+            schedule.append((due, i, payload))
+        schedule.sort(key=lambda item: (item[0], item[1]))
+
+        # Sequence numbers follow the original order, lost and late frames show up as gaps on the device
+        base_sequence = self.downlink_sequence
+        self.downlink_sequence += len(packets)
+        start = time.monotonic()
+        first = True
+        for due, index, payload in schedule:
+            delay = start + due - time.monotonic()
+            if delay > 0:
+                await asyncio.sleep(delay)
+            if self.closed:
+                break
+            await self.send_audio(payload, index * 60, base_sequence + index + 1)
+            if first:
+                self.event('first_downlink', turn=turn)
+                first = False
+        return {'frames': len(packets), 'lost': lost, 'reordered': reordered}
+
+    def close(self):
+        self.closed = True
+        if self.reply_task is not None and not self.reply_task.done():
+            self.reply_task.cancel()
+
+
+class MqttConnection:
+    """Minimal MQTT 3.1.1 broker side of one device, QoS 0 only.
+
+    The device never subscribes, like the cloud broker the server pushes to
+    devices/p2p/<client_id> directly.
+    """
+
+    def __init__(self, server, reader, writer):
+        self.server = server
+        self.reader = reader
+        self.writer = writer
+        self.client_id = ''
+        self.session = None
+        self.udp_session = None
+
+    async def read_packet(self):
+        header = await self.reader.readexactly(1)
+        length = 0
+        shift = 0
+        while True:
+            byte = (await self.reader.readexactly(1))[0]
+            length |= (byte & 0x7f) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        body = await self.reader.readexactly(length) if length else b''
+        return header[0], body
+
+    def write_packet(self, header, body):
+        length = len(body)
+        encoded = bytearray()
+        while True:
+            byte = length % 128
+            length //= 128
+            encoded.append(byte | (0x80 if length else 0))
+            if not length:
+                break
+        self.writer.write(bytes([header]) + bytes(encoded) + body)
+
+    async def publish(self, message):
+        topic = ('devices/p2p/' + self.client_id).encode()
+        payload = json.dumps(message, ensure_ascii=False).encode()
+        self.write_packet(0x30, struct.pack('>H', len(topic)) + topic + payload)
+        await self.writer.drain()
+
+    async def run(self):
+        try:
+            while True:
+                header, body = await self.read_packet()
+                packet_type = header & 0xf0
+                if packet_type == 0x10:
+                    self.handle_connect(body)
+                elif packet_type == 0x30:
+                    topic_length = struct.unpack_from('>H', body)[0]
+                    offset = 2 + topic_length + (2 if (header >> 1) & 0x03 else 0)
+                    await self.handle_publish(json.loads(body[offset:].decode()))
+                elif packet_type == 0x80:
+                    packet_id = body[:2]
+                    self.write_packet(0x90, packet_id + b'\x00')
+                elif packet_type == 0xa0:
+                    self.write_packet(0xb0, body[:2])
+                elif packet_type == 0xc0:
+                    self.write_packet(0xd0, b'')
+                elif packet_type == 0xe0:
+                    break
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        finally:
+            if self.session is not None:
+                self.server.close_udp_session(self.session)
+            self.writer.close()
+            logger.info('MQTT client %s disconnected', self.client_id)
+
+    def handle_connect(self, body):
+        offset = 2 + struct.unpack_from('>H', body)[0] + 4   # Protocol name, level, flags, keep alive
+        client_id_length = struct.unpack_from('>H', body, offset)[0]
+        self.client_id = body[offset + 2:offset + 2 + client_id_length].decode()
+        self.write_packet(0x20, b'\x00\x00')
+        logger.info('MQTT client %s connected', self.client_id)
+
+    async def handle_publish(self, message):
+        if message.get('type') == 'hello':
+            if self.server.config.hello_delay_ms > 0:
+                await asyncio.sleep(self.server.config.hello_delay_ms / 1000)
+            if self.session is not None:
+                self.server.close_udp_session(self.session)
+            self.session = self.server.open_udp_session(self)
+            hello = self.session.hello_iot(message, {
+                'type': 'hello',
+                'transport': 'udp',
+                'session_id': self.session.session_id,
+                'audio_params': self.session.hello_audio_params(message),
+                'udp': {
+                    'server': self.server.config.public_host,
+                    'port': self.server.config.udp_port,
+                    'encryption': 'aes-128-ctr',
+                    'key': self.session.key.hex(),
+                    'nonce': self.session.nonce.hex(),
+                },
+            })
+            self.session.hello_features(message, hello)
+            await self.publish(hello)
+            self.session.event('hello', version=message.get('version'))
+        elif self.session is not None:
+            await self.session.handle_json(message)
+            if message.get('type') == 'goodbye':
+                self.server.close_udp_session(self.session)
+                self.session = None
+
+
+class UdpSession(Session):
+    """Session whose audio rides the encrypted UDP channel.
+
+    Packet: |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|payload|,
+    the 16 byte header doubles as the AES-CTR counter block.
+    """
+
+    def __init__(self, server, mqtt):
+        super().__init__(server, 'mqtt', mqtt.client_id)
+        self.mqtt = mqtt
+        self.key = os.urandom(16)
+        self.ssrc = os.urandom(4)
+        self.nonce = b'\x01\x00\x00\x00' + self.ssrc + b'\x00' * 8
+        self.address = None
+        self.send_json = mqtt.publish
+        self.send_audio = self.send_udp_audio
+
+    async def send_udp_audio(self, payload, timestamp, sequence):
+        if self.address is None:
+            # The device address is only known after its first uplink packet
+            self.server.emit('downlink_no_address', self)
+            return
+        nonce = struct.pack('>BBH4sII', 0x01, 0, len(payload), self.ssrc, timestamp & 0xffffffff, sequence)
+        self.server.udp_transport.sendto(nonce + aes_ctr(self.key, nonce, payload), self.address)
+
+    def on_datagram(self, data, address):
+        self.address = address
+        nonce = data[:16]
+        _, flags, length, _, _, sequence = struct.unpack('>BBH4sII', nonce)
+        payload = aes_ctr(self.key, nonce, data[16:16 + length])
+        self.on_uplink_message(split_aggregated(payload) if flags & 0x01 else [payload], sequence)
+
+
+class UdpProtocol(asyncio.DatagramProtocol):
+    def __init__(self, server):
+        self.server = server
+
+    def datagram_received(self, data, address):
+        if len(data) < 16 or data[0] != 0x01:
+            return
+        session = self.server.udp_sessions.get(data[4:8])
+        if session is not None:
+            session.on_datagram(data, address)
+
+
+class WebSocketSession(Session):
+    def __init__(self, server, reader, writer, version, device_id):
+        super().__init__(server, 'websocket', device_id)
+        self.reader = reader
+        self.writer = writer
+        self.version = version
+        self.send_json = self.send_text
+        self.send_audio = self.send_binary_audio
+        self.hellos = 0
+
+    def restart(self):
+        """Starts a new session on the same connection, the device closed the previous one with a goodbye."""
+        if self.reply_task is not None and not self.reply_task.done():
+            self.reply_task.cancel()
+        self.session_id = str(uuid.uuid4())
+        self.listen_mode = None
+        self.listening = False
+        self.uplink_turn_frames = 0
+        self.uplink_messages = 0
+        self.last_uplink_sequence = None
+
+    def write_frame(self, opcode, payload):
+        header = bytearray([0x80 | opcode])
+        length = len(payload)
+        if length < 126:
+            header.append(length)
+        elif length < 65536:
+            header += bytes([126]) + struct.pack('>H', length)
+        else:
+            header += bytes([127]) + struct.pack('>Q', length)
+        self.writer.write(bytes(header) + payload)
+
+    async def send_text(self, message):
+        if self.closed:
+            return
+        self.write_frame(0x1, json.dumps(message, ensure_ascii=False).encode())
+        await self.writer.drain()
+
+    async def send_binary_audio(self, payload, timestamp, sequence):
+        if self.closed:
+            return
+        if self.version == 2:
+            # BinaryProtocol2: version, type, reserved, timestamp, payload_size
+            header = struct.pack('>HHIII', 2, 0, 0, timestamp & 0xffffffff, len(payload))
+        elif self.version == 3:
+            # BinaryProtocol3: type, reserved, payload_size
+            header = struct.pack('>BBH', 0, 0, len(payload))
+        else:
+            header = b''
+        self.write_frame(0x2, header + payload)
+        await self.writer.drain()
+
+    def parse_binary_audio(self, data):
+        """Opus frames of a binary message, type 2 carries several of them."""
+        if self.version == 2:
+            _, msg_type, _, _, size = struct.unpack_from('>HHIII', data)
+            payload = data[16:16 + size]
+        elif self.version == 3:
+            msg_type, _, size = struct.unpack_from('>BBH', data)
+            payload = data[4:4 + size]
+        else:
+            return [data]
+        return split_aggregated(payload) if msg_type == 2 else [payload]
+
+    async def read_frame(self):
+        b0, b1 = await self.reader.readexactly(2)
+        length = b1 & 0x7f
+        if length == 126:
+            length = struct.unpack('>H', await self.reader.readexactly(2))[0]
+        elif length == 127:
+            length = struct.unpack('>Q', await self.reader.readexactly(8))[0]
+        mask = await self.reader.readexactly(4) if b1 & 0x80 else None
+        payload = await self.reader.readexactly(length) if length else b''
+        if mask:
+            payload = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        return b0 & 0x80, b0 & 0x0f, payload
+
+    async def run(self):
+        message = bytearray()
+        message_opcode = 0
+        try:
+            while not self.closed:
+                fin, opcode, payload = await self.read_frame()
+                if opcode == 0x8:
+                    break
+                if opcode == 0x9:
+                    self.write_frame(0xa, payload)
+                    continue
+                if opcode in (0x1, 0x2):
+                    message_opcode = opcode
+                    message = bytearray(payload)
+                elif opcode == 0x0:
+                    message += payload
+                else:
+                    continue
+                if not fin:
+                    continue
+                if message_opcode == 0x2:
+                    self.on_uplink_message(self.parse_binary_audio(bytes(message)))
+                else:
+                    await self.handle_text(json.loads(message.decode()))
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        finally:
+            self.close()
+            self.writer.close()
+            self.event('disconnected')
+
+    async def handle_text(self, message):
+        if message.get('type') == 'hello':
+            if self.hellos > 0:
+                self.restart()
+                self.event('session_reused')
+            self.hellos += 1
+            if self.config.hello_delay_ms > 0:
+                await asyncio.sleep(self.config.hello_delay_ms / 1000)
+            hello = self.hello_iot(message, {
+                'type': 'hello',
+                'transport': 'websocket',
+                'session_id': self.session_id,
+                'audio_params': self.hello_audio_params(message),
+            })
+            self.hello_features(message, hello)
+            await self.send_text(hello)
+            self.event('hello', version=message.get('version'))
+        elif message.get('type') == 'goodbye':
+            # The session ends, the connection stays open for the next hello
+            self.event('goodbye', metrics=message.get('metrics'))
+            self.listening = False
+            if self.reply_task is not None and not self.reply_task.done():
+                self.reply_task.cancel()
+        else:
+            await self.handle_json(message)
+
+
+class ReferenceServer:
+    def __init__(self, config):
+        self.config = config
+        self.rng = random.Random(config.seed)
+        self.udp_sessions = {}
+        self.iot_descriptors = {}      # Device to the hash of the descriptors it uploaded
+        self.udp_transport = None
+        self.listeners = []
+        self.servers = []
+        self.tts_packets = []
+        for path in config.tts_files or default_tts_files():
+            self.tts_packets += load_p3(path)
+        logger.info('Loaded %d TTS frames (%.1f s)', len(self.tts_packets), len(self.tts_packets) * 0.06)
+
+    def emit(self, name, session, **fields):
+        """Reports an event with a time.monotonic() timestamp to every listener."""
+        now = time.monotonic()
+        logger.debug('%s %s %s', name, session.session_id if session else '-', fields)
+        for listener in self.listeners:
+            listener(now, name, session, fields)
+
+    def open_udp_session(self, mqtt):
+        session = UdpSession(self, mqtt)
+        self.udp_sessions[session.ssrc] = session
+        return session
+
+    def close_udp_session(self, session):
+        session.close()
+        self.udp_sessions.pop(session.ssrc, None)
+
+    async def start(self):
+        config = self.config
+        loop = asyncio.get_running_loop()
+        self.servers.append(await asyncio.start_server(self.handle_http, config.bind, config.http_port))
+        self.servers.append(await asyncio.start_server(self.handle_mqtt, config.bind, config.mqtt_port))
+        self.servers.append(await asyncio.start_server(self.handle_websocket, config.bind, config.ws_port))
+        self.udp_transport, _ = await loop.create_datagram_endpoint(
+            lambda: UdpProtocol(self), local_addr=(config.bind, config.udp_port))
+        logger.info('OTA http://%s:%d/xiaozhi/ota/ MQTT %d UDP %d WebSocket %d (v%d), advertising %s',
+                    config.public_host, config.http_port, config.mqtt_port, config.udp_port,
+                    config.ws_port, config.ws_version, config.transport)
+
+    def stop(self):
+        for server in self.servers:
+            server.close()
+        if self.udp_transport is not None:
+            self.udp_transport.close()
+
+    @property
+    def ota_url(self):
+        return 'http://%s:%d/xiaozhi/ota/' % (self.config.public_host, self.config.http_port)
+
+    def ota_response(self, headers, body):
+        config = self.config
+        device_id = headers.get('device-id', '')
+        client_id = headers.get('client-id', '')
+        try:
+            version = json.loads(body)['application']['version']
+        except (ValueError, KeyError, TypeError):
+            version = '0.0.0'
+        response = {
+            'server_time': {'timestamp': int(time.time() * 1000), 'timezone_offset': 480},
+            # Report the running version so that the device never tries to upgrade
+            'firmware': {'version': version, 'url': ''},
+        }
+        if config.transport == 'mqtt':
+            response['mqtt'] = {
+                'endpoint': '%s:%d' % (config.public_host, config.mqtt_port),
+                'client_id': 'GID_test@@@%s@@@%s' % (device_id.replace(':', '_'), client_id),
+                'username': '',
+                'password': '',
+                'publish_topic': 'device-server',
+            }
+        else:
+            response['websocket'] = {
+                'url': 'ws://%s:%d/xiaozhi/v1/' % (config.public_host, config.ws_port),
+                'token': config.ws_token,
+                'version': config.ws_version,
+            }
+        return response
+
+    async def read_http_request(self, reader):
+        request_line = (await reader.readline()).decode().strip()
+        headers = {}
+        while True:
+            line = (await reader.readline()).decode().strip()
+            if not line:
+                break
+            key, _, value = line.partition(':')
+            headers[key.strip().lower()] = value.strip()
+        return request_line, headers
+
+    async def handle_http(self, reader, writer):
+        try:
+            request_line, headers = await self.read_http_request(reader)
+            length = int(headers.get('content-length', 0))
+            body = (await reader.readexactly(length)).decode() if length else ''
+            payload = json.dumps(self.ota_response(headers, body)).encode()
+            writer.write(b'HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n'
+                         b'Content-Length: %d\r\nConnection: close\r\n\r\n' % len(payload) + payload)
+            await writer.drain()
+            self.emit('ota', None, request=request_line, device_id=headers.get('device-id'))
+        except (asyncio.IncompleteReadError, ConnectionError, ValueError):
+            pass
+        finally:
+            writer.close()
+
+    async def handle_mqtt(self, reader, writer):
+        writer.get_extra_info('socket').setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        await MqttConnection(self, reader, writer).run()
+
+    async def handle_websocket(self, reader, writer):
+        writer.get_extra_info('socket').setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        try:
+            request_line, headers = await self.read_http_request(reader)
+        except (asyncio.IncompleteReadError, ConnectionError):
+            writer.close()
+            return
+        token = headers.get('authorization', '')
+        if self.config.ws_token and token not in (self.config.ws_token, 'Bearer ' + self.config.ws_token):
+            writer.write(b'HTTP/1.1 401 Unauthorized\r\nContent-Length: 0\r\n\r\n')
+            writer.close()
+            return
+        if self.config.ws_connect_delay_ms > 0:
+            await asyncio.sleep(self.config.ws_connect_delay_ms / 1000)
+        key = headers.get('sec-websocket-key', '')
+        accept = base64.b64encode(hashlib.sha1((key + WS_GUID).encode()).digest()).decode()
+        writer.write(('HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n'
+                      'Sec-WebSocket-Accept: %s\r\n\r\n' % accept).encode())
+        await writer.drain()
+        version = int(headers.get('protocol-version', '1') or 1)
+        session = WebSocketSession(self, reader, writer, version, headers.get('device-id', ''))
+        session.event('connected')
+        await session.run()
+
+
+def build_config(args):
+    config = ServerConfig(
+        bind=args.bind, public_host=args.public_host, http_port=args.http_port, mqtt_port=args.mqtt_port,
+        udp_port=args.udp_port, ws_port=args.ws_port, transport=args.transport, ws_version=args.ws_version,
+        ws_token=args.ws_token, tts_files=args.tts or [], tts_repeat=args.tts_repeat, stt_text=args.stt_text,
+        reply_text=args.reply_text, think_ms=args.think_ms, hello_delay_ms=args.hello_delay_ms,
+        ws_connect_delay_ms=args.ws_connect_delay_ms,
+        request_telemetry=args.request_telemetry, utterance_ms=args.utterance_ms,
+        prebuffer_frames=args.prebuffer_frames, iot_every=args.iot_every, iot_cache=not args.no_iot_cache, jitter_ms=args.jitter_ms,
+        loss=args.loss, reorder=args.reorder, seed=args.seed, max_frames_per_packet=args.max_frames_per_packet)
+    if args.iot_command:
+        config.iot_command = json.loads(args.iot_command)
+    return config
+
+
+def add_server_arguments(parser):
+    group = parser.add_argument_group('server')
+    group.add_argument('--bind', default='0.0.0.0')
+    group.add_argument('--public-host', default='127.0.0.1', help='address the device uses to reach this server')
+    group.add_argument('--http-port', type=int, default=8002)
+    group.add_argument('--mqtt-port', type=int, default=1883)
+    group.add_argument('--udp-port', type=int, default=8884)
+    group.add_argument('--ws-port', type=int, default=8000)
+    group.add_argument('--transport', choices=['mqtt', 'websocket'], default='mqtt')
+    group.add_argument('--ws-version', type=int, choices=[1, 2, 3], default=1)
+    group.add_argument('--ws-token', default='test-token')
+    group.add_argument('--tts', action='append', help='.p3 file to stream as TTS, repeatable')
+    group.add_argument('--tts-repeat', type=int, default=3, help='times the TTS frames are repeated per reply')
+    group.add_argument('--stt-text', default='你好')
+    group.add_argument('--reply-text', default='这是本地参考服务器的测试回复。')
+    group.add_argument('--think-ms', type=int, default=0, help='delay between end of turn and the reply')
+    group.add_argument('--hello-delay-ms', type=int, default=0, help='delay before the hello reply')
+    group.add_argument('--ws-connect-delay-ms', type=int, default=0,
+                       help='delay before the WebSocket upgrade response')
+    group.add_argument('--request-telemetry', action='store_true',
+                       help='ask the device for its link metrics after every reply')
+    group.add_argument('--utterance-ms', type=int, default=1200, help='auto mode end of turn')
+    group.add_argument('--prebuffer-frames', type=int, default=3)
+    group.add_argument('--iot-every', type=int, default=0, help='inject an IoT command every N turns')
+    group.add_argument('--no-iot-cache', action='store_true',
+                       help='never echo the IoT descriptors hash, the device uploads them every session')
+    group.add_argument('--iot-command', help='IoT command JSON, defaults to Speaker.SetVolume(60)')
+    group.add_argument('--jitter-ms', type=int, default=0, help='uniform extra downlink delay per frame')
+    group.add_argument('--loss', type=float, default=0.0, help='downlink frame loss probability')
+    group.add_argument('--reorder', type=float, default=0.0, help='probability a frame is sent after the next one')
+    group.add_argument('--seed', type=int, default=1)
+    group.add_argument('--max-frames-per-packet', type=int, default=8,
+                       help='largest uplink aggregation accepted in the hello, 1 disables it')
+
+
+async def serve(config):
+    server = ReferenceServer(config)
+    await server.start()
+    await asyncio.Event().wait()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    add_server_arguments(parser)
+    parser.add_argument('-v', '--verbose', action='store_true')
+    args = parser.parse_args()
+    logging.basicConfig(level=logging.DEBUG if args.verbose else logging.INFO,
+                        format='%(asctime)s %(levelname)s %(message)s')
+    try:
+        asyncio.run(serve(build_config(args)))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+# Decode a xiaozhi deferred log dump into IDF style log lines
+#
+# The input can be the raw binary dump or a serial log that contains the
+# base64 block printed by DeferredLog::DumpToConsole()
+import argparse
+import base64
+import re
+import struct
+import sys
+
+BEGIN_MARKER = "-----BEGIN XIAOZHI LOG-----"
+END_MARKER = "-----END XIAOZHI LOG-----"
+MAGIC = b"XZLG"
+RECORD_HEADER_FORMAT = "<IIHH"
+
+ARG_END = 0
+ARG_INT32 = 1
+ARG_INT64 = 2
+ARG_DOUBLE = 3
+ARG_STRING = 4
+
+LEVEL_LETTERS = "NEWIDV"
+# Flags, width and precision are kept, length modifiers are dropped
+CONVERSION_RE = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|L|q|j|z|t)?([diouxXeEfFgGaAcsp%])")
+
+
+def extract_dumps(raw):
+    """Return every binary dump found in the input (raw or serial log)"""
+    if raw.startswith(MAGIC):
+        return [raw]
+    text = raw.decode("utf-8", errors="ignore")
+    dumps = []
+    inside = False
+    lines = []
+    for line in text.splitlines():
+        line = line.strip()
+        if line.endswith(BEGIN_MARKER):
+            inside = True
+            lines = []
+        elif line.endswith(END_MARKER) and inside:
+            inside = False
+            dumps.append(base64.b64decode("".join(lines)))
+        elif inside and line:
+            lines.append(line)
+    return dumps
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.offset = 0
+
+    def read(self, fmt):
+        values = struct.unpack_from(fmt, self.data, self.offset)
+        self.offset += struct.calcsize(fmt)
+        return values
+
+    def read_string(self):
+        (length,) = self.read("<B")
+        value = self.data[self.offset:self.offset + length].decode("utf-8", errors="replace")
+        self.offset += length
+        return value
+
+
+def parse_dump(data):
+    reader = Reader(data)
+    magic = data[:4]
+    if magic != MAGIC:
+        raise ValueError("Invalid log magic: %r" % magic)
+    reader.offset = 4
+    version, site_count, record_size, record_count = reader.read("<HHHI")
+    if version != 1:
+        raise ValueError("Unsupported log version %d" % version)
+
+    sites = {}
+    for _ in range(site_count):
+        site_id, level, suppressed_total = reader.read("<HBI")
+        tag = reader.read_string()
+        fmt = reader.read_string()
+        sites[site_id] = (level, suppressed_total, tag, fmt)
+
+    records = []
+    for _ in range(record_count):
+        record = data[reader.offset:reader.offset + record_size]
+        reader.offset += record_size
+        sequence, timestamp_ms, site_id, suppressed = struct.unpack_from(RECORD_HEADER_FORMAT, record)
+        if sequence == 0:
+            # Incomplete or overwritten while dumping
+            continue
+        records.append((sequence, timestamp_ms, site_id, suppressed, record[struct.calcsize(RECORD_HEADER_FORMAT):]))
+    return sites, records
+
+
+def decode_args(data):
+    args = []
+    offset = 0
+    while offset < len(data):
+        arg_type = data[offset]
+        offset += 1
+        if arg_type == ARG_INT32 and offset + 4 <= len(data):
+            args.append((arg_type, struct.unpack_from("<I", data, offset)[0]))
+            offset += 4
+        elif arg_type == ARG_INT64 and offset + 8 <= len(data):
+            args.append((arg_type, struct.unpack_from("<Q", data, offset)[0]))
+            offset += 8
+        elif arg_type == ARG_DOUBLE and offset + 8 <= len(data):
+            args.append((arg_type, struct.unpack_from("<d", data, offset)[0]))
+            offset += 8
+        elif arg_type == ARG_STRING and offset < len(data):
+            length = data[offset]
+            args.append((arg_type, data[offset + 1:offset + 1 + length].decode("utf-8", errors="replace")))
+            offset += 1 + length
+        else:
+            break
+    return args
+
+
+def format_record(fmt, args):
+    """Same rules as FormatRecord() on the device"""
+    args = iter(args)
+
+    def replace(match):
+        spec, conversion = match.groups()
+        if conversion == "%":
+            return "%"
+        arg = next(args, None)
+        if arg is None:
+            return "?"
+        arg_type, value = arg
+        if arg_type in (ARG_INT32, ARG_INT64):
+            bits = 32 if arg_type == ARG_INT32 else 64
+            if conversion == "p":
+                return "0x%0*x" % (bits // 4 if bits == 32 else 0, value)
+            if conversion in "di" and value >= 1 << (bits - 1):
+                value -= 1 << bits
+            if conversion == "c":
+                return chr(value & 0xff)
+            if conversion in "eEfFgGaA":
+                value = float(value)
+            if conversion == "s":
+                value = str(value)
+        elif arg_type == ARG_DOUBLE and conversion in "diouxXc":
+            value = int(value)
+        if conversion in "aA":
+            conversion = "e"
+        elif conversion == "p":
+            conversion = "x"
+        return ("%" + spec + conversion) % value
+
+    return CONVERSION_RE.sub(replace, fmt)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode xiaozhi deferred log dumps")
+    parser.add_argument("input", help="binary dump or serial log containing the base64 dump")
+    parser.add_argument("--stats", action="store_true", help="print the suppressed message counters per call site")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        raw = f.read()
+
+    dumps = extract_dumps(raw)
+    if not dumps:
+        print("No log dump found in %s" % args.input, file=sys.stderr)
+        sys.exit(1)
+
+    for index, dump in enumerate(dumps):
+        sites, records = parse_dump(dump)
+        if len(dumps) > 1:
+            print("==== dump %d ====" % index)
+        for _, timestamp_ms, site_id, suppressed, data in records:
+            if site_id not in sites:
+                continue
+            level, _, tag, fmt = sites[site_id]
+            line = "%s (%d) %s: %s" % (LEVEL_LETTERS[level], timestamp_ms, tag, format_record(fmt, decode_args(data)))
+            if suppressed > 0:
+                line += " (%d suppressed)" % suppressed
+            print(line)
+        if args.stats:
+            for site_id, (level, suppressed_total, tag, fmt) in sorted(sites.items()):
+                print("%6d suppressed  %s: %s" % (suppressed_total, tag, fmt))
+
+
+if __name__ == "__main__":
+    main()
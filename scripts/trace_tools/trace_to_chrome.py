@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+# Convert a xiaozhi binary event trace dump into Chrome trace JSON
+#
+# The input can be the raw binary dump or a serial log that contains the
+# base64 block printed by EventTrace::DumpToConsole(). The output can be
+# opened in chrome://tracing or https://ui.perfetto.dev
+import argparse
+import base64
+import json
+import struct
+import sys
+
+BEGIN_MARKER = "-----BEGIN XIAOZHI TRACE-----"
+END_MARKER = "-----END XIAOZHI TRACE-----"
+MAGIC = b"XZTR"
+EVENT_FORMAT = "<IHBBIi"
+EVENT_SIZE = struct.calcsize(EVENT_FORMAT)
+
+EVENT_BEGIN = 0
+EVENT_END = 1
+EVENT_INSTANT = 2
+EVENT_COUNTER = 3
+
+DEVICE_STATES = [
+    "unknown", "starting", "configuring", "idle", "connecting",
+    "listening", "speaking", "upgrading", "activating", "fatal_error",
+]
+
+
+def extract_dumps(raw):
+    """Return every binary dump found in the input (raw or serial log)"""
+    if raw.startswith(MAGIC):
+        return [raw]
+    text = raw.decode("utf-8", errors="ignore")
+    dumps = []
+    inside = False
+    lines = []
+    for line in text.splitlines():
+        line = line.strip()
+        if line.endswith(BEGIN_MARKER):
+            inside = True
+            lines = []
+        elif line.endswith(END_MARKER) and inside:
+            inside = False
+            dumps.append(base64.b64decode("".join(lines)))
+        elif inside and line:
+            lines.append(line)
+    return dumps
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.offset = 0
+
+    def read(self, fmt):
+        values = struct.unpack_from(fmt, self.data, self.offset)
+        self.offset += struct.calcsize(fmt)
+        return values
+
+    def read_string(self):
+        (length,) = self.read("<B")
+        value = self.data[self.offset:self.offset + length].decode("utf-8", errors="replace")
+        self.offset += length
+        return value
+
+
+def parse_dump(data):
+    reader = Reader(data)
+    magic = data[:4]
+    if magic != MAGIC:
+        raise ValueError("Invalid trace magic: %r" % magic)
+    reader.offset = 4
+    version, name_count, task_count, core_count = reader.read("<HHHH")
+    if version != 1:
+        raise ValueError("Unsupported trace version %d" % version)
+
+    names = {}
+    for _ in range(name_count):
+        (name_id,) = reader.read("<H")
+        names[name_id] = reader.read_string()
+
+    tasks = {}
+    for _ in range(task_count):
+        (handle,) = reader.read("<I")
+        tasks[handle] = reader.read_string()
+
+    cores = []
+    for _ in range(core_count):
+        (count,) = reader.read("<I")
+        events = []
+        for _ in range(count):
+            events.append(reader.read(EVENT_FORMAT))
+        cores.append(events)
+    return names, tasks, cores
+
+
+def unwrap_timestamps(events):
+    """The device stores the low 32 bits of the microsecond clock"""
+    result = []
+    base = 0
+    last = None
+    for event in events:
+        timestamp = event[0]
+        if last is not None and timestamp < last and last - timestamp > 0x80000000:
+            base += 1 << 32
+        last = timestamp
+        result.append((base + timestamp,) + tuple(event[1:]))
+    return result
+
+
+def to_chrome(names, tasks, cores):
+    trace_events = []
+    seen_tasks = {}
+
+    all_events = []
+    for events in cores:
+        all_events.extend(unwrap_timestamps(events))
+    all_events.sort(key=lambda e: e[0])
+    if not all_events:
+        return {"traceEvents": []}
+    origin = all_events[0][0]
+
+    for timestamp, name_id, event_type, core, task, value in all_events:
+        name = names.get(name_id, "name_%d" % name_id)
+        if task not in seen_tasks:
+            seen_tasks[task] = tasks.get(task, "task_%08x" % task)
+        event = {
+            "name": name,
+            "ts": timestamp - origin,
+            "pid": 0,
+            "tid": task,
+            "args": {"core": core},
+        }
+        if event_type == EVENT_BEGIN:
+            event["ph"] = "B"
+        elif event_type == EVENT_END:
+            event["ph"] = "E"
+        elif event_type == EVENT_INSTANT:
+            event["ph"] = "i"
+            event["s"] = "t"
+        elif event_type == EVENT_COUNTER:
+            event["ph"] = "C"
+            event["args"] = {name: value}
+            if name == "device_state" and 0 <= value < len(DEVICE_STATES):
+                # Also emit an instant so the state name is visible on the timeline
+                trace_events.append({
+                    "name": "state: " + DEVICE_STATES[value],
+                    "ph": "i", "s": "g",
+                    "ts": timestamp - origin, "pid": 0, "tid": task,
+                })
+        else:
+            continue
+        trace_events.append(event)
+
+    trace_events.append({"name": "process_name", "ph": "M", "pid": 0, "args": {"name": "xiaozhi"}})
+    for task, task_name in seen_tasks.items():
+        trace_events.append({
+            "name": "thread_name", "ph": "M", "pid": 0, "tid": task,
+            "args": {"name": task_name},
+        })
+    return {"traceEvents": trace_events, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert xiaozhi event trace dumps to Chrome trace JSON")
+    parser.add_argument("input", help="binary dump or serial log containing the base64 dump")
+    parser.add_argument("output", help="output JSON file, a suffix is added when the log has several dumps")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        raw = f.read()
+
+    dumps = extract_dumps(raw)
+    if not dumps:
+        print("No trace dump found in %s" % args.input, file=sys.stderr)
+        sys.exit(1)
+
+    for index, dump in enumerate(dumps):
+        names, tasks, cores = parse_dump(dump)
+        output = args.output
+        if len(dumps) > 1:
+            stem, dot, ext = output.rpartition(".")
+            output = "%s_%d.%s" % (stem, index, ext) if dot else "%s_%d" % (output, index)
+        with open(output, "w") as f:
+            json.dump(to_chrome(names, tasks, cores), f)
+        event_count = sum(len(events) for events in cores)
+        print("Wrote %d events from %d cores to %s" % (event_count, len(cores), output))
+
+
+if __name__ == "__main__":
+    main()